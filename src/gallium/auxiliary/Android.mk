@@ -28,7 +28,7 @@ include $(LOCAL_PATH)/Makefile.sources
 
 include $(CLEAR_VARS)
 
-LOCAL_SRC_FILES := $(C_SOURCES)
+LOCAL_SRC_FILES := $(C_SOURCES) $(SSSE3_SOURCES) $(AVX_SOURCES) $(AVX2_SOURCES)
 
 LOCAL_C_INCLUDES := $(GALLIUM_TOP)/auxiliary/util
 
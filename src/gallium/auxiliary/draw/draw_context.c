@@ -262,10 +262,37 @@ static void update_clip_flags( struct draw_context *draw )
                    draw->rasterizer && draw->rasterizer->depth_clip);
    draw->clip_user = draw->rasterizer &&
                      draw->rasterizer->clip_plane_enable != 0;
-   draw->guard_band_points_xy = draw->guard_band_xy ||
-                                (draw->driver.bypass_clip_points &&
+   draw->guard_band_points_xy = (draw->guard_band_xy ||
+                                 draw->driver.bypass_clip_points) &&
                                 (draw->rasterizer &&
-                                 draw->rasterizer->point_tri_clip));
+                                 draw->rasterizer->point_tri_clip);
+}
+
+
+/**
+ * Whether x/y clipping of the given (assembled) primitive type is done
+ * against the guard band rather than the viewport.
+ *
+ * Only filled triangles can use the guard band: GL points are discarded
+ * when their center is outside the viewport, and lines and unfilled
+ * polygons are widened after clipping, so they must be clipped at the
+ * viewport edges.
+ */
+boolean
+draw_guard_band_xy(const struct draw_context *draw, unsigned prim)
+{
+   const struct pipe_rasterizer_state *rast = draw->rasterizer;
+
+   if (prim == PIPE_PRIM_POINTS ||
+       rast->fill_front == PIPE_POLYGON_MODE_POINT)
+      return draw->guard_band_points_xy;
+
+   if (u_reduced_prim(prim) != PIPE_PRIM_TRIANGLES ||
+       rast->fill_front != PIPE_POLYGON_MODE_FILL ||
+       rast->fill_back != PIPE_POLYGON_MODE_FILL)
+      return FALSE;
+
+   return draw->guard_band_xy;
 }
 
 /**
@@ -503,6 +530,19 @@ draw_set_force_passthrough( struct draw_context *draw, boolean enable )
 }
 
 
+/**
+ * Set the number of entries of the post-transform vertex cache, which is
+ * also the most vertices shaded at once by indexed draws.  Rounded up to
+ * a power of two, within the limits of draw_pt_vsplit.c.
+ */
+void
+draw_set_vertex_cache_size( struct draw_context *draw, unsigned size )
+{
+   draw_do_flush( draw, DRAW_FLUSH_STATE_CHANGE );
+   draw->pt.vertex_cache_size = size;
+}
+
+
 
 /**
  * Allocate an extra vertex/geometry shader vertex attribute, if it doesn't
@@ -1031,6 +1071,27 @@ draw_collect_pipeline_statistics(struct draw_context *draw,
    draw->collect_statistics = enable;
 }
 
+/**
+ * Returns the counts of primitives which went through the draw pipeline
+ * stages, rather than straight to the vbuf backend, since the context was
+ * created.
+ */
+const struct draw_clip_counters *
+draw_get_clip_counters(const struct draw_context *draw)
+{
+   return &draw->clip_counters;
+}
+
+/**
+ * Returns the counts of elements drawn and vertices shaded by indexed
+ * draws since the context was created.
+ */
+const struct draw_vertex_cache_counters *
+draw_get_vertex_cache_counters(const struct draw_context *draw)
+{
+   return &draw->vertex_cache_counters;
+}
+
 /**
  * Computes clipper invocation statistics.
  *
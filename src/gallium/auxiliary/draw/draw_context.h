@@ -268,6 +268,9 @@ void draw_set_driver_clipping( struct draw_context *draw,
 void draw_set_force_passthrough( struct draw_context *draw, 
                                  boolean enable );
 
+void draw_set_vertex_cache_size( struct draw_context *draw,
+                                 unsigned size );
+
 
 /*******************************************************************************
  * Draw statistics
@@ -275,6 +278,45 @@ void draw_set_force_passthrough( struct draw_context *draw,
 void draw_collect_pipeline_statistics(struct draw_context *draw,
                                       boolean enable);
 
+/**
+ * Counts of the primitives which left the vertex processing fast path.
+ */
+struct draw_clip_counters
+{
+   uint64_t pipeline_prims;   /**< prims run through the pipeline stages */
+   uint64_t clipped_prims;    /**< prims split by the clip stage */
+   uint64_t culled_prims;     /**< triangles culled ahead of clipping */
+};
+
+const struct draw_clip_counters *
+draw_get_clip_counters(const struct draw_context *draw);
+
+/**
+ * Counts of the elements of indexed draws, and of the vertices shaded
+ * for them, i.e. the misses of the post-transform vertex cache.
+ */
+struct draw_vertex_cache_counters
+{
+   uint64_t indices;
+   uint64_t shaded_vertices;
+};
+
+const struct draw_vertex_cache_counters *
+draw_get_vertex_cache_counters(const struct draw_context *draw);
+
+/*******************************************************************************
+ * Worker threads, which drivers may use for their own parallel jobs
+ * between draw calls into the draw module.
+ */
+unsigned
+draw_get_num_threads(const struct draw_context *draw);
+
+void
+draw_run_jobs(struct draw_context *draw,
+              void (*func)(void *data, unsigned job),
+              void *data,
+              unsigned num_jobs);
+
 /*******************************************************************************
  * Draw pipeline 
  */
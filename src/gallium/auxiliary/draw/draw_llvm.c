@@ -44,12 +44,14 @@
 #include "gallivm/lp_bld_printf.h"
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_cache.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_pack.h"
 #include "gallivm/lp_bld_format.h"
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
 
 #include "util/u_math.h"
 #include "util/u_pointer.h"
@@ -584,6 +586,16 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    variant->gallivm = gallivm_create();
 
+   lp_build_cache_key(variant->gallivm, "vs", 2);
+   lp_build_cache_key(variant->gallivm, shader->base.state.tokens,
+                      tgsi_num_tokens(shader->base.state.tokens) *
+                      sizeof(struct tgsi_token));
+   lp_build_cache_key(variant->gallivm, &llvm->draw->vs.position_output,
+                      sizeof llvm->draw->vs.position_output);
+   lp_build_cache_key(variant->gallivm, &llvm->draw->vs.clipvertex_output,
+                      sizeof llvm->draw->vs.clipvertex_output);
+   lp_build_cache_key(variant->gallivm, key, shader->variant_key_size);
+
    create_jit_types(variant);
 
    memcpy(&variant->key, key, shader->variant_key_size);
@@ -651,6 +663,7 @@ generate_vs(struct draw_llvm_variant *variant,
                      outputs,
                      sampler,
                      &llvm->draw->vs.vertex_shader->info,
+                     NULL,
                      NULL);
 
    {
@@ -1157,6 +1170,7 @@ generate_clipmask(struct draw_llvm *llvm,
                   struct lp_type vs_type,
                   LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
                   boolean clip_xy,
+                  boolean guard_band_xy,
                   boolean clip_z,
                   boolean clip_user,
                   boolean clip_halfz,
@@ -1218,27 +1232,36 @@ generate_clipmask(struct draw_llvm *llvm,
 
    /* Cliptest, for hardwired planes */
    if (clip_xy) {
+      LLVMValueRef xy_x = pos_x, xy_y = pos_y;
+
+      if (guard_band_xy) {
+         /* The guard band planes are at twice the viewport extents */
+         LLVMValueRef half = lp_build_const_vec(gallivm, f32_type, 0.5);
+         xy_x = LLVMBuildFMul(builder, pos_x, half, "");
+         xy_y = LLVMBuildFMul(builder, pos_y, half, "");
+      }
+
       /* plane 1 */
-      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, pos_x , pos_w);
+      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, xy_x , pos_w);
       temp = shift;
       test = LLVMBuildAnd(builder, test, temp, "");
       mask = test;
 
       /* plane 2 */
-      test = LLVMBuildFAdd(builder, pos_x, pos_w, "");
+      test = LLVMBuildFAdd(builder, xy_x, pos_w, "");
       test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, zero, test);
       temp = LLVMBuildShl(builder, temp, shift, "");
       test = LLVMBuildAnd(builder, test, temp, "");
       mask = LLVMBuildOr(builder, mask, test, "");
 
       /* plane 3 */
-      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, pos_y, pos_w);
+      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, xy_y, pos_w);
       temp = LLVMBuildShl(builder, temp, shift, "");
       test = LLVMBuildAnd(builder, test, temp, "");
       mask = LLVMBuildOr(builder, mask, test, "");
 
       /* plane 4 */
-      test = LLVMBuildFAdd(builder, pos_y, pos_w, "");
+      test = LLVMBuildFAdd(builder, xy_y, pos_w, "");
       test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, zero, test);
       temp = LLVMBuildShl(builder, temp, shift, "");
       test = LLVMBuildAnd(builder, test, temp, "");
@@ -1784,6 +1807,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
                                          vs_type,
                                          outputs,
                                          key->clip_xy,
+                                         key->guard_band_xy,
                                          key->clip_z,
                                          key->clip_user,
                                          key->clip_halfz,
@@ -1828,7 +1852,8 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
 
 
 struct draw_llvm_variant_key *
-draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
+draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store,
+                           boolean guard_band_xy)
 {
    unsigned i;
    struct draw_llvm_variant_key *key;
@@ -1849,6 +1874,7 @@ draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
 
    /* will have to rig this up properly later */
    key->clip_xy = llvm->draw->clip_xy;
+   key->guard_band_xy = llvm->draw->clip_xy && guard_band_xy;
    key->clip_z = llvm->draw->clip_z;
    key->clip_user = llvm->draw->clip_user;
    key->bypass_viewport = llvm->draw->identity_viewport;
@@ -1901,6 +1927,7 @@ draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key)
 
    debug_printf("clamp_vertex_color = %u\n", key->clamp_vertex_color);
    debug_printf("clip_xy = %u\n", key->clip_xy);
+   debug_printf("guard_band_xy = %u\n", key->guard_band_xy);
    debug_printf("clip_z = %u\n", key->clip_z);
    debug_printf("clip_user = %u\n", key->clip_user);
    debug_printf("bypass_viewport = %u\n", key->bypass_viewport);
@@ -2206,7 +2233,8 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
                      outputs,
                      sampler,
                      &llvm->draw->gs.geometry_shader->info,
-                     (const struct lp_build_tgsi_gs_iface *)&gs_iface);
+                     (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                     NULL);
 
    sampler->destroy(sampler);
 
@@ -2239,6 +2267,12 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
 
    variant->gallivm = gallivm_create();
 
+   lp_build_cache_key(variant->gallivm, "gs", 2);
+   lp_build_cache_key(variant->gallivm, shader->base.state.tokens,
+                      tgsi_num_tokens(shader->base.state.tokens) *
+                      sizeof(struct tgsi_token));
+   lp_build_cache_key(variant->gallivm, key, shader->variant_key_size);
+
    create_gs_jit_types(variant);
 
    memcpy(&variant->key, key, shader->variant_key_size);
@@ -305,6 +305,7 @@ struct draw_llvm_variant_key
    unsigned nr_sampler_views:8;
    unsigned clamp_vertex_color:1;
    unsigned clip_xy:1;
+   unsigned guard_band_xy:1;
    unsigned clip_z:1;
    unsigned clip_user:1;
    unsigned clip_halfz:1;
@@ -317,7 +318,7 @@ struct draw_llvm_variant_key
     * (and all padding gets zeroed).
     */
    unsigned ucp_enable:PIPE_MAX_CLIP_PLANES;
-   unsigned pad1:24-PIPE_MAX_CLIP_PLANES;
+   unsigned pad1:23-PIPE_MAX_CLIP_PLANES;
 
    /* Variable number of vertex elements:
     */
@@ -500,7 +501,8 @@ void
 draw_llvm_destroy_variant(struct draw_llvm_variant *variant);
 
 struct draw_llvm_variant_key *
-draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
+draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store,
+                           boolean guard_band_xy);
 
 void
 draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key);
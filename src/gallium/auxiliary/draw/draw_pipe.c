@@ -121,6 +121,7 @@ static void do_point( struct draw_context *draw,
    prim.pad = 0;
    prim.v[0] = (struct vertex_header *)v0;
 
+   draw->clip_counters.pipeline_prims++;
    draw->pipeline.first->point( draw->pipeline.first, &prim );
 }
 
@@ -141,6 +142,7 @@ static void do_line( struct draw_context *draw,
    prim.v[0] = (struct vertex_header *)v0;
    prim.v[1] = (struct vertex_header *)v1;
 
+   draw->clip_counters.pipeline_prims++;
    draw->pipeline.first->line( draw->pipeline.first, &prim );
 }
 
@@ -163,6 +165,7 @@ static void do_triangle( struct draw_context *draw,
    prim.flags = flags;
    prim.pad = 0;
 
+   draw->clip_counters.pipeline_prims++;
    draw->pipeline.first->tri( draw->pipeline.first, &prim );
 }
 
@@ -683,12 +683,61 @@ clip_line( struct draw_stage *stage,
    }
    else if ((header->v[0]->clipmask &
              header->v[1]->clipmask) == 0) {
+      stage->draw->clip_counters.clipped_prims++;
       do_clip_line(stage, header, clipmask);
    }
    /* else, totally clipped */
 }
 
 
+/**
+ * Do the zero-area and face culling of the cull stage ahead of clipping,
+ * so that back-facing triangles straddling the clip planes don't get
+ * clipped only to be thrown away afterwards.
+ *
+ * With all w > 0 the determinant of the homogeneous (x, y, w) positions
+ * has the sign of the window coordinates determinant, up to the flip
+ * of the viewport transform.  Otherwise the clipped polygon orientation
+ * isn't known until after clipping, and the cull stage takes care of it.
+ *
+ * \return TRUE if the triangle was culled
+ */
+static boolean
+cull_tri_before_clip( struct draw_stage *stage,
+                      struct prim_header *header )
+{
+   struct draw_context *draw = stage->draw;
+   const float *v0 = header->v[0]->pre_clip_pos;
+   const float *v1 = header->v[1]->pre_clip_pos;
+   const float *v2 = header->v[2]->pre_clip_pos;
+   const float *scale;
+   float det;
+
+   if (!(v0[3] > 0.0f && v1[3] > 0.0f && v2[3] > 0.0f))
+      return FALSE;
+
+   scale = draw->viewports[draw_viewport_index(draw, header->v[0])].scale;
+
+   det = (v0[0] * (v1[1] * v2[3] - v2[1] * v1[3]) -
+          v1[0] * (v0[1] * v2[3] - v2[1] * v0[3]) +
+          v2[0] * (v0[1] * v1[3] - v1[1] * v0[3])) * (scale[0] * scale[1]);
+
+   if (det != 0.0f) {
+      /* same convention as the cull stage */
+      unsigned ccw = (det < 0);
+      unsigned face = ((ccw == draw->rasterizer->front_ccw) ?
+                       PIPE_FACE_FRONT :
+                       PIPE_FACE_BACK);
+
+      if ((face & draw->rasterizer->cull_face) == 0)
+         return FALSE;
+   }
+
+   draw->clip_counters.culled_prims++;
+   return TRUE;
+}
+
+
 static void
 clip_tri( struct draw_stage *stage,
           struct prim_header *header )
@@ -704,6 +753,10 @@ clip_tri( struct draw_stage *stage,
    else if ((header->v[0]->clipmask & 
              header->v[1]->clipmask & 
              header->v[2]->clipmask) == 0) {
+      if (cull_tri_before_clip(stage, header))
+         return;
+
+      stage->draw->clip_counters.clipped_prims++;
       do_clip_tri(stage, header, clipmask);
    }
 }
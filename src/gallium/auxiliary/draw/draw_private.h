@@ -45,6 +45,7 @@
 #include "pipe/p_defines.h"
 
 #include "tgsi/tgsi_scan.h"
+#include "draw_context.h"
 
 #ifdef HAVE_LLVM
 struct draw_llvm;
@@ -170,6 +171,9 @@ struct draw_context
          struct draw_pt_front_end *vsplit;
       } front;
 
+      /** Post-transform vertex cache entries, see draw_pt_vsplit.c */
+      unsigned vertex_cache_size;
+
       struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
       unsigned nr_vertex_buffers;
 
@@ -211,6 +215,9 @@ struct draw_context
 
       boolean test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       boolean no_fse;           /* disable FSE even when it is correct */
+
+      /** Worker threads for vertex shading, or NULL (DRAW_NUM_THREADS) */
+      struct draw_pt_threads *threads;
    } pt;
 
    struct {
@@ -335,6 +342,9 @@ struct draw_context
    struct pipe_query_data_pipeline_statistics statistics;
    boolean collect_statistics;
 
+   struct draw_clip_counters clip_counters;
+   struct draw_vertex_cache_counters vertex_cache_counters;
+
    struct draw_assembler *ia;
 
    void *driver_private;
@@ -410,6 +420,7 @@ int draw_alloc_extra_vertex_attrib(struct draw_context *draw,
 void draw_remove_extra_vertex_attribs(struct draw_context *draw);
 boolean draw_current_shader_uses_viewport_index(
    const struct draw_context *draw);
+boolean draw_guard_band_xy(const struct draw_context *draw, unsigned prim);
 
 
 /*******************************************************************************
@@ -45,6 +45,10 @@
 
 DEBUG_GET_ONCE_BOOL_OPTION(draw_fse, "DRAW_FSE", FALSE)
 DEBUG_GET_ONCE_BOOL_OPTION(draw_no_fse, "DRAW_NO_FSE", FALSE)
+DEBUG_GET_ONCE_NUM_OPTION(draw_vertex_cache_size, "DRAW_VERTEX_CACHE_SIZE", 1024)
+#if HAVE_LLVM
+DEBUG_GET_ONCE_NUM_OPTION(draw_num_threads, "DRAW_NUM_THREADS", 0)
+#endif
 
 /* Overall we split things into:
  *     - frontend -- prepare fetch_elts, draw_elts - eg vsplit
@@ -174,6 +178,7 @@ boolean draw_pt_init( struct draw_context *draw )
 {
    draw->pt.test_fse = debug_get_option_draw_fse();
    draw->pt.no_fse = debug_get_option_draw_no_fse();
+   draw->pt.vertex_cache_size = debug_get_option_draw_vertex_cache_size();
 
    draw->pt.front.vsplit = draw_pt_vsplit(draw);
    if (!draw->pt.front.vsplit)
@@ -192,8 +197,13 @@ boolean draw_pt_init( struct draw_context *draw )
       return FALSE;
 
 #if HAVE_LLVM
-   if (draw->llvm)
+   if (draw->llvm) {
       draw->pt.middle.llvm = draw_pt_fetch_pipeline_or_emit_llvm( draw );
+
+      /* Only the llvm middle end shades vertices in parallel */
+      draw->pt.threads =
+         draw_pt_threads_create(debug_get_option_draw_num_threads());
+   }
 #endif
 
    return TRUE;
@@ -202,6 +212,11 @@ boolean draw_pt_init( struct draw_context *draw )
 
 void draw_pt_destroy( struct draw_context *draw )
 {
+   if (draw->pt.threads) {
+      draw_pt_threads_destroy( draw->pt.threads );
+      draw->pt.threads = NULL;
+   }
+
    if (draw->pt.middle.llvm) {
       draw->pt.middle.llvm->destroy( draw->pt.middle.llvm );
       draw->pt.middle.llvm = NULL;
@@ -229,6 +244,31 @@ void draw_pt_destroy( struct draw_context *draw )
 }
 
 
+/**
+ * Number of worker threads, not counting the calling thread.
+ */
+unsigned
+draw_get_num_threads(const struct draw_context *draw)
+{
+   return draw_pt_threads_count(draw->pt.threads);
+}
+
+
+/**
+ * Run func(data, job) for job = 0 .. num_jobs-1 on the worker threads and
+ * the calling thread, and return once all are done.  Must not be called
+ * from the jobs themselves.
+ */
+void
+draw_run_jobs(struct draw_context *draw,
+              void (*func)(void *data, unsigned job),
+              void *data,
+              unsigned num_jobs)
+{
+   draw_pt_threads_run(draw->pt.threads, func, data, num_jobs);
+}
+
+
 /**
  * Debug- print the first 'count' vertices.
  */
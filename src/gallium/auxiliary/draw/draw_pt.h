@@ -242,6 +242,27 @@ struct pt_post_vs *draw_pt_post_vs_create( struct draw_context *draw );
 void draw_pt_post_vs_destroy( struct pt_post_vs *pvs );
 
 
+/*******************************************************************************
+ * Worker threads:
+ */
+#define DRAW_PT_MAX_THREADS 32
+
+struct draw_pt_threads;
+
+typedef void (*draw_pt_thread_func)(void *data, unsigned job);
+
+struct draw_pt_threads *draw_pt_threads_create(unsigned num_threads);
+
+void draw_pt_threads_destroy(struct draw_pt_threads *threads);
+
+unsigned draw_pt_threads_count(const struct draw_pt_threads *threads);
+
+void draw_pt_threads_run(struct draw_pt_threads *threads,
+                         draw_pt_thread_func func,
+                         void *data,
+                         unsigned num_jobs);
+
+
 /*******************************************************************************
  * Utils: 
  */
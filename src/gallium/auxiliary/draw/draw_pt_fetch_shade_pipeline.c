@@ -82,8 +82,7 @@ fetch_pipeline_prepare(struct draw_pt_middle_end *middle,
                                  u_assembled_prim(prim));
    unsigned nr_vs_outputs = draw_total_vs_outputs(draw);
    unsigned nr = MAX2(vs->info.num_inputs, nr_vs_outputs);
-   unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
-                         gs_out_prim == PIPE_PRIM_POINTS;
+   const boolean guard_band = draw_guard_band_xy(draw, gs_out_prim);
 
    if (gs) {
       nr = MAX2(nr, gs->info.num_outputs + 1);
@@ -115,8 +114,7 @@ fetch_pipeline_prepare(struct draw_pt_middle_end *middle,
                             draw->clip_xy,
                             draw->clip_z,
                             draw->clip_user,
-                            point_clip ? draw->guard_band_points_xy :
-                                         draw->guard_band_xy,
+                            guard_band,
                             draw->identity_viewport,
                             draw->rasterizer->clip_halfz,
                             (draw->vs.edgeflag_output ? TRUE : FALSE) );
@@ -149,8 +149,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
    struct draw_geometry_shader *gs = draw->gs.geometry_shader;
    const unsigned out_prim = gs ? gs->output_primitive :
       u_assembled_prim(in_prim);
-   unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
-                         out_prim == PIPE_PRIM_POINTS;
+   const boolean guard_band = draw_guard_band_xy(draw, out_prim);
    unsigned nr;
 
    fpme->input_prim = in_prim;
@@ -160,8 +159,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
                             draw->clip_xy,
                             draw->clip_z,
                             draw->clip_user,
-                            point_clip ? draw->guard_band_points_xy :
-                                         draw->guard_band_xy,
+                            guard_band,
                             draw->identity_viewport,
                             draw->rasterizer->clip_halfz,
                             (draw->vs.edgeflag_output ? TRUE : FALSE) );
@@ -216,7 +214,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
       char store[DRAW_LLVM_MAX_VARIANT_KEY_SIZE];
       unsigned i;
 
-      key = draw_llvm_make_variant_key(fpme->llvm, store);
+      key = draw_llvm_make_variant_key(fpme->llvm, store, guard_band);
 
       /* Search shader's list of variants for the key */
       li = first_elem(&shader->variants);
@@ -341,6 +339,115 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Run the fetch/vs/cliptest jit function for count vertices starting at
+ * vertex offset of the fetch, writing them at the same offset of verts.
+ */
+static int
+llvm_pipeline_shade_range(struct llvm_middle_end *fpme,
+                          const struct draw_fetch_info *fetch_info,
+                          struct vertex_header *verts,
+                          unsigned offset,
+                          unsigned count)
+{
+   struct draw_context *draw = fpme->draw;
+   struct vertex_header *out = (struct vertex_header *)
+      ((char *) verts + offset * fpme->vertex_size);
+
+   if (fetch_info->linear)
+      return fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                       out,
+                                       draw->pt.user.vbuffer,
+                                       fetch_info->start + offset,
+                                       count,
+                                       fpme->vertex_size,
+                                       draw->pt.vertex_buffer,
+                                       draw->instance_id,
+                                       draw->start_index);
+   else
+      return fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                            out,
+                                            draw->pt.user.vbuffer,
+                                            fetch_info->elts + offset,
+                                            draw->pt.user.eltMax,
+                                            count,
+                                            fpme->vertex_size,
+                                            draw->pt.vertex_buffer,
+                                            draw->instance_id,
+                                            draw->pt.user.eltBias);
+}
+
+
+/**
+ * Minimum number of vertices shaded by one job.  Must be a multiple of
+ * the vector length, as the jit function writes whole vectors of vertices
+ * and jobs must not overwrite each other's output.
+ */
+#define SHADE_JOB_MIN_VERTICES 128
+
+struct llvm_shade_jobs {
+   struct llvm_middle_end *fpme;
+   const struct draw_fetch_info *fetch_info;
+   struct vertex_header *verts;
+   unsigned job_size;
+   int clipped[DRAW_PT_MAX_THREADS + 1];
+};
+
+
+static void
+llvm_pipeline_shade_job(void *data, unsigned job)
+{
+   struct llvm_shade_jobs *jobs = (struct llvm_shade_jobs *) data;
+   unsigned offset = job * jobs->job_size;
+   unsigned count = MIN2(jobs->job_size, jobs->fetch_info->count - offset);
+
+   jobs->clipped[job] = llvm_pipeline_shade_range(jobs->fpme,
+                                                  jobs->fetch_info,
+                                                  jobs->verts,
+                                                  offset, count);
+}
+
+
+/**
+ * Fetch and shade all the vertices of a fetch.  Large fetches are split
+ * in chunks which are shaded in parallel on the draw worker threads.
+ * Vertices are independent of each other at this stage, and the results
+ * end up at the same place as with a single call, so everything
+ * downstream sees the vertices and primitives in their original order.
+ */
+static int
+llvm_pipeline_shade(struct llvm_middle_end *fpme,
+                    const struct draw_fetch_info *fetch_info,
+                    struct vertex_header *verts)
+{
+   struct draw_pt_threads *threads = fpme->draw->pt.threads;
+   unsigned max_jobs = draw_pt_threads_count(threads) + 1;
+   unsigned count = fetch_info->count;
+   struct llvm_shade_jobs jobs;
+   unsigned num_jobs, i;
+   int clipped = 0;
+
+   STATIC_ASSERT(SHADE_JOB_MIN_VERTICES % (LP_MAX_VECTOR_WIDTH / 32) == 0);
+
+   if (max_jobs == 1 || count < 2 * SHADE_JOB_MIN_VERTICES)
+      return llvm_pipeline_shade_range(fpme, fetch_info, verts, 0, count);
+
+   jobs.fpme = fpme;
+   jobs.fetch_info = fetch_info;
+   jobs.verts = verts;
+   jobs.job_size = align((count + max_jobs - 1) / max_jobs,
+                         SHADE_JOB_MIN_VERTICES);
+   num_jobs = (count + jobs.job_size - 1) / jobs.job_size;
+
+   draw_pt_threads_run(threads, llvm_pipeline_shade_job, &jobs, num_jobs);
+
+   for (i = 0; i < num_jobs; i++)
+      clipped |= jobs.clipped[i];
+
+   return clipped;
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -378,27 +485,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id,
-                                       draw->start_index);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            draw->pt.user.eltMax,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id,
-                                            draw->pt.user.eltBias);
+   clipped = llvm_pipeline_shade(fpme, fetch_info, llvm_vert_info.verts);
 
    /* Finished with fetch and vs:
     */
@@ -0,0 +1,210 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * A small pool of worker threads, used to run independent jobs of the
+ * vertex pipeline (e.g. shading chunks of vertices) in parallel.
+ *
+ * The calling thread takes part in the work, and draw_pt_threads_run()
+ * only returns once all the jobs are done, so the rest of the pipeline
+ * (clipping, primitive assembly, emit) stays in order on the calling
+ * thread.
+ */
+
+#include "os/os_thread.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "draw/draw_pt.h"
+
+
+struct draw_pt_threads {
+   pipe_mutex mutex;
+   pipe_condvar work_cond;   /**< a new batch of jobs is available */
+   pipe_condvar done_cond;   /**< all jobs of the batch are done */
+
+   /* Current batch of jobs, protected by the mutex */
+   draw_pt_thread_func func;
+   void *data;
+   unsigned num_jobs;
+   unsigned next_job;
+   unsigned jobs_done;
+   unsigned batch;           /**< incremented for each new batch */
+
+   boolean exit_flag;
+
+   unsigned num_threads;
+   pipe_thread threads[DRAW_PT_MAX_THREADS];
+};
+
+
+/**
+ * Run jobs of the current batch until none are left.
+ * Called and returns with the mutex held.
+ */
+static void
+run_jobs(struct draw_pt_threads *threads)
+{
+   while (threads->next_job < threads->num_jobs) {
+      unsigned job = threads->next_job++;
+
+      pipe_mutex_unlock(threads->mutex);
+      threads->func(threads->data, job);
+      pipe_mutex_lock(threads->mutex);
+
+      if (++threads->jobs_done == threads->num_jobs)
+         pipe_condvar_broadcast(threads->done_cond);
+   }
+}
+
+
+static PIPE_THREAD_ROUTINE( thread_function, init_data )
+{
+   struct draw_pt_threads *threads = (struct draw_pt_threads *) init_data;
+   unsigned batch = 0;
+
+   /* Match the FP state draw_vbo() sets on the calling thread, which also
+    * runs jobs, so that all chunks treat denorms the same.
+    */
+   util_fpstate_set_denorms_to_zero(util_fpstate_get());
+
+   pipe_mutex_lock(threads->mutex);
+
+   while (1) {
+      while (!threads->exit_flag && threads->batch == batch)
+         pipe_condvar_wait(threads->work_cond, threads->mutex);
+
+      if (threads->exit_flag)
+         break;
+
+      batch = threads->batch;
+      run_jobs(threads);
+   }
+
+   pipe_mutex_unlock(threads->mutex);
+
+   return 0;
+}
+
+
+struct draw_pt_threads *
+draw_pt_threads_create(unsigned num_threads)
+{
+   struct draw_pt_threads *threads;
+   unsigned i;
+
+   num_threads = MIN2(num_threads, DRAW_PT_MAX_THREADS);
+   if (num_threads == 0)
+      return NULL;
+
+   threads = CALLOC_STRUCT(draw_pt_threads);
+   if (!threads)
+      return NULL;
+
+   pipe_mutex_init(threads->mutex);
+   pipe_condvar_init(threads->work_cond);
+   pipe_condvar_init(threads->done_cond);
+
+   for (i = 0; i < num_threads; i++) {
+      threads->threads[i] = pipe_thread_create(thread_function, threads);
+      if (!threads->threads[i])
+         break;
+   }
+   threads->num_threads = i;
+
+   if (threads->num_threads == 0) {
+      draw_pt_threads_destroy(threads);
+      return NULL;
+   }
+
+   return threads;
+}
+
+
+void
+draw_pt_threads_destroy(struct draw_pt_threads *threads)
+{
+   unsigned i;
+
+   pipe_mutex_lock(threads->mutex);
+   threads->exit_flag = TRUE;
+   pipe_condvar_broadcast(threads->work_cond);
+   pipe_mutex_unlock(threads->mutex);
+
+   for (i = 0; i < threads->num_threads; i++)
+      pipe_thread_wait(threads->threads[i]);
+
+   pipe_condvar_destroy(threads->done_cond);
+   pipe_condvar_destroy(threads->work_cond);
+   pipe_mutex_destroy(threads->mutex);
+
+   FREE(threads);
+}
+
+
+/** Number of worker threads, not counting the calling thread */
+unsigned
+draw_pt_threads_count(const struct draw_pt_threads *threads)
+{
+   return threads ? threads->num_threads : 0;
+}
+
+
+/**
+ * Run func(data, job) for job = 0 .. num_jobs-1, spread over the worker
+ * threads and the calling thread.  Returns when all jobs are done.
+ */
+void
+draw_pt_threads_run(struct draw_pt_threads *threads,
+                    draw_pt_thread_func func,
+                    void *data,
+                    unsigned num_jobs)
+{
+   unsigned i;
+
+   if (!threads || num_jobs <= 1) {
+      for (i = 0; i < num_jobs; i++)
+         func(data, i);
+      return;
+   }
+
+   pipe_mutex_lock(threads->mutex);
+
+   threads->func = func;
+   threads->data = data;
+   threads->num_jobs = num_jobs;
+   threads->next_job = 0;
+   threads->jobs_done = 0;
+   threads->batch++;
+   pipe_condvar_broadcast(threads->work_cond);
+
+   run_jobs(threads);
+
+   while (threads->jobs_done < threads->num_jobs)
+      pipe_condvar_wait(threads->done_cond, threads->mutex);
+
+   pipe_mutex_unlock(threads->mutex);
+}
@@ -29,9 +29,16 @@
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
+#include "draw/draw_vbuf.h"
 
-#define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+/* Largest number of vertices fetched, and elements drawn, per segment */
+#define MAX_SEGMENT_SIZE 4096
+#define MAX_DRAW_ELTS    (4 * MAX_SEGMENT_SIZE)
+
+/* The fetch to draw element map is set-associative, with FIFO replacement
+ * within each set.
+ */
+#define MAP_WAYS 4
 
 /* The largest possible index withing an index buffer */
 #define MAX_ELT_IDX 0xffffffff
@@ -46,17 +53,21 @@ struct vsplit_frontend {
 
    unsigned max_vertices;
    ushort segment_size;
+   unsigned max_draw_elts;
 
    /* buffers for splitting */
-   unsigned fetch_elts[SEGMENT_SIZE];
-   ushort draw_elts[SEGMENT_SIZE];
-   ushort identity_draw_elts[SEGMENT_SIZE];
+   unsigned fetch_elts[MAX_SEGMENT_SIZE];
+   ushort draw_elts[MAX_DRAW_ELTS];
+   ushort identity_draw_elts[MAX_SEGMENT_SIZE];
 
    struct {
       /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      unsigned fetches[MAX_SEGMENT_SIZE];
+      ushort draws[MAX_SEGMENT_SIZE];
+      ubyte valid[MAX_SEGMENT_SIZE / MAP_WAYS];    /* one bit per way */
+      ubyte next_way[MAX_SEGMENT_SIZE / MAP_WAYS];
+      unsigned size;
+      unsigned set_mask;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
@@ -67,8 +78,8 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
+   memset(vsplit->cache.valid, 0, vsplit->cache.size / MAP_WAYS);
+   memset(vsplit->cache.next_way, 0, vsplit->cache.size / MAP_WAYS);
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -76,6 +87,12 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   struct draw_vertex_cache_counters *counters =
+      &vsplit->draw->vertex_cache_counters;
+
+   counters->indices += vsplit->cache.num_draw_elts;
+   counters->shaded_vertices += vsplit->cache.num_fetch_elts;
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
@@ -87,23 +104,44 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 static INLINE void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch, unsigned ofbias)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
+   const unsigned set = fetch & vsplit->cache.set_mask;
+   unsigned *fetches = &vsplit->cache.fetches[set * MAP_WAYS];
+   ushort *draws = &vsplit->cache.draws[set * MAP_WAYS];
+   ubyte *valid = &vsplit->cache.valid[set];
+   unsigned way;
+
+   for (way = 0; way < MAP_WAYS; way++) {
+      if ((*valid & (1 << way)) && fetches[way] == fetch)
+         break;
+   }
 
    /* If the value isn't in the cache of it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch || ofbias) {
+    * element bias.
+    */
+   if (way == MAP_WAYS || ofbias) {
+      if (way == MAP_WAYS) {
+         if (*valid != (1 << MAP_WAYS) - 1) {
+            /* fill the first empty entry of the set */
+            way = ffs(~*valid) - 1;
+         }
+         else {
+            /* replace the oldest entry of the set */
+            way = vsplit->cache.next_way[set]++ % MAP_WAYS;
+         }
+      }
+
       /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
+      fetches[way] = fetch;
+      draws[way] = vsplit->cache.num_fetch_elts;
+      *valid |= 1 << way;
 
       /* add fetch */
       assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
       vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   assert(vsplit->cache.num_draw_elts < vsplit->max_draw_elts);
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draws[way];
 }
 
 /**
@@ -198,16 +236,7 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
                       unsigned start, unsigned fetch, int elt_bias)
 {
    struct draw_context *draw = vsplit->draw;
-   unsigned raw_elem_idx = start + fetch + elt_bias;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-
-   /* special care for DRAW_MAX_FETCH_IDX */
-   if (raw_elem_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = raw_elem_idx - 1; /* force update */
-      vsplit->cache.has_max_fetch = TRUE;
-   }
-
    vsplit_add_cache(vsplit, elt_idx, ofbias);
 }
 
@@ -262,7 +291,21 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
    vsplit->middle = middle;
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
-   vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+   /* The backend may not take many indices at once */
+   vsplit->max_draw_elts = MAX_DRAW_ELTS;
+   if (vsplit->draw->render)
+      vsplit->max_draw_elts = MIN2(vsplit->max_draw_elts,
+                                   vsplit->draw->render->max_indices);
+
+   /* A power of two number of entries, with at least two sets */
+   vsplit->cache.size = util_next_power_of_two(
+      CLAMP(vsplit->draw->pt.vertex_cache_size,
+            2 * MAP_WAYS, MAX_SEGMENT_SIZE));
+   vsplit->cache.set_mask = vsplit->cache.size / MAP_WAYS - 1;
+
+   /* A segment fetches no more vertices than the cache holds */
+   vsplit->segment_size = MIN3(vsplit->cache.size, vsplit->max_vertices,
+                               vsplit->max_draw_elts);
 }
 
 
@@ -297,7 +340,7 @@ struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
    vsplit->base.destroy = vsplit_destroy;
    vsplit->draw = draw;
 
-   for (i = 0; i < SEGMENT_SIZE; i++)
+   for (i = 0; i < MAX_SEGMENT_SIZE; i++)
       vsplit->identity_draw_elts[i] = i;
 
    return &vsplit->base;
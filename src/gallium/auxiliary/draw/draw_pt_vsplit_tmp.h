@@ -118,9 +118,15 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
-   return vsplit->middle->run_linear_elts(vsplit->middle,
-                                          fetch_start, fetch_count,
-                                          draw_elts, icount, 0x0);
+   if (!vsplit->middle->run_linear_elts(vsplit->middle,
+                                        fetch_start, fetch_count,
+                                        draw_elts, icount, 0x0))
+      return FALSE;
+
+   draw->vertex_cache_counters.indices += icount;
+   draw->vertex_cache_counters.shaded_vertices += fetch_count;
+
+   return TRUE;
 }
 
 /**
@@ -184,6 +190,44 @@ CONCAT(vsplit_segment_cache_, ELT_TYPE)(struct vsplit_frontend *vsplit,
    vsplit_flush_cache(vsplit, flags);
 }
 
+/**
+ * Split a list of separate primitives into segments of as many primitives
+ * as fit in segment_size fetched vertices, rather than segment_size
+ * elements.  With indexed meshes that share vertices between primitives
+ * this makes for much fewer segments, and so fewer vertices shaded again
+ * in the next segment.
+ */
+static void
+CONCAT(vsplit_segment_list_, ELT_TYPE)(struct vsplit_frontend *vsplit,
+                                       unsigned istart, unsigned icount,
+                                       unsigned incr)
+{
+   struct draw_context *draw = vsplit->draw;
+   const ELT_TYPE *ib = (const ELT_TYPE *) draw->pt.user.elts;
+   const int ibias = draw->pt.user.eltBias;
+   unsigned flags = 0x0;
+   unsigned i, j;
+
+   assert(icount % incr == 0);
+
+   vsplit_clear_cache(vsplit);
+
+   for (i = 0; i < icount; i += incr) {
+      /* flush when the next primitive may not fit */
+      if (vsplit->cache.num_fetch_elts + incr > vsplit->segment_size ||
+          vsplit->cache.num_draw_elts + incr > vsplit->max_draw_elts) {
+         vsplit_flush_cache(vsplit, flags | DRAW_SPLIT_AFTER);
+         vsplit_clear_cache(vsplit);
+         flags = DRAW_SPLIT_BEFORE;
+      }
+
+      for (j = 0; j < incr; j++)
+         ADD_CACHE(vsplit, ib, istart, i + j, ibias);
+   }
+
+   vsplit_flush_cache(vsplit, flags);
+}
+
 static void
 CONCAT(vsplit_segment_simple_, ELT_TYPE)(struct vsplit_frontend *vsplit,
                                          unsigned flags,
@@ -230,6 +274,9 @@ CONCAT(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 #define PRIMITIVE(istart, icount)   \
    CONCAT(vsplit_primitive_, ELT_TYPE)(vsplit, istart, icount)
 
+#define SEGMENT_LIST(istart, icount, incr) \
+   CONCAT(vsplit_segment_list_, ELT_TYPE)(vsplit, istart, icount, incr)
+
 #else /* ELT_TYPE */
 
 static void
@@ -319,3 +366,4 @@ vsplit_segment_fan_linear(struct vsplit_frontend *vsplit, unsigned flags,
 
 #undef ELT_TYPE
 #undef ADD_CACHE
+#undef SEGMENT_LIST
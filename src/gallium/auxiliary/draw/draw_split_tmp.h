@@ -59,6 +59,12 @@ FUNC(FUNC_VARS)
    if (count <= max_count_simple) {
       SEGMENT_SIMPLE(0x0, start, count);
    }
+#ifdef SEGMENT_LIST
+   else if (first == incr) {
+      /* list of separate primitives, split on the vertices they fetch */
+      SEGMENT_LIST(start, count, incr);
+   }
+#endif
    else {
       const unsigned rollback = first - incr;
       unsigned flags = DRAW_SPLIT_AFTER, seg_start = 0, seg_max;
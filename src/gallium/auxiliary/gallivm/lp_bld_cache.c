@@ -0,0 +1,345 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Persistent on-disk cache of compiled gallivm modules.
+ *
+ * Each module is stored in its own file, named after a hash of its key.
+ * The file starts with the complete key, which is compared on load, so
+ * hash collisions only cost a cache miss.  Files are written to a
+ * temporary name and renamed into place, so concurrent processes never
+ * see partial files.
+ */
+
+
+#include "pipe/p_config.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_hash.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+#include "util/u_string.h"
+#include "lp_bld.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_init.h"
+#include "lp_bld_type.h"
+#include "lp_bld_cache.h"
+
+#if defined(PIPE_OS_UNIX) && defined(HAVE_DLOPEN)
+#define LP_BUILD_CACHE 1
+#include <dlfcn.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#else
+#define LP_BUILD_CACHE 0
+#endif
+
+
+#define LP_CACHE_MAGIC 0x4c504331  /* "LPC1" */
+
+
+/**
+ * Part of the key shared by all modules, identifying this build and
+ * machine.
+ */
+struct lp_cache_header
+{
+   uint32_t magic;
+   uint32_t llvm_version;
+   uint32_t pointer_size;
+   uint32_t native_vector_width;
+   uint32_t debug;
+   int64_t build_time;   /**< modification time of the library */
+   int64_t build_size;   /**< size of the library */
+   struct util_cpu_caps cpu_caps;
+};
+
+
+/** Directory of the cache, or NULL when disabled */
+static const char *cache_dir = NULL;
+
+static struct lp_cache_header cache_header;
+
+
+/**
+ * Enable the cache if GALLIVM_CACHE_DIR is set.  Must be called once all
+ * the options affecting code generation are known.
+ */
+void
+lp_build_cache_init(void)
+{
+#if LP_BUILD_CACHE
+   Dl_info info;
+   struct stat st;
+
+   cache_dir = debug_get_option("GALLIVM_CACHE_DIR", NULL);
+   if (!cache_dir)
+      return;
+
+   /* Code generation changes between builds, so key the cache with the
+    * library containing it.
+    */
+   if (!dladdr(func_to_pointer((func_pointer) lp_build_cache_init), &info) ||
+       !info.dli_fname ||
+       stat(info.dli_fname, &st) != 0) {
+      debug_printf("gallivm: could not identify library, "
+                   "disabling the shader cache\n");
+      cache_dir = NULL;
+      return;
+   }
+
+   /* Ignore failure, e.g. if it already exists */
+   mkdir(cache_dir, 0755);
+
+   /* Zero padding bytes, since the whole struct is compared */
+   memset(&cache_header, 0, sizeof cache_header);
+   cache_header.magic = LP_CACHE_MAGIC;
+   cache_header.llvm_version = HAVE_LLVM;
+   cache_header.pointer_size = sizeof(void *);
+   cache_header.native_vector_width = lp_native_vector_width;
+   cache_header.debug = gallivm_debug & ~GALLIVM_DEBUG_CACHE;
+   cache_header.build_time = st.st_mtime;
+   cache_header.build_size = st.st_size;
+   cache_header.cpu_caps = util_cpu_caps;
+#endif
+}
+
+
+/**
+ * Append data to the cache key of a module.  The key must cover
+ * everything the generated IR depends on, e.g. the shader tokens and the
+ * variant key, and must be complete before the first function is
+ * verified.
+ */
+void
+lp_build_cache_key(struct gallivm_state *gallivm,
+                   const void *data, unsigned size)
+{
+   ubyte *key;
+
+   if (!cache_dir)
+      return;
+
+   assert(!gallivm->cache_lookup_done);
+
+   key = REALLOC(gallivm->cache_key, gallivm->cache_key_size,
+                 gallivm->cache_key_size + size);
+   if (!key) {
+      gallivm->uncacheable = TRUE;
+      return;
+   }
+
+   memcpy(key + gallivm->cache_key_size, data, size);
+   gallivm->cache_key = key;
+   gallivm->cache_key_size += size;
+}
+
+
+/**
+ * Whether the module's code may be loaded from or saved to the cache.
+ */
+boolean
+lp_build_cache_enabled(const struct gallivm_state *gallivm)
+{
+   return cache_dir &&
+          gallivm->cache_key_size &&
+          !gallivm->uncacheable;
+}
+
+
+#if LP_BUILD_CACHE
+
+/**
+ * Build the complete key and the file name of a module.
+ * \return the key, to be freed with FREE, or NULL on failure
+ */
+static ubyte *
+build_key(const struct gallivm_state *gallivm,
+          unsigned *key_size,
+          char *path, size_t path_size)
+{
+   uint32_t flags = gallivm->flags;
+   unsigned size;
+   ubyte *key;
+
+   size = sizeof cache_header + sizeof flags + gallivm->cache_key_size;
+   key = MALLOC(size);
+   if (!key)
+      return NULL;
+
+   memcpy(key, &cache_header, sizeof cache_header);
+   memcpy(key + sizeof cache_header, &flags, sizeof flags);
+   memcpy(key + sizeof cache_header + sizeof flags,
+          gallivm->cache_key, gallivm->cache_key_size);
+
+   util_snprintf(path, path_size, "%s/%08x-%08x.o",
+                 cache_dir,
+                 util_hash_crc32(key, size),
+                 util_hash_crc32(gallivm->cache_key,
+                                 gallivm->cache_key_size));
+
+   *key_size = size;
+   return key;
+}
+
+
+static void
+load_object(struct gallivm_state *gallivm)
+{
+   char path[1024];
+   unsigned key_size;
+   ubyte *key;
+   ubyte *data = NULL;
+   FILE *fp;
+   long size;
+
+   key = build_key(gallivm, &key_size, path, sizeof path);
+   if (!key)
+      return;
+
+   fp = fopen(path, "rb");
+   if (!fp)
+      goto out;
+
+   if (fseek(fp, 0, SEEK_END) != 0 ||
+       (size = ftell(fp)) <= (long) key_size ||
+       fseek(fp, 0, SEEK_SET) != 0)
+      goto out;
+
+   data = MALLOC(size);
+   if (!data ||
+       fread(data, 1, size, fp) != (size_t) size ||
+       memcmp(data, key, key_size) != 0)
+      goto out;
+
+   /* Keep just the object code */
+   memmove(data, data + key_size, size - key_size);
+   gallivm->cached_object = data;
+   gallivm->cached_object_size = size - key_size;
+   data = NULL;
+
+   if (gallivm_debug & GALLIVM_DEBUG_CACHE) {
+      debug_printf("gallivm: loaded %s\n", path);
+   }
+
+out:
+   if (fp)
+      fclose(fp);
+   FREE(data);
+   FREE(key);
+}
+
+#endif /* LP_BUILD_CACHE */
+
+
+/**
+ * Look up the module in the cache, once its key is complete.
+ * \return TRUE if its code was found, in which case the IR needs neither
+ * optimization nor code generation.
+ */
+boolean
+lp_build_cache_lookup(struct gallivm_state *gallivm)
+{
+   if (!gallivm->cache_lookup_done) {
+      gallivm->cache_lookup_done = TRUE;
+#if LP_BUILD_CACHE
+      if (lp_build_cache_enabled(gallivm)) {
+         load_object(gallivm);
+      }
+#endif
+   }
+
+   return gallivm->cached_object != NULL;
+}
+
+
+/**
+ * Save the compiled code of a module in the cache.
+ */
+void
+lp_build_cache_store(struct gallivm_state *gallivm,
+                     const void *object, size_t size)
+{
+#if LP_BUILD_CACHE
+   char path[1024];
+   char tmp_path[1024 + 32];
+   unsigned key_size;
+   ubyte *key;
+   FILE *fp;
+   boolean ok;
+
+   if (!lp_build_cache_enabled(gallivm) || gallivm->cached_object)
+      return;
+
+   key = build_key(gallivm, &key_size, path, sizeof path);
+   if (!key)
+      return;
+
+   util_snprintf(tmp_path, sizeof tmp_path, "%s.%d.%p",
+                 path, (int) getpid(), (void *) gallivm);
+
+   fp = fopen(tmp_path, "wb");
+   if (fp) {
+      ok = fwrite(key, 1, key_size, fp) == key_size &&
+           fwrite(object, 1, size, fp) == size;
+      ok = fclose(fp) == 0 && ok;
+
+      if (ok && rename(tmp_path, path) == 0) {
+         if (gallivm_debug & GALLIVM_DEBUG_CACHE) {
+            debug_printf("gallivm: saved %s\n", path);
+         }
+      }
+      else {
+         unlink(tmp_path);
+      }
+   }
+
+   FREE(key);
+#else
+   (void) gallivm;
+   (void) object;
+   (void) size;
+#endif
+}
+
+
+/**
+ * Free the cache related state of a module.
+ */
+void
+lp_build_cache_cleanup(struct gallivm_state *gallivm)
+{
+   FREE(gallivm->cache_key);
+   FREE(gallivm->cached_object);
+   gallivm->cache_key = NULL;
+   gallivm->cache_key_size = 0;
+   gallivm->cached_object = NULL;
+   gallivm->cached_object_size = 0;
+}
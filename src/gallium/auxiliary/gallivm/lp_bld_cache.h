@@ -0,0 +1,76 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Persistent on-disk cache of compiled gallivm modules.
+ *
+ * When GALLIVM_CACHE_DIR is set, the machine code of each module is
+ * saved there after compilation, keyed by everything that determined the
+ * generated IR: the key bytes the caller provided with
+ * lp_build_cache_key(), the LLVM version, the library build, the CPU caps
+ * and the relevant gallivm options.  On a later run, a module with the
+ * same key skips the IR optimization passes and code generation, and the
+ * saved code is loaded instead.
+ *
+ * Modules embedding process specific addresses (see
+ * lp_build_const_int_pointer()) are never saved.
+ */
+
+
+#ifndef LP_BLD_CACHE_H
+#define LP_BLD_CACHE_H
+
+
+#include "pipe/p_compiler.h"
+
+
+struct gallivm_state;
+
+
+void
+lp_build_cache_init(void);
+
+void
+lp_build_cache_key(struct gallivm_state *gallivm,
+                   const void *data, unsigned size);
+
+boolean
+lp_build_cache_enabled(const struct gallivm_state *gallivm);
+
+boolean
+lp_build_cache_lookup(struct gallivm_state *gallivm);
+
+void
+lp_build_cache_store(struct gallivm_state *gallivm,
+                     const void *object, size_t size);
+
+void
+lp_build_cache_cleanup(struct gallivm_state *gallivm);
+
+
+#endif /* !LP_BLD_CACHE_H */
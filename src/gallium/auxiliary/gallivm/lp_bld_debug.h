@@ -45,6 +45,8 @@
 #define GALLIVM_DEBUG_NO_RHO_APPROX (1 << 6)
 #define GALLIVM_DEBUG_NO_QUAD_LOD   (1 << 7)
 #define GALLIVM_DEBUG_GC            (1 << 8)
+#define GALLIVM_DEBUG_CACHE         (1 << 9)
+#define GALLIVM_DEBUG_NO_GATHER     (1 << 10)
 
 
 #ifdef __cplusplus
@@ -27,6 +27,8 @@
 
 
 #include "util/u_debug.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_const.h"
 #include "lp_bld_format.h"
@@ -110,6 +112,40 @@ lp_build_gather_elem(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Gather 32-bit elements with the AVX2 gather instructions.
+ *
+ * @sa lp_build_gather()
+ */
+static LLVMValueRef
+lp_build_gather_avx2(struct gallivm_state *gallivm,
+                     unsigned length,
+                     LLVMValueRef base_ptr,
+                     LLVMValueRef offsets)
+{
+   LLVMTypeRef i32_vec_type =
+      LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), length);
+   const char *intrinsic;
+   LLVMValueRef args[5];
+
+   assert(length == 4 || length == 8);
+   assert(LLVMTypeOf(offsets) == i32_vec_type);
+
+   intrinsic = length == 8 ? "llvm.x86.avx2.gather.d.d.256" :
+                             "llvm.x86.avx2.gather.d.d";
+
+   /* All lanes are enabled, so the pass-through values are never used */
+   args[0] = LLVMGetUndef(i32_vec_type);
+   args[1] = base_ptr;
+   args[2] = offsets;
+   args[3] = LLVMConstAllOnes(i32_vec_type);
+   args[4] = LLVMConstInt(LLVMInt8TypeInContext(gallivm->context), 1, 0);
+
+   return lp_build_intrinsic(gallivm->builder, intrinsic,
+                             i32_vec_type, args, Elements(args));
+}
+
+
 /**
  * Gather elements from scatter positions in memory into a single vector.
  * Use for fetching texels from a texture.
@@ -146,6 +182,14 @@ lp_build_gather(struct gallivm_state *gallivm,
       return lp_build_gather_elem(gallivm, length,
                                   src_width, dst_width,
                                   base_ptr, offsets, 0, vector_justify);
+   } else if (util_cpu_caps.has_avx2 &&
+              src_width == 32 && dst_width == 32 &&
+              (length == 4 || length == 8) &&
+              !(gallivm_debug & GALLIVM_DEBUG_NO_GATHER)) {
+      /* Narrower elements are still loaded one at a time, as a 32-bit
+       * gather could read past the end of the texture.
+       */
+      res = lp_build_gather_avx2(gallivm, length, base_ptr, offsets);
    } else {
       /* Vector */
 
@@ -36,6 +36,7 @@
 #include "lp_bld_debug.h"
 #include "lp_bld_misc.h"
 #include "lp_bld_init.h"
+#include "lp_bld_cache.h"
 
 #include <llvm-c/Analysis.h>
 #include <llvm-c/Transforms/Scalar.h>
@@ -82,6 +83,8 @@ static const struct debug_named_value lp_bld_debug_flags[] = {
    { "no_rho_approx", GALLIVM_DEBUG_NO_RHO_APPROX, NULL },
    { "no_quad_lod", GALLIVM_DEBUG_NO_QUAD_LOD, NULL },
    { "gc",     GALLIVM_DEBUG_GC, NULL },
+   { "cache",  GALLIVM_DEBUG_CACHE, NULL },
+   { "no_gather", GALLIVM_DEBUG_NO_GATHER, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -143,7 +146,8 @@ create_pass_manager(struct gallivm_state *gallivm)
 
    LLVMAddTargetData(gallivm->target, gallivm->passmgr);
 
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0 &&
+       (gallivm->flags & GALLIVM_CREATE_NO_OPT) == 0) {
       /* These are the passes currently listed in llvm-c/Transforms/Scalar.h,
        * but there are more on SVN.
        * TODO: Add more passes.
@@ -219,6 +223,12 @@ free_gallivm_state(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   if (gallivm->object_cache) {
+      lp_object_cache_destroy(gallivm->object_cache);
+   }
+
+   lp_build_cache_cleanup(gallivm);
+
 #if !USE_MCJIT
    /* Don't free the TargetData, it's owned by the exec engine */
 #else
@@ -244,6 +254,7 @@ free_gallivm_state(struct gallivm_state *gallivm)
    gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->object_cache = NULL;
 }
 
 
@@ -256,7 +267,8 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) ||
+          (gallivm->flags & GALLIVM_CREATE_NO_OPT)) {
          optlevel = None;
       }
       else {
@@ -264,10 +276,18 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       }
 
 #if HAVE_LLVM >= 0x0301
+      if (lp_build_cache_enabled(gallivm)) {
+         lp_build_cache_lookup(gallivm);
+         gallivm->object_cache =
+            lp_object_cache_create(gallivm->cached_object,
+                                   gallivm->cached_object_size);
+      }
+
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     gallivm->module,
                                                     (unsigned) optlevel,
                                                     USE_MCJIT,
+                                                    gallivm->object_cache,
                                                     &error);
 #else
       ret = LLVMCreateJITCompiler(&gallivm->engine, gallivm->provider,
@@ -331,10 +351,11 @@ static LLVMContextRef gallivm_context = NULL;
 
 /**
  * Allocate gallivm LLVM objects.
+ * \param context  LLVM context to use, or NULL for the singleton
  * \return  TRUE for success, FALSE for failure
  */
 static boolean
-init_gallivm_state(struct gallivm_state *gallivm)
+init_gallivm_state(struct gallivm_state *gallivm, LLVMContextRef context)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -342,10 +363,13 @@ init_gallivm_state(struct gallivm_state *gallivm)
 
    lp_build_init();
 
-   if (!gallivm_context) {
-      gallivm_context = LLVMContextCreate();
+   if (!context) {
+      if (!gallivm_context) {
+         gallivm_context = LLVMContextCreate();
+      }
+      context = gallivm_context;
    }
-   gallivm->context = gallivm_context;
+   gallivm->context = context;
    if (!gallivm->context)
       goto fail;
 
@@ -470,6 +494,7 @@ lp_build_init(void)
        */
       util_cpu_caps.has_avx = 0;
       util_cpu_caps.has_avx2 = 0;
+      util_cpu_caps.has_avx512f = 0;
    }
 
    if (!HAVE_AVX) {
@@ -504,6 +529,11 @@ lp_build_init(void)
    }
 #endif
 
+#if USE_MCJIT
+   /* Needs MCJIT for loading the cached code */
+   lp_build_cache_init();
+#endif
+
    gallivm_initialized = TRUE;
 
 #if 0
@@ -524,6 +554,24 @@ lp_build_init(void)
  */
 struct gallivm_state *
 gallivm_create(void)
+{
+   return gallivm_create_ex(NULL, 0);
+}
+
+
+/**
+ * Create a new gallivm_state object in the given LLVM context.
+ *
+ * Objects sharing an LLVM context must only be used from one thread at a
+ * time, so code may only be generated concurrently in distinct contexts.
+ * The caller owns a non-NULL context, and must not dispose of it before
+ * destroying the gallivm_state.
+ *
+ * \param context  LLVM context, or NULL for the global one
+ * \param flags  bitmask of GALLIVM_CREATE_x flags
+ */
+struct gallivm_state *
+gallivm_create_ex(LLVMContextRef context, unsigned flags)
 {
    struct gallivm_state *gallivm;
 
@@ -535,7 +583,8 @@ gallivm_create(void)
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm)) {
+      gallivm->flags = flags;
+      if (!init_gallivm_state(gallivm, context)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -607,7 +656,10 @@ gallivm_verify_function(struct gallivm_state *gallivm,
    }
 #endif
 
-   gallivm_optimize_function(gallivm, func);
+   /* Cached code was compiled from the optimized IR already */
+   if (!lp_build_cache_lookup(gallivm)) {
+      gallivm_optimize_function(gallivm, func);
+   }
 
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       /* Print the LLVM IR to stderr */
@@ -632,6 +684,26 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    }
 
 #if USE_MCJIT
+   if (lp_build_cache_enabled(gallivm)) {
+      /*
+       * Function names contain shader and variant numbers, which vary
+       * between runs, while the cached code must be found under the same
+       * names.
+       */
+      LLVMValueRef func;
+      unsigned i = 0;
+      char name[32];
+
+      for (func = LLVMGetFirstFunction(gallivm->module);
+           func;
+           func = LLVMGetNextFunction(func)) {
+         if (!LLVMIsDeclaration(func)) {
+            util_snprintf(name, sizeof name, "func%u", i++);
+            LLVMSetValueName(func, name);
+         }
+      }
+   }
+
    assert(!gallivm->engine);
    if (!init_gallivm_engine(gallivm)) {
       assert(0);
@@ -658,6 +730,17 @@ gallivm_jit_function(struct gallivm_state *gallivm,
    assert(code);
    jit_func = pointer_to_func(code);
 
+   if (gallivm->object_cache) {
+      const void *object;
+      size_t size;
+
+      /* MCJIT compiles the whole module on the first lookup */
+      object = lp_object_cache_get_compiled(gallivm->object_cache, &size);
+      if (object) {
+         lp_build_cache_store(gallivm, object, size);
+      }
+   }
+
    if (gallivm_debug & GALLIVM_DEBUG_ASM) {
       lp_disassemble(func, code);
    }
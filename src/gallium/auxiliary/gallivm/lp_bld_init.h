@@ -46,9 +46,23 @@ struct gallivm_state
    LLVMContextRef context;
    LLVMBuilderRef builder;
    unsigned compiled;
+   unsigned flags;  /**< GALLIVM_CREATE_x */
+
+   /* On-disk code cache state, see lp_bld_cache.c */
+   ubyte *cache_key;
+   unsigned cache_key_size;
+   boolean cache_lookup_done;
+   boolean uncacheable;  /**< code embeds process specific addresses */
+   void *cached_object;  /**< machine code loaded from the cache */
+   size_t cached_object_size;
+   struct lp_object_cache *object_cache;
 };
 
 
+/** gallivm_create_ex() flags */
+#define GALLIVM_CREATE_NO_OPT  (1 << 0)  /**< skip IR passes, -O0 codegen */
+
+
 void
 lp_build_init(void);
 
@@ -56,6 +70,9 @@ lp_build_init(void);
 struct gallivm_state *
 gallivm_create(void);
 
+struct gallivm_state *
+gallivm_create_ex(LLVMContextRef context, unsigned flags);
+
 void
 gallivm_destroy(struct gallivm_state *gallivm);
 
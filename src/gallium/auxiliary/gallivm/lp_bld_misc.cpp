@@ -71,6 +71,8 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/CBindingWrapping.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Support/MemoryBuffer.h>
 #endif
 
 #include "pipe/p_config.h"
@@ -243,6 +245,127 @@ lp_set_store_alignment(LLVMValueRef Inst,
 }
 
 
+#if HAVE_LLVM >= 0x0303
+
+/**
+ * MCJIT object cache for a single module, which hands the machine code over
+ * from and to gallivm's on-disk cache (see lp_bld_cache.c).
+ */
+struct lp_object_cache : public llvm::ObjectCache
+{
+   /** Code loaded from the disk, or NULL */
+   const void *object;
+   size_t object_size;
+
+   /** Code compiled by MCJIT, until fetched */
+   std::string compiled;
+   bool has_compiled;
+
+   lp_object_cache(const void *object, size_t object_size) :
+      object(object), object_size(object_size), has_compiled(false)
+   {
+   }
+
+#if HAVE_LLVM >= 0x0306
+   virtual void notifyObjectCompiled(const llvm::Module *M,
+                                     llvm::MemoryBufferRef Obj)
+   {
+      store(Obj.getBufferStart(), Obj.getBufferSize());
+   }
+#else
+   virtual void notifyObjectCompiled(const llvm::Module *M,
+                                     const llvm::MemoryBuffer *Obj)
+   {
+      store(Obj->getBufferStart(), Obj->getBufferSize());
+   }
+#endif
+
+   void store(const char *data, size_t size)
+   {
+      if (!object) {
+         compiled.assign(data, size);
+         has_compiled = true;
+      }
+   }
+
+#if HAVE_LLVM >= 0x0305
+   virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M)
+#else
+   virtual llvm::MemoryBuffer *getObject(const llvm::Module *M)
+#endif
+   {
+      if (!object)
+         return NULL;
+      llvm::StringRef data((const char *) object, object_size);
+#if HAVE_LLVM >= 0x0305
+      return std::unique_ptr<llvm::MemoryBuffer>(
+         llvm::MemoryBuffer::getMemBufferCopy(data));
+#else
+      return llvm::MemoryBuffer::getMemBufferCopy(data);
+#endif
+   }
+};
+
+
+extern "C"
+struct lp_object_cache *
+lp_object_cache_create(const void *object, size_t size)
+{
+   return new lp_object_cache(object, size);
+}
+
+
+/**
+ * Return the code compiled since the last call, or NULL.
+ */
+extern "C"
+const void *
+lp_object_cache_get_compiled(struct lp_object_cache *cache, size_t *size)
+{
+   if (!cache->has_compiled)
+      return NULL;
+   cache->has_compiled = false;
+   *size = cache->compiled.size();
+   return cache->compiled.data();
+}
+
+
+extern "C"
+void
+lp_object_cache_destroy(struct lp_object_cache *cache)
+{
+   delete cache;
+}
+
+#else /* HAVE_LLVM < 0x0303 */
+
+/* MCJIT has no object cache before LLVM 3.3 */
+
+extern "C"
+struct lp_object_cache *
+lp_object_cache_create(const void *object, size_t size)
+{
+   return NULL;
+}
+
+
+extern "C"
+const void *
+lp_object_cache_get_compiled(struct lp_object_cache *cache, size_t *size)
+{
+   return NULL;
+}
+
+
+extern "C"
+void
+lp_object_cache_destroy(struct lp_object_cache *cache)
+{
+}
+
+#endif /* HAVE_LLVM < 0x0303 */
+
+
 #if HAVE_LLVM >= 0x301
 
 /**
@@ -261,6 +384,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         LLVMModuleRef M,
                                         unsigned OptLevel,
                                         int useMCJIT,
+                                        struct lp_object_cache *cache,
                                         char **OutError)
 {
    using namespace llvm;
@@ -312,6 +436,9 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       if (util_cpu_caps.has_f16c) {
          MAttrs.push_back("+f16c");
       }
+      if (util_cpu_caps.has_avx2) {
+         MAttrs.push_back("+avx2");
+      }
       builder.setMAttrs(MAttrs);
    }
    builder.setJITMemoryManager(JITMemoryManager::CreateDefaultMemManager());
@@ -329,6 +456,11 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    JIT = builder.create(builder.selectTarget(TT, MArch, MCPU, MAttrs));
 #endif
    if (JIT) {
+#if HAVE_LLVM >= 0x0303
+      if (useMCJIT && cache) {
+         JIT->setObjectCache(cache);
+      }
+#endif
       *OutJIT = wrap(JIT);
       return 0;
    }
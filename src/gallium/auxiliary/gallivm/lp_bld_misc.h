@@ -52,11 +52,23 @@ extern LLVMValueRef
 lp_build_load_volatile(LLVMBuilderRef B, LLVMValueRef PointerVal,
                        const char *Name);
 
+struct lp_object_cache;
+
+extern struct lp_object_cache *
+lp_object_cache_create(const void *object, size_t size);
+
+extern const void *
+lp_object_cache_get_compiled(struct lp_object_cache *cache, size_t *size);
+
+extern void
+lp_object_cache_destroy(struct lp_object_cache *cache);
+
 extern int
 lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         LLVMModuleRef M,
                                         unsigned OptLevel,
                                         int useMCJIT,
+                                        struct lp_object_cache *cache,
                                         char **OutError);
 
 
@@ -465,6 +465,39 @@ lp_build_pack2(struct gallivm_state *gallivm,
    assert(src_type.length * 2 == dst_type.length);
 
    /* Check for special cases first */
+   if (util_cpu_caps.has_avx2 &&
+       src_type.width * src_type.length == 256 &&
+       (src_type.width == 32 || src_type.width == 16)) {
+      LLVMTypeRef i64x4_type =
+         LLVMVectorType(LLVMInt64TypeInContext(gallivm->context), 4);
+      LLVMValueRef elems[4];
+      const char *intrinsic;
+
+      if (src_type.width == 32) {
+         intrinsic = dst_type.sign ? "llvm.x86.avx2.packssdw" :
+                                     "llvm.x86.avx2.packusdw";
+      }
+      else {
+         intrinsic = dst_type.sign ? "llvm.x86.avx2.packsswb" :
+                                     "llvm.x86.avx2.packuswb";
+      }
+
+      res = lp_build_intrinsic_binary(builder, intrinsic, dst_vec_type, lo, hi);
+
+      /*
+       * The AVX2 packs work within each 128-bit lane, so the 64-bit quarters
+       * of the result come out as lo0 hi0 lo1 hi1.  Put lo before hi.
+       */
+      elems[0] = lp_build_const_int32(gallivm, 0);
+      elems[1] = lp_build_const_int32(gallivm, 2);
+      elems[2] = lp_build_const_int32(gallivm, 1);
+      elems[3] = lp_build_const_int32(gallivm, 3);
+      res = LLVMBuildBitCast(builder, res, i64x4_type, "");
+      res = LLVMBuildShuffleVector(builder, res, res,
+                                   LLVMConstVector(elems, 4), "");
+      return LLVMBuildBitCast(builder, res, dst_vec_type, "");
+   }
+
    if((util_cpu_caps.has_sse2 || util_cpu_caps.has_altivec) &&
        src_type.width * src_type.length >= 128) {
       const char *intrinsic = NULL;
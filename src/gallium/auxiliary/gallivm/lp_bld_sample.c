@@ -1972,6 +1972,9 @@ lp_build_cube_lookup(struct lp_build_sample_context *bld,
  *
  * @param coord   coordinate in pixels
  * @param stride  number of bytes between rows of successive pixel blocks
+ * @param tile_stride   for textures in the tiled layout, number of bytes
+ *                      between successive pixels within a tile, and NULL
+ *                      for the linear layout
  * @param block_length  number of pixels in a pixels block along the coordinate
  *                      axis
  * @param out_offset    resulting relative offset of the pixel block in bytes
@@ -1982,6 +1985,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                unsigned block_length,
                                LLVMValueRef coord,
                                LLVMValueRef stride,
+                               LLVMValueRef tile_stride,
                                LLVMValueRef *out_offset,
                                LLVMValueRef *out_subcoord)
 {
@@ -2014,7 +2018,27 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 #endif
    }
 
-   offset = lp_build_mul(bld, coord, stride);
+   if (tile_stride) {
+      /*
+       * The tiled layout only holds plain pixels.  The high coordinate bits
+       * select the tile and the low ones the pixel within it, see
+       * LP_SAMPLER_TILE_SIZE.
+       */
+      LLVMValueRef tile_mask =
+         lp_build_const_int_vec(bld->gallivm, bld->type,
+                                LP_SAMPLER_TILE_SIZE - 1);
+      LLVMValueRef tile_coord = LLVMBuildAnd(builder, coord, tile_mask, "");
+
+      assert(block_length == 1);
+
+      coord = LLVMBuildXor(builder, coord, tile_coord, "");
+      offset = lp_build_add(bld,
+                            lp_build_mul(bld, coord, stride),
+                            lp_build_mul(bld, tile_coord, tile_stride));
+   }
+   else {
+      offset = lp_build_mul(bld, coord, stride);
+   }
 
    assert(out_offset);
    assert(out_subcoord);
@@ -2024,16 +2048,54 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Get the x and y strides to pass to lp_build_sample_partial_offset() for
+ * the linear or the tiled layout.
+ *
+ * @param row_stride  number of bytes between image rows
+ */
+void
+lp_build_sample_strides(struct lp_build_context *bld,
+                        const struct util_format_description *format_desc,
+                        boolean tiled,
+                        LLVMValueRef row_stride,
+                        LLVMValueRef *x_stride,
+                        LLVMValueRef *x_tile_stride,
+                        LLVMValueRef *y_stride,
+                        LLVMValueRef *y_tile_stride)
+{
+   const unsigned bytes = format_desc->block.bits/8;
+
+   if (tiled) {
+      /* Whole tiles are LP_SAMPLER_TILE_SIZE pixels apart along x */
+      *x_stride = lp_build_const_vec(bld->gallivm, bld->type,
+                                     bytes * LP_SAMPLER_TILE_SIZE);
+      *x_tile_stride = lp_build_const_vec(bld->gallivm, bld->type, bytes);
+      *y_stride = row_stride;
+      *y_tile_stride = *x_stride;
+   }
+   else {
+      *x_stride = lp_build_const_vec(bld->gallivm, bld->type, bytes);
+      *x_tile_stride = NULL;
+      *y_stride = row_stride;
+      *y_tile_stride = NULL;
+   }
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
  * x, y, z, y_stride, z_stride are vectors, and they refer to pixels.
+ * tiled selects the LP_SAMPLER_TILE_SIZE tiled layout rather than the
+ * linear one.
  *
  * Returns the relative offset and i,j sub-block coordinates
  */
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2043,22 +2105,24 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_i,
                        LLVMValueRef *out_j)
 {
-   LLVMValueRef x_stride;
+   LLVMValueRef x_stride, x_tile_stride;
+   LLVMValueRef y_tile_stride;
    LLVMValueRef offset;
 
-   x_stride = lp_build_const_vec(bld->gallivm, bld->type,
-                                 format_desc->block.bits/8);
+   lp_build_sample_strides(bld, format_desc, tiled, y_stride,
+                           &x_stride, &x_tile_stride,
+                           &y_stride, &y_tile_stride);
 
    lp_build_sample_partial_offset(bld,
                                   format_desc->block.width,
-                                  x, x_stride,
+                                  x, x_stride, x_tile_stride,
                                   &offset, out_i);
 
    if (y && y_stride) {
       LLVMValueRef y_offset;
       lp_build_sample_partial_offset(bld,
                                      format_desc->block.height,
-                                     y, y_stride,
+                                     y, y_stride, y_tile_stride,
                                      &y_offset, out_j);
       offset = lp_build_add(bld, offset, y_offset);
    }
@@ -2071,7 +2135,7 @@ lp_build_sample_offset(struct lp_build_context *bld,
       LLVMValueRef k;
       lp_build_sample_partial_offset(bld,
                                      1, /* pixel blocks are always 2D */
-                                     z, z_stride,
+                                     z, z_stride, NULL,
                                      &z_offset, &k);
       offset = lp_build_add(bld, offset, z_offset);
    }
@@ -68,6 +68,21 @@ enum lp_sampler_lod_property {
 };
 
 
+/**
+ * Width and height in texels of the tiles of textures in the tiled layout.
+ *
+ * The tiles of an image are stored in row-major order, and so are the
+ * texels within each tile, which keeps the offset of a texel separable
+ * into an x and a y part:
+ *
+ *    offset = (y & ~3) * row_stride + (y & 3) * 4 * bpp +
+ *             (x & ~3) * 4 * bpp + (x & 3) * bpp
+ *
+ * The image size and row stride are the same as for the linear layout.
+ */
+#define LP_SAMPLER_TILE_SIZE 4
+
+
 /**
  * Texture static state.
  *
@@ -89,6 +104,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< texels in LP_SAMPLER_TILE_SIZE tiles? */
 };
 
 
@@ -481,13 +497,26 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                unsigned block_length,
                                LLVMValueRef coord,
                                LLVMValueRef stride,
+                               LLVMValueRef tile_stride,
                                LLVMValueRef *out_offset,
                                LLVMValueRef *out_i);
 
 
+void
+lp_build_sample_strides(struct lp_build_context *bld,
+                        const struct util_format_description *format_desc,
+                        boolean tiled,
+                        LLVMValueRef row_stride,
+                        LLVMValueRef *x_stride,
+                        LLVMValueRef *x_tile_stride,
+                        LLVMValueRef *y_stride,
+                        LLVMValueRef *y_tile_stride);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -63,6 +63,7 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_cs_iface;
 
 
 enum lp_build_tex_modifier {
@@ -157,6 +158,11 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef instance_id;
    LLVMValueRef vertex_id;
    LLVMValueRef prim_id;
+   /* compute shaders: thread_id are vectors, the others scalars */
+   LLVMValueRef thread_id[3];
+   LLVMValueRef block_id[3];
+   LLVMValueRef block_size[3];
+   LLVMValueRef grid_size[3];
 };
 
 
@@ -231,7 +237,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef (*outputs)[4],
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface);
 
 
 void
@@ -422,6 +429,30 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Compute shader interface.
+ *
+ * LOAD and STORE are emitted one active lane at a time, with the memory
+ * layout of the TGSI_FILE_RESOURCE registers left to the driver.
+ */
+struct lp_build_tgsi_cs_iface
+{
+   /** Instruction the kernel starts at */
+   unsigned pc;
+
+   /**
+    * Return an i8 pointer to the given byte address of a resource, one of
+    * the TGSI_RESOURCE_x special indices or a RES[] register index.
+    * \param lane  vector lane the address is for, as private memory is
+    *              per thread
+    */
+   LLVMValueRef (*mem_pointer)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                               struct lp_build_tgsi_context * bld_base,
+                               unsigned resource,
+                               unsigned lane,
+                               LLVMValueRef address);
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -430,6 +461,7 @@ struct lp_build_tgsi_soa_context
    struct lp_build_context elem_bld;
 
    const struct lp_build_tgsi_gs_iface *gs_iface;
+   const struct lp_build_tgsi_cs_iface *cs_iface;
    LLVMValueRef emitted_prims_vec_ptr;
    LLVMValueRef total_emitted_vertices_vec_ptr;
    LLVMValueRef emitted_vertices_vec_ptr;
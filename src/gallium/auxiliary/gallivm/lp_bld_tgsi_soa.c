@@ -1535,6 +1535,30 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = swizzle < 3 ? bld->system_values.thread_id[swizzle] :
+                          bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+   case TGSI_SEMANTIC_GRID_SIZE:
+      {
+         const LLVMValueRef *values =
+            info->system_value_semantic_name[reg->Register.Index] ==
+               TGSI_SEMANTIC_BLOCK_ID ? bld->system_values.block_id :
+            info->system_value_semantic_name[reg->Register.Index] ==
+               TGSI_SEMANTIC_BLOCK_SIZE ? bld->system_values.block_size :
+            bld->system_values.grid_size;
+
+         res = swizzle < 3 ?
+            lp_build_broadcast_scalar(&bld_base->uint_bld, values[swizzle]) :
+            bld_base->uint_bld.zero;
+         atype = TGSI_TYPE_UNSIGNED;
+      }
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -1836,6 +1860,10 @@ emit_store(
    unsigned chan_index;
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
 
+   /* STORE and MFENCE write memory, not registers */
+   if (info->num_dst && inst->Dst[0].Register.File == TGSI_FILE_RESOURCE)
+      return;
+
    if(info->num_dst) {
       LLVMValueRef pred[TGSI_NUM_CHANNELS];
 
@@ -3043,6 +3071,155 @@ mask_vec(struct lp_build_tgsi_context *bld_base)
                        exec_mask->exec_mask, "");
 }
 
+/**
+ * Emit the access of a LOAD or STORE for each active lane in turn.
+ *
+ * \param values  vectors loaded into, or stored from, for the channels in
+ *                writemask
+ */
+static void
+emit_mem_access(struct lp_build_tgsi_context *bld_base,
+                unsigned resource,
+                LLVMValueRef address,
+                unsigned writemask,
+                boolean store,
+                LLVMValueRef *values)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMTypeRef int32_ptr_type =
+      LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0);
+   LLVMValueRef exec_mask = mask_vec(bld_base);
+   LLVMValueRef vars[TGSI_NUM_CHANNELS];
+   unsigned lane, chan;
+
+   if (!store) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (writemask & (1 << chan))
+            vars[chan] = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+      }
+   }
+
+   for (lane = 0; lane < uint_bld->type.length; lane++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, lane);
+      LLVMValueRef active, ptr;
+      struct lp_build_if_state ifthen;
+
+      active = LLVMBuildExtractElement(builder, exec_mask, index, "");
+      active = LLVMBuildICmp(builder, LLVMIntNE, active,
+                             lp_build_const_int32(gallivm, 0), "");
+
+      lp_build_if(&ifthen, gallivm, active);
+
+      ptr = bld->cs_iface->mem_pointer(bld->cs_iface, bld_base, resource, lane,
+                                       LLVMBuildExtractElement(builder, address,
+                                                               index, ""));
+      ptr = LLVMBuildBitCast(builder, ptr, int32_ptr_type, "");
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         LLVMValueRef chan_index, chan_ptr, elem;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         /* consecutive dwords */
+         chan_index = lp_build_const_int32(gallivm, chan);
+         chan_ptr = LLVMBuildGEP(builder, ptr, &chan_index, 1, "");
+
+         if (store) {
+            elem = LLVMBuildExtractElement(builder, values[chan], index, "");
+            LLVMBuildStore(builder, elem, chan_ptr);
+         }
+         else {
+            LLVMValueRef vec = LLVMBuildLoad(builder, vars[chan], "");
+            elem = LLVMBuildLoad(builder, chan_ptr, "");
+            vec = LLVMBuildInsertElement(builder, vec, elem, index, "");
+            LLVMBuildStore(builder, vec, vars[chan]);
+         }
+      }
+
+      lp_build_endif(&ifthen);
+   }
+
+   if (!store) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (writemask & (1 << chan))
+            values[chan] = LLVMBuildLoad(builder, vars[chan], "");
+      }
+   }
+}
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef address, values[TGSI_NUM_CHANNELS];
+   unsigned writemask = inst->Dst[0].Register.WriteMask;
+   unsigned chan;
+
+   address = lp_build_emit_fetch(bld_base, inst, 1, TGSI_CHAN_X);
+   address = LLVMBuildBitCast(builder, address,
+                              bld_base->uint_bld.vec_type, "");
+
+   emit_mem_access(bld_base, inst->Src[0].Register.Index, address,
+                   writemask, FALSE, values);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan)) {
+         emit_data->output[chan] =
+            LLVMBuildBitCast(builder, values[chan],
+                             bld_base->base.vec_type, "");
+      }
+   }
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef address, values[TGSI_NUM_CHANNELS];
+   unsigned writemask = inst->Dst[0].Register.WriteMask;
+   unsigned chan;
+
+   address = lp_build_emit_fetch(bld_base, inst, 0, TGSI_CHAN_X);
+   address = LLVMBuildBitCast(builder, address,
+                              bld_base->uint_bld.vec_type, "");
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan)) {
+         values[chan] = lp_build_emit_fetch(bld_base, inst, 1, chan);
+         values[chan] = LLVMBuildBitCast(builder, values[chan],
+                                         bld_base->uint_bld.vec_type, "");
+      }
+   }
+
+   emit_mem_access(bld_base, inst->Dst[0].Register.Index, address,
+                   writemask, TRUE, values);
+}
+
+/**
+ * MFENCE and BARRIER.  The lanes of a vector run in lockstep, and the
+ * memory writes of each lane are done in program order, so there is
+ * nothing to do.
+ */
+static void
+nop_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+}
+
 static void
 increment_vec_ptr_by_mask(struct lp_build_tgsi_context * bld_base,
                           LLVMValueRef ptr,
@@ -3623,7 +3800,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3754,6 +3932,15 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      bld.bld_base.pc = cs_iface->pc;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MFENCE].emit = nop_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = nop_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
@@ -65,6 +65,9 @@ void x86_print_reg( struct x86_reg reg )
    case file_XMM:
       debug_printf( "XMM%u", reg.idx );
       break;
+   case file_YMM:
+      debug_printf( "YMM%u", reg.idx );
+      break;
    case file_x87:
       debug_printf( "fp%u", reg.idx );
       break;
@@ -123,6 +126,17 @@ void x86_print_reg( struct x86_reg reg )
    debug_printf( ", %u", I );                   \
 } while( 0 )
 
+#define DUMP_RRR( R0, R1, R2 ) do {             \
+   DUMP_RR( R0, R1 );                           \
+   debug_printf( ", " );                        \
+   x86_print_reg( R2 );                            \
+} while( 0 )
+
+#define DUMP_RRRI( R0, R1, R2, I ) do {         \
+   DUMP_RRR( R0, R1, R2 );                      \
+   debug_printf( ", %u", I );                   \
+} while( 0 )
+
 #else
 
 #define DUMP_START()
@@ -133,6 +147,8 @@ void x86_print_reg( struct x86_reg reg )
 #define DUMP_RR( R0, R1 )
 #define DUMP_RI( R0, I )
 #define DUMP_RRI( R0, R1, I )
+#define DUMP_RRR( R0, R1, R2 )
+#define DUMP_RRRI( R0, R1, R2, I )
 
 #endif
 
@@ -1508,6 +1524,305 @@ void sse2_rcpss( struct x86_function *p,
    emit_modrm( p, dst, src );
 }
 
+/***********************************************************************
+ * AVX instructions
+ */
+
+/* Values for the pp and m-mmmm fields of the VEX prefix, which stand for
+ * the mandatory prefix and leading opcode bytes of the SSE encoding.
+ */
+enum vex_pp {
+   vex_pp_none,
+   vex_pp_66,
+   vex_pp_F3,
+   vex_pp_F2
+};
+
+enum vex_map {
+   vex_map_0F = 1,
+   vex_map_0F38,
+   vex_map_0F3A
+};
+
+/* Emit a VEX prefix.  Like emit_modrm() this only knows about the first
+ * eight registers, so the (inverted) R, X and B bits are always set.  The
+ * two byte form is used whenever it can encode the instruction.
+ */
+static void emit_vex( struct x86_function *p,
+                      enum vex_pp pp,
+                      enum vex_map map,
+                      unsigned w,
+                      unsigned l,
+                      unsigned vvvv )
+{
+   unsigned char last = (w << 7) | ((~vvvv & 0xf) << 3) | (l << 2) | pp;
+
+   if (map == vex_map_0F && !w)
+      emit_2ub(p, 0xc5, 0x80 | last);
+   else
+      emit_3ub(p, 0xc4, 0xe0 | map, last);
+}
+
+/* Emit a VEX encoded instruction with reg in the modrm reg field, src0 in
+ * VEX.vvvv and regmem in the modrm r/m field.  Pass x86_make_reg(file_XMM,
+ * 0) as src0 for instructions that have no such operand.  VEX.L is set
+ * when any register operand is a YMM register.
+ */
+static void emit_vex_op( struct x86_function *p,
+                         enum vex_pp pp,
+                         enum vex_map map,
+                         unsigned char op,
+                         struct x86_reg reg,
+                         struct x86_reg src0,
+                         struct x86_reg regmem )
+{
+   unsigned l = reg.file == file_YMM ||
+                src0.file == file_YMM ||
+                (regmem.file == file_YMM && regmem.mod == mod_REG);
+
+   assert(src0.mod == mod_REG);
+   emit_vex(p, pp, map, 0, l, src0.idx);
+   emit_1ub(p, op);
+   emit_modrm(p, reg, regmem);
+}
+
+/* Like emit_op_modrm(), pick the load or store opcode.
+ */
+static void emit_vex_mov( struct x86_function *p,
+                          enum vex_pp pp,
+                          unsigned char op_dst_is_reg,
+                          unsigned char op_dst_is_mem,
+                          struct x86_reg dst,
+                          struct x86_reg src )
+{
+   struct x86_reg none = x86_make_reg(file_XMM, 0);
+
+   if (dst.mod == mod_REG) {
+      emit_vex_op(p, pp, vex_map_0F, op_dst_is_reg, dst, none, src);
+   }
+   else {
+      assert(src.mod == mod_REG);
+      emit_vex_op(p, pp, vex_map_0F, op_dst_is_mem, src, none, dst);
+   }
+}
+
+void avx_vzeroupper( struct x86_function *p )
+{
+   DUMP();
+   emit_3ub(p, 0xc5, 0xf8, 0x77);
+}
+
+void avx_vmovups( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_vex_mov(p, vex_pp_none, 0x10, 0x11, dst, src);
+}
+
+void avx_vmovdqu( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_vex_mov(p, vex_pp_F3, 0x6f, 0x7f, dst, src);
+}
+
+void avx_vmovd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   struct x86_reg none = x86_make_reg(file_XMM, 0);
+
+   DUMP_RR( dst, src );
+   if (dst.file == file_XMM && dst.mod == mod_REG)
+      emit_vex_op(p, vex_pp_66, vex_map_0F, 0x6e, dst, none, src);
+   else
+      emit_vex_op(p, vex_pp_66, vex_map_0F, 0x7e, src, none, dst);
+}
+
+void avx_vmovq( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   struct x86_reg none = x86_make_reg(file_XMM, 0);
+
+   DUMP_RR( dst, src );
+   if (dst.mod == mod_REG) {
+      emit_vex_op(p, vex_pp_F3, vex_map_0F, 0x7e, dst, none, src);
+   }
+   else {
+      assert(src.mod == mod_REG);
+      emit_vex_op(p, vex_pp_66, vex_map_0F, 0xd6, src, none, dst);
+   }
+}
+
+/* Insert the dword src1 (a general purpose register or memory) into dword
+ * imm of src0.
+ */
+void avx_vpinsrd( struct x86_function *p,
+                  struct x86_reg dst,
+                  struct x86_reg src0,
+                  struct x86_reg src1,
+                  unsigned char imm )
+{
+   DUMP_RRRI( dst, src0, src1, imm );
+   assert(dst.file == file_XMM && src0.file == file_XMM);
+   emit_vex_op(p, vex_pp_66, vex_map_0F3A, 0x22, dst, src0, src1);
+   emit_1ub(p, imm);
+}
+
+void avx_vextractps( struct x86_function *p,
+                     struct x86_reg dst,
+                     struct x86_reg src,
+                     unsigned char imm )
+{
+   DUMP_RRI( dst, src, imm );
+   assert(src.file == file_XMM);
+   emit_vex_op(p, vex_pp_66, vex_map_0F3A, 0x17, src,
+               x86_make_reg(file_XMM, 0), dst);
+   emit_1ub(p, imm);
+}
+
+/* Replace the 128-bit half imm of the YMM register src0 with src1.
+ */
+void avx_vinsertf128( struct x86_function *p,
+                      struct x86_reg dst,
+                      struct x86_reg src0,
+                      struct x86_reg src1,
+                      unsigned char imm )
+{
+   DUMP_RRRI( dst, src0, src1, imm );
+   assert(dst.file == file_YMM && src0.file == file_YMM);
+   assert(src1.file == file_XMM || src1.mod != mod_REG);
+   emit_vex_op(p, vex_pp_66, vex_map_0F3A, 0x18, dst, src0, src1);
+   emit_1ub(p, imm);
+}
+
+void avx_vextractf128( struct x86_function *p,
+                       struct x86_reg dst,
+                       struct x86_reg src,
+                       unsigned char imm )
+{
+   DUMP_RRI( dst, src, imm );
+   assert(src.file == file_YMM);
+   assert(dst.file == file_XMM || dst.mod != mod_REG);
+   emit_vex_op(p, vex_pp_66, vex_map_0F3A, 0x19, src,
+               x86_make_reg(file_XMM, 0), dst);
+   emit_1ub(p, imm);
+}
+
+/* Load 128 bits from memory into both halves of a YMM register.
+ */
+void avx_vbroadcastf128( struct x86_function *p,
+                         struct x86_reg dst,
+                         struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(dst.file == file_YMM);
+   assert(src.mod != mod_REG);
+   emit_vex_op(p, vex_pp_66, vex_map_0F38, 0x1a, dst,
+               x86_make_reg(file_XMM, 0), src);
+}
+
+void avx_vcvtdq2ps( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_vex_op(p, vex_pp_none, vex_map_0F, 0x5b, dst,
+               x86_make_reg(file_XMM, 0), src);
+}
+
+void avx_vcvtps2dq( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_vex_op(p, vex_pp_66, vex_map_0F, 0x5b, dst,
+               x86_make_reg(file_XMM, 0), src);
+}
+
+void avx_vmulps( struct x86_function *p,
+                 struct x86_reg dst,
+                 struct x86_reg src0,
+                 struct x86_reg src1 )
+{
+   DUMP_RRR( dst, src0, src1 );
+   emit_vex_op(p, vex_pp_none, vex_map_0F, 0x59, dst, src0, src1);
+}
+
+void avx_vorps( struct x86_function *p,
+                struct x86_reg dst,
+                struct x86_reg src0,
+                struct x86_reg src1 )
+{
+   DUMP_RRR( dst, src0, src1 );
+   emit_vex_op(p, vex_pp_none, vex_map_0F, 0x56, dst, src0, src1);
+}
+
+/* Shuffles each 128-bit half separately, with the same selector.
+ */
+void avx_vshufps( struct x86_function *p,
+                  struct x86_reg dst,
+                  struct x86_reg src0,
+                  struct x86_reg src1,
+                  unsigned char shuf )
+{
+   DUMP_RRRI( dst, src0, src1, shuf );
+   emit_vex_op(p, vex_pp_none, vex_map_0F, 0xc6, dst, src0, src1);
+   emit_1ub(p, shuf);
+}
+
+
+/***********************************************************************
+ * AVX2 instructions
+ */
+
+/* Zero or sign extend the low bytes or words of src (an XMM register or
+ * memory) to the dwords of dst.
+ */
+void avx2_vpmovzxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(src.file == file_XMM || src.mod != mod_REG);
+   emit_vex_op(p, vex_pp_66, vex_map_0F38, 0x31, dst,
+               x86_make_reg(file_XMM, 0), src);
+}
+
+void avx2_vpmovzxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(src.file == file_XMM || src.mod != mod_REG);
+   emit_vex_op(p, vex_pp_66, vex_map_0F38, 0x33, dst,
+               x86_make_reg(file_XMM, 0), src);
+}
+
+void avx2_vpmovsxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(src.file == file_XMM || src.mod != mod_REG);
+   emit_vex_op(p, vex_pp_66, vex_map_0F38, 0x21, dst,
+               x86_make_reg(file_XMM, 0), src);
+}
+
+void avx2_vpmovsxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   assert(src.file == file_XMM || src.mod != mod_REG);
+   emit_vex_op(p, vex_pp_66, vex_map_0F38, 0x23, dst,
+               x86_make_reg(file_XMM, 0), src);
+}
+
+/* The 256-bit packs work on each 128-bit half separately.
+ */
+void avx2_vpackssdw( struct x86_function *p,
+                     struct x86_reg dst,
+                     struct x86_reg src0,
+                     struct x86_reg src1 )
+{
+   DUMP_RRR( dst, src0, src1 );
+   emit_vex_op(p, vex_pp_66, vex_map_0F, 0x6b, dst, src0, src1);
+}
+
+void avx2_vpackuswb( struct x86_function *p,
+                     struct x86_reg dst,
+                     struct x86_reg src0,
+                     struct x86_reg src1 )
+{
+   DUMP_RRR( dst, src0, src1 );
+   emit_vex_op(p, vex_pp_66, vex_map_0F, 0x67, dst, src0, src1);
+}
+
+
 /***********************************************************************
  * x87 instructions
  */
@@ -2164,6 +2479,10 @@ static void x86_init_func_common( struct x86_function *p )
       p->caps |= X86_SSE3;
    if(util_cpu_caps.has_sse4_1)
       p->caps |= X86_SSE4_1;
+   if(util_cpu_caps.has_avx)
+      p->caps |= X86_AVX;
+   if(util_cpu_caps.has_avx2)
+      p->caps |= X86_AVX2;
    p->csr = p->store;
    DUMP_START();
 }
@@ -35,10 +35,10 @@
  * for mmx/sse/sse2 support on the cpu.
  */
 struct x86_reg {
-   unsigned file:2;
+   unsigned file:3;
    unsigned idx:4;
    unsigned mod:2;		/* mod_REG if this is just a register */
-   int      disp:24;		/* only +/- 23bits of offset - should be enough... */
+   int      disp:23;		/* only +/- 22bits of offset - should be enough... */
 };
 
 #define X86_MMX 1
@@ -47,6 +47,8 @@ struct x86_reg {
 #define X86_SSE2 8
 #define X86_SSE3 0x10
 #define X86_SSE4_1 0x20
+#define X86_AVX 0x40
+#define X86_AVX2 0x80
 
 struct x86_function {
    unsigned caps;
@@ -65,7 +67,8 @@ enum x86_reg_file {
    file_REG32,
    file_MMX,
    file_XMM,
-   file_x87
+   file_x87,
+   file_YMM
 };
 
 /* Values for mod field of modr/m byte
@@ -308,6 +311,45 @@ void sse_unpcklps( struct x86_function *p, struct x86_reg dst, struct x86_reg sr
 void sse_pmovmskb( struct x86_function *p, struct x86_reg dest, struct x86_reg src );
 void sse_movmskps( struct x86_function *p, struct x86_reg dst, struct x86_reg src);
 
+/* AVX instructions are VEX encoded and take a separate first source where
+ * the SSE versions overwrite dst.  They operate on 256 bits when any
+ * register operand is from file_YMM, and on 128 bits (clearing the upper
+ * half of the destination) otherwise.
+ */
+void avx_vzeroupper( struct x86_function *p );
+void avx_vmovups( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vmovdqu( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vmovd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vmovq( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vpinsrd( struct x86_function *p, struct x86_reg dst, struct x86_reg src0,
+                  struct x86_reg src1, unsigned char imm );
+void avx_vextractps( struct x86_function *p, struct x86_reg dst, struct x86_reg src,
+                     unsigned char imm );
+void avx_vinsertf128( struct x86_function *p, struct x86_reg dst, struct x86_reg src0,
+                      struct x86_reg src1, unsigned char imm );
+void avx_vextractf128( struct x86_function *p, struct x86_reg dst, struct x86_reg src,
+                       unsigned char imm );
+void avx_vbroadcastf128( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vcvtdq2ps( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vcvtps2dq( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx_vmulps( struct x86_function *p, struct x86_reg dst, struct x86_reg src0,
+                 struct x86_reg src1 );
+void avx_vorps( struct x86_function *p, struct x86_reg dst, struct x86_reg src0,
+                struct x86_reg src1 );
+void avx_vshufps( struct x86_function *p, struct x86_reg dst, struct x86_reg src0,
+                  struct x86_reg src1, unsigned char shuf );
+
+/* The 128-bit forms of these only need AVX, the 256-bit ones AVX2.
+ */
+void avx2_vpmovzxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx2_vpmovzxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx2_vpmovsxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx2_vpmovsxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void avx2_vpackssdw( struct x86_function *p, struct x86_reg dst, struct x86_reg src0,
+                     struct x86_reg src1 );
+void avx2_vpackuswb( struct x86_function *p, struct x86_reg dst, struct x86_reg src0,
+                     struct x86_reg src1 );
+
 void x86_add( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
 void x86_and( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
 void x86_cmovcc( struct x86_function *p, struct x86_reg dst, struct x86_reg src, enum x86_cc cc );
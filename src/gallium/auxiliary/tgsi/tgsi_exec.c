@@ -58,6 +58,8 @@
 #include "tgsi/tgsi_parse.h"
 #include "tgsi/tgsi_util.h"
 #include "tgsi_exec.h"
+#include "tgsi_exec_simd.h"
+#include "util/u_debug.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 
@@ -65,6 +67,9 @@
 #define DEBUG_EXECUTION 0
 
 
+DEBUG_GET_ONCE_BOOL_OPTION(predecode, "TGSI_EXEC_PREDECODE", TRUE)
+
+
 #define FAST_MATH 0
 
 #define TILE_TOP_LEFT     0
@@ -269,18 +274,6 @@ micro_lg2(union tgsi_exec_channel *dst,
 #endif
 }
 
-static void
-micro_lrp(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
-{
-   dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
-   dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
-   dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
-   dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
-}
-
 static void
 micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
@@ -355,28 +348,6 @@ micro_sqrt(union tgsi_exec_channel *dst,
    dst->f[3] = sqrtf(src->f[3]);
 }
 
-static void
-micro_seq(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
-{
-   dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
-}
-
-static void
-micro_sge(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
-{
-   dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
-}
-
 static void
 micro_sgn(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
@@ -429,28 +400,6 @@ micro_sle(union tgsi_exec_channel *dst,
    dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
 }
 
-static void
-micro_slt(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
-{
-   dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
-}
-
-static void
-micro_sne(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
-{
-   dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
-}
-
 static void
 micro_sfl(union tgsi_exec_channel *dst)
 {
@@ -632,6 +581,10 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+static void
+decode_instructions(struct tgsi_exec_machine *mach);
+
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -670,6 +623,12 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      FREE(mach->Ops);
+      mach->Ops = NULL;
+
+      FREE(mach->ImmChannels);
+      mach->ImmChannels = NULL;
+
       return;
    }
 
@@ -804,6 +763,8 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   decode_instructions(mach);
 }
 
 
@@ -820,6 +781,8 @@ tgsi_exec_machine_create( void )
    memset(mach, 0, sizeof(*mach));
 
    mach->Addrs = &mach->Temps[TGSI_EXEC_TEMP_ADDR];
+   mach->SimdFuncs = tgsi_exec_choose_simd_funcs();
+   mach->Predecode = debug_get_option_predecode();
    mach->MaxGeometryShaderOutputs = TGSI_MAX_TOTAL_VERTICES;
    mach->Predicates = &mach->Temps[TGSI_EXEC_TEMP_P0];
 
@@ -866,6 +829,8 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
    if (mach) {
       FREE(mach->Instructions);
       FREE(mach->Declarations);
+      FREE(mach->Ops);
+      FREE(mach->ImmChannels);
 
       align_free(mach->Inputs);
       align_free(mach->Outputs);
@@ -1296,6 +1261,54 @@ fetch_source(const struct tgsi_exec_machine *mach,
    }
 }
 
+/**
+ * Write the enabled lanes of a channel, applying the saturate mode.
+ */
+static INLINE void
+store_channel(union tgsi_exec_channel *dst,
+              const union tgsi_exec_channel *chan,
+              uint execmask,
+              unsigned saturate)
+{
+   uint i;
+
+   switch (saturate) {
+   case TGSI_SAT_NONE:
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         if (execmask & (1 << i))
+            dst->i[i] = chan->i[i];
+      break;
+
+   case TGSI_SAT_ZERO_ONE:
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+      break;
+
+   case TGSI_SAT_MINUS_PLUS_ONE:
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < -1.0f)
+               dst->f[i] = -1.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+      break;
+
+   default:
+      assert( 0 );
+   }
+}
+
+
 static void
 store_dest(struct tgsi_exec_machine *mach,
            const union tgsi_exec_channel *chan,
@@ -1512,40 +1525,7 @@ store_dest(struct tgsi_exec_machine *mach,
       }
    }
 
-   switch (inst->Instruction.Saturate) {
-   case TGSI_SAT_NONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i))
-            dst->i[i] = chan->i[i];
-      break;
-
-   case TGSI_SAT_ZERO_ONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i)) {
-            if (chan->f[i] < 0.0f)
-               dst->f[i] = 0.0f;
-            else if (chan->f[i] > 1.0f)
-               dst->f[i] = 1.0f;
-            else
-               dst->i[i] = chan->i[i];
-         }
-      break;
-
-   case TGSI_SAT_MINUS_PLUS_ONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i)) {
-            if (chan->f[i] < -1.0f)
-               dst->f[i] = -1.0f;
-            else if (chan->f[i] > 1.0f)
-               dst->f[i] = 1.0f;
-            else
-               dst->i[i] = chan->i[i];
-         }
-      break;
-
-   default:
-      assert( 0 );
-   }
+   store_channel(dst, chan, execmask, inst->Instruction.Saturate);
 }
 
 #define FETCH(VAL,INDEX,CHAN)\
@@ -2603,6 +2583,139 @@ exec_vector_trinary(struct tgsi_exec_machine *mach,
    }
 }
 
+/**
+ * Fetch the channels in writemask of a source operand.  Plain temporaries,
+ * the bulk of the operands in real shaders, are copied straight from the
+ * register file instead of going through fetch_source()'s per-lane
+ * indexing.
+ */
+static void
+fetch_vector(const struct tgsi_exec_machine *mach,
+             struct tgsi_exec_vector *vec,
+             const struct tgsi_full_src_register *reg,
+             unsigned writemask,
+             enum tgsi_exec_datatype src_datatype)
+{
+   unsigned int chan;
+
+   if (reg->Register.File != TGSI_FILE_TEMPORARY ||
+       reg->Register.Indirect ||
+       reg->Register.Dimension) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (writemask & (1 << chan)) {
+            fetch_source(mach, &vec->xyzw[chan], reg, chan, src_datatype);
+         }
+      }
+      return;
+   }
+
+   assert(reg->Register.Index < TGSI_EXEC_NUM_TEMPS);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan)) {
+         union tgsi_exec_channel *dst = &vec->xyzw[chan];
+         uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan);
+
+         *dst = mach->Temps[reg->Register.Index].xyzw[swizzle];
+
+         if (reg->Register.Absolute) {
+            if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
+               micro_abs(dst, dst);
+            } else {
+               micro_iabs(dst, dst);
+            }
+         }
+
+         if (reg->Register.Negate) {
+            if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
+               micro_neg(dst, dst);
+            } else {
+               micro_ineg(dst, dst);
+            }
+         }
+      }
+   }
+}
+
+/**
+ * Store the channels in writemask of the destination operand, copying
+ * whole channels when all the lanes are enabled and the destination is a
+ * plain temporary.
+ */
+static void
+store_vector(struct tgsi_exec_machine *mach,
+             const struct tgsi_exec_vector *vec,
+             const struct tgsi_full_instruction *inst,
+             unsigned writemask,
+             enum tgsi_exec_datatype dst_datatype)
+{
+   const struct tgsi_full_dst_register *reg = &inst->Dst[0];
+   unsigned int chan;
+
+   if (reg->Register.File == TGSI_FILE_TEMPORARY &&
+       !reg->Register.Indirect &&
+       !reg->Register.Dimension &&
+       !inst->Instruction.Predicate &&
+       inst->Instruction.Saturate == TGSI_SAT_NONE &&
+       mach->ExecMask == 0xf) {
+      struct tgsi_exec_vector *temp = &mach->Temps[reg->Register.Index];
+
+      assert(reg->Register.Index < TGSI_EXEC_NUM_TEMPS);
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (writemask & (1 << chan)) {
+            temp->xyzw[chan] = vec->xyzw[chan];
+         }
+      }
+      return;
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan)) {
+         store_dest(mach, &vec->xyzw[chan], reg, inst, chan, dst_datatype);
+      }
+   }
+}
+
+/**
+ * Like exec_vector_binary(), but with a single kernel call computing all
+ * the written channels at once.
+ */
+static void
+exec_simd_binary(struct tgsi_exec_machine *mach,
+                 const struct tgsi_full_instruction *inst,
+                 enum tgsi_exec_simd_binary_op op,
+                 enum tgsi_exec_datatype dst_datatype,
+                 enum tgsi_exec_datatype src_datatype)
+{
+   const unsigned writemask = inst->Dst[0].Register.WriteMask;
+   struct tgsi_exec_vector src[2];
+   struct tgsi_exec_vector dst;
+
+   fetch_vector(mach, &src[0], &inst->Src[0], writemask, src_datatype);
+   fetch_vector(mach, &src[1], &inst->Src[1], writemask, src_datatype);
+   mach->SimdFuncs->binary[op](&dst, &src[0], &src[1], writemask);
+   store_vector(mach, &dst, inst, writemask, dst_datatype);
+}
+
+static void
+exec_simd_trinary(struct tgsi_exec_machine *mach,
+                  const struct tgsi_full_instruction *inst,
+                  enum tgsi_exec_simd_trinary_op op,
+                  enum tgsi_exec_datatype dst_datatype,
+                  enum tgsi_exec_datatype src_datatype)
+{
+   const unsigned writemask = inst->Dst[0].Register.WriteMask;
+   struct tgsi_exec_vector src[3];
+   struct tgsi_exec_vector dst;
+
+   fetch_vector(mach, &src[0], &inst->Src[0], writemask, src_datatype);
+   fetch_vector(mach, &src[1], &inst->Src[1], writemask, src_datatype);
+   fetch_vector(mach, &src[2], &inst->Src[2], writemask, src_datatype);
+   mach->SimdFuncs->trinary[op](&dst, &src[0], &src[1], &src[2], writemask);
+   store_vector(mach, &dst, inst, writemask, dst_datatype);
+}
+
 static void
 exec_dp3(struct tgsi_exec_machine *mach,
          const struct tgsi_full_instruction *inst)
@@ -3195,39 +3308,6 @@ micro_shl(union tgsi_exec_channel *dst,
    dst->u[3] = src0->u[3] << masked_count;
 }
 
-static void
-micro_and(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->u[0] & src1->u[0];
-   dst->u[1] = src0->u[1] & src1->u[1];
-   dst->u[2] = src0->u[2] & src1->u[2];
-   dst->u[3] = src0->u[3] & src1->u[3];
-}
-
-static void
-micro_or(union tgsi_exec_channel *dst,
-         const union tgsi_exec_channel *src0,
-         const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->u[0] | src1->u[0];
-   dst->u[1] = src0->u[1] | src1->u[1];
-   dst->u[2] = src0->u[2] | src1->u[2];
-   dst->u[3] = src0->u[3] | src1->u[3];
-}
-
-static void
-micro_xor(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->u[0] ^ src1->u[0];
-   dst->u[1] = src0->u[1] ^ src1->u[1];
-   dst->u[2] = src0->u[2] ^ src1->u[2];
-   dst->u[3] = src0->u[3] ^ src1->u[3];
-}
-
 static void
 micro_mod(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
@@ -3249,50 +3329,6 @@ micro_f2i(union tgsi_exec_channel *dst,
    dst->i[3] = (int)src->f[3];
 }
 
-static void
-micro_fseq(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->f[0] == src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] == src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] == src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] == src1->f[3] ? ~0 : 0;
-}
-
-static void
-micro_fsge(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->f[0] >= src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] >= src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] >= src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] >= src1->f[3] ? ~0 : 0;
-}
-
-static void
-micro_fslt(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->f[0] < src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] < src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] < src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] < src1->f[3] ? ~0 : 0;
-}
-
-static void
-micro_fsne(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->f[0] != src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] != src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] != src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] != src1->f[3] ? ~0 : 0;
-}
-
 static void
 micro_idiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
@@ -3384,17 +3420,6 @@ micro_u2f(union tgsi_exec_channel *dst,
    dst->f[3] = (float)src->u[3];
 }
 
-static void
-micro_uadd(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
-{
-   dst->u[0] = src0->u[0] + src1->u[0];
-   dst->u[1] = src0->u[1] + src1->u[1];
-   dst->u[2] = src0->u[2] + src1->u[2];
-   dst->u[3] = src0->u[3] + src1->u[3];
-}
-
 static void
 micro_udiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
@@ -3610,11 +3635,11 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_MUL:
-      exec_vector_binary(mach, inst, micro_mul, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_MUL, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_ADD:
-      exec_vector_binary(mach, inst, micro_add, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_ADD, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_DP3:
@@ -3630,31 +3655,31 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_MIN:
-      exec_vector_binary(mach, inst, micro_min, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_MIN, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_MAX:
-      exec_vector_binary(mach, inst, micro_max, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_MAX, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_SLT:
-      exec_vector_binary(mach, inst, micro_slt, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_SLT, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_SGE:
-      exec_vector_binary(mach, inst, micro_sge, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_SGE, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_MAD:
-      exec_vector_trinary(mach, inst, micro_mad, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_trinary(mach, inst, TGSI_EXEC_SIMD_MAD, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_SUB:
-      exec_vector_binary(mach, inst, micro_sub, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_SUB, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_LRP:
-      exec_vector_trinary(mach, inst, micro_lrp, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_trinary(mach, inst, TGSI_EXEC_SIMD_LRP, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_CND:
@@ -3754,7 +3779,7 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_SEQ:
-      exec_vector_binary(mach, inst, micro_seq, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_SEQ, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_SFL:
@@ -3774,7 +3799,7 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_SNE:
-      exec_vector_binary(mach, inst, micro_sne, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_SNE, TGSI_EXEC_DATA_FLOAT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_STR:
@@ -4062,11 +4087,11 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_AND:
-      exec_vector_binary(mach, inst, micro_and, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_UINT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_AND, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_UINT);
       break;
 
    case TGSI_OPCODE_OR:
-      exec_vector_binary(mach, inst, micro_or, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_UINT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_OR, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_UINT);
       break;
 
    case TGSI_OPCODE_MOD:
@@ -4074,7 +4099,7 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_XOR:
-      exec_vector_binary(mach, inst, micro_xor, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_UINT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_XOR, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_UINT);
       break;
 
    case TGSI_OPCODE_SAD:
@@ -4209,19 +4234,19 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_FSEQ:
-      exec_vector_binary(mach, inst, micro_fseq, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_FSEQ, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_FSGE:
-      exec_vector_binary(mach, inst, micro_fsge, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_FSGE, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_FSLT:
-      exec_vector_binary(mach, inst, micro_fslt, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_FSLT, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_FSNE:
-      exec_vector_binary(mach, inst, micro_fsne, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_FSNE, TGSI_EXEC_DATA_UINT, TGSI_EXEC_DATA_FLOAT);
       break;
 
    case TGSI_OPCODE_IDIV:
@@ -4261,7 +4286,7 @@ exec_instruction(
       break;
 
    case TGSI_OPCODE_UADD:
-      exec_vector_binary(mach, inst, micro_uadd, TGSI_EXEC_DATA_INT, TGSI_EXEC_DATA_INT);
+      exec_simd_binary(mach, inst, TGSI_EXEC_SIMD_UADD, TGSI_EXEC_DATA_INT, TGSI_EXEC_DATA_INT);
       break;
 
    case TGSI_OPCODE_UDIV:
@@ -4423,6 +4448,541 @@ exec_instruction(
 }
 
 
+/*
+ * Pre-decoded instructions.
+ *
+ * At bind time each instruction is turned into a tgsi_exec_op carrying its
+ * handler and, for the common ALU opcodes, operands resolved to pointers
+ * into the register files.  tgsi_exec_machine_run() then just calls the
+ * handler of the op at pc, without the opcode switch, and the handlers
+ * skip fetch_source()/store_dest()'s per-lane index arithmetic.
+ * Everything else (flow control, texturing, indirect or 2D addressing,
+ * predication, ...) gets a handler that calls exec_instruction().
+ */
+
+/**
+ * A source operand resolved at bind time.
+ */
+struct tgsi_exec_decoded_src
+{
+   /** Swizzled channels, or NULL for constants */
+   const union tgsi_exec_channel *chan[TGSI_NUM_CHANNELS];
+
+   /** Constant buffer and positions in it, read at run time since the
+    * buffers can change between runs.
+    */
+   unsigned const_buf;
+   int const_pos[TGSI_NUM_CHANNELS];
+
+   boolean absolute;
+   boolean negate;
+};
+
+typedef void (*tgsi_exec_op_func)(struct tgsi_exec_machine *mach,
+                                  const struct tgsi_exec_op *op,
+                                  int *pc);
+
+struct tgsi_exec_op
+{
+   tgsi_exec_op_func func;
+
+   /** The instruction, for the exec_instruction() fallback */
+   const struct tgsi_full_instruction *inst;
+
+   /** enum tgsi_exec_simd_binary_op or tgsi_exec_simd_trinary_op */
+   unsigned kernel;
+
+   unsigned writemask;
+   unsigned saturate;
+   enum tgsi_exec_datatype src_datatype;
+
+   union tgsi_exec_channel *dst[TGSI_NUM_CHANNELS];
+   struct tgsi_exec_decoded_src src[3];
+};
+
+
+static INLINE void
+fetch_decoded(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_op *op,
+              union tgsi_exec_channel *chan,
+              unsigned src_index,
+              unsigned chan_index)
+{
+   const struct tgsi_exec_decoded_src *src = &op->src[src_index];
+
+   if (src->chan[chan_index]) {
+      *chan = *src->chan[chan_index];
+   } else {
+      /* Same bounds check as fetch_src_file_channel() */
+      const unsigned constbuf = src->const_buf;
+      const int pos = src->const_pos[chan_index];
+      uint value = 0;
+
+      if (pos < (int) mach->ConstsSize[constbuf]) {
+         assert(mach->Consts[constbuf]);
+         value = ((const uint *) mach->Consts[constbuf])[pos];
+      }
+      chan->u[0] =
+      chan->u[1] =
+      chan->u[2] =
+      chan->u[3] = value;
+   }
+
+   if (src->absolute) {
+      if (op->src_datatype == TGSI_EXEC_DATA_FLOAT) {
+         micro_abs(chan, chan);
+      } else {
+         micro_iabs(chan, chan);
+      }
+   }
+
+   if (src->negate) {
+      if (op->src_datatype == TGSI_EXEC_DATA_FLOAT) {
+         micro_neg(chan, chan);
+      } else {
+         micro_ineg(chan, chan);
+      }
+   }
+}
+
+static INLINE void
+store_decoded(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_op *op,
+              const union tgsi_exec_channel *chan,
+              unsigned chan_index)
+{
+   union tgsi_exec_channel *dst = op->dst[chan_index];
+
+   if (mach->ExecMask == 0xf && op->saturate == TGSI_SAT_NONE) {
+      *dst = *chan;
+   } else {
+      store_channel(dst, chan, mach->ExecMask, op->saturate);
+   }
+}
+
+
+static void
+exec_op_fallback(struct tgsi_exec_machine *mach,
+                 const struct tgsi_exec_op *op,
+                 int *pc)
+{
+   exec_instruction(mach, op->inst, pc);
+}
+
+static void
+exec_op_mov(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   struct tgsi_exec_vector src;
+   unsigned chan;
+
+   (*pc)++;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         fetch_decoded(mach, op, &src.xyzw[chan], 0, chan);
+      }
+   }
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         store_decoded(mach, op, &src.xyzw[chan], chan);
+      }
+   }
+}
+
+static void
+exec_op_binary(struct tgsi_exec_machine *mach,
+               const struct tgsi_exec_op *op,
+               int *pc)
+{
+   struct tgsi_exec_vector src[2];
+   struct tgsi_exec_vector dst;
+   unsigned chan;
+
+   (*pc)++;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         fetch_decoded(mach, op, &src[0].xyzw[chan], 0, chan);
+         fetch_decoded(mach, op, &src[1].xyzw[chan], 1, chan);
+      }
+   }
+   mach->SimdFuncs->binary[op->kernel](&dst, &src[0], &src[1], op->writemask);
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         store_decoded(mach, op, &dst.xyzw[chan], chan);
+      }
+   }
+}
+
+static void
+exec_op_trinary(struct tgsi_exec_machine *mach,
+                const struct tgsi_exec_op *op,
+                int *pc)
+{
+   struct tgsi_exec_vector src[3];
+   struct tgsi_exec_vector dst;
+   unsigned chan;
+
+   (*pc)++;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         fetch_decoded(mach, op, &src[0].xyzw[chan], 0, chan);
+         fetch_decoded(mach, op, &src[1].xyzw[chan], 1, chan);
+         fetch_decoded(mach, op, &src[2].xyzw[chan], 2, chan);
+      }
+   }
+   mach->SimdFuncs->trinary[op->kernel](&dst, &src[0], &src[1], &src[2],
+                                        op->writemask);
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         store_decoded(mach, op, &dst.xyzw[chan], chan);
+      }
+   }
+}
+
+/**
+ * DP3 and DP4, with the same operation order as exec_dp3()/exec_dp4().
+ */
+static INLINE void
+exec_op_dot(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            unsigned num_chans)
+{
+   union tgsi_exec_channel arg[3];
+   unsigned chan;
+
+   fetch_decoded(mach, op, &arg[0], 0, TGSI_CHAN_X);
+   fetch_decoded(mach, op, &arg[1], 1, TGSI_CHAN_X);
+   micro_mul(&arg[2], &arg[0], &arg[1]);
+
+   for (chan = TGSI_CHAN_Y; chan < num_chans; chan++) {
+      fetch_decoded(mach, op, &arg[0], 0, chan);
+      fetch_decoded(mach, op, &arg[1], 1, chan);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         store_decoded(mach, op, &arg[2], chan);
+      }
+   }
+}
+
+static void
+exec_op_dp3(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_dot(mach, op, 3);
+}
+
+static void
+exec_op_dp4(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_dot(mach, op, 4);
+}
+
+
+/**
+ * Resolve a source operand, if it is a register we can point at directly
+ * or a constant.
+ */
+static boolean
+decode_src(struct tgsi_exec_machine *mach,
+           struct tgsi_exec_decoded_src *src,
+           const struct tgsi_full_src_register *reg)
+{
+   const int index = reg->Register.Index;
+   unsigned chan;
+
+   if (reg->Register.Indirect || index < 0) {
+      return FALSE;
+   }
+
+   if (reg->Register.Dimension &&
+       (reg->Register.File != TGSI_FILE_CONSTANT ||
+        reg->Dimension.Indirect)) {
+      return FALSE;
+   }
+
+   src->const_buf = reg->Register.Dimension ? reg->Dimension.Index : 0;
+   src->absolute = reg->Register.Absolute;
+   src->negate = reg->Register.Negate;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      const uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan);
+
+      src->chan[chan] = NULL;
+      src->const_pos[chan] = 0;
+
+      switch (reg->Register.File) {
+      case TGSI_FILE_TEMPORARY:
+         if (index >= TGSI_EXEC_NUM_TEMPS) {
+            return FALSE;
+         }
+         src->chan[chan] = &mach->Temps[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_INPUT:
+         if (index >= PIPE_MAX_ATTRIBS) {
+            return FALSE;
+         }
+         src->chan[chan] = &mach->Inputs[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_IMMEDIATE:
+         if (index >= (int) mach->ImmLimit) {
+            return FALSE;
+         }
+         src->chan[chan] = &mach->ImmChannels[index * 4 + swizzle];
+         break;
+
+      case TGSI_FILE_CONSTANT:
+         if (src->const_buf >= PIPE_MAX_CONSTANT_BUFFERS) {
+            return FALSE;
+         }
+         src->const_pos[chan] = index * 4 + swizzle;
+         break;
+
+      default:
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+/**
+ * Resolve the destination operand, if it is a temporary, or an output of
+ * a shader that doesn't emit vertices (so the output offset stays zero).
+ */
+static boolean
+decode_dst(struct tgsi_exec_machine *mach,
+           struct tgsi_exec_op *op,
+           const struct tgsi_full_dst_register *reg)
+{
+   const int index = reg->Register.Index;
+   struct tgsi_exec_vector *vec;
+   unsigned chan;
+
+   if (reg->Register.Indirect || reg->Register.Dimension || index < 0) {
+      return FALSE;
+   }
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      if (index >= TGSI_EXEC_NUM_TEMPS) {
+         return FALSE;
+      }
+      vec = &mach->Temps[index];
+      break;
+
+   case TGSI_FILE_OUTPUT:
+      if (mach->Processor == TGSI_PROCESSOR_GEOMETRY ||
+          index >= PIPE_MAX_ATTRIBS) {
+         return FALSE;
+      }
+      vec = &mach->Outputs[index];
+      break;
+
+   default:
+      return FALSE;
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      op->dst[chan] = &vec->xyzw[chan];
+   }
+
+   return TRUE;
+}
+
+static void
+decode_instruction(struct tgsi_exec_machine *mach,
+                   struct tgsi_exec_op *op,
+                   const struct tgsi_full_instruction *inst)
+{
+   tgsi_exec_op_func func = NULL;
+   unsigned kernel = 0;
+   enum tgsi_exec_datatype src_datatype = TGSI_EXEC_DATA_FLOAT;
+   unsigned i;
+
+   memset(op, 0, sizeof *op);
+   op->func = exec_op_fallback;
+   op->inst = inst;
+
+   switch (inst->Instruction.Opcode) {
+   case TGSI_OPCODE_MOV:
+      func = exec_op_mov;
+      break;
+   case TGSI_OPCODE_DP3:
+      func = exec_op_dp3;
+      break;
+   case TGSI_OPCODE_DP4:
+      func = exec_op_dp4;
+      break;
+
+   case TGSI_OPCODE_ADD:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_ADD;
+      break;
+   case TGSI_OPCODE_SUB:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_SUB;
+      break;
+   case TGSI_OPCODE_MUL:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_MUL;
+      break;
+   case TGSI_OPCODE_MIN:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_MIN;
+      break;
+   case TGSI_OPCODE_MAX:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_MAX;
+      break;
+   case TGSI_OPCODE_SLT:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_SLT;
+      break;
+   case TGSI_OPCODE_SGE:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_SGE;
+      break;
+   case TGSI_OPCODE_SEQ:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_SEQ;
+      break;
+   case TGSI_OPCODE_SNE:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_SNE;
+      break;
+   case TGSI_OPCODE_FSLT:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_FSLT;
+      break;
+   case TGSI_OPCODE_FSGE:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_FSGE;
+      break;
+   case TGSI_OPCODE_FSEQ:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_FSEQ;
+      break;
+   case TGSI_OPCODE_FSNE:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_FSNE;
+      break;
+   case TGSI_OPCODE_AND:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_AND;
+      src_datatype = TGSI_EXEC_DATA_UINT;
+      break;
+   case TGSI_OPCODE_OR:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_OR;
+      src_datatype = TGSI_EXEC_DATA_UINT;
+      break;
+   case TGSI_OPCODE_XOR:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_XOR;
+      src_datatype = TGSI_EXEC_DATA_UINT;
+      break;
+   case TGSI_OPCODE_UADD:
+      func = exec_op_binary;
+      kernel = TGSI_EXEC_SIMD_UADD;
+      src_datatype = TGSI_EXEC_DATA_INT;
+      break;
+
+   case TGSI_OPCODE_MAD:
+      func = exec_op_trinary;
+      kernel = TGSI_EXEC_SIMD_MAD;
+      break;
+   case TGSI_OPCODE_LRP:
+      func = exec_op_trinary;
+      kernel = TGSI_EXEC_SIMD_LRP;
+      break;
+
+   default:
+      return;
+   }
+
+   if (inst->Instruction.Predicate ||
+       inst->Instruction.NumDstRegs != 1 ||
+       !decode_dst(mach, op, &inst->Dst[0])) {
+      return;
+   }
+
+   for (i = 0; i < inst->Instruction.NumSrcRegs; i++) {
+      if (!decode_src(mach, &op->src[i], &inst->Src[i])) {
+         return;
+      }
+   }
+
+   op->func = func;
+   op->kernel = kernel;
+   op->writemask = inst->Dst[0].Register.WriteMask;
+   op->saturate = inst->Instruction.Saturate;
+   op->src_datatype = src_datatype;
+}
+
+/**
+ * Build mach->Ops for the bound shader.  Without it, or when the
+ * allocations fail, tgsi_exec_machine_run() interprets mach->Instructions
+ * directly.
+ */
+static void
+decode_instructions(struct tgsi_exec_machine *mach)
+{
+   uint i, chan;
+
+   FREE(mach->Ops);
+   mach->Ops = NULL;
+
+   FREE(mach->ImmChannels);
+   mach->ImmChannels = NULL;
+
+   if (!mach->Predecode || !mach->NumInstructions) {
+      return;
+   }
+
+   if (mach->ImmLimit) {
+      mach->ImmChannels = MALLOC(mach->ImmLimit * 4 *
+                                 sizeof(union tgsi_exec_channel));
+      if (!mach->ImmChannels) {
+         return;
+      }
+
+      for (i = 0; i < mach->ImmLimit; i++) {
+         for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+            union tgsi_exec_channel *dst = &mach->ImmChannels[i * 4 + chan];
+
+            dst->f[0] =
+            dst->f[1] =
+            dst->f[2] =
+            dst->f[3] = mach->Imms[i][chan];
+         }
+      }
+   }
+
+   mach->Ops = MALLOC(mach->NumInstructions * sizeof(struct tgsi_exec_op));
+   if (!mach->Ops) {
+      return;
+   }
+
+   for (i = 0; i < mach->NumInstructions; i++) {
+      decode_instruction(mach, &mach->Ops[i], &mach->Instructions[i]);
+   }
+}
+
+
 /**
  * Run TGSI interpreter.
  * \return bitmask of "alive" quad components
@@ -4487,7 +5047,11 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach )
 #endif
 
          assert(pc < (int) mach->NumInstructions);
-         exec_instruction(mach, mach->Instructions + pc, &pc);
+         if (mach->Ops) {
+            mach->Ops[pc].func(mach, &mach->Ops[pc], &pc);
+         } else {
+            exec_instruction(mach, mach->Instructions + pc, &pc);
+         }
 
 #if DEBUG_EXECUTION
          for (i = 0; i < TGSI_EXEC_NUM_TEMPS + TGSI_EXEC_NUM_TEMP_EXTRAS; i++) {
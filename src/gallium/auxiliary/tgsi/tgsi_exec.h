@@ -37,6 +37,9 @@
 extern "C" {
 #endif
 
+struct tgsi_exec_op;
+struct tgsi_exec_simd_funcs;
+
 #define TGSI_CHAN_X 0
 #define TGSI_CHAN_Y 1
 #define TGSI_CHAN_Z 2
@@ -276,6 +279,9 @@ struct tgsi_exec_machine
    struct tgsi_exec_vector       *Inputs;
    struct tgsi_exec_vector       *Outputs;
 
+   /** Kernels for the component-wise ALU opcodes, see tgsi_exec_simd.h */
+   const struct tgsi_exec_simd_funcs *SimdFuncs;
+
    /* System values */
    unsigned                      SysSemanticToIndex[TGSI_SEMANTIC_COUNT];
    union tgsi_exec_channel       SystemValue[TGSI_MAX_MISC_INPUTS];
@@ -350,6 +356,18 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Instructions decoded at bind time, one per entry of Instructions */
+   struct tgsi_exec_op *Ops;
+
+   /** Immediates broadcast to whole channels, for the decoded operands */
+   union tgsi_exec_channel *ImmChannels;
+
+   /** Resolve operands at bind time (default, TGSI_EXEC_PREDECODE=0 to
+    * disable).  Otherwise every instruction goes through the generic
+    * interpreter.
+    */
+   boolean Predecode;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
@@ -0,0 +1,395 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Plain C and SSE2 versions of the wide interpreter kernels, and the
+ * runtime selection between those and the AVX ones.
+ *
+ * The results must match the micro_* functions in tgsi_exec.c bit for bit,
+ * including for NaNs, so the comparisons pick the SSE predicates with the
+ * same ordered/unordered behaviour as the C operators.
+ */
+
+#include "pipe/p_config.h"
+#include "rtasm/rtasm_cpu.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_sse.h"
+#include "tgsi_exec_simd.h"
+
+
+#define SIMD_C_BINARY(name, member, expr)                                   \
+static void                                                                 \
+simd_c_##name(struct tgsi_exec_vector *dst,                                 \
+              const struct tgsi_exec_vector *src0,                          \
+              const struct tgsi_exec_vector *src1,                          \
+              unsigned writemask)                                           \
+{                                                                           \
+   unsigned chan, i;                                                        \
+                                                                            \
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {                       \
+      if (writemask & (1 << chan)) {                                        \
+         const union tgsi_exec_channel *a = &src0->xyzw[chan];              \
+         const union tgsi_exec_channel *b = &src1->xyzw[chan];              \
+         union tgsi_exec_channel *d = &dst->xyzw[chan];                     \
+                                                                            \
+         for (i = 0; i < TGSI_QUAD_SIZE; i++) {                             \
+            d->member[i] = (expr);                                          \
+         }                                                                  \
+      }                                                                     \
+   }                                                                        \
+}
+
+#define SIMD_C_TRINARY(name, member, expr)                                  \
+static void                                                                 \
+simd_c_##name(struct tgsi_exec_vector *dst,                                 \
+              const struct tgsi_exec_vector *src0,                          \
+              const struct tgsi_exec_vector *src1,                          \
+              const struct tgsi_exec_vector *src2,                          \
+              unsigned writemask)                                           \
+{                                                                           \
+   unsigned chan, i;                                                        \
+                                                                            \
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {                       \
+      if (writemask & (1 << chan)) {                                        \
+         const union tgsi_exec_channel *a = &src0->xyzw[chan];              \
+         const union tgsi_exec_channel *b = &src1->xyzw[chan];              \
+         const union tgsi_exec_channel *c = &src2->xyzw[chan];              \
+         union tgsi_exec_channel *d = &dst->xyzw[chan];                     \
+                                                                            \
+         for (i = 0; i < TGSI_QUAD_SIZE; i++) {                             \
+            d->member[i] = (expr);                                          \
+         }                                                                  \
+      }                                                                     \
+   }                                                                        \
+}
+
+SIMD_C_BINARY(add,  f, a->f[i] + b->f[i])
+SIMD_C_BINARY(sub,  f, a->f[i] - b->f[i])
+SIMD_C_BINARY(mul,  f, a->f[i] * b->f[i])
+SIMD_C_BINARY(min,  f, a->f[i] < b->f[i] ? a->f[i] : b->f[i])
+SIMD_C_BINARY(max,  f, a->f[i] > b->f[i] ? a->f[i] : b->f[i])
+SIMD_C_BINARY(slt,  f, a->f[i] < b->f[i] ? 1.0f : 0.0f)
+SIMD_C_BINARY(sge,  f, a->f[i] >= b->f[i] ? 1.0f : 0.0f)
+SIMD_C_BINARY(seq,  f, a->f[i] == b->f[i] ? 1.0f : 0.0f)
+SIMD_C_BINARY(sne,  f, a->f[i] != b->f[i] ? 1.0f : 0.0f)
+SIMD_C_BINARY(fslt, u, a->f[i] < b->f[i] ? ~0U : 0U)
+SIMD_C_BINARY(fsge, u, a->f[i] >= b->f[i] ? ~0U : 0U)
+SIMD_C_BINARY(fseq, u, a->f[i] == b->f[i] ? ~0U : 0U)
+SIMD_C_BINARY(fsne, u, a->f[i] != b->f[i] ? ~0U : 0U)
+SIMD_C_BINARY(and,  u, a->u[i] & b->u[i])
+SIMD_C_BINARY(or,   u, a->u[i] | b->u[i])
+SIMD_C_BINARY(xor,  u, a->u[i] ^ b->u[i])
+SIMD_C_BINARY(uadd, u, a->u[i] + b->u[i])
+
+SIMD_C_TRINARY(mad, f, a->f[i] * b->f[i] + c->f[i])
+SIMD_C_TRINARY(lrp, f, a->f[i] * (b->f[i] - c->f[i]) + c->f[i])
+
+
+const struct tgsi_exec_simd_funcs tgsi_exec_simd_funcs_c = {
+   "c",
+   {
+      simd_c_add,
+      simd_c_sub,
+      simd_c_mul,
+      simd_c_min,
+      simd_c_max,
+      simd_c_slt,
+      simd_c_sge,
+      simd_c_seq,
+      simd_c_sne,
+      simd_c_fslt,
+      simd_c_fsge,
+      simd_c_fseq,
+      simd_c_fsne,
+      simd_c_and,
+      simd_c_or,
+      simd_c_xor,
+      simd_c_uadd
+   },
+   {
+      simd_c_mad,
+      simd_c_lrp
+   }
+};
+
+
+#if defined(PIPE_ARCH_SSE)
+
+
+static INLINE __m128
+sse2_add(__m128 a, __m128 b)
+{
+   return _mm_add_ps(a, b);
+}
+
+static INLINE __m128
+sse2_sub(__m128 a, __m128 b)
+{
+   return _mm_sub_ps(a, b);
+}
+
+static INLINE __m128
+sse2_mul(__m128 a, __m128 b)
+{
+   return _mm_mul_ps(a, b);
+}
+
+/* minps/maxps return the second operand when either is a NaN, which is
+ * what the C conditional in micro_min/micro_max does too.
+ */
+static INLINE __m128
+sse2_min(__m128 a, __m128 b)
+{
+   return _mm_min_ps(a, b);
+}
+
+static INLINE __m128
+sse2_max(__m128 a, __m128 b)
+{
+   return _mm_max_ps(a, b);
+}
+
+static INLINE __m128
+sse2_fslt(__m128 a, __m128 b)
+{
+   return _mm_cmplt_ps(a, b);
+}
+
+static INLINE __m128
+sse2_fsge(__m128 a, __m128 b)
+{
+   return _mm_cmpge_ps(a, b);
+}
+
+static INLINE __m128
+sse2_fseq(__m128 a, __m128 b)
+{
+   return _mm_cmpeq_ps(a, b);
+}
+
+static INLINE __m128
+sse2_fsne(__m128 a, __m128 b)
+{
+   return _mm_cmpneq_ps(a, b);
+}
+
+static INLINE __m128
+sse2_slt(__m128 a, __m128 b)
+{
+   return _mm_and_ps(_mm_cmplt_ps(a, b), _mm_set1_ps(1.0f));
+}
+
+static INLINE __m128
+sse2_sge(__m128 a, __m128 b)
+{
+   return _mm_and_ps(_mm_cmpge_ps(a, b), _mm_set1_ps(1.0f));
+}
+
+static INLINE __m128
+sse2_seq(__m128 a, __m128 b)
+{
+   return _mm_and_ps(_mm_cmpeq_ps(a, b), _mm_set1_ps(1.0f));
+}
+
+static INLINE __m128
+sse2_sne(__m128 a, __m128 b)
+{
+   return _mm_and_ps(_mm_cmpneq_ps(a, b), _mm_set1_ps(1.0f));
+}
+
+static INLINE __m128
+sse2_and(__m128 a, __m128 b)
+{
+   return _mm_and_ps(a, b);
+}
+
+static INLINE __m128
+sse2_or(__m128 a, __m128 b)
+{
+   return _mm_or_ps(a, b);
+}
+
+static INLINE __m128
+sse2_xor(__m128 a, __m128 b)
+{
+   return _mm_xor_ps(a, b);
+}
+
+static INLINE __m128
+sse2_uadd(__m128 a, __m128 b)
+{
+   return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(a),
+                                         _mm_castps_si128(b)));
+}
+
+static INLINE __m128
+sse2_mad(__m128 a, __m128 b, __m128 c)
+{
+   return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+
+static INLINE __m128
+sse2_lrp(__m128 a, __m128 b, __m128 c)
+{
+   return _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(b, c)), c);
+}
+
+
+/* The vectors are usually on the stack or in the machine's register
+ * files, so don't assume any alignment.
+ */
+#define SIMD_SSE2_BINARY(name)                                              \
+static void                                                                 \
+simd_sse2_##name(struct tgsi_exec_vector *dst,                              \
+                 const struct tgsi_exec_vector *src0,                       \
+                 const struct tgsi_exec_vector *src1,                       \
+                 unsigned writemask)                                        \
+{                                                                           \
+   unsigned chan;                                                           \
+                                                                            \
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {                       \
+      if (writemask & (1 << chan)) {                                        \
+         __m128 a = _mm_loadu_ps(src0->xyzw[chan].f);                       \
+         __m128 b = _mm_loadu_ps(src1->xyzw[chan].f);                       \
+         _mm_storeu_ps(dst->xyzw[chan].f, sse2_##name(a, b));               \
+      }                                                                     \
+   }                                                                        \
+}
+
+#define SIMD_SSE2_TRINARY(name)                                             \
+static void                                                                 \
+simd_sse2_##name(struct tgsi_exec_vector *dst,                              \
+                 const struct tgsi_exec_vector *src0,                       \
+                 const struct tgsi_exec_vector *src1,                       \
+                 const struct tgsi_exec_vector *src2,                       \
+                 unsigned writemask)                                        \
+{                                                                           \
+   unsigned chan;                                                           \
+                                                                            \
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {                       \
+      if (writemask & (1 << chan)) {                                        \
+         __m128 a = _mm_loadu_ps(src0->xyzw[chan].f);                       \
+         __m128 b = _mm_loadu_ps(src1->xyzw[chan].f);                       \
+         __m128 c = _mm_loadu_ps(src2->xyzw[chan].f);                       \
+         _mm_storeu_ps(dst->xyzw[chan].f, sse2_##name(a, b, c));            \
+      }                                                                     \
+   }                                                                        \
+}
+
+SIMD_SSE2_BINARY(add)
+SIMD_SSE2_BINARY(sub)
+SIMD_SSE2_BINARY(mul)
+SIMD_SSE2_BINARY(min)
+SIMD_SSE2_BINARY(max)
+SIMD_SSE2_BINARY(slt)
+SIMD_SSE2_BINARY(sge)
+SIMD_SSE2_BINARY(seq)
+SIMD_SSE2_BINARY(sne)
+SIMD_SSE2_BINARY(fslt)
+SIMD_SSE2_BINARY(fsge)
+SIMD_SSE2_BINARY(fseq)
+SIMD_SSE2_BINARY(fsne)
+SIMD_SSE2_BINARY(and)
+SIMD_SSE2_BINARY(or)
+SIMD_SSE2_BINARY(xor)
+SIMD_SSE2_BINARY(uadd)
+
+SIMD_SSE2_TRINARY(mad)
+SIMD_SSE2_TRINARY(lrp)
+
+
+static const struct tgsi_exec_simd_funcs simd_funcs_sse2 = {
+   "sse2",
+   {
+      simd_sse2_add,
+      simd_sse2_sub,
+      simd_sse2_mul,
+      simd_sse2_min,
+      simd_sse2_max,
+      simd_sse2_slt,
+      simd_sse2_sge,
+      simd_sse2_seq,
+      simd_sse2_sne,
+      simd_sse2_fslt,
+      simd_sse2_fsge,
+      simd_sse2_fseq,
+      simd_sse2_fsne,
+      simd_sse2_and,
+      simd_sse2_or,
+      simd_sse2_xor,
+      simd_sse2_uadd
+   },
+   {
+      simd_sse2_mad,
+      simd_sse2_lrp
+   }
+};
+
+
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_simd_funcs_sse2(void)
+{
+   return &simd_funcs_sse2;
+}
+
+
+#else /* !PIPE_ARCH_SSE */
+
+
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_simd_funcs_sse2(void)
+{
+   return NULL;
+}
+
+
+#endif /* !PIPE_ARCH_SSE */
+
+
+/**
+ * Pick the widest kernels the CPU supports.  GALLIUM_NOSSE=1 forces the
+ * plain C ones.
+ */
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_choose_simd_funcs(void)
+{
+   const struct tgsi_exec_simd_funcs *funcs = NULL;
+
+   if (rtasm_cpu_has_sse2()) {
+      if (util_cpu_caps.has_avx)
+         funcs = tgsi_exec_simd_funcs_avx();
+
+      if (!funcs)
+         funcs = tgsi_exec_simd_funcs_sse2();
+   }
+
+   if (!funcs)
+      funcs = &tgsi_exec_simd_funcs_c;
+
+   return funcs;
+}
@@ -0,0 +1,124 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Wide kernels for the component-wise ALU opcodes of the TGSI interpreter.
+ *
+ * Instead of one call per channel, each kernel processes every written
+ * channel of a whole vector, i.e. up to 16 lanes (4 channels of 4 pixels
+ * or vertices) per decoded instruction.  There are plain C, SSE2 and AVX
+ * versions; the AVX one handles two channels (8 lanes) per instruction.
+ */
+
+#ifndef TGSI_EXEC_SIMD_H
+#define TGSI_EXEC_SIMD_H
+
+#include "tgsi_exec.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+
+enum tgsi_exec_simd_binary_op
+{
+   TGSI_EXEC_SIMD_ADD,
+   TGSI_EXEC_SIMD_SUB,
+   TGSI_EXEC_SIMD_MUL,
+   TGSI_EXEC_SIMD_MIN,
+   TGSI_EXEC_SIMD_MAX,
+   TGSI_EXEC_SIMD_SLT,
+   TGSI_EXEC_SIMD_SGE,
+   TGSI_EXEC_SIMD_SEQ,
+   TGSI_EXEC_SIMD_SNE,
+   TGSI_EXEC_SIMD_FSLT,
+   TGSI_EXEC_SIMD_FSGE,
+   TGSI_EXEC_SIMD_FSEQ,
+   TGSI_EXEC_SIMD_FSNE,
+   TGSI_EXEC_SIMD_AND,
+   TGSI_EXEC_SIMD_OR,
+   TGSI_EXEC_SIMD_XOR,
+   TGSI_EXEC_SIMD_UADD,
+   TGSI_EXEC_SIMD_NUM_BINARY
+};
+
+enum tgsi_exec_simd_trinary_op
+{
+   TGSI_EXEC_SIMD_MAD,
+   TGSI_EXEC_SIMD_LRP,
+   TGSI_EXEC_SIMD_NUM_TRINARY
+};
+
+
+/**
+ * Compute dst = op(src0, src1) for the channels set in writemask.
+ * The other channels of dst are left untouched and the other channels of
+ * the sources need not be initialized.  dst may alias a source.
+ */
+typedef void (*tgsi_exec_simd_binary_func)(struct tgsi_exec_vector *dst,
+                                           const struct tgsi_exec_vector *src0,
+                                           const struct tgsi_exec_vector *src1,
+                                           unsigned writemask);
+
+typedef void (*tgsi_exec_simd_trinary_func)(struct tgsi_exec_vector *dst,
+                                            const struct tgsi_exec_vector *src0,
+                                            const struct tgsi_exec_vector *src1,
+                                            const struct tgsi_exec_vector *src2,
+                                            unsigned writemask);
+
+
+/**
+ * The kernels built for one instruction set.
+ */
+struct tgsi_exec_simd_funcs
+{
+   const char *name;
+   tgsi_exec_simd_binary_func binary[TGSI_EXEC_SIMD_NUM_BINARY];
+   tgsi_exec_simd_trinary_func trinary[TGSI_EXEC_SIMD_NUM_TRINARY];
+};
+
+
+extern const struct tgsi_exec_simd_funcs tgsi_exec_simd_funcs_c;
+
+/* NULL if this build has no kernels for the instruction set; whether the
+ * CPU supports it is still up to the caller (util_cpu_caps).
+ */
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_simd_funcs_sse2(void);
+
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_simd_funcs_avx(void);
+
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_choose_simd_funcs(void);
+
+
+#if defined __cplusplus
+}
+#endif
+
+#endif /* TGSI_EXEC_SIMD_H */
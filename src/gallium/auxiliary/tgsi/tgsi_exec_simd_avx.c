@@ -0,0 +1,274 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * AVX versions of the wide interpreter kernels.
+ *
+ * The channels of a tgsi_exec_vector are contiguous, so a pair of channels
+ * (xy or zw) fills one 256-bit register.  A pair with only one channel
+ * written falls back to a 128-bit operation.
+ *
+ * This file is compiled with -mavx and the functions are only installed
+ * when util_cpu_caps reports AVX support.
+ */
+
+#include "tgsi_exec_simd.h"
+
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+
+#define AVX_BINARY_PS(name, op256, op128)                                   \
+static INLINE __m256                                                        \
+avx_##name##_256(__m256 a, __m256 b)                                        \
+{                                                                           \
+   return op256(a, b);                                                      \
+}                                                                           \
+                                                                            \
+static INLINE __m128                                                        \
+avx_##name##_128(__m128 a, __m128 b)                                        \
+{                                                                           \
+   return op128(a, b);                                                      \
+}
+
+AVX_BINARY_PS(add, _mm256_add_ps, _mm_add_ps)
+AVX_BINARY_PS(sub, _mm256_sub_ps, _mm_sub_ps)
+AVX_BINARY_PS(mul, _mm256_mul_ps, _mm_mul_ps)
+AVX_BINARY_PS(min, _mm256_min_ps, _mm_min_ps)
+AVX_BINARY_PS(max, _mm256_max_ps, _mm_max_ps)
+AVX_BINARY_PS(and, _mm256_and_ps, _mm_and_ps)
+AVX_BINARY_PS(or,  _mm256_or_ps,  _mm_or_ps)
+AVX_BINARY_PS(xor, _mm256_xor_ps, _mm_xor_ps)
+
+
+/* Comparison predicates with the same NaN behaviour as the C operators:
+ * <, >= and == are false when unordered, != is true.
+ */
+#define AVX_COMPARE(name, pred)                                             \
+static INLINE __m256                                                        \
+avx_fs##name##_256(__m256 a, __m256 b)                                      \
+{                                                                           \
+   return _mm256_cmp_ps(a, b, pred);                                        \
+}                                                                           \
+                                                                            \
+static INLINE __m128                                                        \
+avx_fs##name##_128(__m128 a, __m128 b)                                      \
+{                                                                           \
+   return _mm_cmp_ps(a, b, pred);                                           \
+}                                                                           \
+                                                                            \
+static INLINE __m256                                                        \
+avx_s##name##_256(__m256 a, __m256 b)                                       \
+{                                                                           \
+   return _mm256_and_ps(_mm256_cmp_ps(a, b, pred), _mm256_set1_ps(1.0f));   \
+}                                                                           \
+                                                                            \
+static INLINE __m128                                                        \
+avx_s##name##_128(__m128 a, __m128 b)                                       \
+{                                                                           \
+   return _mm_and_ps(_mm_cmp_ps(a, b, pred), _mm_set1_ps(1.0f));            \
+}
+
+AVX_COMPARE(lt, _CMP_LT_OQ)
+AVX_COMPARE(ge, _CMP_GE_OQ)
+AVX_COMPARE(eq, _CMP_EQ_OQ)
+AVX_COMPARE(ne, _CMP_NEQ_UQ)
+
+
+/* AVX has no 256-bit integer arithmetic, so add the halves separately.
+ */
+static INLINE __m256
+avx_uadd_256(__m256 a, __m256 b)
+{
+   __m256i ia = _mm256_castps_si256(a);
+   __m256i ib = _mm256_castps_si256(b);
+   __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(ia),
+                              _mm256_castsi256_si128(ib));
+   __m128i hi = _mm_add_epi32(_mm256_extractf128_si256(ia, 1),
+                              _mm256_extractf128_si256(ib, 1));
+   return _mm256_castsi256_ps(
+      _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+}
+
+static INLINE __m128
+avx_uadd_128(__m128 a, __m128 b)
+{
+   return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(a),
+                                         _mm_castps_si128(b)));
+}
+
+
+static INLINE __m256
+avx_mad_256(__m256 a, __m256 b, __m256 c)
+{
+   return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+
+static INLINE __m128
+avx_mad_128(__m128 a, __m128 b, __m128 c)
+{
+   return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+
+static INLINE __m256
+avx_lrp_256(__m256 a, __m256 b, __m256 c)
+{
+   return _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(b, c)), c);
+}
+
+static INLINE __m128
+avx_lrp_128(__m128 a, __m128 b, __m128 c)
+{
+   return _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(b, c)), c);
+}
+
+
+#define SIMD_AVX_BINARY(name)                                               \
+static void                                                                 \
+simd_avx_##name(struct tgsi_exec_vector *dst,                               \
+                const struct tgsi_exec_vector *src0,                        \
+                const struct tgsi_exec_vector *src1,                        \
+                unsigned writemask)                                         \
+{                                                                           \
+   unsigned chan;                                                           \
+                                                                            \
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan += 2) {                    \
+      unsigned pair = (writemask >> chan) & 3;                              \
+                                                                            \
+      if (pair == 3) {                                                      \
+         __m256 a = _mm256_loadu_ps(src0->xyzw[chan].f);                    \
+         __m256 b = _mm256_loadu_ps(src1->xyzw[chan].f);                    \
+         _mm256_storeu_ps(dst->xyzw[chan].f, avx_##name##_256(a, b));       \
+      }                                                                     \
+      else if (pair) {                                                      \
+         unsigned c = chan + (pair >> 1);                                   \
+         __m128 a = _mm_loadu_ps(src0->xyzw[c].f);                          \
+         __m128 b = _mm_loadu_ps(src1->xyzw[c].f);                          \
+         _mm_storeu_ps(dst->xyzw[c].f, avx_##name##_128(a, b));             \
+      }                                                                     \
+   }                                                                        \
+}
+
+#define SIMD_AVX_TRINARY(name)                                              \
+static void                                                                 \
+simd_avx_##name(struct tgsi_exec_vector *dst,                               \
+                const struct tgsi_exec_vector *src0,                        \
+                const struct tgsi_exec_vector *src1,                        \
+                const struct tgsi_exec_vector *src2,                        \
+                unsigned writemask)                                         \
+{                                                                           \
+   unsigned chan;                                                           \
+                                                                            \
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan += 2) {                    \
+      unsigned pair = (writemask >> chan) & 3;                              \
+                                                                            \
+      if (pair == 3) {                                                      \
+         __m256 a = _mm256_loadu_ps(src0->xyzw[chan].f);                    \
+         __m256 b = _mm256_loadu_ps(src1->xyzw[chan].f);                    \
+         __m256 c = _mm256_loadu_ps(src2->xyzw[chan].f);                    \
+         _mm256_storeu_ps(dst->xyzw[chan].f, avx_##name##_256(a, b, c));    \
+      }                                                                     \
+      else if (pair) {                                                      \
+         unsigned ch = chan + (pair >> 1);                                  \
+         __m128 a = _mm_loadu_ps(src0->xyzw[ch].f);                         \
+         __m128 b = _mm_loadu_ps(src1->xyzw[ch].f);                         \
+         __m128 c = _mm_loadu_ps(src2->xyzw[ch].f);                         \
+         _mm_storeu_ps(dst->xyzw[ch].f, avx_##name##_128(a, b, c));         \
+      }                                                                     \
+   }                                                                        \
+}
+
+SIMD_AVX_BINARY(add)
+SIMD_AVX_BINARY(sub)
+SIMD_AVX_BINARY(mul)
+SIMD_AVX_BINARY(min)
+SIMD_AVX_BINARY(max)
+SIMD_AVX_BINARY(slt)
+SIMD_AVX_BINARY(sge)
+SIMD_AVX_BINARY(seq)
+SIMD_AVX_BINARY(sne)
+SIMD_AVX_BINARY(fslt)
+SIMD_AVX_BINARY(fsge)
+SIMD_AVX_BINARY(fseq)
+SIMD_AVX_BINARY(fsne)
+SIMD_AVX_BINARY(and)
+SIMD_AVX_BINARY(or)
+SIMD_AVX_BINARY(xor)
+SIMD_AVX_BINARY(uadd)
+
+SIMD_AVX_TRINARY(mad)
+SIMD_AVX_TRINARY(lrp)
+
+
+static const struct tgsi_exec_simd_funcs simd_funcs_avx = {
+   "avx",
+   {
+      simd_avx_add,
+      simd_avx_sub,
+      simd_avx_mul,
+      simd_avx_min,
+      simd_avx_max,
+      simd_avx_slt,
+      simd_avx_sge,
+      simd_avx_seq,
+      simd_avx_sne,
+      simd_avx_fslt,
+      simd_avx_fsge,
+      simd_avx_fseq,
+      simd_avx_fsne,
+      simd_avx_and,
+      simd_avx_or,
+      simd_avx_xor,
+      simd_avx_uadd
+   },
+   {
+      simd_avx_mad,
+      simd_avx_lrp
+   }
+};
+
+
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_simd_funcs_avx(void)
+{
+   return &simd_funcs_avx;
+}
+
+
+#else /* !__AVX__ */
+
+
+const struct tgsi_exec_simd_funcs *
+tgsi_exec_simd_funcs_avx(void)
+{
+   return NULL;
+}
+
+
+#endif /* !__AVX__ */
@@ -660,7 +660,7 @@ static ALWAYS_INLINE void PIPE_CDECL generic_run_one( struct translate_generic *
          }
       } else {
          if(likely(tg->attrib[attr].copy_size >= 0))
-            memcpy(data, &instance_id, 4);
+            memcpy(dst, &instance_id, 4);
          else
          {
             data[0] = (float)instance_id;
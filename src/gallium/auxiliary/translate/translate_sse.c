@@ -66,6 +66,9 @@ struct translate_buffer_variant
 
 #define NUM_CONSTS 7
 
+/* The AVX2 loop keeps the constants it uses in YMM2 + id, so all but the
+ * last one (which it doesn't use) must fit in YMM2-7.
+ */
 enum
 {
    CONST_IDENTITY,
@@ -73,8 +76,8 @@ enum
    CONST_INV_255,
    CONST_INV_32767,
    CONST_INV_65535,
-   CONST_INV_2147483647,
-   CONST_255
+   CONST_255,
+   CONST_INV_2147483647
 };
 
 #define C(v) {(float)(v), (float)(v), (float)(v), (float)(v)}
@@ -84,8 +87,8 @@ static float consts[NUM_CONSTS][4] = {
    C(1.0 / 255.0),
    C(1.0 / 32767.0),
    C(1.0 / 65535.0),
-   C(1.0 / 2147483647.0),
-   C(255.0)
+   C(255.0),
+   C(1.0 / 2147483647.0)
 };
 
 #undef C
@@ -173,6 +176,29 @@ get_const(struct translate_sse *p, unsigned id)
 }
 
 
+/* load 1 to 3 bytes in a general purpose register, padding with zeros */
+static void
+emit_load_gpr(struct translate_sse *p,
+              struct x86_reg data, struct x86_reg src, unsigned size)
+{
+   switch (size) {
+   case 1:
+      x86_movzx8(p->func, data, src);
+      break;
+   case 2:
+      x86_movzx16(p->func, data, src);
+      break;
+   case 3:
+      x86_movzx8(p->func, data, x86_make_disp(src, 2));
+      x86_shl_imm(p->func, data, 16);
+      x86_mov16(p->func, data, src);
+      break;
+   default:
+      assert(0);
+   }
+}
+
+
 /* load the data in a SSE2 register, padding with zeros */
 static boolean
 emit_load_sse2(struct translate_sse *p,
@@ -182,17 +208,9 @@ emit_load_sse2(struct translate_sse *p,
    struct x86_reg tmp = p->tmp_EAX;
    switch (size) {
    case 1:
-      x86_movzx8(p->func, tmp, src);
-      sse2_movd(p->func, data, tmp);
-      break;
    case 2:
-      x86_movzx16(p->func, tmp, src);
-      sse2_movd(p->func, data, tmp);
-      break;
    case 3:
-      x86_movzx8(p->func, tmp, x86_make_disp(src, 2));
-      x86_shl_imm(p->func, tmp, 16);
-      x86_mov16(p->func, tmp, src);
+      emit_load_gpr(p, tmp, src, size);
       sse2_movd(p->func, data, tmp);
       break;
    case 4:
@@ -455,6 +473,20 @@ emit_memcpy(struct translate_sse *p, struct x86_reg dst, struct x86_reg src,
    }
 }
 
+/* Compare everything but the shift, which differs between the channels of
+ * every multi-channel format.
+ */
+static boolean
+channel_equal(const struct util_format_channel_description *a,
+              const struct util_format_channel_description *b)
+{
+   return a->type == b->type &&
+          a->normalized == b->normalized &&
+          a->pure_integer == b->pure_integer &&
+          a->size == b->size;
+}
+
+
 static boolean
 translate_attr_convert(struct translate_sse *p,
                        const struct translate_element *a,
@@ -483,18 +515,13 @@ translate_attr_convert(struct translate_sse *p,
       return FALSE;
 
    for (i = 1; i < input_desc->nr_channels; ++i) {
-      if (memcmp
-          (&input_desc->channel[i], &input_desc->channel[0],
-           sizeof(input_desc->channel[0])))
+      if (!channel_equal(&input_desc->channel[i], &input_desc->channel[0]))
          return FALSE;
    }
 
    for (i = 1; i < output_desc->nr_channels; ++i) {
-      if (memcmp
-          (&output_desc->channel[i], &output_desc->channel[0],
-           sizeof(output_desc->channel[0]))) {
+      if (!channel_equal(&output_desc->channel[i], &output_desc->channel[0]))
          return FALSE;
-      }
    }
 
    for (i = 0; i < output_desc->nr_channels; ++i) {
@@ -774,7 +801,8 @@ translate_attr_convert(struct translate_sse *p,
             if (input_desc->channel[0].normalized) {
                sse2_movq(p->func, tmpXMM, get_const(p, CONST_IDENTITY));
                sse2_punpcklbw(p->func, tmpXMM, dataXMM);
-               sse2_psllw_imm(p->func, dataXMM, 9);
+               sse2_movdqa(p->func, dataXMM, tmpXMM);
+               sse2_psllw_imm(p->func, dataXMM, 1);
                sse2_psrlw_imm(p->func, dataXMM, 8);
                sse2_por(p->func, tmpXMM, dataXMM);
                sse2_psrlw_imm(p->func, dataXMM, 7);
@@ -797,7 +825,7 @@ translate_attr_convert(struct translate_sse *p,
          if (output_desc->channel[0].normalized)
             imms[1] =
                (output_desc->channel[0].type ==
-                UTIL_FORMAT_TYPE_UNSIGNED) ? 0xffff : 0x7ffff;
+                UTIL_FORMAT_TYPE_UNSIGNED) ? 0xffff : 0x7fff;
 
          if (!id_swizzle)
             sse2_pshuflw(p->func, dataXMM, dataXMM,
@@ -883,8 +911,7 @@ translate_attr_convert(struct translate_sse *p,
       }
       return TRUE;
    }
-   else if (!memcmp(&output_desc->channel[0], &input_desc->channel[0],
-                    sizeof(output_desc->channel[0]))) {
+   else if (channel_equal(&output_desc->channel[0], &input_desc->channel[0])) {
       struct x86_reg tmp = p->tmp_EAX;
       unsigned i;
 
@@ -1069,6 +1096,356 @@ translate_attr(struct translate_sse *p,
 }
 
 
+/*
+ * The AVX2 loop converts two vertices per iteration, packing each attribute
+ * of both vertices into one YMM register.  It is only used when every
+ * element has a wide form, so that no legacy SSE instruction runs while
+ * the upper halves of the YMM registers are dirty.
+ */
+
+enum wide_kind
+{
+   WIDE_COPY,
+   WIDE_TO_FLOAT,
+   WIDE_TO_UB4
+};
+
+struct wide_attr
+{
+   enum wide_kind kind;
+   unsigned size;               /* input bytes per vertex */
+   unsigned out_size;           /* output bytes per vertex */
+   unsigned chan_size;          /* input channel bits, for WIDE_TO_FLOAT */
+   boolean is_signed;
+   int scale;                   /* CONST_x to multiply by, or -1 */
+   boolean shuffle;
+   unsigned char shuf;
+   boolean one_w;               /* or 1.0 into the fourth channel */
+};
+
+
+/* Check whether the element has a wide form.  This must not accept anything
+ * translate_attr() would convert differently.
+ */
+static boolean
+get_wide_attr(const struct translate_element *a, struct wide_attr *w)
+{
+   const struct util_format_description *input_desc;
+   const struct util_format_description *output_desc;
+   unsigned swizzle[4] =
+      { UTIL_FORMAT_SWIZZLE_NONE, UTIL_FORMAT_SWIZZLE_NONE,
+        UTIL_FORMAT_SWIZZLE_NONE, UTIL_FORMAT_SWIZZLE_NONE };
+   unsigned i;
+
+   memset(w, 0, sizeof *w);
+   w->scale = -1;
+
+   if (a->output_format == PIPE_FORMAT_NONE
+       || a->input_format == PIPE_FORMAT_NONE)
+      return FALSE;
+
+   w->size = util_format_get_stride(a->input_format, 1);
+
+   if (a->input_format == a->output_format) {
+      w->kind = WIDE_COPY;
+      switch (w->size) {
+      case 1: case 2: case 3: case 4: case 6:
+      case 8: case 12: case 16: case 24: case 32:
+         return TRUE;
+      default:
+         return FALSE;
+      }
+   }
+
+   if (a->input_format == PIPE_FORMAT_R32G32B32A32_FLOAT &&
+       (a->output_format == PIPE_FORMAT_R8G8B8A8_UNORM ||
+        a->output_format == PIPE_FORMAT_B8G8R8A8_UNORM)) {
+      w->kind = WIDE_TO_UB4;
+      w->scale = CONST_255;
+      if (a->output_format == PIPE_FORMAT_B8G8R8A8_UNORM) {
+         w->shuffle = TRUE;
+         w->shuf = SHUF(2, 1, 0, 3);
+      }
+      return TRUE;
+   }
+
+   /* Same preconditions as the float output path of
+    * translate_attr_convert().
+    */
+   if (a->output_format != PIPE_FORMAT_R32_FLOAT &&
+       a->output_format != PIPE_FORMAT_R32G32_FLOAT &&
+       a->output_format != PIPE_FORMAT_R32G32B32_FLOAT &&
+       a->output_format != PIPE_FORMAT_R32G32B32A32_FLOAT)
+      return FALSE;
+
+   input_desc = util_format_description(a->input_format);
+   output_desc = util_format_description(a->output_format);
+
+   if (input_desc->colorspace != output_desc->colorspace)
+      return FALSE;
+
+   for (i = 1; i < input_desc->nr_channels; ++i) {
+      if (!channel_equal(&input_desc->channel[i], &input_desc->channel[0]))
+         return FALSE;
+   }
+
+   w->kind = WIDE_TO_FLOAT;
+   w->out_size = 4 * output_desc->nr_channels;
+   w->chan_size = input_desc->channel[0].size;
+
+   switch (input_desc->channel[0].type) {
+   case UTIL_FORMAT_TYPE_UNSIGNED:
+      if (w->chan_size == 8 && input_desc->channel[0].normalized)
+         w->scale = CONST_INV_255;
+      else if (w->chan_size == 16 && input_desc->channel[0].normalized)
+         w->scale = CONST_INV_65535;
+      else if (w->chan_size != 8 && w->chan_size != 16)
+         return FALSE;
+      break;
+   case UTIL_FORMAT_TYPE_SIGNED:
+      w->is_signed = TRUE;
+      if (w->chan_size == 8 && input_desc->channel[0].normalized)
+         w->scale = CONST_INV_127;
+      else if (w->chan_size == 16 && input_desc->channel[0].normalized)
+         w->scale = CONST_INV_32767;
+      else if (w->chan_size != 8 && w->chan_size != 16)
+         return FALSE;
+      break;
+   case UTIL_FORMAT_TYPE_FLOAT:
+      if (w->chan_size != 32)
+         return FALSE;
+      break;
+   default:
+      return FALSE;
+   }
+
+   for (i = 0; i < output_desc->nr_channels; ++i) {
+      if (output_desc->swizzle[i] < 4)
+         swizzle[output_desc->swizzle[i]] = input_desc->swizzle[i];
+   }
+
+   /* The loads pad the vertex with zeros, so with less than four input
+    * channels the fourth one reads as 0.0.
+    */
+   for (i = 0; i < 4; ++i) {
+      unsigned sel = i;
+
+      if (i < output_desc->nr_channels) {
+         if (swizzle[i] < 4)
+            sel = swizzle[i];
+         else if (swizzle[i] == UTIL_FORMAT_SWIZZLE_0
+                  && i >= input_desc->nr_channels)
+            sel = i;
+         else if (input_desc->nr_channels < 4
+                  && (swizzle[i] == UTIL_FORMAT_SWIZZLE_0
+                      || (swizzle[i] == UTIL_FORMAT_SWIZZLE_1 && i == 3))) {
+            sel = 3;
+            if (swizzle[i] == UTIL_FORMAT_SWIZZLE_1)
+               w->one_w = TRUE;
+         }
+         else
+            return FALSE;
+      }
+
+      if (sel != i)
+         w->shuffle = TRUE;
+      w->shuf |= sel << (i * 2);
+   }
+
+   return TRUE;
+}
+
+
+/* The constants the wide loop uses live in YMM2 + id for the whole loop.
+ */
+static struct x86_reg
+get_wide_const(unsigned id)
+{
+   assert(id < 6);
+   return x86_make_reg(file_YMM, 2 + id);
+}
+
+
+/* Load size bytes into the dwords of data starting at pos.  A load at
+ * pos 0 zeroes the rest of the register.
+ */
+static void
+emit_load_avx(struct translate_sse *p, struct x86_reg data,
+              struct x86_reg src, unsigned size, unsigned pos)
+{
+   unsigned offset = 0;
+
+   if (pos == 0 && size == 16) {
+      avx_vmovups(p->func, data, src);
+      return;
+   }
+
+   if (pos == 0 && size >= 8) {
+      avx_vmovq(p->func, data, src);
+      offset = 8;
+      pos = 2;
+   }
+
+   for (; offset < size; offset += 4, ++pos) {
+      struct x86_reg chunk = x86_make_disp(src, offset);
+
+      if (size - offset < 4) {
+         emit_load_gpr(p, p->tmp_EAX, chunk, size - offset);
+         chunk = p->tmp_EAX;
+      }
+
+      if (pos == 0)
+         avx_vmovd(p->func, data, chunk);
+      else
+         avx_vpinsrd(p->func, data, data, chunk, pos);
+   }
+}
+
+
+static void
+emit_store_avx(struct translate_sse *p, struct x86_reg dst,
+               struct x86_reg data, unsigned size)
+{
+   switch (size) {
+   case 4:
+      avx_vmovd(p->func, dst, data);
+      break;
+   case 8:
+      avx_vmovq(p->func, dst, data);
+      break;
+   case 12:
+      avx_vmovq(p->func, dst, data);
+      avx_vextractps(p->func, x86_make_disp(dst, 8), data, 2);
+      break;
+   case 16:
+      avx_vmovups(p->func, dst, data);
+      break;
+   default:
+      assert(0);
+   }
+}
+
+
+static void
+emit_memcpy_avx(struct translate_sse *p, struct x86_reg dst,
+                struct x86_reg src, unsigned size)
+{
+   struct x86_reg dataXMM = x86_make_reg(file_XMM, 0);
+   struct x86_reg dataXMM2 = x86_make_reg(file_XMM, 1);
+
+   switch (size) {
+   case 8:
+      avx_vmovq(p->func, dataXMM, src);
+      avx_vmovq(p->func, dst, dataXMM);
+      break;
+   case 12:
+      avx_vmovq(p->func, dataXMM, src);
+      x86_mov(p->func, p->tmp_EAX, x86_make_disp(src, 8));
+      avx_vmovq(p->func, dst, dataXMM);
+      x86_mov(p->func, x86_make_disp(dst, 8), p->tmp_EAX);
+      break;
+   case 16:
+      avx_vmovdqu(p->func, dataXMM, src);
+      avx_vmovdqu(p->func, dst, dataXMM);
+      break;
+   case 24:
+      avx_vmovdqu(p->func, dataXMM, src);
+      avx_vmovq(p->func, dataXMM2, x86_make_disp(src, 16));
+      avx_vmovdqu(p->func, dst, dataXMM);
+      avx_vmovq(p->func, x86_make_disp(dst, 16), dataXMM2);
+      break;
+   case 32:
+      avx_vmovdqu(p->func, x86_make_reg(file_YMM, 0), src);
+      avx_vmovdqu(p->func, dst, x86_make_reg(file_YMM, 0));
+      break;
+   default:
+      /* below 8 bytes emit_memcpy() only uses general purpose registers */
+      emit_memcpy(p, dst, src, size);
+      break;
+   }
+}
+
+
+/* Convert one attribute of two vertices: the first one goes in the low,
+ * the second one in the high half of YMM0.
+ */
+static void
+translate_attr_wide(struct translate_sse *p, const struct wide_attr *w,
+                    struct x86_reg src0, struct x86_reg src1,
+                    struct x86_reg dst0, struct x86_reg dst1)
+{
+   struct x86_reg dataXMM = x86_make_reg(file_XMM, 0);
+   struct x86_reg dataYMM = x86_make_reg(file_YMM, 0);
+   struct x86_reg tmpXMM = x86_make_reg(file_XMM, 1);
+
+   switch (w->kind) {
+   case WIDE_COPY:
+      emit_memcpy_avx(p, dst0, src0, w->size);
+      emit_memcpy_avx(p, dst1, src1, w->size);
+      return;
+
+   case WIDE_TO_UB4:
+      avx_vmovups(p->func, dataXMM, src0);
+      avx_vinsertf128(p->func, dataYMM, dataYMM, src1, 1);
+      if (w->shuffle)
+         avx_vshufps(p->func, dataYMM, dataYMM, dataYMM, w->shuf);
+      avx_vmulps(p->func, dataYMM, dataYMM, get_wide_const(w->scale));
+      avx_vcvtps2dq(p->func, dataYMM, dataYMM);
+      avx2_vpackssdw(p->func, dataYMM, dataYMM, dataYMM);
+      avx2_vpackuswb(p->func, dataYMM, dataYMM, dataYMM);
+      avx_vmovd(p->func, dst0, dataXMM);
+      avx_vextractf128(p->func, tmpXMM, dataYMM, 1);
+      avx_vmovd(p->func, dst1, tmpXMM);
+      return;
+
+   case WIDE_TO_FLOAT:
+      if (w->chan_size == 32) {
+         emit_load_avx(p, dataXMM, src0, w->size, 0);
+         if (w->size == 16) {
+            avx_vinsertf128(p->func, dataYMM, dataYMM, src1, 1);
+         }
+         else {
+            emit_load_avx(p, tmpXMM, src1, w->size, 0);
+            avx_vinsertf128(p->func, dataYMM, dataYMM, tmpXMM, 1);
+         }
+      }
+      else {
+         /* both vertices go in the low half, then get widened to dwords */
+         emit_load_avx(p, dataXMM, src0, w->size, 0);
+         emit_load_avx(p, dataXMM, src1, w->size, w->chan_size == 8 ? 1 : 2);
+
+         if (w->chan_size == 8) {
+            if (w->is_signed)
+               avx2_vpmovsxbd(p->func, dataYMM, dataXMM);
+            else
+               avx2_vpmovzxbd(p->func, dataYMM, dataXMM);
+         }
+         else {
+            if (w->is_signed)
+               avx2_vpmovsxwd(p->func, dataYMM, dataXMM);
+            else
+               avx2_vpmovzxwd(p->func, dataYMM, dataXMM);
+         }
+
+         avx_vcvtdq2ps(p->func, dataYMM, dataYMM);
+         if (w->scale >= 0)
+            avx_vmulps(p->func, dataYMM, dataYMM, get_wide_const(w->scale));
+      }
+
+      if (w->shuffle)
+         avx_vshufps(p->func, dataYMM, dataYMM, dataYMM, w->shuf);
+      if (w->one_w)
+         avx_vorps(p->func, dataYMM, dataYMM,
+                   get_wide_const(CONST_IDENTITY));
+
+      emit_store_avx(p, dst0, dataXMM, w->out_size);
+      avx_vextractf128(p->func, tmpXMM, dataYMM, 1);
+      emit_store_avx(p, dst1, tmpXMM, w->out_size);
+      return;
+   }
+}
+
+
 static boolean
 init_inputs(struct translate_sse *p, unsigned index_size)
 {
@@ -1228,8 +1605,10 @@ static boolean
 incr_inputs(struct translate_sse *p, unsigned index_size)
 {
    if (!index_size && p->nr_buffer_variants == 1) {
+      unsigned buffer_index = p->buffer_variant[0].buffer_index;
       struct x86_reg stride =
-         x86_make_disp(p->machine_EDI, get_offset(p, &p->buffer[0].stride));
+         x86_make_disp(p->machine_EDI,
+                       get_offset(p, &p->buffer[buffer_index].stride));
 
       if (p->buffer_variant[0].instance_divisor == 0) {
          x64_rexw(p->func);
@@ -1270,6 +1649,97 @@ incr_inputs(struct translate_sse *p, unsigned index_size)
 }
 
 
+/* Emit the two vertex AVX2 loop of the linear run function, which leaves
+ * at most one vertex for the normal loop.  Returns FALSE without emitting
+ * anything if some element has no wide form.
+ */
+static boolean
+build_wide_loop(struct translate_sse *p)
+{
+   const struct translate_buffer_variant *variant = &p->buffer_variant[0];
+   struct x86_reg stride =
+      x86_make_disp(p->machine_EDI,
+                    get_offset(p, &p->buffer[variant->buffer_index].stride));
+   struct x86_reg vertex0 = p->idx_ESI;
+   struct x86_reg vertex1 = p->src_ECX;
+   struct wide_attr wide[TRANSLATE_MAX_ATTRIBS];
+   unsigned used_consts = 0;
+   unsigned output_stride = p->translate.key.output_stride;
+   int fixup, label;
+   unsigned j;
+
+   if (!(x86_target_caps(p->func) & X86_AVX2) ||
+       p->nr_buffer_variants != 1 ||
+       variant->instance_divisor)
+      return FALSE;
+
+   for (j = 0; j < p->translate.key.nr_elements; j++) {
+      if (!get_wide_attr(&p->translate.key.element[j], &wide[j]))
+         return FALSE;
+      if (wide[j].scale >= 0)
+         used_consts |= 1 << wide[j].scale;
+      if (wide[j].one_w)
+         used_consts |= 1 << CONST_IDENTITY;
+   }
+
+   x86_cmp_imm(p->func, p->count_EBP, 2);
+   fixup = x86_jcc_forward(p->func, cc_NAE);
+
+   for (j = 0; j < NUM_CONSTS; j++) {
+      if (used_consts & (1 << j))
+         avx_vbroadcastf128(p->func, get_wide_const(j),
+                            x86_make_disp(p->machine_EDI,
+                                          get_offset(p, &p->consts[j][0])));
+   }
+
+   label = x86_get_label(p->func);
+
+   x64_rexw(p->func);
+   x86_mov(p->func, vertex1, vertex0);
+   x64_rexw(p->func);
+   x86_add(p->func, vertex1, stride);
+
+   for (j = 0; j < p->translate.key.nr_elements; j++) {
+      const struct translate_element *a = &p->translate.key.element[j];
+      struct x86_reg src0, src1;
+
+      if (p->element_to_buffer_variant[j] == ELEMENT_BUFFER_INSTANCE_ID) {
+         src0 = src1 = get_buffer_ptr(p, 0, ELEMENT_BUFFER_INSTANCE_ID,
+                                      vertex0);
+      }
+      else {
+         src0 = x86_make_disp(vertex0, a->input_offset);
+         src1 = x86_make_disp(vertex1, a->input_offset);
+      }
+
+      translate_attr_wide(p, &wide[j], src0, src1,
+                          x86_make_disp(p->outbuf_EBX, a->output_offset),
+                          x86_make_disp(p->outbuf_EBX,
+                                        output_stride + a->output_offset));
+   }
+
+   x64_rexw(p->func);
+   x86_lea(p->func, p->outbuf_EBX,
+           x86_make_disp(p->outbuf_EBX, 2 * output_stride));
+
+   x64_rexw(p->func);
+   x86_mov(p->func, vertex0, vertex1);
+   x64_rexw(p->func);
+   x86_add(p->func, vertex0, stride);
+   sse_prefetchnta(p->func, x86_make_disp(vertex0, 192));
+
+   x86_sub_imm(p->func, p->count_EBP, 2);
+   x86_cmp_imm(p->func, p->count_EBP, 2);
+   x86_jcc(p->func, cc_AE, label);
+
+   avx_vzeroupper(p->func);
+
+   x86_fixup_fwd_jump(p->func, fixup);
+
+   return TRUE;
+}
+
+
 /* Build run( struct translate *machine,
  *            unsigned start,
  *            unsigned count,
@@ -1290,7 +1760,8 @@ static boolean
 build_vertex_emit(struct translate_sse *p,
                   struct x86_function *func, unsigned index_size)
 {
-   int fixup, label;
+   int fixup, tail_fixup = 0, label;
+   boolean wide = FALSE;
    unsigned j;
 
    memset(p->reg_to_const, 0xff, sizeof(p->reg_to_const));
@@ -1368,6 +1839,14 @@ build_vertex_emit(struct translate_sse *p,
     */
    init_inputs(p, index_size);
 
+   if (!index_size)
+      wide = build_wide_loop(p);
+
+   if (wide) {
+      x86_test(p->func, p->count_EBP, p->count_EBP);
+      tail_fixup = x86_jcc_forward(p->func, cc_E);
+   }
+
    /* Note address for loop jump
     */
    label = x86_get_label(p->func);
@@ -1414,9 +1893,11 @@ build_vertex_emit(struct translate_sse *p,
    if (p->func->need_emms)
       mmx_emms(p->func);
 
-   /* Land forward jump here:
+   /* Land forward jumps here:
     */
    x86_fixup_fwd_jump(p->func, fixup);
+   if (wide)
+      x86_fixup_fwd_jump(p->func, tail_fixup);
 
    /* Pop regs and return
     */
@@ -1529,6 +2010,8 @@ translate_sse2_create(const struct translate_key *key)
       else {
          assert(key->element[i].type == TRANSLATE_ELEMENT_INSTANCE_ID);
 
+         /* the instance id is only loaded into the machine when instancing */
+         p->use_instancing = TRUE;
          p->element_to_buffer_variant[i] = ELEMENT_BUFFER_INSTANCE_ID;
       }
    }
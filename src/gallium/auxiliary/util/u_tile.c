@@ -39,6 +39,7 @@
 #include "util/u_memory.h"
 #include "util/u_surface.h"
 #include "util/u_tile.h"
+#include "util/u_tile_simd.h"
 
 
 /**
@@ -147,59 +148,6 @@ z32_get_tile_rgba(const unsigned *src,
 }
 
 
-/*** PIPE_FORMAT_Z24_UNORM_S8_UINT ***/
-
-/**
- * Return Z component as four float in [0,1].  Stencil part ignored.
- */
-static void
-s8z24_get_tile_rgba(const unsigned *src,
-                    unsigned w, unsigned h,
-                    float *p,
-                    unsigned dst_stride)
-{
-   const double scale = 1.0 / ((1 << 24) - 1);
-   unsigned i, j;
-
-   for (i = 0; i < h; i++) {
-      float *pRow = p;
-      for (j = 0; j < w; j++, pRow += 4) {
-         pRow[0] =
-         pRow[1] =
-         pRow[2] =
-         pRow[3] = (float) (scale * (*src++ & 0xffffff));
-      }
-      p += dst_stride;
-   }
-}
-
-
-/*** PIPE_FORMAT_S8_UINT_Z24_UNORM ***/
-
-/**
- * Return Z component as four float in [0,1].  Stencil part ignored.
- */
-static void
-z24s8_get_tile_rgba(const unsigned *src,
-                    unsigned w, unsigned h,
-                    float *p,
-                    unsigned dst_stride)
-{
-   const double scale = 1.0 / ((1 << 24) - 1);
-   unsigned i, j;
-
-   for (i = 0; i < h; i++) {
-      float *pRow = p;
-      for (j = 0; j < w; j++, pRow += 4) {
-         pRow[0] =
-         pRow[1] =
-         pRow[2] =
-         pRow[3] = (float) (scale * (*src++ >> 8));
-      }
-      p += dst_stride;
-   }
-}
-
 /*** PIPE_FORMAT_S8X24_UINT ***/
 
 /**
@@ -276,31 +224,6 @@ s8_get_tile_rgba(const unsigned char *src,
    }
 }
 
-/*** PIPE_FORMAT_Z32_FLOAT ***/
-
-/**
- * Return each Z value as four floats in [0,1].
- */
-static void
-z32f_get_tile_rgba(const float *src,
-                   unsigned w, unsigned h,
-                   float *p,
-                   unsigned dst_stride)
-{
-   unsigned i, j;
-
-   for (i = 0; i < h; i++) {
-      float *pRow = p;
-      for (j = 0; j < w; j++, pRow += 4) {
-         pRow[0] =
-         pRow[1] =
-         pRow[2] =
-         pRow[3] = *src++;
-      }
-      p += dst_stride;
-   }
-}
-
 /*** PIPE_FORMAT_Z32_FLOAT_S8X24_UINT ***/
 
 /**
@@ -359,6 +282,21 @@ pipe_tile_raw_to_rgba(enum pipe_format format,
                       uint w, uint h,
                       float *dst, unsigned dst_stride)
 {
+   util_tile_unpack_func unpack = util_tile_simd_unpack_func(format);
+
+   if (unpack) {
+      const ubyte *src_row = (const ubyte *) src;
+      unsigned src_stride = util_format_get_stride(format, w);
+      unsigned i;
+
+      for (i = 0; i < h; i++) {
+         unpack(dst, src_row, w);
+         src_row += src_stride;
+         dst += dst_stride;
+      }
+      return;
+   }
+
    switch (format) {
    case PIPE_FORMAT_Z16_UNORM:
       z16_get_tile_rgba((ushort *) src, w, h, dst, dst_stride);
@@ -366,26 +304,15 @@ pipe_tile_raw_to_rgba(enum pipe_format format,
    case PIPE_FORMAT_Z32_UNORM:
       z32_get_tile_rgba((unsigned *) src, w, h, dst, dst_stride);
       break;
-   case PIPE_FORMAT_Z24_UNORM_S8_UINT:
-   case PIPE_FORMAT_Z24X8_UNORM:
-      s8z24_get_tile_rgba((unsigned *) src, w, h, dst, dst_stride);
-      break;
    case PIPE_FORMAT_S8_UINT:
       s8_get_tile_rgba((unsigned char *) src, w, h, dst, dst_stride);
       break;
    case PIPE_FORMAT_X24S8_UINT:
       s8x24_get_tile_rgba((unsigned *) src, w, h, dst, dst_stride);
       break;
-   case PIPE_FORMAT_S8_UINT_Z24_UNORM:
-   case PIPE_FORMAT_X8Z24_UNORM:
-      z24s8_get_tile_rgba((unsigned *) src, w, h, dst, dst_stride);
-      break;
    case PIPE_FORMAT_S8X24_UINT:
       x24s8_get_tile_rgba((unsigned *) src, w, h, dst, dst_stride);
       break;
-   case PIPE_FORMAT_Z32_FLOAT:
-      z32f_get_tile_rgba((float *) src, w, h, dst, dst_stride);
-      break;
    case PIPE_FORMAT_Z32_FLOAT_S8X24_UINT:
       z32f_x24s8_get_tile_rgba((float *) src, w, h, dst, dst_stride);
       break;
@@ -442,12 +369,30 @@ pipe_get_tile_rgba_format(struct pipe_transfer *pt,
                           float *p)
 {
    unsigned dst_stride = w * 4;
+   util_tile_unpack_func unpack;
    void *packed;
 
    if (u_clip_tile(x, y, &w, &h, &pt->box)) {
       return;
    }
 
+   /* Convert straight from the mapping when there is a row kernel for the
+    * format, instead of copying the rect out first.
+    */
+   unpack = util_tile_simd_unpack_func(format);
+   if (unpack) {
+      const ubyte *src_row = (const ubyte *) src + y * pt->stride +
+                             x * util_format_get_blocksize(format);
+      unsigned i;
+
+      for (i = 0; i < h; i++) {
+         unpack(p, src_row, w);
+         src_row += pt->stride;
+         p += dst_stride;
+      }
+      return;
+   }
+
    packed = MALLOC(util_format_get_nblocks(format, w, h) * util_format_get_blocksize(format));
    if (!packed) {
       return;
@@ -483,11 +428,26 @@ pipe_put_tile_rgba_format(struct pipe_transfer *pt,
                           const float *p)
 {
    unsigned src_stride = w * 4;
+   util_tile_pack_func pack;
    void *packed;
 
    if (u_clip_tile(x, y, &w, &h, &pt->box))
       return;
 
+   pack = util_tile_simd_pack_func(format);
+   if (pack) {
+      ubyte *dst_row = (ubyte *) dst + y * pt->stride +
+                       x * util_format_get_blocksize(format);
+      unsigned i;
+
+      for (i = 0; i < h; i++) {
+         pack(dst_row, p, w);
+         dst_row += pt->stride;
+         p += src_stride;
+      }
+      return;
+   }
+
    packed = MALLOC(util_format_get_nblocks(format, w, h) * util_format_get_blocksize(format));
 
    if (!packed)
@@ -0,0 +1,797 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Plain C and SSE2 versions of the tile row conversion kernels, and the
+ * runtime selection between those and the SSSE3/AVX2 ones.
+ *
+ * The C kernels do exactly what the generated util_format code does; the
+ * vector ones reproduce the same float operations in the same order so the
+ * results are identical.  The Z24 conversions are done in double precision
+ * like the scalar loops in u_tile.c.
+ */
+
+#include "pipe/p_config.h"
+#include "os/os_thread.h"
+#include "rtasm/rtasm_cpu.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_half.h"
+#include "util/u_math.h"
+#include "util/u_sse.h"
+#include "util/u_tile_simd.h"
+
+
+static INLINE boolean
+is_bgr(enum util_tile_simd_format format)
+{
+   return format == UTIL_TILE_SIMD_B8G8R8A8_UNORM ||
+          format == UTIL_TILE_SIMD_B8G8R8X8_UNORM;
+}
+
+static INLINE boolean
+has_alpha(enum util_tile_simd_format format)
+{
+   return format == UTIL_TILE_SIMD_R8G8B8A8_UNORM ||
+          format == UTIL_TILE_SIMD_B8G8R8A8_UNORM;
+}
+
+
+static INLINE void
+unpack_8888_c(float *dst, const void *src, unsigned n,
+              enum util_tile_simd_format format)
+{
+   const unsigned rshift = is_bgr(format) ? 16 : 0;
+   const unsigned bshift = is_bgr(format) ? 0 : 16;
+   const uint32_t *s = (const uint32_t *) src;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      uint32_t value = s[i];
+
+      dst[0] = ubyte_to_float((value >> rshift) & 0xff);
+      dst[1] = ubyte_to_float((value >> 8) & 0xff);
+      dst[2] = ubyte_to_float((value >> bshift) & 0xff);
+      dst[3] = has_alpha(format) ? ubyte_to_float(value >> 24) : 1.0f;
+      dst += 4;
+   }
+}
+
+static INLINE void
+pack_8888_c(void *dst, const float *src, unsigned n,
+            enum util_tile_simd_format format)
+{
+   const unsigned rshift = is_bgr(format) ? 16 : 0;
+   const unsigned bshift = is_bgr(format) ? 0 : 16;
+   uint32_t *d = (uint32_t *) dst;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      uint32_t value = 0;
+
+      value |= (uint32_t) float_to_ubyte(src[0]) << rshift;
+      value |= (uint32_t) float_to_ubyte(src[1]) << 8;
+      value |= (uint32_t) float_to_ubyte(src[2]) << bshift;
+      if (has_alpha(format))
+         value |= (uint32_t) float_to_ubyte(src[3]) << 24;
+      d[i] = value;
+      src += 4;
+   }
+}
+
+#define C_8888(name, format)                                                \
+static void                                                                 \
+unpack_##name##_c(float *dst, const void *src, unsigned n)                  \
+{                                                                           \
+   unpack_8888_c(dst, src, n, format);                                      \
+}                                                                           \
+                                                                            \
+static void                                                                 \
+pack_##name##_c(void *dst, const float *src, unsigned n)                    \
+{                                                                           \
+   pack_8888_c(dst, src, n, format);                                        \
+}
+
+C_8888(rgba8, UTIL_TILE_SIMD_R8G8B8A8_UNORM)
+C_8888(bgra8, UTIL_TILE_SIMD_B8G8R8A8_UNORM)
+C_8888(rgbx8, UTIL_TILE_SIMD_R8G8B8X8_UNORM)
+C_8888(bgrx8, UTIL_TILE_SIMD_B8G8R8X8_UNORM)
+
+
+static void
+unpack_565_c(float *dst, const void *src, unsigned n)
+{
+   const uint16_t *s = (const uint16_t *) src;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      uint16_t value = s[i];
+
+      dst[0] = (float) ((value >> 11) * (1.0f / 0x1f));
+      dst[1] = (float) (((value >> 5) & 0x3f) * (1.0f / 0x3f));
+      dst[2] = (float) ((value & 0x1f) * (1.0f / 0x1f));
+      dst[3] = 1.0f;
+      dst += 4;
+   }
+}
+
+static void
+pack_565_c(void *dst, const float *src, unsigned n)
+{
+   uint16_t *d = (uint16_t *) dst;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      uint16_t value = 0;
+
+      value |= ((uint16_t) util_iround(CLAMP(src[2], 0, 1) * 0x1f)) & 0x1f;
+      value |= (((uint16_t) util_iround(CLAMP(src[1], 0, 1) * 0x3f)) & 0x3f) << 5;
+      value |= ((uint16_t) util_iround(CLAMP(src[0], 0, 1) * 0x1f)) << 11;
+      d[i] = value;
+      src += 4;
+   }
+}
+
+
+static void
+unpack_rgba16f_c(float *dst, const void *src, unsigned n)
+{
+   const uint16_t *s = (const uint16_t *) src;
+   unsigned i;
+
+   for (i = 0; i < n * 4; i++) {
+      dst[i] = util_half_to_float(s[i]);
+   }
+}
+
+static void
+pack_rgba16f_c(void *dst, const float *src, unsigned n)
+{
+   uint16_t *d = (uint16_t *) dst;
+   unsigned i;
+
+   for (i = 0; i < n * 4; i++) {
+      d[i] = util_float_to_half(src[i]);
+   }
+}
+
+
+static void
+unpack_z24s8_c(float *dst, const void *src, unsigned n)
+{
+   const double scale = 1.0 / ((1 << 24) - 1);
+   const uint32_t *s = (const uint32_t *) src;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      dst[0] =
+      dst[1] =
+      dst[2] =
+      dst[3] = (float) (scale * (s[i] & 0xffffff));
+      dst += 4;
+   }
+}
+
+static void
+unpack_s8z24_c(float *dst, const void *src, unsigned n)
+{
+   const double scale = 1.0 / ((1 << 24) - 1);
+   const uint32_t *s = (const uint32_t *) src;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      dst[0] =
+      dst[1] =
+      dst[2] =
+      dst[3] = (float) (scale * (s[i] >> 8));
+      dst += 4;
+   }
+}
+
+static void
+unpack_z32f_c(float *dst, const void *src, unsigned n)
+{
+   const float *s = (const float *) src;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      dst[0] =
+      dst[1] =
+      dst[2] =
+      dst[3] = s[i];
+      dst += 4;
+   }
+}
+
+
+const struct util_tile_simd_funcs util_tile_simd_funcs_c = {
+   "c",
+   {
+      unpack_rgba8_c,
+      unpack_bgra8_c,
+      unpack_rgbx8_c,
+      unpack_bgrx8_c,
+      unpack_565_c,
+      unpack_rgba16f_c,
+      unpack_z24s8_c,
+      unpack_s8z24_c,
+      unpack_z32f_c
+   },
+   {
+      pack_rgba8_c,
+      pack_bgra8_c,
+      pack_rgbx8_c,
+      pack_bgrx8_c,
+      pack_565_c,
+      pack_rgba16f_c,
+      NULL,
+      NULL,
+      NULL
+   }
+};
+
+
+#if defined(PIPE_ARCH_SSE)
+
+
+/**
+ * float_to_ubyte() on four lanes.
+ */
+static INLINE __m128i
+sse2_float_to_ubyte(__m128 f)
+{
+   const __m128i bits = _mm_castps_si128(f);
+   const __m128i neg = _mm_cmplt_epi32(bits, _mm_setzero_si128());
+   const __m128i one = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x3f7fffff));
+   __m128i ub;
+
+   f = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f / 256.0f)),
+                  _mm_set1_ps(32768.0f));
+   ub = _mm_or_si128(_mm_castps_si128(f), one);
+   ub = _mm_and_si128(ub, _mm_set1_epi32(0xff));
+   return _mm_andnot_si128(neg, ub);
+}
+
+
+/**
+ * util_iround() of values already clamped to [0, max], which is a plain
+ * truncation of x + 0.5 except where it is done with the x87 fistp.
+ */
+static INLINE __m128i
+sse2_iround_unorm(__m128 x)
+{
+#if defined(PIPE_ARCH_X86) && (defined(PIPE_CC_GCC) || defined(PIPE_CC_MSVC))
+   return _mm_cvtps_epi32(x);
+#else
+   return _mm_cvttps_epi32(_mm_add_ps(x, _mm_set1_ps(0.5f)));
+#endif
+}
+
+
+/**
+ * Pack the low 16 bits of each 32-bit lane, without the signed saturation
+ * of _mm_packs_epi32.
+ */
+static INLINE __m128i
+sse2_packus_epi32(__m128i a, __m128i b)
+{
+   a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+   b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+   return _mm_packs_epi32(a, b);
+}
+
+
+/**
+ * util_half_to_float() of the halves in the low 16 bits of each lane.
+ */
+static INLINE __m128
+sse2_half_to_float(__m128i h)
+{
+   const __m128i magic = _mm_set1_epi32(0xef << 23);
+   __m128i bits = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+   __m128 f = _mm_mul_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(magic));
+   __m128 infnan = _mm_cmpge_ps(f, _mm_set1_ps(65536.0f));
+
+   bits = _mm_castps_si128(f);
+   bits = _mm_or_si128(bits, _mm_and_si128(_mm_castps_si128(infnan),
+                                           _mm_set1_epi32(0xff << 23)));
+   bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+   return _mm_castsi128_ps(bits);
+}
+
+
+static INLINE __m128i
+sse2_select(__m128i mask, __m128i a, __m128i b)
+{
+   return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+
+/**
+ * util_float_to_half() on four lanes, returning the halves in the low 16
+ * bits of each lane.
+ */
+static INLINE __m128i
+sse2_float_to_half(__m128 f)
+{
+   const __m128i f32inf = _mm_set1_epi32(0xff << 23);
+   const __m128i f16inf = _mm_set1_epi32(0x1f << 23);
+   const __m128i magic = _mm_set1_epi32(0xf << 23);
+   __m128i bits = _mm_castps_si128(f);
+   __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(0x80000000));
+   __m128i inf, nan, over, h;
+
+   bits = _mm_xor_si128(bits, sign);
+   inf = _mm_cmpeq_epi32(bits, f32inf);
+   nan = _mm_cmpgt_epi32(bits, f32inf);
+
+   h = _mm_and_si128(bits, _mm_set1_epi32(~0xfff));
+   h = _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(h),
+                                   _mm_castsi128_ps(magic)));
+   h = _mm_add_epi32(h, _mm_set1_epi32(0x1000));
+   over = _mm_cmpgt_epi32(h, f16inf);
+   h = sse2_select(over, _mm_sub_epi32(f16inf, _mm_set1_epi32(1)), h);
+   h = _mm_srli_epi32(h, 13);
+
+   h = sse2_select(inf, _mm_set1_epi32(0x7c00), h);
+   h = sse2_select(nan, _mm_set1_epi32(0x7e00), h);
+   return _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+}
+
+
+/**
+ * Store four Z values as four pixels of ZZZZ.
+ */
+static INLINE void
+sse2_store_z4(float *dst, __m128 z)
+{
+   _mm_storeu_ps(dst +  0, _mm_shuffle_ps(z, z, _MM_SHUFFLE(0, 0, 0, 0)));
+   _mm_storeu_ps(dst +  4, _mm_shuffle_ps(z, z, _MM_SHUFFLE(1, 1, 1, 1)));
+   _mm_storeu_ps(dst +  8, _mm_shuffle_ps(z, z, _MM_SHUFFLE(2, 2, 2, 2)));
+   _mm_storeu_ps(dst + 12, _mm_shuffle_ps(z, z, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+
+/**
+ * Convert one pixel of 32-bit channels to float RGBA.
+ */
+static INLINE __m128
+sse2_ubyte_to_float(__m128i c, enum util_tile_simd_format format)
+{
+   __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(1.0f / 255.0f));
+
+   if (!has_alpha(format)) {
+      f = _mm_and_ps(f, _mm_castsi128_ps(_mm_setr_epi32(~0, ~0, ~0, 0)));
+      f = _mm_or_ps(f, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+   }
+   return f;
+}
+
+static INLINE void
+unpack_8888_sse2(float *dst, const void *src, unsigned n,
+                 enum util_tile_simd_format format)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const ubyte *s = (const ubyte *) src;
+   unsigned i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128i p = _mm_loadu_si128((const __m128i *) s);
+      __m128i lo = _mm_unpacklo_epi8(p, zero);
+      __m128i hi = _mm_unpackhi_epi8(p, zero);
+
+      if (is_bgr(format)) {
+         lo = _mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 0, 1, 2));
+         lo = _mm_shufflehi_epi16(lo, _MM_SHUFFLE(3, 0, 1, 2));
+         hi = _mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 0, 1, 2));
+         hi = _mm_shufflehi_epi16(hi, _MM_SHUFFLE(3, 0, 1, 2));
+      }
+
+      _mm_storeu_ps(dst +  0, sse2_ubyte_to_float(_mm_unpacklo_epi16(lo, zero), format));
+      _mm_storeu_ps(dst +  4, sse2_ubyte_to_float(_mm_unpackhi_epi16(lo, zero), format));
+      _mm_storeu_ps(dst +  8, sse2_ubyte_to_float(_mm_unpacklo_epi16(hi, zero), format));
+      _mm_storeu_ps(dst + 12, sse2_ubyte_to_float(_mm_unpackhi_epi16(hi, zero), format));
+      dst += 16;
+      s += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.unpack[format](dst, s, n - i);
+}
+
+static INLINE void
+pack_8888_sse2(void *dst, const float *src, unsigned n,
+               enum util_tile_simd_format format)
+{
+   ubyte *d = (ubyte *) dst;
+   unsigned i, j;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128i c[4], p;
+
+      for (j = 0; j < 4; j++) {
+         c[j] = sse2_float_to_ubyte(_mm_loadu_ps(src));
+         if (is_bgr(format))
+            c[j] = _mm_shuffle_epi32(c[j], _MM_SHUFFLE(3, 0, 1, 2));
+         src += 4;
+      }
+
+      p = _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]),
+                           _mm_packs_epi32(c[2], c[3]));
+      if (!has_alpha(format))
+         p = _mm_and_si128(p, _mm_set1_epi32(0x00ffffff));
+      _mm_storeu_si128((__m128i *) d, p);
+      d += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.pack[format](d, src, n - i);
+}
+
+#define SSE2_8888(name, format)                                             \
+static void                                                                 \
+unpack_##name##_sse2(float *dst, const void *src, unsigned n)               \
+{                                                                           \
+   unpack_8888_sse2(dst, src, n, format);                                   \
+}                                                                           \
+                                                                            \
+static void                                                                 \
+pack_##name##_sse2(void *dst, const float *src, unsigned n)                 \
+{                                                                           \
+   pack_8888_sse2(dst, src, n, format);                                     \
+}
+
+SSE2_8888(rgba8, UTIL_TILE_SIMD_R8G8B8A8_UNORM)
+SSE2_8888(bgra8, UTIL_TILE_SIMD_B8G8R8A8_UNORM)
+SSE2_8888(rgbx8, UTIL_TILE_SIMD_R8G8B8X8_UNORM)
+SSE2_8888(bgrx8, UTIL_TILE_SIMD_B8G8R8X8_UNORM)
+
+
+static void
+unpack_565_sse2(float *dst, const void *src, unsigned n)
+{
+   const ubyte *s = (const ubyte *) src;
+   unsigned i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128i v = _mm_loadl_epi64((const __m128i *) s);
+      __m128 r, g, b, a;
+
+      v = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+      r = _mm_cvtepi32_ps(_mm_srli_epi32(v, 11));
+      g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 5),
+                                        _mm_set1_epi32(0x3f)));
+      b = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0x1f)));
+      r = _mm_mul_ps(r, _mm_set1_ps(1.0f / 0x1f));
+      g = _mm_mul_ps(g, _mm_set1_ps(1.0f / 0x3f));
+      b = _mm_mul_ps(b, _mm_set1_ps(1.0f / 0x1f));
+      a = _mm_set1_ps(1.0f);
+
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+      _mm_storeu_ps(dst +  0, r);
+      _mm_storeu_ps(dst +  4, g);
+      _mm_storeu_ps(dst +  8, b);
+      _mm_storeu_ps(dst + 12, a);
+      dst += 16;
+      s += 8;
+   }
+
+   if (i < n)
+      unpack_565_c(dst, s, n - i);
+}
+
+static void
+pack_565_sse2(void *dst, const float *src, unsigned n)
+{
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+   ubyte *d = (ubyte *) dst;
+   unsigned i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128 r = _mm_loadu_ps(src +  0);
+      __m128 g = _mm_loadu_ps(src +  4);
+      __m128 b = _mm_loadu_ps(src +  8);
+      __m128 a = _mm_loadu_ps(src + 12);
+      __m128i v;
+
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+
+      /* max/min return the second operand for NaNs, so they clamp NaN to
+       * zero like the C code ends up doing.
+       */
+      r = _mm_min_ps(_mm_max_ps(r, zero), one);
+      g = _mm_min_ps(_mm_max_ps(g, zero), one);
+      b = _mm_min_ps(_mm_max_ps(b, zero), one);
+
+      v = sse2_iround_unorm(_mm_mul_ps(b, _mm_set1_ps(0x1f)));
+      v = _mm_or_si128(v, _mm_slli_epi32(sse2_iround_unorm(_mm_mul_ps(g, _mm_set1_ps(0x3f))), 5));
+      v = _mm_or_si128(v, _mm_slli_epi32(sse2_iround_unorm(_mm_mul_ps(r, _mm_set1_ps(0x1f))), 11));
+
+      _mm_storel_epi64((__m128i *) d, sse2_packus_epi32(v, v));
+      src += 16;
+      d += 8;
+   }
+
+   if (i < n)
+      pack_565_c(d, src, n - i);
+}
+
+
+static void
+unpack_rgba16f_sse2(float *dst, const void *src, unsigned n)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const ubyte *s = (const ubyte *) src;
+   unsigned i;
+
+   for (i = 0; i + 2 <= n; i += 2) {
+      __m128i h = _mm_loadu_si128((const __m128i *) s);
+
+      _mm_storeu_ps(dst + 0, sse2_half_to_float(_mm_unpacklo_epi16(h, zero)));
+      _mm_storeu_ps(dst + 4, sse2_half_to_float(_mm_unpackhi_epi16(h, zero)));
+      dst += 8;
+      s += 16;
+   }
+
+   if (i < n)
+      unpack_rgba16f_c(dst, s, n - i);
+}
+
+static void
+pack_rgba16f_sse2(void *dst, const float *src, unsigned n)
+{
+   ubyte *d = (ubyte *) dst;
+   unsigned i;
+
+   for (i = 0; i + 2 <= n; i += 2) {
+      __m128i h0 = sse2_float_to_half(_mm_loadu_ps(src + 0));
+      __m128i h1 = sse2_float_to_half(_mm_loadu_ps(src + 4));
+
+      _mm_storeu_si128((__m128i *) d, sse2_packus_epi32(h0, h1));
+      src += 8;
+      d += 16;
+   }
+
+   if (i < n)
+      pack_rgba16f_c(d, src, n - i);
+}
+
+
+static INLINE void
+unpack_z24_sse2(float *dst, const void *src, unsigned n, boolean low)
+{
+   const __m128d scale = _mm_set1_pd(1.0 / ((1 << 24) - 1));
+   const ubyte *s = (const ubyte *) src;
+   unsigned i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *) s);
+      __m128 lo, hi;
+
+      if (low)
+         v = _mm_and_si128(v, _mm_set1_epi32(0xffffff));
+      else
+         v = _mm_srli_epi32(v, 8);
+
+      lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(v), scale));
+      hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)),
+                                   scale));
+      sse2_store_z4(dst, _mm_movelh_ps(lo, hi));
+      dst += 16;
+      s += 16;
+   }
+
+   if (i < n) {
+      if (low)
+         unpack_z24s8_c(dst, s, n - i);
+      else
+         unpack_s8z24_c(dst, s, n - i);
+   }
+}
+
+static void
+unpack_z24s8_sse2(float *dst, const void *src, unsigned n)
+{
+   unpack_z24_sse2(dst, src, n, TRUE);
+}
+
+static void
+unpack_s8z24_sse2(float *dst, const void *src, unsigned n)
+{
+   unpack_z24_sse2(dst, src, n, FALSE);
+}
+
+static void
+unpack_z32f_sse2(float *dst, const void *src, unsigned n)
+{
+   const float *s = (const float *) src;
+   unsigned i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      sse2_store_z4(dst, _mm_loadu_ps(s));
+      dst += 16;
+      s += 4;
+   }
+
+   if (i < n)
+      unpack_z32f_c(dst, s, n - i);
+}
+
+
+static const struct util_tile_simd_funcs tile_simd_funcs_sse2 = {
+   "sse2",
+   {
+      unpack_rgba8_sse2,
+      unpack_bgra8_sse2,
+      unpack_rgbx8_sse2,
+      unpack_bgrx8_sse2,
+      unpack_565_sse2,
+      unpack_rgba16f_sse2,
+      unpack_z24s8_sse2,
+      unpack_s8z24_sse2,
+      unpack_z32f_sse2
+   },
+   {
+      pack_rgba8_sse2,
+      pack_bgra8_sse2,
+      pack_rgbx8_sse2,
+      pack_bgrx8_sse2,
+      pack_565_sse2,
+      pack_rgba16f_sse2,
+      NULL,
+      NULL,
+      NULL
+   }
+};
+
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_sse2(void)
+{
+   return &tile_simd_funcs_sse2;
+}
+
+
+#else /* !PIPE_ARCH_SSE */
+
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_sse2(void)
+{
+   return NULL;
+}
+
+
+#endif /* !PIPE_ARCH_SSE */
+
+
+pipe_static_mutex(funcs_mutex);
+
+
+/**
+ * Combine the kernels of the widest instruction sets the CPU supports.
+ * GALLIUM_NOSSE=1 forces the plain C ones.
+ */
+const struct util_tile_simd_funcs *
+util_tile_choose_simd_funcs(void)
+{
+   static struct util_tile_simd_funcs table;
+   static const struct util_tile_simd_funcs *funcs = NULL;
+
+   if (funcs)
+      return funcs;
+
+   /* The table is only written once, under the mutex, and published with
+    * a single pointer store when complete.
+    */
+   pipe_mutex_lock(funcs_mutex);
+
+   if (!funcs) {
+      const struct util_tile_simd_funcs *isa[3];
+      unsigned num_isa = 0;
+      unsigned i, j;
+
+      table = util_tile_simd_funcs_c;
+
+      if (rtasm_cpu_has_sse2()) {
+         isa[num_isa++] = util_tile_simd_funcs_sse2();
+         if (util_cpu_caps.has_ssse3)
+            isa[num_isa++] = util_tile_simd_funcs_ssse3();
+         if (util_cpu_caps.has_avx2)
+            isa[num_isa++] = util_tile_simd_funcs_avx2();
+      }
+
+      for (i = 0; i < num_isa; i++) {
+         if (!isa[i])
+            continue;
+
+         for (j = 0; j < UTIL_TILE_SIMD_NUM_FORMATS; j++) {
+            if (isa[i]->unpack[j])
+               table.unpack[j] = isa[i]->unpack[j];
+            if (isa[i]->pack[j])
+               table.pack[j] = isa[i]->pack[j];
+         }
+         table.name = isa[i]->name;
+      }
+
+      PIPE_READ_WRITE_BARRIER();
+      funcs = &table;
+   }
+
+   pipe_mutex_unlock(funcs_mutex);
+
+   return funcs;
+}
+
+
+int
+util_tile_simd_format(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      return UTIL_TILE_SIMD_R8G8B8A8_UNORM;
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+      return UTIL_TILE_SIMD_B8G8R8A8_UNORM;
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+      return UTIL_TILE_SIMD_R8G8B8X8_UNORM;
+   case PIPE_FORMAT_B8G8R8X8_UNORM:
+      return UTIL_TILE_SIMD_B8G8R8X8_UNORM;
+   case PIPE_FORMAT_B5G6R5_UNORM:
+      return UTIL_TILE_SIMD_B5G6R5_UNORM;
+   case PIPE_FORMAT_R16G16B16A16_FLOAT:
+      return UTIL_TILE_SIMD_R16G16B16A16_FLOAT;
+   case PIPE_FORMAT_Z24_UNORM_S8_UINT:
+   case PIPE_FORMAT_Z24X8_UNORM:
+      return UTIL_TILE_SIMD_Z24_UNORM_S8_UINT;
+   case PIPE_FORMAT_S8_UINT_Z24_UNORM:
+   case PIPE_FORMAT_X8Z24_UNORM:
+      return UTIL_TILE_SIMD_S8_UINT_Z24_UNORM;
+   case PIPE_FORMAT_Z32_FLOAT:
+      return UTIL_TILE_SIMD_Z32_FLOAT;
+   default:
+      return -1;
+   }
+}
+
+
+util_tile_unpack_func
+util_tile_simd_unpack_func(enum pipe_format format)
+{
+   int f = util_tile_simd_format(format);
+
+   return f < 0 ? NULL : util_tile_choose_simd_funcs()->unpack[f];
+}
+
+
+util_tile_pack_func
+util_tile_simd_pack_func(enum pipe_format format)
+{
+   int f = util_tile_simd_format(format);
+
+   return f < 0 ? NULL : util_tile_choose_simd_funcs()->pack[f];
+}
@@ -0,0 +1,127 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Row conversion kernels between the common color/depth formats and
+ * float RGBA, used by the u_tile get/put functions.
+ *
+ * Each kernel converts a run of n pixels.  There are plain C, SSE2, SSSE3
+ * and AVX2 versions; they give bit for bit the same results as the
+ * util_format pack/unpack functions (and, for depth, as the scalar loops
+ * that used to be in u_tile.c), including for NaNs and denormals.
+ */
+
+#ifndef U_TILE_SIMD_H
+#define U_TILE_SIMD_H
+
+#include "pipe/p_compiler.h"
+#include "pipe/p_format.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+
+enum util_tile_simd_format
+{
+   UTIL_TILE_SIMD_R8G8B8A8_UNORM,
+   UTIL_TILE_SIMD_B8G8R8A8_UNORM,
+   UTIL_TILE_SIMD_R8G8B8X8_UNORM,
+   UTIL_TILE_SIMD_B8G8R8X8_UNORM,
+   UTIL_TILE_SIMD_B5G6R5_UNORM,
+   UTIL_TILE_SIMD_R16G16B16A16_FLOAT,
+   UTIL_TILE_SIMD_Z24_UNORM_S8_UINT,   /**< also Z24X8_UNORM */
+   UTIL_TILE_SIMD_S8_UINT_Z24_UNORM,   /**< also X8Z24_UNORM */
+   UTIL_TILE_SIMD_Z32_FLOAT,
+   UTIL_TILE_SIMD_NUM_FORMATS
+};
+
+
+/**
+ * Convert n packed pixels to float RGBA.  Depth formats return Z in all
+ * four channels and ignore stencil.  Neither pointer needs any alignment.
+ */
+typedef void (*util_tile_unpack_func)(float *dst, const void *src,
+                                      unsigned n);
+
+/**
+ * Convert n float RGBA pixels to the packed format.  Unused bits (X8) are
+ * written as zero.
+ */
+typedef void (*util_tile_pack_func)(void *dst, const float *src,
+                                    unsigned n);
+
+
+/**
+ * The kernels built for one instruction set.  Entries an instruction set
+ * doesn't improve on are NULL; util_tile_choose_simd_funcs() fills those
+ * from the narrower sets.  There are no pack kernels for depth formats.
+ */
+struct util_tile_simd_funcs
+{
+   const char *name;
+   util_tile_unpack_func unpack[UTIL_TILE_SIMD_NUM_FORMATS];
+   util_tile_pack_func pack[UTIL_TILE_SIMD_NUM_FORMATS];
+};
+
+
+extern const struct util_tile_simd_funcs util_tile_simd_funcs_c;
+
+/* Per instruction set tables, or NULL when not compiled in.  Check
+ * util_cpu_caps before calling through them.
+ */
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_sse2(void);
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_ssse3(void);
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_avx2(void);
+
+const struct util_tile_simd_funcs *
+util_tile_choose_simd_funcs(void);
+
+
+/**
+ * Return the kernel format for a pipe format, or -1 if there is none.
+ */
+int
+util_tile_simd_format(enum pipe_format format);
+
+util_tile_unpack_func
+util_tile_simd_unpack_func(enum pipe_format format);
+
+util_tile_pack_func
+util_tile_simd_pack_func(enum pipe_format format);
+
+
+#if defined __cplusplus
+}
+#endif
+
+#endif /* U_TILE_SIMD_H */
@@ -0,0 +1,464 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * AVX2 versions of the tile row conversion kernels.
+ *
+ * A 256-bit register holds two float RGBA pixels, so most kernels work on
+ * pairs of pixels, and 565 and depth are transposed eight at a time.  The
+ * in-lane pack instructions leave the pixels interleaved between the two
+ * halves, hence the cross-lane permutes before storing.
+ *
+ * This file is compiled with -mavx2 and the functions are only installed
+ * when util_cpu_caps reports AVX2 support.
+ */
+
+#include "pipe/p_config.h"
+#include "util/u_tile_simd.h"
+
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+
+static INLINE __m256i
+avx2_float_to_ubyte(__m256 f)
+{
+   const __m256i bits = _mm256_castps_si256(f);
+   const __m256i neg = _mm256_cmpgt_epi32(_mm256_setzero_si256(), bits);
+   const __m256i one = _mm256_cmpgt_epi32(bits, _mm256_set1_epi32(0x3f7fffff));
+   __m256i ub;
+
+   f = _mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(255.0f / 256.0f)),
+                     _mm256_set1_ps(32768.0f));
+   ub = _mm256_or_si256(_mm256_castps_si256(f), one);
+   ub = _mm256_and_si256(ub, _mm256_set1_epi32(0xff));
+   return _mm256_andnot_si256(neg, ub);
+}
+
+
+/* See sse2_iround_unorm() in u_tile_simd.c. */
+static INLINE __m256i
+avx2_iround_unorm(__m256 x)
+{
+#if defined(PIPE_ARCH_X86) && (defined(PIPE_CC_GCC) || defined(PIPE_CC_MSVC))
+   return _mm256_cvtps_epi32(x);
+#else
+   return _mm256_cvttps_epi32(_mm256_add_ps(x, _mm256_set1_ps(0.5f)));
+#endif
+}
+
+
+static INLINE __m256
+avx2_half_to_float(__m256i h)
+{
+   const __m256i magic = _mm256_set1_epi32(0xef << 23);
+   __m256i bits = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x7fff)), 13);
+   __m256 f = _mm256_mul_ps(_mm256_castsi256_ps(bits),
+                            _mm256_castsi256_ps(magic));
+   __m256 infnan = _mm256_cmp_ps(f, _mm256_set1_ps(65536.0f), _CMP_GE_OQ);
+
+   bits = _mm256_castps_si256(f);
+   bits = _mm256_or_si256(bits, _mm256_and_si256(_mm256_castps_si256(infnan),
+                                                 _mm256_set1_epi32(0xff << 23)));
+   bits = _mm256_or_si256(bits, _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16));
+   return _mm256_castsi256_ps(bits);
+}
+
+
+static INLINE __m256i
+avx2_float_to_half(__m256 f)
+{
+   const __m256i f32inf = _mm256_set1_epi32(0xff << 23);
+   const __m256i f16inf = _mm256_set1_epi32(0x1f << 23);
+   const __m256i magic = _mm256_set1_epi32(0xf << 23);
+   __m256i bits = _mm256_castps_si256(f);
+   __m256i sign = _mm256_and_si256(bits, _mm256_set1_epi32(0x80000000));
+   __m256i inf, nan, over, h;
+
+   bits = _mm256_xor_si256(bits, sign);
+   inf = _mm256_cmpeq_epi32(bits, f32inf);
+   nan = _mm256_cmpgt_epi32(bits, f32inf);
+
+   h = _mm256_and_si256(bits, _mm256_set1_epi32(~0xfff));
+   h = _mm256_castps_si256(_mm256_mul_ps(_mm256_castsi256_ps(h),
+                                         _mm256_castsi256_ps(magic)));
+   h = _mm256_add_epi32(h, _mm256_set1_epi32(0x1000));
+   over = _mm256_cmpgt_epi32(h, f16inf);
+   h = _mm256_blendv_epi8(h, _mm256_sub_epi32(f16inf, _mm256_set1_epi32(1)),
+                          over);
+   h = _mm256_srli_epi32(h, 13);
+
+   h = _mm256_blendv_epi8(h, _mm256_set1_epi32(0x7c00), inf);
+   h = _mm256_blendv_epi8(h, _mm256_set1_epi32(0x7e00), nan);
+   return _mm256_or_si256(h, _mm256_srli_epi32(sign, 16));
+}
+
+
+/**
+ * Store eight Z values as eight pixels of ZZZZ.
+ */
+static INLINE void
+avx2_store_z8(float *dst, __m256 z)
+{
+   _mm256_storeu_ps(dst +  0, _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1)));
+   _mm256_storeu_ps(dst +  8, _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3)));
+   _mm256_storeu_ps(dst + 16, _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5)));
+   _mm256_storeu_ps(dst + 24, _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7)));
+}
+
+
+static INLINE boolean
+is_bgr(enum util_tile_simd_format format)
+{
+   return format == UTIL_TILE_SIMD_B8G8R8A8_UNORM ||
+          format == UTIL_TILE_SIMD_B8G8R8X8_UNORM;
+}
+
+static INLINE boolean
+has_alpha(enum util_tile_simd_format format)
+{
+   return format == UTIL_TILE_SIMD_R8G8B8A8_UNORM ||
+          format == UTIL_TILE_SIMD_B8G8R8A8_UNORM;
+}
+
+
+static INLINE void
+unpack_8888_avx2(float *dst, const void *src, unsigned n,
+                 enum util_tile_simd_format format)
+{
+   const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+   const __m256 rgb_mask = _mm256_castsi256_ps(_mm256_setr_epi32(~0, ~0, ~0, 0, ~0, ~0, ~0, 0));
+   const __m256 alpha_one = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 1.0f,
+                                           0.0f, 0.0f, 0.0f, 1.0f);
+   const unsigned char *s = (const unsigned char *) src;
+   unsigned i, j;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      for (j = 0; j < 4; j++) {
+         __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) s));
+         __m256 f;
+
+         if (is_bgr(format))
+            c = _mm256_shuffle_epi32(c, _MM_SHUFFLE(3, 0, 1, 2));
+         f = _mm256_mul_ps(_mm256_cvtepi32_ps(c), scale);
+         if (!has_alpha(format))
+            f = _mm256_or_ps(_mm256_and_ps(f, rgb_mask), alpha_one);
+         _mm256_storeu_ps(dst, f);
+         dst += 8;
+         s += 8;
+      }
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.unpack[format](dst, s, n - i);
+}
+
+static INLINE void
+pack_8888_avx2(void *dst, const float *src, unsigned n,
+               enum util_tile_simd_format format)
+{
+   const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+   unsigned char *d = (unsigned char *) dst;
+   unsigned i, j;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      __m256i c[4], p;
+
+      for (j = 0; j < 4; j++) {
+         c[j] = avx2_float_to_ubyte(_mm256_loadu_ps(src));
+         if (is_bgr(format))
+            c[j] = _mm256_shuffle_epi32(c[j], _MM_SHUFFLE(3, 0, 1, 2));
+         src += 8;
+      }
+
+      /* Leaves pixels 0 2 4 6 1 3 5 7. */
+      p = _mm256_packus_epi16(_mm256_packs_epi32(c[0], c[1]),
+                              _mm256_packs_epi32(c[2], c[3]));
+      p = _mm256_permutevar8x32_epi32(p, order);
+      if (!has_alpha(format))
+         p = _mm256_and_si256(p, _mm256_set1_epi32(0x00ffffff));
+      _mm256_storeu_si256((__m256i *) d, p);
+      d += 32;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.pack[format](d, src, n - i);
+}
+
+#define AVX2_8888(name, format)                                             \
+static void                                                                 \
+unpack_##name##_avx2(float *dst, const void *src, unsigned n)               \
+{                                                                           \
+   unpack_8888_avx2(dst, src, n, format);                                   \
+}                                                                           \
+                                                                            \
+static void                                                                 \
+pack_##name##_avx2(void *dst, const float *src, unsigned n)                 \
+{                                                                           \
+   pack_8888_avx2(dst, src, n, format);                                     \
+}
+
+AVX2_8888(rgba8, UTIL_TILE_SIMD_R8G8B8A8_UNORM)
+AVX2_8888(bgra8, UTIL_TILE_SIMD_B8G8R8A8_UNORM)
+AVX2_8888(rgbx8, UTIL_TILE_SIMD_R8G8B8X8_UNORM)
+AVX2_8888(bgrx8, UTIL_TILE_SIMD_B8G8R8X8_UNORM)
+
+
+static void
+unpack_565_avx2(float *dst, const void *src, unsigned n)
+{
+   const unsigned char *s = (const unsigned char *) src;
+   unsigned i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) s));
+      __m256 r, g, b, a, t0, t1, t2, t3, p0, p1, p2, p3;
+
+      r = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 11));
+      g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 5),
+                                              _mm256_set1_epi32(0x3f)));
+      b = _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0x1f)));
+      r = _mm256_mul_ps(r, _mm256_set1_ps(1.0f / 0x1f));
+      g = _mm256_mul_ps(g, _mm256_set1_ps(1.0f / 0x3f));
+      b = _mm256_mul_ps(b, _mm256_set1_ps(1.0f / 0x1f));
+      a = _mm256_set1_ps(1.0f);
+
+      /* Transpose within the lanes, giving pixels 0|4, 1|5, 2|6 and 3|7. */
+      t0 = _mm256_unpacklo_ps(r, g);
+      t1 = _mm256_unpacklo_ps(b, a);
+      t2 = _mm256_unpackhi_ps(r, g);
+      t3 = _mm256_unpackhi_ps(b, a);
+      p0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+      p1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+      p2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+      p3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+      _mm256_storeu_ps(dst +  0, _mm256_permute2f128_ps(p0, p1, 0x20));
+      _mm256_storeu_ps(dst +  8, _mm256_permute2f128_ps(p2, p3, 0x20));
+      _mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(p0, p1, 0x31));
+      _mm256_storeu_ps(dst + 24, _mm256_permute2f128_ps(p2, p3, 0x31));
+      dst += 32;
+      s += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.unpack[UTIL_TILE_SIMD_B5G6R5_UNORM](dst, s, n - i);
+}
+
+static void
+pack_565_avx2(void *dst, const float *src, unsigned n)
+{
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one = _mm256_set1_ps(1.0f);
+   unsigned char *d = (unsigned char *) dst;
+   unsigned i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      __m256 m0 = _mm256_loadu_ps(src +  0);
+      __m256 m1 = _mm256_loadu_ps(src +  8);
+      __m256 m2 = _mm256_loadu_ps(src + 16);
+      __m256 m3 = _mm256_loadu_ps(src + 24);
+      __m256 a0, a1, a2, a3, t0, t1, t2, t3, r, g, b;
+      __m256i v;
+
+      /* Pixels 0|4, 1|5, 2|6 and 3|7, then transpose within the lanes. */
+      a0 = _mm256_permute2f128_ps(m0, m2, 0x20);
+      a1 = _mm256_permute2f128_ps(m0, m2, 0x31);
+      a2 = _mm256_permute2f128_ps(m1, m3, 0x20);
+      a3 = _mm256_permute2f128_ps(m1, m3, 0x31);
+      t0 = _mm256_unpacklo_ps(a0, a1);
+      t1 = _mm256_unpacklo_ps(a2, a3);
+      t2 = _mm256_unpackhi_ps(a0, a1);
+      t3 = _mm256_unpackhi_ps(a2, a3);
+      r = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+      g = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+      b = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+
+      /* NaNs clamp to zero, see pack_565_sse2(). */
+      r = _mm256_min_ps(_mm256_max_ps(r, zero), one);
+      g = _mm256_min_ps(_mm256_max_ps(g, zero), one);
+      b = _mm256_min_ps(_mm256_max_ps(b, zero), one);
+
+      v = avx2_iround_unorm(_mm256_mul_ps(b, _mm256_set1_ps(0x1f)));
+      v = _mm256_or_si256(v, _mm256_slli_epi32(avx2_iround_unorm(_mm256_mul_ps(g, _mm256_set1_ps(0x3f))), 5));
+      v = _mm256_or_si256(v, _mm256_slli_epi32(avx2_iround_unorm(_mm256_mul_ps(r, _mm256_set1_ps(0x1f))), 11));
+
+      v = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v),
+                                   _MM_SHUFFLE(3, 1, 2, 0));
+      _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(v));
+      src += 32;
+      d += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.pack[UTIL_TILE_SIMD_B5G6R5_UNORM](d, src, n - i);
+}
+
+
+static void
+unpack_rgba16f_avx2(float *dst, const void *src, unsigned n)
+{
+   const unsigned char *s = (const unsigned char *) src;
+   unsigned i;
+
+   for (i = 0; i + 2 <= n; i += 2) {
+      __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) s));
+
+      _mm256_storeu_ps(dst, avx2_half_to_float(h));
+      dst += 8;
+      s += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.unpack[UTIL_TILE_SIMD_R16G16B16A16_FLOAT](dst, s, n - i);
+}
+
+static void
+pack_rgba16f_avx2(void *dst, const float *src, unsigned n)
+{
+   unsigned char *d = (unsigned char *) dst;
+   unsigned i;
+
+   for (i = 0; i + 2 <= n; i += 2) {
+      __m256i h = avx2_float_to_half(_mm256_loadu_ps(src));
+
+      h = _mm256_permute4x64_epi64(_mm256_packus_epi32(h, h),
+                                   _MM_SHUFFLE(3, 1, 2, 0));
+      _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(h));
+      src += 8;
+      d += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.pack[UTIL_TILE_SIMD_R16G16B16A16_FLOAT](d, src, n - i);
+}
+
+
+static INLINE void
+unpack_z24_avx2(float *dst, const void *src, unsigned n,
+                enum util_tile_simd_format format)
+{
+   const __m256d scale = _mm256_set1_pd(1.0 / ((1 << 24) - 1));
+   const unsigned char *s = (const unsigned char *) src;
+   unsigned i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *) s);
+      __m128 lo, hi;
+
+      if (format == UTIL_TILE_SIMD_Z24_UNORM_S8_UINT)
+         v = _mm256_and_si256(v, _mm256_set1_epi32(0xffffff));
+      else
+         v = _mm256_srli_epi32(v, 8);
+
+      lo = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), scale));
+      hi = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), scale));
+      avx2_store_z8(dst, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+      dst += 32;
+      s += 32;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.unpack[format](dst, s, n - i);
+}
+
+static void
+unpack_z24s8_avx2(float *dst, const void *src, unsigned n)
+{
+   unpack_z24_avx2(dst, src, n, UTIL_TILE_SIMD_Z24_UNORM_S8_UINT);
+}
+
+static void
+unpack_s8z24_avx2(float *dst, const void *src, unsigned n)
+{
+   unpack_z24_avx2(dst, src, n, UTIL_TILE_SIMD_S8_UINT_Z24_UNORM);
+}
+
+static void
+unpack_z32f_avx2(float *dst, const void *src, unsigned n)
+{
+   const float *s = (const float *) src;
+   unsigned i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      avx2_store_z8(dst, _mm256_loadu_ps(s));
+      dst += 32;
+      s += 8;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.unpack[UTIL_TILE_SIMD_Z32_FLOAT](dst, s, n - i);
+}
+
+
+static const struct util_tile_simd_funcs tile_simd_funcs_avx2 = {
+   "avx2",
+   {
+      unpack_rgba8_avx2,
+      unpack_bgra8_avx2,
+      unpack_rgbx8_avx2,
+      unpack_bgrx8_avx2,
+      unpack_565_avx2,
+      unpack_rgba16f_avx2,
+      unpack_z24s8_avx2,
+      unpack_s8z24_avx2,
+      unpack_z32f_avx2
+   },
+   {
+      pack_rgba8_avx2,
+      pack_bgra8_avx2,
+      pack_rgbx8_avx2,
+      pack_bgrx8_avx2,
+      pack_565_avx2,
+      pack_rgba16f_avx2,
+      NULL,
+      NULL,
+      NULL
+   }
+};
+
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_avx2(void)
+{
+   return &tile_simd_funcs_avx2;
+}
+
+
+#else /* !__AVX2__ */
+
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_avx2(void)
+{
+   return NULL;
+}
+
+
+#endif /* !__AVX2__ */
@@ -0,0 +1,226 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * SSSE3 versions of the tile row conversion kernels.
+ *
+ * Only the 8-bit RGBA formats benefit: pshufb expands a pixel to dwords,
+ * swizzling the channels and zeroing X8 in the same instruction, and
+ * reorders/masks four packed pixels at once.  The other formats are left
+ * to the SSE2 kernels.
+ *
+ * This file is compiled with -mssse3 and the functions are only installed
+ * when util_cpu_caps reports SSSE3 support.
+ */
+
+#include "util/u_tile_simd.h"
+
+
+#if defined(__SSSE3__)
+
+#include <tmmintrin.h>
+
+
+#define Z 0x80
+
+/* pshufb masks expanding pixel p of four to RGBA dwords.  r, g, b and a
+ * are the byte offsets of the channels within the pixel, a < 0 for X8.
+ */
+#define EXPAND(p, r, g, b, a) \
+   { (p)*4 + (r), Z, Z, Z, (p)*4 + (g), Z, Z, Z, \
+     (p)*4 + (b), Z, Z, Z, (a) < 0 ? Z : (p)*4 + (a), Z, Z, Z }
+
+#define EXPAND4(r, g, b, a) \
+   { EXPAND(0, r, g, b, a), EXPAND(1, r, g, b, a), \
+     EXPAND(2, r, g, b, a), EXPAND(3, r, g, b, a) }
+
+/* pshufb masks reordering four RGBA pixels to the packed format. */
+#define SWIZZLE4(r, g, b, a) \
+   { (r) + 0,  (g) + 0,  (b) + 0,  (a) < 0 ? Z : (a) + 0, \
+     (r) + 4,  (g) + 4,  (b) + 4,  (a) < 0 ? Z : (a) + 4, \
+     (r) + 8,  (g) + 8,  (b) + 8,  (a) < 0 ? Z : (a) + 8, \
+     (r) + 12, (g) + 12, (b) + 12, (a) < 0 ? Z : (a) + 12 }
+
+static const unsigned char unpack_masks[4][4][16] = {
+   EXPAND4(0, 1, 2, 3),    /* R8G8B8A8 */
+   EXPAND4(2, 1, 0, 3),    /* B8G8R8A8 */
+   EXPAND4(0, 1, 2, -1),   /* R8G8B8X8 */
+   EXPAND4(2, 1, 0, -1)    /* B8G8R8X8 */
+};
+
+static const unsigned char pack_masks[4][16] = {
+   SWIZZLE4(0, 1, 2, 3),
+   SWIZZLE4(2, 1, 0, 3),
+   SWIZZLE4(0, 1, 2, -1),
+   SWIZZLE4(2, 1, 0, -1)
+};
+
+#undef SWIZZLE4
+#undef EXPAND4
+#undef EXPAND
+#undef Z
+
+
+static INLINE __m128i
+ssse3_float_to_ubyte(__m128 f)
+{
+   const __m128i bits = _mm_castps_si128(f);
+   const __m128i neg = _mm_cmplt_epi32(bits, _mm_setzero_si128());
+   const __m128i one = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x3f7fffff));
+   __m128i ub;
+
+   f = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f / 256.0f)),
+                  _mm_set1_ps(32768.0f));
+   ub = _mm_or_si128(_mm_castps_si128(f), one);
+   ub = _mm_and_si128(ub, _mm_set1_epi32(0xff));
+   return _mm_andnot_si128(neg, ub);
+}
+
+
+static INLINE void
+unpack_8888_ssse3(float *dst, const void *src, unsigned n,
+                  enum util_tile_simd_format format)
+{
+   const __m128i m0 = _mm_loadu_si128((const __m128i *) unpack_masks[format][0]);
+   const __m128i m1 = _mm_loadu_si128((const __m128i *) unpack_masks[format][1]);
+   const __m128i m2 = _mm_loadu_si128((const __m128i *) unpack_masks[format][2]);
+   const __m128i m3 = _mm_loadu_si128((const __m128i *) unpack_masks[format][3]);
+   const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+   const boolean x8 = format == UTIL_TILE_SIMD_R8G8B8X8_UNORM ||
+                      format == UTIL_TILE_SIMD_B8G8R8X8_UNORM;
+   const __m128 alpha_one = _mm_setr_ps(0.0f, 0.0f, 0.0f, x8 ? 1.0f : 0.0f);
+   const unsigned char *s = (const unsigned char *) src;
+   unsigned i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128i p = _mm_loadu_si128((const __m128i *) s);
+      __m128 f0 = _mm_cvtepi32_ps(_mm_shuffle_epi8(p, m0));
+      __m128 f1 = _mm_cvtepi32_ps(_mm_shuffle_epi8(p, m1));
+      __m128 f2 = _mm_cvtepi32_ps(_mm_shuffle_epi8(p, m2));
+      __m128 f3 = _mm_cvtepi32_ps(_mm_shuffle_epi8(p, m3));
+
+      /* X8 comes out as 0.0f, so or-ing in 1.0f is enough. */
+      _mm_storeu_ps(dst +  0, _mm_or_ps(_mm_mul_ps(f0, scale), alpha_one));
+      _mm_storeu_ps(dst +  4, _mm_or_ps(_mm_mul_ps(f1, scale), alpha_one));
+      _mm_storeu_ps(dst +  8, _mm_or_ps(_mm_mul_ps(f2, scale), alpha_one));
+      _mm_storeu_ps(dst + 12, _mm_or_ps(_mm_mul_ps(f3, scale), alpha_one));
+      dst += 16;
+      s += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.unpack[format](dst, s, n - i);
+}
+
+static INLINE void
+pack_8888_ssse3(void *dst, const float *src, unsigned n,
+                enum util_tile_simd_format format)
+{
+   const __m128i mask = _mm_loadu_si128((const __m128i *) pack_masks[format]);
+   unsigned char *d = (unsigned char *) dst;
+   unsigned i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128i c0 = ssse3_float_to_ubyte(_mm_loadu_ps(src +  0));
+      __m128i c1 = ssse3_float_to_ubyte(_mm_loadu_ps(src +  4));
+      __m128i c2 = ssse3_float_to_ubyte(_mm_loadu_ps(src +  8));
+      __m128i c3 = ssse3_float_to_ubyte(_mm_loadu_ps(src + 12));
+      __m128i p = _mm_packus_epi16(_mm_packs_epi32(c0, c1),
+                                   _mm_packs_epi32(c2, c3));
+
+      _mm_storeu_si128((__m128i *) d, _mm_shuffle_epi8(p, mask));
+      src += 16;
+      d += 16;
+   }
+
+   if (i < n)
+      util_tile_simd_funcs_c.pack[format](d, src, n - i);
+}
+
+#define SSSE3_8888(name, format)                                            \
+static void                                                                 \
+unpack_##name##_ssse3(float *dst, const void *src, unsigned n)              \
+{                                                                           \
+   unpack_8888_ssse3(dst, src, n, format);                                  \
+}                                                                           \
+                                                                            \
+static void                                                                 \
+pack_##name##_ssse3(void *dst, const float *src, unsigned n)                \
+{                                                                           \
+   pack_8888_ssse3(dst, src, n, format);                                    \
+}
+
+SSSE3_8888(rgba8, UTIL_TILE_SIMD_R8G8B8A8_UNORM)
+SSSE3_8888(bgra8, UTIL_TILE_SIMD_B8G8R8A8_UNORM)
+SSSE3_8888(rgbx8, UTIL_TILE_SIMD_R8G8B8X8_UNORM)
+SSSE3_8888(bgrx8, UTIL_TILE_SIMD_B8G8R8X8_UNORM)
+
+
+static const struct util_tile_simd_funcs tile_simd_funcs_ssse3 = {
+   "ssse3",
+   {
+      unpack_rgba8_ssse3,
+      unpack_bgra8_ssse3,
+      unpack_rgbx8_ssse3,
+      unpack_bgrx8_ssse3,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL
+   },
+   {
+      pack_rgba8_ssse3,
+      pack_bgra8_ssse3,
+      pack_rgbx8_ssse3,
+      pack_bgrx8_ssse3,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      NULL
+   }
+};
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_ssse3(void)
+{
+   return &tile_simd_funcs_ssse3;
+}
+
+
+#else /* !__SSSE3__ */
+
+
+const struct util_tile_simd_funcs *
+util_tile_simd_funcs_ssse3(void)
+{
+   return NULL;
+}
+
+
+#endif /* !__SSSE3__ */
@@ -56,6 +56,15 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    uint i, j;
 
+   if (llvmpipe->draw) {
+      const struct draw_clip_counters *counters =
+         draw_get_clip_counters(llvmpipe->draw);
+
+      LP_COUNT_ADD(nr_draw_pipeline_prims, counters->pipeline_prims);
+      LP_COUNT_ADD(nr_draw_clipped_prims, counters->clipped_prims);
+      LP_COUNT_ADD(nr_draw_culled_before_clip, counters->culled_prims);
+   }
+
    lp_print_counters();
 
    if (llvmpipe->blitter) {
@@ -95,6 +104,8 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
       pipe_resource_reference(&llvmpipe->vertex_buffer[i].buffer, NULL);
    }
 
+   llvmpipe_cleanup_compute(llvmpipe);
+
    lp_delete_setup_variants(llvmpipe);
 
    align_free( llvmpipe );
@@ -136,6 +147,7 @@ llvmpipe_create_context( struct pipe_screen *screen, void *priv )
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
    make_empty_list(&llvmpipe->fs_variants_list);
+   llvmpipe->fs_spec_candidate = -1;
 
    make_empty_list(&llvmpipe->setup_variants_list);
 
@@ -161,6 +173,7 @@ llvmpipe_create_context( struct pipe_screen *screen, void *priv )
    llvmpipe_init_fs_funcs(llvmpipe);
    llvmpipe_init_vs_funcs(llvmpipe);
    llvmpipe_init_gs_funcs(llvmpipe);
+   llvmpipe_init_compute_funcs(llvmpipe);
    llvmpipe_init_rasterizer_funcs(llvmpipe);
    llvmpipe_init_context_resource_funcs( &llvmpipe->pipe );
    llvmpipe_init_surface_functions(llvmpipe);
@@ -200,6 +213,11 @@ llvmpipe_create_context( struct pipe_screen *screen, void *priv )
    draw_wide_point_threshold(llvmpipe->draw, 10000.0);
    draw_wide_line_threshold(llvmpipe->draw, 10000.0);
 
+   /* Setup handles triangles reaching out into draw's guard band, which
+    * spares most of them the clipper.
+    */
+   draw_set_driver_clipping(llvmpipe->draw, FALSE, FALSE, TRUE, FALSE);
+
    lp_reset_counters();
 
    return &llvmpipe->pipe;
@@ -39,6 +39,7 @@
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
 #include "lp_setup.h"
+#include "lp_state_cs.h"
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
 
@@ -67,6 +68,7 @@ struct llvmpipe_context {
    const struct lp_geometry_shader *gs;
    const struct lp_velems_state *velems;
    const struct lp_so_state *so;
+   struct lp_compute_shader *cs;
 
    /** Other rendering state */
    unsigned sample_mask;
@@ -94,6 +96,10 @@ struct llvmpipe_context {
    int num_so_targets;
    struct pipe_query_data_so_statistics so_stats;
 
+   /** Compute resources and global buffers */
+   struct pipe_surface *cs_resources[PIPE_MAX_SHADER_RESOURCES];
+   struct pipe_resource *cs_globals[LP_MAX_CS_GLOBALS];
+
    struct pipe_query_data_pipeline_statistics pipeline_statistics;
    unsigned active_statistics_queries;
 
@@ -146,6 +152,9 @@ struct llvmpipe_context {
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Candidate of lp->fs->spec_candidates[] for the current constants, or -1 */
+   int fs_spec_candidate;
+
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
 
@@ -36,6 +36,7 @@
 #include "util/u_prim.h"
 
 #include "lp_context.h"
+#include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_query.h"
 
@@ -60,9 +61,21 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    if (!llvmpipe_check_render_cond(lp))
       return;
 
+   /* Textures changed by other contexts, or untiled, need new state even
+    * if nothing else changed.
+    */
+   if (lp->tex_timestamp != llvmpipe_screen(pipe->screen)->timestamp)
+      lp->dirty |= LP_NEW_SAMPLER_VIEW;
+
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   /* Draws that change no state count towards specializing the fragment
+    * shader on its constants too.
+    */
+   if (llvmpipe_count_fs_constants( lp ))
+      llvmpipe_update_fs( lp );
+
    /*
     * Map vertex buffers
     */
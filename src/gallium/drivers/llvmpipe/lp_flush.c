@@ -32,11 +32,13 @@
 
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
+#include "os/os_time.h"
 #include "util/u_string.h"
 #include "draw/draw_context.h"
 #include "lp_flush.h"
 #include "lp_context.h"
 #include "lp_setup.h"
+#include "lp_texture.h"
 
 
 /**
@@ -81,7 +83,10 @@ llvmpipe_finish( struct pipe_context *pipe,
    struct pipe_fence_handle *fence = NULL;
    llvmpipe_flush(pipe, &fence, reason);
    if (fence) {
+      int64_t start = os_time_get_nano();
       pipe->screen->fence_finish(pipe->screen, fence, PIPE_TIMEOUT_INFINITE);
+      lp_setup_account_wait(llvmpipe_context(pipe)->setup, "finish",
+                            start, os_time_get_nano());
       pipe->screen->fence_reference(pipe->screen, &fence, NULL);
    }
 }
@@ -109,22 +114,20 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
 
    if ((referenced & LP_REFERENCED_FOR_WRITE) ||
        ((referenced & LP_REFERENCED_FOR_READ) && !read_only)) {
+      if (cpu_access && do_not_block)
+         return FALSE;
 
-      if (cpu_access) {
-         /*
-          * Flush and wait.
-          */
-         if (do_not_block)
-            return FALSE;
-
-         llvmpipe_finish(pipe, reason);
-      } else {
-         /*
-          * Just flush.
-          */
+      llvmpipe_flush(pipe, NULL, reason);
+   }
 
-         llvmpipe_flush(pipe, NULL, reason);
-      }
+   if (cpu_access) {
+      /*
+       * Wait for the scenes accessing the resource, not for all scenes
+       * queued.  Scenes of other contexts may still be rasterizing it too,
+       * so this is needed even when this context doesn't reference it.
+       */
+      if (!llvmpipe_resource_wait(resource, !read_only, do_not_block))
+         return FALSE;
    }
 
    return TRUE;
@@ -0,0 +1,282 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Pool of threads compiling optimized fragment shader variants.
+ *
+ * Each job owns a second, private variant with the same key as the one
+ * bound on the draw path.  The private variant is compiled in its own LLVM
+ * context, since LLVM contexts may not be used concurrently, and its
+ * functions are then stored into the draw path variant, replacing the
+ * quick, unoptimized ones.  The rasterizer threads only fetch the
+ * jit_function[] pointers when executing the shader, so the swap needs no
+ * rebinding.  Both sets of code live until the variant is destroyed.
+ */
+
+#include "os/os_thread.h"
+#include "os/os_time.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "lp_context.h"
+#include "lp_fs_compiler.h"
+#include "lp_limits.h"
+#include "lp_perf.h"
+
+
+enum lp_fs_compile_job_state {
+   LP_FS_JOB_PENDING,
+   LP_FS_JOB_RUNNING,
+   LP_FS_JOB_DONE
+};
+
+
+struct lp_fs_compile_job
+{
+   struct lp_fs_compile_job *next;
+
+   /** The variant bound on the draw path */
+   struct lp_fragment_shader_variant *variant;
+
+   /** Private variant receiving the optimized code */
+   struct lp_fragment_shader_variant *optimized;
+
+   enum lp_fs_compile_job_state state;
+   int64_t queued_time;
+};
+
+
+struct lp_fs_compiler
+{
+   pipe_mutex mutex;
+   pipe_condvar work_cond;   /**< a job was queued */
+   pipe_condvar done_cond;   /**< a job was completed */
+
+   /* FIFO of pending jobs, protected by the mutex */
+   struct lp_fs_compile_job *head;
+   struct lp_fs_compile_job *tail;
+
+   boolean exit_flag;
+
+   unsigned num_threads;
+   pipe_thread threads[LP_MAX_COMPILE_THREADS];
+};
+
+
+static void
+compile_job(struct lp_fs_compile_job *job)
+{
+   struct lp_fragment_shader_variant *optimized = job->optimized;
+
+   optimized->context = LLVMContextCreate();
+   if (optimized->context) {
+      llvmpipe_compile_fs_variant(optimized, 0);
+   }
+}
+
+
+static PIPE_THREAD_ROUTINE( compiler_thread, init_data )
+{
+   struct lp_fs_compiler *compiler = (struct lp_fs_compiler *) init_data;
+
+   pipe_mutex_lock(compiler->mutex);
+
+   while (!compiler->exit_flag) {
+      struct lp_fs_compile_job *job = compiler->head;
+
+      if (!job) {
+         pipe_condvar_wait(compiler->work_cond, compiler->mutex);
+         continue;
+      }
+
+      compiler->head = job->next;
+      if (!compiler->head)
+         compiler->tail = NULL;
+      job->state = LP_FS_JOB_RUNNING;
+
+      pipe_mutex_unlock(compiler->mutex);
+      compile_job(job);
+      pipe_mutex_lock(compiler->mutex);
+
+      if (job->optimized->jit_function[RAST_EDGE_TEST]) {
+         struct lp_fragment_shader_variant *variant = job->variant;
+
+         /* The rasterizer may be running the quick code right now, but
+          * storing a function pointer is atomic.
+          */
+         variant->jit_function[RAST_WHOLE] =
+            job->optimized->jit_function[RAST_WHOLE];
+         variant->jit_function[RAST_EDGE_TEST] =
+            job->optimized->jit_function[RAST_EDGE_TEST];
+      }
+
+      LP_COUNT(nr_llvm_async_compiles);
+      LP_COUNT_ADD(llvm_async_compile_latency,
+                   os_time_get() - job->queued_time);
+
+      job->state = LP_FS_JOB_DONE;
+      pipe_condvar_broadcast(compiler->done_cond);
+   }
+
+   pipe_mutex_unlock(compiler->mutex);
+
+   return 0;
+}
+
+
+/**
+ * Create a pool of compiler threads.
+ * \param num_threads  number of threads, must be non-zero
+ */
+struct lp_fs_compiler *
+lp_fs_compiler_create(unsigned num_threads)
+{
+   struct lp_fs_compiler *compiler;
+   unsigned i;
+
+   assert(num_threads);
+
+   compiler = CALLOC_STRUCT(lp_fs_compiler);
+   if (!compiler)
+      return NULL;
+
+   pipe_mutex_init(compiler->mutex);
+   pipe_condvar_init(compiler->work_cond);
+   pipe_condvar_init(compiler->done_cond);
+
+   compiler->num_threads = MIN2(num_threads, LP_MAX_COMPILE_THREADS);
+   for (i = 0; i < compiler->num_threads; i++) {
+      compiler->threads[i] = pipe_thread_create(compiler_thread,
+                                                (void *) compiler);
+   }
+
+   return compiler;
+}
+
+
+/**
+ * Shut down the compiler threads.  Jobs still pending are never run, and
+ * remain owned by their variants.
+ */
+void
+lp_fs_compiler_destroy(struct lp_fs_compiler *compiler)
+{
+   unsigned i;
+
+   pipe_mutex_lock(compiler->mutex);
+   compiler->exit_flag = TRUE;
+   pipe_condvar_broadcast(compiler->work_cond);
+   pipe_mutex_unlock(compiler->mutex);
+
+   for (i = 0; i < compiler->num_threads; i++) {
+      pipe_thread_wait(compiler->threads[i]);
+   }
+
+   pipe_condvar_destroy(compiler->done_cond);
+   pipe_condvar_destroy(compiler->work_cond);
+   pipe_mutex_destroy(compiler->mutex);
+
+   FREE(compiler);
+}
+
+
+/**
+ * Queue the compilation of optimized code for a variant.
+ * \param variant  the variant currently bound, with quick code
+ * \param optimized  a new variant with the same key, but no code yet
+ */
+struct lp_fs_compile_job *
+lp_fs_compiler_queue(struct lp_fs_compiler *compiler,
+                     struct lp_fragment_shader_variant *variant,
+                     struct lp_fragment_shader_variant *optimized)
+{
+   struct lp_fs_compile_job *job;
+
+   job = CALLOC_STRUCT(lp_fs_compile_job);
+   if (!job)
+      return NULL;
+
+   job->variant = variant;
+   job->optimized = optimized;
+   job->state = LP_FS_JOB_PENDING;
+   job->queued_time = os_time_get();
+
+   pipe_mutex_lock(compiler->mutex);
+   if (compiler->tail)
+      compiler->tail->next = job;
+   else
+      compiler->head = job;
+   compiler->tail = job;
+   pipe_condvar_signal(compiler->work_cond);
+   pipe_mutex_unlock(compiler->mutex);
+
+   return job;
+}
+
+
+/**
+ * Retire a job, cancelling it if it has not started yet, or waiting for
+ * it if it is running.  The job is freed.
+ * \return the private variant of the job, with or without code, which the
+ * caller must destroy after the variant of the job.
+ */
+struct lp_fragment_shader_variant *
+lp_fs_compiler_finish(struct lp_fs_compiler *compiler,
+                      struct lp_fs_compile_job *job)
+{
+   struct lp_fragment_shader_variant *optimized = job->optimized;
+
+   pipe_mutex_lock(compiler->mutex);
+
+   if (job->state == LP_FS_JOB_PENDING) {
+      struct lp_fs_compile_job **prev = &compiler->head;
+      struct lp_fs_compile_job *last = NULL;
+
+      while (*prev != job) {
+         last = *prev;
+         prev = &last->next;
+      }
+      *prev = job->next;
+      if (compiler->tail == job)
+         compiler->tail = last;
+   }
+   else if (job->state == LP_FS_JOB_RUNNING) {
+      int64_t t0 = os_time_get();
+
+      while (job->state != LP_FS_JOB_DONE) {
+         pipe_condvar_wait(compiler->done_cond, compiler->mutex);
+      }
+
+      LP_COUNT(nr_llvm_compile_stalls);
+      LP_COUNT_ADD(llvm_compile_stall_time, os_time_get() - t0);
+   }
+
+   pipe_mutex_unlock(compiler->mutex);
+
+   FREE(job);
+
+   return optimized;
+}
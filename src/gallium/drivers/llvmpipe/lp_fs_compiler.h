@@ -1,6 +1,6 @@
 /**************************************************************************
  *
- * Copyright 2009 VMware, Inc.
+ * Copyright 2014 VMware, Inc.
  * All Rights Reserved.
  *
  * Permission is hereby granted, free of charge, to any person obtaining a
@@ -25,29 +25,40 @@
  *
  **************************************************************************/
 
+/**
+ * Background compilation of fragment shader variants.
+ *
+ * New variants are first compiled quickly, without optimizations, on the
+ * draw path.  The optimized code is then generated on a small pool of
+ * compiler threads and swapped into the variant once ready.
+ */
 
-#ifndef LP_SCENE_QUEUE
-#define LP_SCENE_QUEUE
 
-#include "pipe/p_compiler.h"
+#ifndef LP_FS_COMPILER_H
+#define LP_FS_COMPILER_H
 
-struct lp_scene_queue;
-struct lp_scene;
+#include "pipe/p_compiler.h"
 
 
-struct lp_scene_queue *
-lp_scene_queue_create(void);
+struct lp_fs_compiler;
+struct lp_fs_compile_job;
+struct lp_fragment_shader_variant;
 
-void
-lp_scene_queue_destroy(struct lp_scene_queue *queue);
 
-struct lp_scene *
-lp_scene_dequeue(struct lp_scene_queue *queue, boolean wait);
+struct lp_fs_compiler *
+lp_fs_compiler_create(unsigned num_threads);
 
 void
-lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene);
+lp_fs_compiler_destroy(struct lp_fs_compiler *compiler);
 
+struct lp_fs_compile_job *
+lp_fs_compiler_queue(struct lp_fs_compiler *compiler,
+                     struct lp_fragment_shader_variant *variant,
+                     struct lp_fragment_shader_variant *optimized);
 
+struct lp_fragment_shader_variant *
+lp_fs_compiler_finish(struct lp_fs_compiler *compiler,
+                      struct lp_fs_compile_job *job);
 
 
-#endif /* LP_BIN_QUEUE */
+#endif /* LP_FS_COMPILER_H */
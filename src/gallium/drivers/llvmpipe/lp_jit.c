@@ -38,6 +38,7 @@
 #include "gallivm/lp_bld_debug.h"
 #include "lp_context.h"
 #include "lp_jit.h"
+#include "lp_state_cs.h"
 
 
 static void
@@ -272,3 +273,80 @@ lp_jit_init_types(struct lp_fragment_shader_variant *lp)
    if (!lp->jit_context_ptr_type)
       lp_jit_create_types(lp);
 }
+
+
+static void
+lp_jit_create_cs_types(struct lp_compute_shader_variant *lp)
+{
+   struct gallivm_state *gallivm = lp->gallivm;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef i8_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   LLVMTypeRef i32_type = LLVMInt32TypeInContext(lc);
+
+   /* struct lp_jit_cs_context */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_CTX_COUNT];
+      LLVMTypeRef context_type;
+
+      elem_types[LP_JIT_CS_CTX_GLOBALS] =
+            LLVMArrayType(i8_ptr_type, LP_MAX_CS_GLOBALS);
+      elem_types[LP_JIT_CS_CTX_RESOURCES] =
+            LLVMArrayType(i8_ptr_type, PIPE_MAX_SHADER_RESOURCES);
+      elem_types[LP_JIT_CS_CTX_INPUT] = i8_ptr_type;
+      elem_types[LP_JIT_CS_CTX_GRID_SIZE] =
+      elem_types[LP_JIT_CS_CTX_BLOCK_SIZE] = LLVMArrayType(i32_type, 3);
+      elem_types[LP_JIT_CS_CTX_NUM_THREADS] =
+      elem_types[LP_JIT_CS_CTX_PRIVATE_SIZE] = i32_type;
+      elem_types[LP_JIT_CS_CTX_THREAD_IDS] = LLVMPointerType(i32_type, 0);
+
+      context_type = LLVMStructTypeInContext(lc, elem_types,
+                                             Elements(elem_types), 0);
+
+#if HAVE_LLVM < 0x0300
+      LLVMInvalidateStructLayout(gallivm->target, context_type);
+
+      LLVMAddTypeName(gallivm->module, "cs_context", context_type);
+#endif
+
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, globals,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_GLOBALS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, resources,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_RESOURCES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, input,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_INPUT);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, grid_size,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_GRID_SIZE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, block_size,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_BLOCK_SIZE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, num_threads,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_NUM_THREADS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, private_size,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_PRIVATE_SIZE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, thread_ids,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_THREAD_IDS);
+      LP_CHECK_STRUCT_SIZE(struct lp_jit_cs_context,
+                           gallivm->target, context_type);
+
+      lp->jit_context_ptr_type = LLVMPointerType(context_type, 0);
+   }
+
+   if (gallivm_debug & GALLIVM_DEBUG_IR) {
+      LLVMDumpModule(gallivm->module);
+   }
+}
+
+
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp)
+{
+   if (!lp->jit_context_ptr_type)
+      lp_jit_create_cs_types(lp);
+}
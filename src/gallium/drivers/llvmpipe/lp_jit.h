@@ -44,6 +44,7 @@
 
 
 struct lp_fragment_shader_variant;
+struct lp_compute_shader_variant;
 struct llvmpipe_screen;
 
 
@@ -248,6 +249,92 @@ typedef void
                     unsigned depth_stride);
 
 
+/**
+ * This structure is passed directly to the generated compute shader.
+ *
+ * Changes here must be reflected in the lp_jit_cs_context_* macros and
+ * lp_jit_init_cs_types function.
+ */
+struct lp_jit_cs_context
+{
+   uint8_t *globals[LP_MAX_CS_GLOBALS];
+   uint8_t *resources[PIPE_MAX_SHADER_RESOURCES];
+   uint8_t *input;
+
+   uint32_t grid_size[3];
+   uint32_t block_size[3];
+
+   /** Threads per block */
+   uint32_t num_threads;
+
+   /** Bytes of private memory per thread */
+   uint32_t private_size;
+
+   /**
+    * Thread ids, in vectors of x, y, z for each vector of threads, with
+    * num_threads rounded up to the vector length.
+    */
+   const uint32_t *thread_ids;
+};
+
+
+enum {
+   LP_JIT_CS_CTX_GLOBALS = 0,
+   LP_JIT_CS_CTX_RESOURCES,
+   LP_JIT_CS_CTX_INPUT,
+   LP_JIT_CS_CTX_GRID_SIZE,
+   LP_JIT_CS_CTX_BLOCK_SIZE,
+   LP_JIT_CS_CTX_NUM_THREADS,
+   LP_JIT_CS_CTX_PRIVATE_SIZE,
+   LP_JIT_CS_CTX_THREAD_IDS,
+   LP_JIT_CS_CTX_COUNT
+};
+
+
+#define lp_jit_cs_context_globals(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_GLOBALS, "globals")
+
+#define lp_jit_cs_context_resources(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_RESOURCES, "resources")
+
+#define lp_jit_cs_context_input(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_CTX_INPUT, "input")
+
+#define lp_jit_cs_context_grid_size(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_GRID_SIZE, "grid_size")
+
+#define lp_jit_cs_context_block_size(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_BLOCK_SIZE, "block_size")
+
+#define lp_jit_cs_context_num_threads(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_CTX_NUM_THREADS, "num_threads")
+
+#define lp_jit_cs_context_private_size(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_CTX_PRIVATE_SIZE, "private_size")
+
+#define lp_jit_cs_context_thread_ids(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_CTX_THREAD_IDS, "thread_ids")
+
+
+/**
+ * typedef for compute shader function, which runs all threads of a block
+ *
+ * @param context       jit context
+ * @param block_x       block id x
+ * @param block_y       block id y
+ * @param block_z       block id z
+ * @param local_mem     local memory of the block
+ * @param private_mem   private memory for a vector of threads
+ */
+typedef void
+(*lp_jit_cs_func)(const struct lp_jit_cs_context *context,
+                  uint32_t block_x,
+                  uint32_t block_y,
+                  uint32_t block_z,
+                  uint8_t *local_mem,
+                  uint8_t *private_mem);
+
+
 void
 lp_jit_screen_cleanup(struct llvmpipe_screen *screen);
 
@@ -260,4 +347,8 @@ void
 lp_jit_init_types(struct lp_fragment_shader_variant *lp);
 
 
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp);
+
+
 #endif /* LP_JIT_H */
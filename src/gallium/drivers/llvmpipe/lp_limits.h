@@ -35,10 +35,25 @@
 
 /**
  * Tile size (width and height). This needs to be a power of two.
+ *
+ * This is the default tile size, and the granularity at which resources
+ * are allocated.  Each scene may bin with smaller or larger tiles, in the
+ * range [LP_MIN_TILE_ORDER, LP_MAX_TILE_ORDER] (see lp_scene.tile_order).
  */
 #define TILE_ORDER 6
 #define TILE_SIZE (1 << TILE_ORDER)
 
+#define LP_MIN_TILE_ORDER 5
+#define LP_MAX_TILE_ORDER 7
+#define LP_MAX_TILE_SIZE (1 << LP_MAX_TILE_ORDER)
+
+/**
+ * Bins per rasterizer thread below which scenes are binned with the
+ * smallest tiles, and above which they are binned with the largest ones.
+ */
+#define LP_MIN_BINS_PER_THREAD 4
+#define LP_MAX_BINS_PER_THREAD 32
+
 
 /**
  * Max texture sizes
@@ -60,8 +75,24 @@
 #define LP_MAX_HEIGHT (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
+/**
+ * Window coordinate range setup handles.  Draw clips triangles at twice
+ * the viewport size, i.e. half the largest viewport past either side.
+ */
+#define LP_GUARD_BAND_MIN (-(LP_MAX_WIDTH / 2))
+#define LP_GUARD_BAND_MAX (LP_MAX_WIDTH + LP_MAX_WIDTH / 2)
+
+
+/**
+ * Max number of rasterizer threads.
+ */
+#define LP_MAX_THREADS 64
+
 
-#define LP_MAX_THREADS 16
+/**
+ * Max number of background shader compiler threads.
+ */
+#define LP_MAX_COMPILE_THREADS 8
 
 
 /**
@@ -81,6 +112,19 @@
  */
 #define LP_MAX_SHADER_INSTRUCTIONS (512*LP_MAX_SHADER_VARIANTS)
 
+/**
+ * Fragment shader constant specialization (LP_PERF=spec_consts): constant
+ * buffer 0 contents are baked into a variant once they were drawn with
+ * LP_SPEC_CONST_MIN_DRAWS times.  Only shaders reading up to
+ * LP_MAX_SPEC_CONSTS vec4 constants are specialized, with at most
+ * LP_MAX_SPEC_VARIANTS specialized variants per shader, and
+ * LP_SPEC_CONST_CANDIDATES buffer contents counted per shader.
+ */
+#define LP_MAX_SPEC_CONSTS 64
+#define LP_MAX_SPEC_VARIANTS 8
+#define LP_SPEC_CONST_CANDIDATES 16
+#define LP_SPEC_CONST_MIN_DRAWS 32
+
 /**
  * Max number of setup variants that will be kept around.
  *
@@ -91,4 +135,23 @@
  */
 #define LP_MAX_SETUP_VARIANTS 64
 
+
+/**
+ * Compute kernels address global memory with 32 bits: the buffer bound
+ * with set_global_binding() in the upper bits, and the byte offset in it
+ * in the lower LP_CS_GLOBAL_OFFSET_BITS.
+ */
+#define LP_CS_GLOBAL_OFFSET_BITS 27
+#define LP_MAX_CS_GLOBALS (1 << (32 - LP_CS_GLOBAL_OFFSET_BITS))
+
+/**
+ * Max threads per compute block launch_grid() can run (blocks with
+ * barriers are limited to one vector, see lp_cs_max_threads()), and bytes
+ * of local, private and input memory.
+ */
+#define LP_MAX_CS_THREADS 1024
+#define LP_MAX_CS_LOCAL_SIZE (32 * 1024)
+#define LP_MAX_CS_PRIVATE_SIZE (16 * 1024)
+#define LP_MAX_CS_INPUT_SIZE 4096
+
 #endif /* LP_LIMITS_H */
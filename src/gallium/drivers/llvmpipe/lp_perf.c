@@ -46,10 +46,15 @@ lp_print_counters(void)
 {
    if (LP_DEBUG & DEBUG_COUNTERS) {
       unsigned total_64, total_16, total_4;
+      unsigned i;
       float p1, p2, p3, p4, p5, p6;
 
       debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
       debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
+      debug_printf("llvmpipe: nr_guard_band_triangles:      %9u\n", lp_count.nr_guard_band_tris);
+      debug_printf("llvmpipe: nr_draw_pipeline_prims:       %9llu\n", (unsigned long long) lp_count.nr_draw_pipeline_prims);
+      debug_printf("llvmpipe:   nr_draw_clipped_prims:      %9llu\n", (unsigned long long) lp_count.nr_draw_clipped_prims);
+      debug_printf("llvmpipe:   nr_draw_culled_before_clip: %9llu\n", (unsigned long long) lp_count.nr_draw_culled_before_clip);
 
       total_64 = (lp_count.nr_empty_64 + 
                   lp_count.nr_fully_covered_64 +
@@ -72,7 +77,8 @@ lp_print_counters(void)
 
       total_16 = (lp_count.nr_empty_16 + 
                   lp_count.nr_fully_covered_16 +
-                  lp_count.nr_partially_covered_16);
+                  lp_count.nr_partially_covered_16 +
+                  lp_count.nr_hiz_culled_16);
 
       p1 = 100.0 * (float) lp_count.nr_empty_16 / (float) total_16;
       p2 = 100.0 * (float) lp_count.nr_fully_covered_16 / (float) total_16;
@@ -82,6 +88,7 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_16, p2, total_16);
       debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_16, p3, total_16);
       debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_16, p1, total_16);
+      debug_printf("llvmpipe:   nr_hiz_culled_16x16:        %9u (%3.0f%% of %u)\n", lp_count.nr_hiz_culled_16, 100.0 * (float) lp_count.nr_hiz_culled_16 / (float) total_16, total_16);
 
       total_4 = (lp_count.nr_empty_4 +
                  lp_count.nr_fully_covered_4 +
@@ -99,12 +106,38 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
 
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
+      debug_printf("llvmpipe: nr_color_tile_clear_skipped:  %9u\n", lp_count.nr_color_tile_clear_skipped);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
+      debug_printf("llvmpipe: nr_llvm_async_compiles:       %u\n", lp_count.nr_llvm_async_compiles);
+      if (lp_count.nr_llvm_async_compiles)
+         debug_printf("llvmpipe: average async compile latency: %.2f sec\n", lp_count.llvm_async_compile_latency / 1000000.0 / lp_count.nr_llvm_async_compiles);
+      debug_printf("llvmpipe: nr_llvm_compile_stalls:       %u\n", lp_count.nr_llvm_compile_stalls);
+      debug_printf("llvmpipe: total compile stall time:     %.2f sec\n", lp_count.llvm_compile_stall_time / 1000000.0);
+
+      debug_printf("llvmpipe: nr_scenes_queued:             %9u\n", lp_count.nr_scenes_queued);
+      debug_printf("llvmpipe: nr_scenes_created:            %9u\n", lp_count.nr_scenes_created);
+      debug_printf("llvmpipe: nr_scene_stalls:              %9u\n", lp_count.nr_scene_stalls);
+      debug_printf("llvmpipe: total scene stall time:       %.2f sec\n", lp_count.scene_stall_time / 1000000.0);
+      debug_printf("llvmpipe: nr_data_blocks_allocated:     %9u\n", lp_count.nr_data_blocks_allocated);
+      debug_printf("llvmpipe: nr_data_blocks_reused:        %9u\n", lp_count.nr_data_blocks_reused);
+      debug_printf("llvmpipe: nr_resource_waits:            %9u\n", lp_count.nr_resource_waits);
+      debug_printf("llvmpipe: total resource wait time:     %.2f sec\n", lp_count.resource_wait_time / 1000000.0);
+      debug_printf("llvmpipe: nr_buffer_renames:            %9u\n", lp_count.nr_buffer_renames);
+
+      for (i = 0; i < LP_MAX_THREADS; i++) {
+         if (lp_count.nr_thread_bins[i] == 0)
+            continue;
+         debug_printf("llvmpipe: thread %2u: nr_bins: %9u nr_stolen_bins: %9u idle time: %.2f sec\n",
+                      i,
+                      lp_count.nr_thread_bins[i],
+                      lp_count.nr_thread_stolen_bins[i],
+                      lp_count.thread_idle_time[i] / 1000000.0);
+      }
 
    }
 }
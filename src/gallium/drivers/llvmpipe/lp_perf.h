@@ -34,6 +34,7 @@
 #define LP_PERF_H
 
 #include "pipe/p_compiler.h"
+#include "lp_limits.h"
 
 /**
  * Various counters
@@ -42,6 +43,10 @@ struct lp_counters
 {
    unsigned nr_tris;
    unsigned nr_culled_tris;
+   unsigned nr_guard_band_tris;  /**< cut at the viewport edges by setup */
+   uint64_t nr_draw_pipeline_prims;  /**< through the draw pipeline stages */
+   uint64_t nr_draw_clipped_prims;
+   uint64_t nr_draw_culled_before_clip;
    unsigned nr_empty_64;
    unsigned nr_fully_covered_64;
    unsigned nr_partially_covered_64;
@@ -52,16 +57,37 @@ struct lp_counters
    unsigned nr_empty_16;
    unsigned nr_fully_covered_16;
    unsigned nr_partially_covered_16;
+   unsigned nr_hiz_culled_16;  /**< rejected by hierarchical Z */
    unsigned nr_empty_4;
    unsigned nr_fully_covered_4;
    unsigned nr_partially_covered_4;
    unsigned nr_non_empty_4;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
+   unsigned nr_llvm_async_compiles;
+   int64_t llvm_async_compile_latency;  /**< queued to ready, in microseconds */
+   unsigned nr_llvm_compile_stalls;  /**< waited for a background compile */
+   int64_t llvm_compile_stall_time;  /**< total, in microseconds */
 
    unsigned nr_color_tile_clear;
+   unsigned nr_color_tile_clear_skipped;  /**< overwritten before written */
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   unsigned nr_scenes_queued;
+   unsigned nr_scenes_created;
+   unsigned nr_scene_stalls;   /**< setup waited for an empty scene */
+   int64_t scene_stall_time;   /**< total, in microseconds */
+   unsigned nr_data_blocks_allocated;
+   unsigned nr_data_blocks_reused;   /**< taken from a scene's free blocks */
+   unsigned nr_resource_waits;  /**< CPU maps waited for a resource fence */
+   int64_t resource_wait_time;  /**< total, in microseconds */
+   unsigned nr_buffer_renames;  /**< discarding maps given new storage */
+
+   /* per rasterizer thread */
+   unsigned nr_thread_bins[LP_MAX_THREADS];
+   unsigned nr_thread_stolen_bins[LP_MAX_THREADS];
+   int64_t thread_idle_time[LP_MAX_THREADS];  /**< total, in microseconds */
 };
 
 
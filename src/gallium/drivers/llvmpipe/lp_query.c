@@ -54,7 +54,9 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= PIPE_QUERY_DRIVER_SPECIFIC &&
+           type < LP_QUERY_DRIVER_SPECIFIC_END));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -66,6 +68,46 @@ llvmpipe_create_query(struct pipe_context *pipe,
 }
 
 
+/**
+ * Current value of the counter behind a driver specific query.
+ */
+static uint64_t
+driver_query_value(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   const struct draw_vertex_cache_counters *vcache =
+      draw_get_vertex_cache_counters(llvmpipe->draw);
+   const struct lp_scene_stats *scenes;
+
+   switch (type) {
+   case LP_QUERY_DRAW_INDICES:
+      return vcache->indices;
+   case LP_QUERY_DRAW_SHADED_VERTICES:
+      return vcache->shaded_vertices;
+   default:
+      break;
+   }
+
+   /* times are in microseconds */
+   scenes = lp_setup_get_scene_stats(llvmpipe->setup);
+
+   switch (type) {
+   case LP_QUERY_SCENES:
+      return scenes->nr_scenes;
+   case LP_QUERY_BIN_TIME:
+      return scenes->bin_time / 1000;
+   case LP_QUERY_RAST_TIME:
+      return scenes->rast_time / 1000;
+   case LP_QUERY_SHADE_TIME:
+      return scenes->shade_time / 1000;
+   case LP_QUERY_WAIT_TIME:
+      return scenes->wait_time / 1000;
+   default:
+      assert(0);
+      return 0;
+   }
+}
+
+
 static void
 llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 {
@@ -100,6 +142,12 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    uint64_t *result = (uint64_t *)vresult;
    int i;
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      /* totals are sampled at begin/end, so there is nothing to wait for */
+      *result = pq->end[0] - pq->start[0];
+      return TRUE;
+   }
+
    if (pq->fence) {
       /* only have a fence if there was a scene */
       if (!lp_fence_signalled(pq->fence)) {
@@ -189,6 +237,14 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      if (pq->type == LP_QUERY_SHADE_TIME)
+         lp_setup_time_shading(llvmpipe->setup, TRUE);
+      pq->start[0] = driver_query_value(llvmpipe, pq->type);
+      pq->end[0] = pq->start[0];
+      return;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -243,6 +299,13 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->end[0] = driver_query_value(llvmpipe, pq->type);
+      if (pq->type == LP_QUERY_SHADE_TIME)
+         lp_setup_time_shading(llvmpipe->setup, FALSE);
+      return;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -41,6 +41,19 @@
 struct llvmpipe_context;
 
 
+/** Driver specific queries, reading the draw module's vertex cache counters */
+#define LP_QUERY_DRAW_INDICES          (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_DRAW_SHADED_VERTICES  (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+
+/** Driver specific queries of the scene timing, see lp_scene_stats */
+#define LP_QUERY_SCENES                (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+#define LP_QUERY_BIN_TIME              (PIPE_QUERY_DRIVER_SPECIFIC + 3)
+#define LP_QUERY_RAST_TIME             (PIPE_QUERY_DRIVER_SPECIFIC + 4)
+#define LP_QUERY_SHADE_TIME            (PIPE_QUERY_DRIVER_SPECIFIC + 5)
+#define LP_QUERY_WAIT_TIME             (PIPE_QUERY_DRIVER_SPECIFIC + 6)
+#define LP_QUERY_DRIVER_SPECIFIC_END   (PIPE_QUERY_DRIVER_SPECIFIC + 7)
+
+
 struct llvmpipe_query {
    uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
    uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
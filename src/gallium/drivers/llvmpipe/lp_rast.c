@@ -26,15 +26,19 @@
  **************************************************************************/
 
 #include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
+#include "util/u_string.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
 
 #include "os/os_time.h"
 
-#include "lp_scene_queue.h"
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
@@ -45,6 +49,7 @@
 #include "gallivm/lp_bld_debug.h"
 #include "lp_scene.h"
 #include "lp_tex_sample.h"
+#include "lp_trace.h"
 
 
 #ifdef DEBUG
@@ -62,21 +67,21 @@ static void
 lp_rast_begin( struct lp_rasterizer *rast,
                struct lp_scene *scene )
 {
-   rast->curr_scene = scene;
-
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
+   scene->rast_workers = 0;
+   scene->rast_exhausted = FALSE;
+
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->num_threads );
 }
 
 
 static void
-lp_rast_end( struct lp_rasterizer *rast )
+lp_rast_end( struct lp_rasterizer *rast,
+             struct lp_scene *scene )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
-
-   rast->curr_scene = NULL;
+   lp_scene_end_rasterization( scene );
 }
 
 
@@ -90,126 +95,129 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
                    const struct cmd_bin *bin,
                    int x, int y)
 {
+   const unsigned tile_size = task->scene->tile_size;
+
    LP_DBG(DEBUG_RAST, "%s %d,%d\n", __FUNCTION__, x, y);
 
    task->bin = bin;
-   task->x = x * TILE_SIZE;
-   task->y = y * TILE_SIZE;
-   task->width = TILE_SIZE + x * TILE_SIZE > task->scene->fb.width ?
-                    task->scene->fb.width - x * TILE_SIZE : TILE_SIZE;
-   task->height = TILE_SIZE + y * TILE_SIZE > task->scene->fb.height ?
-                    task->scene->fb.height - y * TILE_SIZE : TILE_SIZE;
+   task->x = x * tile_size;
+   task->y = y * tile_size;
+   task->width = tile_size + x * tile_size > task->scene->fb.width ?
+                    task->scene->fb.width - x * tile_size : tile_size;
+   task->height = tile_size + y * tile_size > task->scene->fb.height ?
+                    task->scene->fb.height - y * tile_size : tile_size;
 
    task->thread_data.vis_counter = 0;
    task->ps_invocations = 0;
+   task->hiz_valid = FALSE;
 
    /* reset pointers to color and depth tile(s) */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
    task->depth_tile = NULL;
+
+   /* the scene's clears, if any, come before the bin's commands */
+   task->clear_color = task->scene->clear_color;
+   task->clear_zsvalue = task->scene->clear_zsvalue;
+   task->clear_zsmask = task->scene->clear_zsmask;
 }
 
 
 /**
- * Examine a framebuffer object to determine if any of the colorbuffers
- * use a pure integer format.
- * XXX this could be a gallium utility function if useful elsewhere.
+ * Fill a rectangle with a pixel value of block_size bytes, only changing
+ * the bits set in the mask.  All render target formats are handled the
+ * same way: the value is replicated into a 48 byte pattern, which holds
+ * a whole number of pixels for all block sizes up to 16 bytes, and the
+ * rows are written with 16 byte stores.
  */
-static boolean
-is_fb_pure_integer(const struct pipe_framebuffer_state *fb)
+static void
+fill_rect(uint8_t *dst, unsigned stride,
+          unsigned width, unsigned height,
+          unsigned block_size,
+          const uint8_t *value, const uint8_t *mask)
 {
-   unsigned i;
-   for (i = 0; i < fb->nr_cbufs; i++) {
-      if (fb->cbufs[i] &&
-          util_format_is_pure_integer(fb->cbufs[i]->format)) {
-         return TRUE;
+   const unsigned row_bytes = width * block_size;
+   PIPE_ALIGN_VAR(16) uint8_t pattern[48];
+   PIPE_ALIGN_VAR(16) uint8_t mask_pattern[48];
+   boolean masked = FALSE;
+   unsigned i, y;
+
+   assert(block_size && 48 % block_size == 0);
+
+   for (i = 0; i < 48; i++) {
+      pattern[i] = value[i % block_size];
+      mask_pattern[i] = mask ? mask[i % block_size] : 0xff;
+      masked |= mask_pattern[i] != 0xff;
+   }
+
+   for (y = 0; y < height; y++) {
+      uint8_t *row = dst;
+
+      i = 0;
+#if defined(PIPE_ARCH_SSE)
+      {
+         const __m128i *p = (const __m128i *)pattern;
+         const __m128i *m = (const __m128i *)mask_pattern;
+
+         if (!masked) {
+            for (; i + 16 <= row_bytes; i += 16)
+               _mm_storeu_si128((__m128i *)(row + i), p[(i / 16) % 3]);
+         }
+         else {
+            for (; i + 16 <= row_bytes; i += 16) {
+               __m128i old = _mm_loadu_si128((const __m128i *)(row + i));
+               unsigned j = (i / 16) % 3;
+
+               old = _mm_andnot_si128(m[j], old);
+               _mm_storeu_si128((__m128i *)(row + i),
+                                _mm_or_si128(old, _mm_and_si128(m[j], p[j])));
+            }
+         }
       }
+#endif
+      if (!masked) {
+         for (; i < row_bytes; i += 48)
+            memcpy(row + i, pattern, MIN2(48, row_bytes - i));
+      }
+      else {
+         for (; i < row_bytes; i++) {
+            row[i] = (row[i] & ~mask_pattern[i % 48]) |
+                     (pattern[i % 48] & mask_pattern[i % 48]);
+         }
+      }
+
+      dst += stride;
    }
-   return FALSE;
 }
 
 
 /**
- * Clear the rasterizer's current color tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Write the pending color clear into the rasterizer's current tile.
+ * Clears always clear all bound layers.
  */
 static void
-lp_rast_clear_color(struct lp_rasterizer_task *task,
-                    const union lp_rast_cmd_arg arg)
+resolve_clear_color(struct lp_rasterizer_task *task)
 {
    const struct lp_scene *scene = task->scene;
+   const struct lp_rast_clear_color *clear_color = task->clear_color;
+   unsigned i, layer;
 
-   if (scene->fb.nr_cbufs) {
-      unsigned i;
-      union util_color uc;
-
-      if (is_fb_pure_integer(&scene->fb)) {
-         /*
-          * We expect int/uint clear values here, though some APIs
-          * might disagree (but in any case util_pack_color()
-          * couldn't handle it)...
-          */
-         LP_DBG(DEBUG_RAST, "%s pure int 0x%x,0x%x,0x%x,0x%x\n", __FUNCTION__,
-                    arg.clear_color.ui[0],
-                    arg.clear_color.ui[1],
-                    arg.clear_color.ui[2],
-                    arg.clear_color.ui[3]);
+   task->clear_color = NULL;
 
-         for (i = 0; i < scene->fb.nr_cbufs; i++) {
-            enum pipe_format format = scene->fb.cbufs[i]->format;
-
-            if (util_format_is_pure_sint(format)) {
-               util_format_write_4i(format, arg.clear_color.i, 0, &uc, 0, 0, 0, 1, 1);
-            }
-            else {
-               assert(util_format_is_pure_uint(format));
-               util_format_write_4ui(format, arg.clear_color.ui, 0, &uc, 0, 0, 0, 1, 1);
-            }
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      uint8_t *dst;
 
-            util_fill_box(scene->cbufs[i].map,
-                          format,
-                          scene->cbufs[i].stride,
-                          scene->cbufs[i].layer_stride,
-                          task->x,
-                          task->y,
-                          0,
-                          task->width,
-                          task->height,
-                          scene->fb_max_layer + 1,
-                          &uc);
-         }
-      }
-      else {
-         uint8_t clear_color[4];
+      if (!scene->fb.cbufs[i])
+         continue;
 
-         for (i = 0; i < 4; ++i) {
-            clear_color[i] = float_to_ubyte(arg.clear_color.f[i]);
-         }
+      dst = lp_rast_get_unswizzled_color_tile_pointer(task, i,
+                                                      LP_TEX_USAGE_WRITE_ALL);
 
-         LP_DBG(DEBUG_RAST, "%s 0x%x,0x%x,0x%x,0x%x\n", __FUNCTION__,
-                    clear_color[0],
-                    clear_color[1],
-                    clear_color[2],
-                    clear_color[3]);
-
-         for (i = 0; i < scene->fb.nr_cbufs; i++) {
-            if (scene->fb.cbufs[i]) {
-               util_pack_color(arg.clear_color.f,
-                               scene->fb.cbufs[i]->format, &uc);
-
-               util_fill_box(scene->cbufs[i].map,
-                             scene->fb.cbufs[i]->format,
-                             scene->cbufs[i].stride,
-                             scene->cbufs[i].layer_stride,
-                             task->x,
-                             task->y,
-                             0,
-                             task->width,
-                             task->height,
-                             scene->fb_max_layer + 1,
-                             &uc);
-            }
-         }
+      for (layer = 0; layer <= scene->fb_max_layer; layer++) {
+         fill_rect(dst, scene->cbufs[i].stride,
+                   task->width, task->height,
+                   util_format_get_blocksize(scene->fb.cbufs[i]->format),
+                   clear_color->packed[i], NULL);
+         dst += scene->cbufs[i].layer_stride;
       }
    }
 
@@ -217,119 +225,167 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Set the depth bounds of the tile after a z/stencil clear.
+ */
+static void
+hiz_clear(struct lp_rasterizer_task *task, uint64_t clear_mask)
+{
+   const struct lp_scene *scene = task->scene;
+   const enum pipe_format format = scene->fb.zsbuf->format;
+   const struct util_format_description *desc = util_format_description(format);
+   const uint64_t depth_mask = util_pack64_mask_z(format, 0xffffffff);
+   float z;
+   unsigned i, j;
+
+   if (!(clear_mask & depth_mask))
+      return;
+
+   task->hiz_valid = FALSE;
+
+   /* Only track the first layer, and only when the current state can't
+    * raise the depth values without another set_state command.
+    */
+   if ((clear_mask & depth_mask) != depth_mask ||
+       scene->fb_max_layer != 0 ||
+       (task->state && task->state->variant->hiz_invalidate))
+      return;
+
+   desc->unpack_z_float(&z, 0,
+                        lp_rast_get_unswizzled_depth_tile_pointer(task, LP_TEX_USAGE_READ),
+                        0, 1, 1);
+
+   for (i = 0; i < Elements(task->hiz_zmax); i++)
+      for (j = 0; j < Elements(task->hiz_zmax[0]); j++)
+         task->hiz_zmax[i][j] = z;
+
+   if (desc->channel[desc->swizzle[0]].type == UTIL_FORMAT_TYPE_FLOAT) {
+      task->hiz_unorm = FALSE;
+      task->hiz_epsilon = 0.0f;
+   }
+   else {
+      /* Allow for the conversion to fixed point rounding either way */
+      task->hiz_unorm = TRUE;
+      task->hiz_epsilon =
+         2.0f / (float)((1ULL << desc->channel[desc->swizzle[0]].size) - 1);
+   }
+
+   task->hiz_valid = TRUE;
+}
 
 
 /**
- * Clear the rasterizer's current z/stencil tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Write the pending z/stencil clear into the rasterizer's current tile.
+ * Clears always clear all bound layers.
  */
 static void
-lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
-                       const union lp_rast_cmd_arg arg)
+resolve_clear_zstencil(struct lp_rasterizer_task *task)
 {
    const struct lp_scene *scene = task->scene;
-   uint64_t clear_value64 = arg.clear_zstencil.value;
-   uint64_t clear_mask64 = arg.clear_zstencil.mask;
-   uint32_t clear_value = (uint32_t) clear_value64;
-   uint32_t clear_mask = (uint32_t) clear_mask64;
-   const unsigned height = task->height;
-   const unsigned width = task->width;
-   const unsigned dst_stride = scene->zsbuf.stride;
+   const unsigned block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
+   const uint64_t clear_mask64 = task->clear_zsmask;
+   union {
+      uint8_t u8;
+      uint16_t u16;
+      uint32_t u32;
+      uint64_t u64;
+      uint8_t bytes[8];
+   } value, mask;
    uint8_t *dst;
-   unsigned i, j;
-   unsigned block_size;
+   unsigned layer;
 
-   LP_DBG(DEBUG_RAST, "%s: value=0x%08x, mask=0x%08x\n",
-           __FUNCTION__, clear_value, clear_mask);
+   LP_DBG(DEBUG_RAST, "%s: value=0x%llx, mask=0x%llx\n", __FUNCTION__,
+          (unsigned long long)task->clear_zsvalue,
+          (unsigned long long)clear_mask64);
 
-   /*
-    * Clear the area of the depth/depth buffer matching this tile.
-    */
+   task->clear_zsmask = 0;
+
+   /* the pixel value in memory order */
+   switch (block_size) {
+   case 1:
+      value.u8 = (uint8_t)task->clear_zsvalue;
+      mask.u8 = (uint8_t)clear_mask64;
+      break;
+   case 2:
+      value.u16 = (uint16_t)task->clear_zsvalue;
+      mask.u16 = (uint16_t)clear_mask64;
+      break;
+   case 4:
+      value.u32 = (uint32_t)task->clear_zsvalue;
+      mask.u32 = (uint32_t)clear_mask64;
+      break;
+   case 8:
+      value.u64 = task->clear_zsvalue;
+      mask.u64 = clear_mask64;
+      break;
+   default:
+      assert(0);
+      return;
+   }
 
-   if (scene->fb.zsbuf) {
-      unsigned layer;
-      uint8_t *dst_layer = lp_rast_get_unswizzled_depth_tile_pointer(task, LP_TEX_USAGE_READ_WRITE);
-      block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
+   dst = lp_rast_get_unswizzled_depth_tile_pointer(task, LP_TEX_USAGE_READ_WRITE);
 
-      clear_value &= clear_mask;
+   for (layer = 0; layer <= scene->fb_max_layer; layer++) {
+      fill_rect(dst, scene->zsbuf.stride,
+                task->width, task->height,
+                block_size,
+                value.bytes, mask.bytes);
+      dst += scene->zsbuf.layer_stride;
+   }
 
-      for (layer = 0; layer <= scene->fb_max_layer; layer++) {
-         dst = dst_layer;
+   hiz_clear(task, clear_mask64);
+}
 
-         switch (block_size) {
-         case 1:
-            assert(clear_mask == 0xff);
-            memset(dst, (uint8_t) clear_value, height * width);
-            break;
-         case 2:
-            if (clear_mask == 0xffff) {
-               for (i = 0; i < height; i++) {
-                  uint16_t *row = (uint16_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = (uint16_t) clear_value;
-                  dst += dst_stride;
-               }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint16_t *row = (uint16_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint16_t tmp = ~clear_mask & *row;
-                     *row++ = clear_value | tmp;
-                  }
-                  dst += dst_stride;
-               }
-            }
-            break;
-         case 4:
-            if (clear_mask == 0xffffffff) {
-               for (i = 0; i < height; i++) {
-                  uint32_t *row = (uint32_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = clear_value;
-                  dst += dst_stride;
-               }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint32_t *row = (uint32_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint32_t tmp = ~clear_mask & *row;
-                     *row++ = clear_value | tmp;
-                  }
-                  dst += dst_stride;
-               }
-            }
-            break;
-         case 8:
-            clear_value64 &= clear_mask64;
-            if (clear_mask64 == 0xffffffffffULL) {
-               for (i = 0; i < height; i++) {
-                  uint64_t *row = (uint64_t *)dst;
-                  for (j = 0; j < width; j++)
-                     *row++ = clear_value64;
-                  dst += dst_stride;
-               }
-            }
-            else {
-               for (i = 0; i < height; i++) {
-                  uint64_t *row = (uint64_t *)dst;
-                  for (j = 0; j < width; j++) {
-                     uint64_t tmp = ~clear_mask64 & *row;
-                     *row++ = clear_value64 | tmp;
-                  }
-                  dst += dst_stride;
-               }
-            }
-            break;
 
-         default:
-            assert(0);
-            break;
-         }
-         dst_layer += scene->zsbuf.layer_stride;
-      }
+/**
+ * Write the tile's pending clears, before the tile contents are used.
+ */
+static INLINE void
+resolve_clears(struct lp_rasterizer_task *task)
+{
+   if (task->clear_color)
+      resolve_clear_color(task);
+
+   if (task->clear_zsmask)
+      resolve_clear_zstencil(task);
+}
+
+
+/**
+ * Clear the rasterizer's current color tile.
+ * This is a bin command called during bin processing.
+ * The clear is only written once the tile contents are used, so it's
+ * dropped if the tile gets overwritten first.
+ */
+static void
+lp_rast_clear_color(struct lp_rasterizer_task *task,
+                    const union lp_rast_cmd_arg arg)
+{
+   LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
+
+   if (task->scene->fb.nr_cbufs)
+      task->clear_color = arg.clear_color;
+}
+
+
+/**
+ * Clear the rasterizer's current z/stencil tile.
+ * This is a bin command called during bin processing.
+ * The clear is only written once the tile contents are used.
+ */
+static void
+lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
+                       const union lp_rast_cmd_arg arg)
+{
+   uint64_t clear_value64 = arg.clear_zstencil.value;
+   uint64_t clear_mask64 = arg.clear_zstencil.mask;
+
+   LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
+
+   if (task->scene->fb.zsbuf) {
+      task->clear_zsvalue = (task->clear_zsvalue & ~clear_mask64) |
+                            (clear_value64 & clear_mask64);
+      task->clear_zsmask |= clear_mask64;
    }
 }
 
@@ -349,7 +405,8 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_rast_state *state;
    struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
-   unsigned x, y;
+   unsigned bx, by, x, y;
+   BEGIN_SHADE_TIMING(task);
 
    if (inputs->disable) {
       /* This command was partially binned and has been disabled */
@@ -365,49 +422,64 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
-   /* render the whole 64x64 tile in 4x4 chunks */
-   for (y = 0; y < task->height; y += 4){
-      for (x = 0; x < task->width; x += 4) {
-         uint8_t *color[PIPE_MAX_COLOR_BUFS];
-         unsigned stride[PIPE_MAX_COLOR_BUFS];
-         uint8_t *depth = NULL;
-         unsigned depth_stride = 0;
-         unsigned i;
-
-         /* color buffer */
-         for (i = 0; i < scene->fb.nr_cbufs; i++){
-            stride[i] = scene->cbufs[i].stride;
-            color[i] = lp_rast_get_unswizzled_color_block_pointer(task, i, tile_x + x,
-                                                                  tile_y + y, inputs->layer);
+   /* render the whole tile in 16x16 blocks of 4x4 chunks */
+   for (by = 0; by < task->height; by += 16) {
+      for (bx = 0; bx < task->width; bx += 16) {
+         if (task->hiz_valid && variant->hiz_cull &&
+             lp_rast_hiz_cull(task, inputs, tile_x + bx, tile_y + by, 0x1)) {
+            LP_COUNT(nr_hiz_culled_16);
+            continue;
          }
 
-         /* depth buffer */
-         if (scene->zsbuf.map) {
-            depth = lp_rast_get_unswizzled_depth_block_pointer(task, tile_x + x,
-                                                               tile_y + y, inputs->layer);
-            depth_stride = scene->zsbuf.stride;
-         }
+         for (y = by; y < MIN2(by + 16, task->height); y += 4) {
+            for (x = bx; x < MIN2(bx + 16, task->width); x += 4) {
+               uint8_t *color[PIPE_MAX_COLOR_BUFS];
+               unsigned stride[PIPE_MAX_COLOR_BUFS];
+               uint8_t *depth = NULL;
+               unsigned depth_stride = 0;
+               unsigned i;
+
+               /* color buffer */
+               for (i = 0; i < scene->fb.nr_cbufs; i++){
+                  stride[i] = scene->cbufs[i].stride;
+                  color[i] = lp_rast_get_unswizzled_color_block_pointer(task, i, tile_x + x,
+                                                                        tile_y + y, inputs->layer);
+               }
 
-         /* Propagate non-interpolated raster state. */
-         task->thread_data.raster_state.viewport_index = inputs->viewport_index;
+               /* depth buffer */
+               if (scene->zsbuf.map) {
+                  depth = lp_rast_get_unswizzled_depth_block_pointer(task, tile_x + x,
+                                                                     tile_y + y, inputs->layer);
+                  depth_stride = scene->zsbuf.stride;
+               }
 
-         /* run shader on 4x4 block */
-         BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
-         END_JIT_CALL();
+               /* Propagate non-interpolated raster state. */
+               task->thread_data.raster_state.viewport_index = inputs->viewport_index;
+
+               /* run shader on 4x4 block */
+               BEGIN_JIT_CALL(state, task);
+               variant->jit_function[RAST_WHOLE]( &state->jit_context,
+                                                  tile_x + x, tile_y + y,
+                                                  inputs->frontfacing,
+                                                  GET_A0(inputs),
+                                                  GET_DADX(inputs),
+                                                  GET_DADY(inputs),
+                                                  color,
+                                                  depth,
+                                                  0xffff,
+                                                  &task->thread_data,
+                                                  stride,
+                                                  depth_stride);
+               END_JIT_CALL();
+            }
+         }
+
+         if (task->hiz_valid && variant->hiz_tighten)
+            lp_rast_hiz_tighten(task, inputs, tile_x + bx, tile_y + by);
       }
    }
+
+   END_SHADE_TIMING(task);
 }
 
 
@@ -420,6 +492,8 @@ static void
 lp_rast_shade_tile_opaque(struct lp_rasterizer_task *task,
                           const union lp_rast_cmd_arg arg)
 {
+   const struct lp_scene *scene = task->scene;
+
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    assert(task->state);
@@ -427,6 +501,19 @@ lp_rast_shade_tile_opaque(struct lp_rasterizer_task *task,
       return;
    }
 
+   /* A pending color clear would be overwritten without being read.
+    * Only the first layer is shaded, and there's no depth test to do.
+    */
+   if (task->clear_color &&
+       !arg.shade_tile->disable &&
+       !scene->fb.zsbuf &&
+       scene->fb_max_layer == 0) {
+      task->clear_color = NULL;
+      LP_COUNT(nr_color_tile_clear_skipped);
+   }
+
+   resolve_clears(task);
+
    lp_rast_shade_tile(task, arg);
 }
 
@@ -455,8 +542,8 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    assert(state);
 
    /* Sanity checks */
-   assert(x < scene->tiles_x * TILE_SIZE);
-   assert(y < scene->tiles_y * TILE_SIZE);
+   assert(x < scene->tiles_x * scene->tile_size);
+   assert(y < scene->tiles_y * scene->tile_size);
    assert(x % TILE_VECTOR_WIDTH == 0);
    assert(y % TILE_VECTOR_HEIGHT == 0);
 
@@ -488,7 +575,9 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
     * The rasterizer may produce fragments outside our
     * allocated 4x4 blocks hence need to filter them out here.
     */
-   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+   if (x - task->x < task->width && y - task->y < task->height) {
+      BEGIN_SHADE_TIMING(task);
+
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
@@ -511,6 +600,8 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                                             stride,
                                             depth_stride);
       END_JIT_CALL();
+
+      END_SHADE_TIMING(task);
    }
 }
 
@@ -580,6 +671,9 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
    task->state = arg.state;
+
+   if (task->state->variant->hiz_invalidate)
+      task->hiz_valid = FALSE;
 }
 
 
@@ -596,6 +690,8 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
 
+   resolve_clears(task);
+
    /* debug */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
    task->depth_tile = NULL;
@@ -637,6 +733,27 @@ static lp_rast_cmd_func dispatch[LP_RAST_OP_MAX] =
 };
 
 
+/**
+ * Whether a command reads or writes the tile contents.  Opaque tile
+ * shading deals with the pending clears itself.
+ */
+static INLINE boolean
+cmd_uses_tile(unsigned cmd)
+{
+   switch (cmd) {
+   case LP_RAST_OP_CLEAR_COLOR:
+   case LP_RAST_OP_CLEAR_ZSTENCIL:
+   case LP_RAST_OP_SHADE_TILE_OPAQUE:
+   case LP_RAST_OP_BEGIN_QUERY:
+   case LP_RAST_OP_END_QUERY:
+   case LP_RAST_OP_SET_STATE:
+      return FALSE;
+   default:
+      return TRUE;
+   }
+}
+
+
 static void
 do_rasterize_bin(struct lp_rasterizer_task *task,
                  const struct cmd_bin *bin,
@@ -646,11 +763,19 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
    unsigned k;
 
    if (0)
-      lp_debug_bin(bin, x, y);
+      lp_debug_bin(task->scene, bin, x, y);
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
-         dispatch[block->cmd[k]]( task, block->arg[k] );
+         const unsigned cmd = block->cmd[k];
+
+         /* Commands using the tile contents need the clears first */
+         if ((task->clear_color || task->clear_zsmask) &&
+             cmd_uses_tile(cmd)) {
+            resolve_clears(task);
+         }
+
+         dispatch[cmd]( task, block->arg[k] );
       }
    }
 }
@@ -676,7 +801,7 @@ rasterize_bin(struct lp_rasterizer_task *task,
 
    /* Debug/Perf flags:
     */
-   if (bin->head->count == 1) {
+   if (bin->head && bin->head->count == 1) {
       if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE_OPAQUE)
          LP_COUNT(nr_pure_shade_opaque_64);
       else if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE)
@@ -707,26 +832,38 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   struct lp_scene_timing *timing = &scene->timing;
+   const unsigned thread_index = task->thread_index;
+
    task->scene = scene;
+   task->time_shading = timing->time_shading;
+   task->shade_time = 0;
+
+   timing->rast_start[thread_index] = os_time_get_nano();
 
    if (!task->rast->no_rast && !scene->discard) {
       /* loop over scene bins, rasterize each */
       {
          struct cmd_bin *bin;
+         boolean stolen;
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-            if (!is_empty_bin( bin ))
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                              &i, &j, &stolen))) {
+            if (!is_empty_bin( bin ) || lp_scene_has_clears(scene))
                rasterize_bin(task, bin, i, j);
+
+            timing->nr_bins[thread_index]++;
+            LP_COUNT(nr_thread_bins[thread_index]);
+            if (stolen)
+               LP_COUNT(nr_thread_stolen_bins[thread_index]);
          }
       }
    }
 
-
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
+   timing->shade_time[thread_index] = task->shade_time;
+   timing->rast_end[thread_index] = os_time_get_nano();
 
    task->scene = NULL;
 }
@@ -754,51 +891,473 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 
       rasterize_scene( &rast->tasks[0], scene );
 
-      lp_rast_end( rast );
+      lp_rast_end( rast, scene );
 
-      util_fpstate_set(fpstate);
+      if (scene->fence) {
+         lp_fence_signal(scene->fence);
+      }
 
-      rast->curr_scene = NULL;
+      util_fpstate_set(fpstate);
    }
    else {
       /* threaded rendering! */
-      unsigned i;
+      pipe_mutex_lock(rast->mutex);
 
-      lp_scene_enqueue( rast->full_scenes, scene );
+      scene->rast_next = NULL;
+      *rast->pending_tail = scene;
+      rast->pending_tail = &scene->rast_next;
 
       /* signal the threads that there's work to do */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_signal(&rast->tasks[i].work_ready);
-      }
+      pipe_condvar_broadcast(rast->work_cond);
+
+      pipe_mutex_unlock(rast->mutex);
    }
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
 }
 
 
+static boolean
+scene_uses_resource(const struct lp_scene *scene,
+                    const struct pipe_resource *resource,
+                    boolean reads)
+{
+   unsigned i;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && scene->fb.cbufs[i]->texture == resource)
+         return TRUE;
+   }
+
+   if (scene->fb.zsbuf && scene->fb.zsbuf->texture == resource)
+      return TRUE;
+
+   return reads && lp_scene_is_resource_referenced(scene, resource);
+}
+
+
+/**
+ * Wait until no queued scene, from any context, renders to the given
+ * resource, or also reads it if write is set (i.e. the caller is about
+ * to write it).
+ *
+ * Returns FALSE if it would have to wait but do_not_block is set.
+ */
+boolean
+lp_rast_wait_resource( struct lp_rasterizer *rast,
+                       const struct pipe_resource *resource,
+                       boolean write,
+                       boolean do_not_block )
+{
+   boolean ret = TRUE;
+
+   if (rast->num_threads == 0) {
+      /* rendering is synchronous */
+      return TRUE;
+   }
+
+   pipe_mutex_lock(rast->mutex);
+
+   for (;;) {
+      const struct lp_scene *scene;
+      boolean busy = FALSE;
+      unsigned i;
+
+      for (i = 0; i < rast->num_active && !busy; i++) {
+         busy = scene_uses_resource(rast->active[i], resource, write);
+      }
+      for (scene = rast->pending_head; scene && !busy;
+           scene = scene->rast_next) {
+         busy = scene_uses_resource(scene, resource, write);
+      }
+
+      if (!busy)
+         break;
+
+      if (do_not_block) {
+         ret = FALSE;
+         break;
+      }
+
+      pipe_condvar_wait(rast->done_cond, rast->mutex);
+   }
+
+   pipe_mutex_unlock(rast->mutex);
+
+   return ret;
+}
+
+
+/**
+ * Run items of the job until there are none left.
+ */
+static void
+run_job_items(struct lp_rast_job *job, unsigned thread_index)
+{
+   for (;;) {
+      int32_t item = p_atomic_read(&job->next_item);
+
+      if (item >= (int32_t)job->num_items)
+         break;
+
+      if (p_atomic_cmpxchg(&job->next_item, item, item + 1) == item)
+         job->run(job->data, thread_index, item);
+   }
+}
+
+
+unsigned
+lp_rast_num_threads( const struct lp_rasterizer *rast )
+{
+   return rast->num_threads;
+}
+
+
+/**
+ * Run all items of the job, on the calling thread and on the rasterizer
+ * threads not busy with scenes.  Returns once all items are done.  The
+ * calling thread runs its items with thread_index num_threads.
+ */
 void
-lp_rast_finish( struct lp_rasterizer *rast )
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 struct lp_rast_job *job )
 {
+   unsigned fpstate = util_fpstate_get();
+
+   /* Run the items with the FP state of the rasterizer threads */
+   util_fpstate_set_denorms_to_zero(fpstate);
+
+   job->next_item = 0;
+
    if (rast->num_threads == 0) {
-      /* nothing to do */
+      run_job_items(job, 0);
+      util_fpstate_set(fpstate);
+      return;
+   }
+
+   pipe_mutex_lock(rast->mutex);
+
+   /* one job at a time, across contexts */
+   while (rast->job)
+      pipe_condvar_wait(rast->done_cond, rast->mutex);
+
+   rast->job = job;
+   pipe_condvar_broadcast(rast->work_cond);
+   pipe_mutex_unlock(rast->mutex);
+
+   run_job_items(job, rast->num_threads);
+
+   /* All items are handed out now, wait for those still running */
+   pipe_mutex_lock(rast->mutex);
+   while (rast->job_workers)
+      pipe_condvar_wait(rast->done_cond, rast->mutex);
+   rast->job = NULL;
+   pipe_condvar_broadcast(rast->done_cond);
+   pipe_mutex_unlock(rast->mutex);
+
+   util_fpstate_set(fpstate);
+}
+
+
+#if defined(PIPE_OS_LINUX) && defined(HAVE_PTHREAD)
+
+#include <sched.h>
+
+/**
+ * Parse a sysfs CPU or node list such as "0-15,32-47" and append the
+ * numbers to the cpus[] array.
+ */
+static unsigned
+parse_cpu_list(const char *list, int *cpus, unsigned num_cpus,
+               unsigned max_cpus)
+{
+   const char *p = list;
+
+   while (*p && *p != '\n') {
+      char *end;
+      long first, last, cpu;
+
+      first = strtol(p, &end, 10);
+      if (end == p)
+         break;
+      last = first;
+      p = end;
+      if (*p == '-') {
+         p++;
+         last = strtol(p, &end, 10);
+         if (end == p)
+            break;
+         p = end;
+      }
+      for (cpu = first; cpu <= last && num_cpus < max_cpus; cpu++)
+         cpus[num_cpus++] = (int) cpu;
+      if (*p == ',')
+         p++;
+   }
+
+   return num_cpus;
+}
+
+
+/**
+ * Read a sysfs list file, returning the number of entries.
+ */
+static unsigned
+read_cpu_list(const char *path, int *cpus, unsigned max_cpus)
+{
+   char list[1024];
+   FILE *f;
+
+   f = fopen(path, "r");
+   if (!f)
+      return 0;
+   if (!fgets(list, sizeof list, f))
+      list[0] = 0;
+   fclose(f);
+
+   return parse_cpu_list(list, cpus, 0, max_cpus);
+}
+
+
+#define LP_MAX_NUMA_NODES 16
+#define LP_MAX_NUMA_CPUS 1024
+
+/**
+ * Decide which CPU each rasterizer thread should be pinned to, according
+ * to the LP_THREAD_PLACEMENT policy:
+ *
+ *  - "none" (default): threads float freely.
+ *  - "compact": fill the CPUs of one NUMA node before moving to the next,
+ *    so that a small number of threads shares a single memory controller
+ *    and last level cache.
+ *  - "scatter": distribute threads round-robin across the NUMA nodes, to
+ *    maximize the aggregate memory bandwidth.
+ *
+ * Pinning the threads also means memory first touched by a rasterizer
+ * thread (e.g. the framebuffer tiles it renders) is allocated on the
+ * thread's local node by the kernel's default first-touch policy.  The
+ * scene's bin data is written by the setup thread, so it stays on that
+ * thread's node.
+ */
+static void
+compute_thread_placement(struct lp_rasterizer *rast)
+{
+   int (*node_cpus)[LP_MAX_NUMA_CPUS];
+   unsigned num_node_cpus[LP_MAX_NUMA_NODES];
+   int online[LP_MAX_NUMA_NODES];
+   unsigned num_online, num_nodes = 0;
+   const char *policy;
+   boolean scatter;
+   unsigned i, node;
+
+   policy = debug_get_option("LP_THREAD_PLACEMENT", "none");
+   if (strcmp(policy, "compact") == 0)
+      scatter = FALSE;
+   else if (strcmp(policy, "scatter") == 0)
+      scatter = TRUE;
+   else
+      return;
+
+   node_cpus = MALLOC(LP_MAX_NUMA_NODES * sizeof *node_cpus);
+   if (!node_cpus)
+      return;
+
+   /* Node numbers can have gaps, so go by the list of online nodes.
+    * Nodes without CPUs (memory only) are left out.
+    */
+   num_online = read_cpu_list("/sys/devices/system/node/online",
+                              online, LP_MAX_NUMA_NODES);
+   for (i = 0; i < num_online; i++) {
+      char path[64];
+
+      util_snprintf(path, sizeof path,
+                    "/sys/devices/system/node/node%d/cpulist", online[i]);
+      num_node_cpus[num_nodes] = read_cpu_list(path, node_cpus[num_nodes],
+                                               LP_MAX_NUMA_CPUS);
+      if (num_node_cpus[num_nodes])
+         num_nodes++;
+   }
+
+   if (num_nodes == 0) {
+      /* No NUMA information -- treat all CPUs as a single node */
+      num_nodes = 1;
+      num_node_cpus[0] = MIN2(util_cpu_caps.nr_cpus, LP_MAX_NUMA_CPUS);
+      for (i = 0; i < num_node_cpus[0]; i++)
+         node_cpus[0][i] = i;
+   }
+
+   if (scatter) {
+      unsigned slot = 0;
+
+      i = 0;
+      while (i < rast->num_threads) {
+         boolean any = FALSE;
+         for (node = 0; node < num_nodes && i < rast->num_threads; node++) {
+            if (slot < num_node_cpus[node]) {
+               rast->tasks[i++].cpu = node_cpus[node][slot];
+               any = TRUE;
+            }
+         }
+         if (!any) {
+            /* more threads than CPUs -- wrap around */
+            slot = 0;
+         }
+         else {
+            slot++;
+         }
+      }
    }
    else {
-      int i;
+      unsigned slot = 0;
 
-      /* wait for work to complete */
+      node = 0;
       for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
+         while (slot >= num_node_cpus[node]) {
+            slot = 0;
+            node = (node + 1) % num_nodes;
+         }
+         rast->tasks[i].cpu = node_cpus[node][slot++];
+      }
+   }
+
+   FREE(node_cpus);
+
+   if (LP_DEBUG & DEBUG_RAST) {
+      for (i = 0; i < rast->num_threads; i++)
+         debug_printf("llvmpipe: rasterizer thread %u on cpu %d\n",
+                      i, rast->tasks[i].cpu);
+   }
+}
+
+
+static void
+pin_thread(const struct lp_rasterizer_task *task)
+{
+   cpu_set_t set;
+
+   if (task->cpu < 0)
+      return;
+
+   CPU_ZERO(&set);
+   CPU_SET(task->cpu, &set);
+   if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0)
+      debug_printf("llvmpipe: failed to pin thread %u to cpu %d\n",
+                   task->thread_index, task->cpu);
+}
+
+#else
+
+static void
+compute_thread_placement(struct lp_rasterizer *rast)
+{
+}
+
+static void
+pin_thread(const struct lp_rasterizer_task *task)
+{
+}
+
+#endif
+
+
+/**
+ * Move pending scenes to the active list.  Scenes of a context are
+ * rasterized in the order they were queued, one at a time, but scenes of
+ * different contexts are rasterized concurrently.
+ * Called with the rasterizer mutex held.
+ */
+static void
+activate_pending_scenes(struct lp_rasterizer *rast)
+{
+   struct lp_scene **prev = &rast->pending_head;
+   struct lp_scene *scene;
+
+   while ((scene = *prev) != NULL &&
+          rast->num_active < Elements(rast->active)) {
+      boolean context_active = FALSE;
+      unsigned i;
+
+      for (i = 0; i < rast->num_active; i++) {
+         if (rast->active[i]->pipe == scene->pipe) {
+            context_active = TRUE;
+            break;
+         }
       }
+
+      if (context_active) {
+         prev = &scene->rast_next;
+         continue;
+      }
+
+      /* unlink from the pending list */
+      *prev = scene->rast_next;
+      if (rast->pending_tail == &scene->rast_next)
+         rast->pending_tail = prev;
+      scene->rast_next = NULL;
+
+      lp_rast_begin(rast, scene);
+      rast->active[rast->num_active++] = scene;
    }
 }
 
 
+/**
+ * Pick an active scene for a thread to work on.  Threads are spread
+ * evenly over the active scenes, so that the thread pool is shared fairly
+ * between contexts.
+ * Called with the rasterizer mutex held.
+ */
+static struct lp_scene *
+get_next_scene(struct lp_rasterizer *rast)
+{
+   struct lp_scene *best = NULL;
+   unsigned i;
+
+   activate_pending_scenes(rast);
+
+   for (i = 0; i < rast->num_active; i++) {
+      struct lp_scene *scene = rast->active[i];
+      if (!scene->rast_exhausted &&
+          (!best || scene->rast_workers < best->rast_workers)) {
+         best = scene;
+      }
+   }
+
+   return best;
+}
+
+
+/**
+ * Called by the last thread leaving a scene with no bins left.
+ * Called with the rasterizer mutex held.
+ */
+static void
+finish_scene(struct lp_rasterizer *rast, struct lp_scene *scene)
+{
+   unsigned i;
+
+   lp_rast_end(rast, scene);
+
+   for (i = 0; i < rast->num_active; i++) {
+      if (rast->active[i] == scene) {
+         rast->active[i] = rast->active[--rast->num_active];
+         break;
+      }
+   }
+
+   /* The next scene of this context may now be activated */
+   pipe_condvar_broadcast(rast->work_cond);
+   pipe_condvar_broadcast(rast->done_cond);
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
- *   1. wait for work
- *   2. do work
- *   3. signal that we're done
+ *   1. pick a scene with bins left to rasterize, or wait for one
+ *   2. rasterize bins of the scene until there are none left
+ *   3. if we're the last thread in the scene, signal its fence
+ * Items of a job, if any, are run before picking a scene.
  */
 static PIPE_THREAD_ROUTINE( thread_function, init_data )
 {
@@ -812,58 +1371,95 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
     */
    util_fpstate_set_denorms_to_zero(fpstate);
 
+   pin_thread(task);
+
+   pipe_mutex_lock(rast->mutex);
+
    while (1) {
-      /* wait for work */
-      if (debug)
-         debug_printf("thread %d waiting for work\n", task->thread_index);
-      pipe_semaphore_wait(&task->work_ready);
+      struct lp_scene *scene;
+      struct lp_fence *fence = NULL;
 
       if (rast->exit_flag)
          break;
 
-      if (task->thread_index == 0) {
-         /* thread[0]:
-          *  - get next scene to rasterize
-          *  - map the framebuffer surfaces
-          */
-         lp_rast_begin( rast, 
-                        lp_scene_dequeue( rast->full_scenes, TRUE ) );
+      if (rast->job &&
+          rast->job->next_item < (int32_t)rast->job->num_items) {
+         struct lp_rast_job *job = rast->job;
+
+         rast->job_workers++;
+         pipe_mutex_unlock(rast->mutex);
+
+         run_job_items(job, task->thread_index);
+
+         pipe_mutex_lock(rast->mutex);
+         if (--rast->job_workers == 0)
+            pipe_condvar_broadcast(rast->done_cond);
+         continue;
       }
 
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
-       */
-      pipe_barrier_wait( &rast->barrier );
+      scene = get_next_scene(rast);
+      if (!scene) {
+         /* wait for work */
+         if (debug)
+            debug_printf("thread %d waiting for work\n", task->thread_index);
+         {
+            int64_t start = os_time_get_nano();
+            int64_t end;
+
+            pipe_condvar_wait(rast->work_cond, rast->mutex);
+
+            end = os_time_get_nano();
+            LP_COUNT_ADD(thread_idle_time[task->thread_index],
+                         (end - start) / 1000);
+            lp_trace_event("idle", LP_TRACE_TID_RAST(task->thread_index),
+                           start, end, NULL);
+         }
+         continue;
+      }
+
+      scene->rast_workers++;
+      pipe_mutex_unlock(rast->mutex);
 
       /* do work */
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task,
-                      rast->curr_scene);
-      
-      /* wait for all threads to finish with this scene */
-      pipe_barrier_wait( &rast->barrier );
+      rasterize_scene(task, scene);
 
-      /* XXX: shouldn't be necessary:
-       */
-      if (task->thread_index == 0) {
-         lp_rast_end( rast );
-      }
+      pipe_mutex_lock(rast->mutex);
 
-      /* signal done with work */
-      if (debug)
-         debug_printf("thread %d done working\n", task->thread_index);
+      /* No bins were left for us, so none are left for anybody else */
+      scene->rast_exhausted = TRUE;
+
+      if (--scene->rast_workers == 0) {
+         finish_scene(rast, scene);
+
+         /* Signal the fence last: the setup module may reuse the scene as
+          * soon as it is signalled.
+          */
+         lp_fence_reference(&fence, scene->fence);
+         pipe_mutex_unlock(rast->mutex);
+
+         if (fence) {
+            lp_fence_signal(fence);
+            lp_fence_reference(&fence, NULL);
+         }
+
+         if (debug)
+            debug_printf("thread %d done with scene\n", task->thread_index);
 
-      pipe_semaphore_signal(&task->work_done);
+         pipe_mutex_lock(rast->mutex);
+      }
    }
 
+   pipe_mutex_unlock(rast->mutex);
+
    return 0;
 }
 
 
 /**
- * Initialize semaphores and spawn the threads.
+ * Spawn the threads.
  */
 static void
 create_rast_threads(struct lp_rasterizer *rast)
@@ -872,8 +1468,6 @@ create_rast_threads(struct lp_rasterizer *rast)
 
    /* NOTE: if num_threads is zero, we won't use any threads */
    for (i = 0; i < rast->num_threads; i++) {
-      pipe_semaphore_init(&rast->tasks[i].work_ready, 0);
-      pipe_semaphore_init(&rast->tasks[i].work_done, 0);
       rast->threads[i] = pipe_thread_create(thread_function,
                                             (void *) &rast->tasks[i]);
    }
@@ -890,41 +1484,49 @@ struct lp_rasterizer *
 lp_rast_create( unsigned num_threads )
 {
    struct lp_rasterizer *rast;
+   const struct lp_rast_tri_funcs *tri_funcs;
    unsigned i;
 
    rast = CALLOC_STRUCT(lp_rasterizer);
    if (!rast) {
-      goto no_rast;
+      return NULL;
    }
 
-   rast->full_scenes = lp_scene_queue_create();
-   if (!rast->full_scenes) {
-      goto no_full_scenes;
-   }
+   pipe_mutex_init(rast->mutex);
+   pipe_condvar_init(rast->work_cond);
+   pipe_condvar_init(rast->done_cond);
+   rast->pending_tail = &rast->pending_head;
 
    for (i = 0; i < Elements(rast->tasks); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
+      task->cpu = -1;
    }
 
    rast->num_threads = num_threads;
 
+   compute_thread_placement(rast);
+
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
-   create_rast_threads(rast);
+   /* The edge mask vector width doesn't change the rasterized pixels, so
+    * the triangle commands are patched in the (shared) dispatch table.
+    */
+   tri_funcs = lp_rast_choose_tri_funcs();
+   for (i = 0; i < Elements(tri_funcs->tri); i++) {
+      dispatch[LP_RAST_OP_TRIANGLE_1 + i] = tri_funcs->tri[i];
+      dispatch[LP_RAST_OP_TRIANGLE_32_1 + i] = tri_funcs->tri_32[i];
+   }
+
+   if (LP_DEBUG & DEBUG_RAST)
+      debug_printf("llvmpipe: %s triangle edge masks\n", tri_funcs->name);
 
-   /* for synchronizing rasterization threads */
-   pipe_barrier_init( &rast->barrier, rast->num_threads );
+   create_rast_threads(rast);
 
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
 
    return rast;
-
-no_full_scenes:
-   FREE(rast);
-no_rast:
-   return NULL;
 }
 
 
@@ -934,32 +1536,26 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 {
    unsigned i;
 
-   /* Set exit_flag and signal each thread's work_ready semaphore.
-    * Each thread will be woken up, notice that the exit_flag is set and
-    * break out of its main loop.  The thread will then exit.
+   /* Set exit_flag and wake up all the threads.
+    * Each thread will notice that the exit_flag is set and break out of
+    * its main loop.  The thread will then exit.
     */
+   pipe_mutex_lock(rast->mutex);
    rast->exit_flag = TRUE;
-   for (i = 0; i < rast->num_threads; i++) {
-      pipe_semaphore_signal(&rast->tasks[i].work_ready);
-   }
+   pipe_condvar_broadcast(rast->work_cond);
+   pipe_mutex_unlock(rast->mutex);
 
    /* Wait for threads to terminate before cleaning up per-thread data */
    for (i = 0; i < rast->num_threads; i++) {
       pipe_thread_wait(rast->threads[i]);
    }
 
-   /* Clean up per-thread data */
-   for (i = 0; i < rast->num_threads; i++) {
-      pipe_semaphore_destroy(&rast->tasks[i].work_ready);
-      pipe_semaphore_destroy(&rast->tasks[i].work_done);
-   }
-
-   /* for synchronizing rasterization threads */
-   pipe_barrier_destroy( &rast->barrier );
+   assert(rast->pending_head == NULL);
+   assert(rast->num_active == 0);
 
-   lp_scene_queue_destroy(rast->full_scenes);
+   pipe_condvar_destroy(rast->done_cond);
+   pipe_condvar_destroy(rast->work_cond);
+   pipe_mutex_destroy(rast->mutex);
 
    FREE(rast);
 }
-
-
@@ -153,8 +153,43 @@ void
 lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
+boolean
+lp_rast_wait_resource( struct lp_rasterizer *rast,
+                       const struct pipe_resource *resource,
+                       boolean write,
+                       boolean do_not_block );
+
+
+/**
+ * A job of independent items, such as the blocks of a compute grid, run
+ * by the rasterizer threads in between scenes.
+ */
+struct lp_rast_job
+{
+   /** Run one item; thread_index is in [0, num_threads] */
+   void (*run)(void *data, unsigned thread_index, unsigned item);
+   void *data;
+   unsigned num_items;
+
+   /** Next item to hand out */
+   int32_t next_item;
+};
+
+unsigned
+lp_rast_num_threads( const struct lp_rasterizer *rast );
+
 void
-lp_rast_finish( struct lp_rasterizer *rast );
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 struct lp_rast_job *job );
+
+
+/**
+ * The clear color of each color buffer, packed in the buffer's format.
+ * Packed once by setup, so that tiles are cleared with plain fills.
+ */
+struct lp_rast_clear_color {
+   uint8_t packed[PIPE_MAX_COLOR_BUFS][16];
+};
 
 
 union lp_rast_cmd_arg {
@@ -164,7 +199,7 @@ union lp_rast_cmd_arg {
       unsigned plane_mask;
    } triangle;
    const struct lp_rast_state *set_state;
-   union pipe_color_union clear_color;
+   const struct lp_rast_clear_color *clear_color;
    struct {
       uint64_t value;
       uint64_t mask;
@@ -228,6 +263,15 @@ lp_rast_arg_fence( struct lp_fence *fence )
 }
 
 
+static INLINE union lp_rast_cmd_arg
+lp_rast_arg_clear_color( const struct lp_rast_clear_color *clear_color )
+{
+   union lp_rast_cmd_arg arg;
+   arg.clear_color = clear_color;
+   return arg;
+}
+
+
 static INLINE union lp_rast_cmd_arg
 lp_rast_arg_clearzs( uint64_t value, uint64_t mask )
 {
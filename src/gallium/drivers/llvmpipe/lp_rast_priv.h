@@ -29,7 +29,9 @@
 #define LP_RAST_PRIV_H
 
 #include "os/os_thread.h"
+#include "os/os_time.h"
 #include "util/u_format.h"
+#include "util/u_math.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
 #include "lp_rast.h"
@@ -76,6 +78,17 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/* Time the shader calls between these, when the scene asks for it */
+#define BEGIN_SHADE_TIMING(task) \
+   int64_t shade_start = (task)->time_shading ? os_time_get_nano() : 0
+
+#define END_SHADE_TIMING(task) \
+   do { \
+      if ((task)->time_shading) \
+         (task)->shade_time += os_time_get_nano() - shade_start; \
+   } while (0)
+
 /**
  * Per-thread rasterization state
  */
@@ -91,46 +104,82 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /**
+    * Clears of the tile which weren't written yet.  They're written
+    * before the first command using the tile contents, or at the end of
+    * the tile, and color clears are dropped when the tile is overwritten.
+    */
+   const struct lp_rast_clear_color *clear_color;  /**< or NULL */
+   uint64_t clear_zsvalue;
+   uint64_t clear_zsmask;                          /**< or 0 */
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
    /** "my" index */
    unsigned thread_index;
 
+   /** CPU the thread is pinned to, or -1 to let it float */
+   int cpu;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
-   pipe_semaphore work_ready;
-   pipe_semaphore work_done;
+   /** Time spent in the fragment shader, if the scene times shading */
+   boolean time_shading;
+   int64_t shade_time;
+
+   /**
+    * Hierarchical Z: upper bounds of the depth values in the 16x16 blocks
+    * of the tile.  They are only known after a depth clear of the tile in
+    * the current scene, are lowered as opaque triangles cover whole blocks,
+    * and are lost when a shader may raise depth values.
+    */
+   boolean hiz_valid;
+   boolean hiz_unorm;      /**< depth values are clamped to [0,1] */
+   float hiz_epsilon;      /**< depth buffer precision */
+   float hiz_zmax[LP_MAX_TILE_SIZE / 16][LP_MAX_TILE_SIZE / 16];
 };
 
 
 /**
  * This is the state required while rasterizing tiles.
  * Note that this contains per-thread information too.
- * The tile size is TILE_SIZE x TILE_SIZE pixels.
+ * The tile size is chosen per scene (see lp_scene::tile_size).
  */
 struct lp_rasterizer
 {
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
 
-   /** The incoming queue of scenes ready to rasterize */
-   struct lp_scene_queue *full_scenes;
+   /** Protects the scene lists below */
+   pipe_mutex mutex;
+
+   /** Signalled when a scene is queued, or a context becomes idle */
+   pipe_condvar work_cond;
+
+   /** Signalled when a scene is done */
+   pipe_condvar done_cond;
+
+   /** The incoming queue of scenes ready to rasterize, from all contexts */
+   struct lp_scene *pending_head;
+   struct lp_scene **pending_tail;
+
+   /** The scenes currently being rasterized, at most one per context */
+   struct lp_scene *active[LP_MAX_THREADS];
+   unsigned num_active;
 
-   /** The scene currently being rasterized by the threads */
-   struct lp_scene *curr_scene;
+   /** The job being run, and the number of threads running its items */
+   struct lp_rast_job *job;
+   unsigned job_workers;
 
    /** A task object for each rasterization thread */
    struct lp_rasterizer_task tasks[LP_MAX_THREADS];
 
    unsigned num_threads;
    pipe_thread threads[LP_MAX_THREADS];
-
-   /** For synchronizing the rasterization threads */
-   pipe_barrier barrier;
 };
 
 
@@ -152,10 +201,10 @@ lp_rast_get_unswizzled_color_tile_pointer(struct lp_rasterizer_task *task,
    const struct lp_scene *scene = task->scene;
    unsigned format_bytes;
 
-   assert(task->x < scene->tiles_x * TILE_SIZE);
-   assert(task->y < scene->tiles_y * TILE_SIZE);
-   assert(task->x % TILE_SIZE == 0);
-   assert(task->y % TILE_SIZE == 0);
+   assert(task->x < scene->tiles_x * scene->tile_size);
+   assert(task->y < scene->tiles_y * scene->tile_size);
+   assert(task->x % scene->tile_size == 0);
+   assert(task->y % scene->tile_size == 0);
    assert(buf < scene->fb.nr_cbufs);
 
    if (!task->color_tiles[buf]) {
@@ -180,10 +229,10 @@ lp_rast_get_unswizzled_depth_tile_pointer(struct lp_rasterizer_task *task,
    const struct lp_scene *scene = task->scene;
    unsigned format_bytes;
 
-   assert(task->x < scene->tiles_x * TILE_SIZE);
-   assert(task->y < scene->tiles_y * TILE_SIZE);
-   assert(task->x % TILE_SIZE == 0);
-   assert(task->y % TILE_SIZE == 0);
+   assert(task->x < scene->tiles_x * scene->tile_size);
+   assert(task->y < scene->tiles_y * scene->tile_size);
+   assert(task->x % scene->tile_size == 0);
+   assert(task->y % scene->tile_size == 0);
 
    if (!task->depth_tile) {
       struct pipe_surface *dbuf = scene->fb.zsbuf;
@@ -198,7 +247,7 @@ lp_rast_get_unswizzled_depth_tile_pointer(struct lp_rasterizer_task *task,
 
 
 /**
- * Get the pointer to an unswizzled 4x4 color block (within an unswizzled 64x64 tile).
+ * Get the pointer to an unswizzled 4x4 color block (within an unswizzled tile).
  * \param x, y location of 4x4 block in window coords
  */
 static INLINE uint8_t *
@@ -209,8 +258,8 @@ lp_rast_get_unswizzled_color_block_pointer(struct lp_rasterizer_task *task,
    unsigned px, py, pixel_offset, format_bytes;
    uint8_t *color;
 
-   assert(x < task->scene->tiles_x * TILE_SIZE);
-   assert(y < task->scene->tiles_y * TILE_SIZE);
+   assert(x < task->scene->tiles_x * task->scene->tile_size);
+   assert(y < task->scene->tiles_y * task->scene->tile_size);
    assert((x % TILE_VECTOR_WIDTH) == 0);
    assert((y % TILE_VECTOR_HEIGHT) == 0);
    assert(buf < task->scene->fb.nr_cbufs);
@@ -220,8 +269,8 @@ lp_rast_get_unswizzled_color_block_pointer(struct lp_rasterizer_task *task,
    color = lp_rast_get_unswizzled_color_tile_pointer(task, buf, LP_TEX_USAGE_READ_WRITE);
    assert(color);
 
-   px = x % TILE_SIZE;
-   py = y % TILE_SIZE;
+   px = x - task->x;
+   py = y - task->y;
    pixel_offset = px * format_bytes + py * task->scene->cbufs[buf].stride;
 
    color = color + pixel_offset;
@@ -236,7 +285,7 @@ lp_rast_get_unswizzled_color_block_pointer(struct lp_rasterizer_task *task,
 
 
 /**
- * Get the pointer to an unswizzled 4x4 depth block (within an unswizzled 64x64 tile).
+ * Get the pointer to an unswizzled 4x4 depth block (within an unswizzled tile).
  * \param x, y location of 4x4 block in window coords
  */
 static INLINE uint8_t *
@@ -246,8 +295,8 @@ lp_rast_get_unswizzled_depth_block_pointer(struct lp_rasterizer_task *task,
    unsigned px, py, pixel_offset, format_bytes;
    uint8_t *depth;
 
-   assert(x < task->scene->tiles_x * TILE_SIZE);
-   assert(y < task->scene->tiles_y * TILE_SIZE);
+   assert(x < task->scene->tiles_x * task->scene->tile_size);
+   assert(y < task->scene->tiles_y * task->scene->tile_size);
    assert((x % TILE_VECTOR_WIDTH) == 0);
    assert((y % TILE_VECTOR_HEIGHT) == 0);
 
@@ -256,8 +305,8 @@ lp_rast_get_unswizzled_depth_block_pointer(struct lp_rasterizer_task *task,
    depth = lp_rast_get_unswizzled_depth_tile_pointer(task, LP_TEX_USAGE_READ_WRITE);
    assert(depth);
 
-   px = x % TILE_SIZE;
-   py = y % TILE_SIZE;
+   px = x - task->x;
+   py = y - task->y;
    pixel_offset = px * format_bytes + py * task->scene->zsbuf.stride;
 
    depth = depth + pixel_offset;
@@ -272,6 +321,90 @@ lp_rast_get_unswizzled_depth_block_pointer(struct lp_rasterizer_task *task,
 
 
 
+/**
+ * Compute the depth range of a triangle over a 16x16 block, as seen by the
+ * depth test of the fragment shader.  The range is widened to account for
+ * the rounding errors of interpolation and conversion to the depth format.
+ * \param x, y location of 16x16 block in window coords
+ */
+static INLINE void
+lp_rast_hiz_block_range(const struct lp_rasterizer_task *task,
+                        const struct lp_rast_shader_inputs *inputs,
+                        int x, int y,
+                        float *zmin, float *zmax)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float z = a0 + dzdx * x + dzdy * y;
+   const float err = task->hiz_epsilon +
+      (fabsf(a0) + fabsf(dzdx * x) + fabsf(dzdy * y)) * 4.0f * FLT_EPSILON;
+   float lo = z + MIN2(dzdx * 16.0f, 0.0f) + MIN2(dzdy * 16.0f, 0.0f) - err;
+   float hi = z + MAX2(dzdx * 16.0f, 0.0f) + MAX2(dzdy * 16.0f, 0.0f) + err;
+
+   if (task->state->variant->key.depth_clamp) {
+      const struct lp_jit_viewport *vp =
+         &task->state->jit_context.viewports[inputs->viewport_index];
+      lo = CLAMP(lo, vp->min_depth, vp->max_depth);
+      hi = CLAMP(hi, vp->min_depth, vp->max_depth);
+   }
+
+   if (task->hiz_unorm) {
+      lo = CLAMP(lo, 0.0f, 1.0f);
+      hi = CLAMP(hi, 0.0f, 1.0f);
+   }
+
+   *zmin = lo;
+   *zmax = hi;
+}
+
+
+/**
+ * Return which of the 16x16 blocks in block_mask, within the 64x64 block
+ * at x, y, a triangle fails the depth test everywhere in.
+ * \param x, y location of 64x64 block in window coords
+ */
+static INLINE unsigned
+lp_rast_hiz_cull(const struct lp_rasterizer_task *task,
+                 const struct lp_rast_shader_inputs *inputs,
+                 int x, int y,
+                 unsigned block_mask)
+{
+   unsigned culled = 0;
+
+   while (block_mask) {
+      int i = u_bit_scan(&block_mask);
+      int bx = x + (i & 3) * 16;
+      int by = y + (i >> 2) * 16;
+      float zmin, zmax;
+
+      lp_rast_hiz_block_range(task, inputs, bx, by, &zmin, &zmax);
+      if (zmin > task->hiz_zmax[(by - task->y) / 16][(bx - task->x) / 16])
+         culled |= 1 << i;
+   }
+
+   return culled;
+}
+
+
+/**
+ * Lower the depth bound of a 16x16 block after a triangle covering it was
+ * shaded with a state which has hiz_tighten set.
+ * \param x, y location of 16x16 block in window coords
+ */
+static INLINE void
+lp_rast_hiz_tighten(struct lp_rasterizer_task *task,
+                    const struct lp_rast_shader_inputs *inputs,
+                    int x, int y)
+{
+   float *bound = &task->hiz_zmax[(y - task->y) / 16][(x - task->x) / 16];
+   float zmin, zmax;
+
+   lp_rast_hiz_block_range(task, inputs, x, y, &zmin, &zmax);
+   *bound = MIN2(*bound, zmax);
+}
+
+
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
  * triangle in/out tests.
@@ -313,7 +446,9 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
     * The rasterizer may produce fragments outside our
     * allocated 4x4 blocks hence need to filter them out here.
     */
-   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+   if (x - task->x < task->width && y - task->y < task->height) {
+      BEGIN_SHADE_TIMING(task);
+
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
@@ -336,9 +471,44 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
                                          stride,
                                          depth_stride);
       END_JIT_CALL();
+
+      END_SHADE_TIMING(task);
    }
 }
 
+
+/**
+ * Shade all pixels in a 4x4 block.
+ */
+static INLINE void
+lp_rast_block_full_4(struct lp_rasterizer_task *task,
+                     const struct lp_rast_triangle *tri,
+                     int x, int y)
+{
+   lp_rast_shade_quads_all(task, &tri->inputs, x, y);
+}
+
+
+/**
+ * Shade all pixels in a 16x16 block.
+ */
+static INLINE void
+lp_rast_block_full_16(struct lp_rasterizer_task *task,
+                      const struct lp_rast_triangle *tri,
+                      int x, int y)
+{
+   unsigned ix, iy;
+   assert(x % 16 == 0);
+   assert(y % 16 == 0);
+   for (iy = 0; iy < 16; iy += 4)
+      for (ix = 0; ix < 16; ix += 4)
+         lp_rast_block_full_4(task, tri, x + ix, y + iy);
+
+   if (task->hiz_valid && task->state->variant->hiz_tighten)
+      lp_rast_hiz_tighten(task, &tri->inputs, x, y);
+}
+
+
 void lp_rast_triangle_1( struct lp_rasterizer_task *, 
                          const union lp_rast_cmd_arg );
 void lp_rast_triangle_2( struct lp_rasterizer_task *, 
@@ -392,11 +562,38 @@ void lp_rast_triangle_32_3_16( struct lp_rasterizer_task *,
 void lp_rast_triangle_32_4_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
+
+/**
+ * The triangle rasterization commands whose edge masks are built with a
+ * given instruction set.
+ */
+struct lp_rast_tri_funcs
+{
+   const char *name;
+   lp_rast_cmd_func tri[8];      /**< LP_RAST_OP_TRIANGLE_1..8 */
+   lp_rast_cmd_func tri_32[8];   /**< LP_RAST_OP_TRIANGLE_32_1..8 */
+};
+
+extern const struct lp_rast_tri_funcs lp_rast_tri_funcs_default;
+
+/* NULL when the AVX2/AVX-512 variants weren't compiled; callers also
+ * check util_cpu_caps.
+ */
+const struct lp_rast_tri_funcs *
+lp_rast_tri_funcs_avx2(void);
+
+const struct lp_rast_tri_funcs *
+lp_rast_tri_funcs_avx512(void);
+
+const struct lp_rast_tri_funcs *
+lp_rast_choose_tri_funcs(void);
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
  
 void
-lp_debug_bin( const struct cmd_bin *bin, int x, int y );
+lp_debug_bin( const struct lp_scene *scene,
+              const struct cmd_bin *bin, int x, int y );
 
 #endif
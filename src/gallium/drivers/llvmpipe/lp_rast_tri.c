@@ -31,38 +31,11 @@
 
 #include <limits.h>
 #include "util/u_math.h"
+#include "util/u_cpu_detect.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 #include "lp_rast_priv.h"
 
-/**
- * Shade all pixels in a 4x4 block.
- */
-static void
-block_full_4(struct lp_rasterizer_task *task,
-             const struct lp_rast_triangle *tri,
-             int x, int y)
-{
-   lp_rast_shade_quads_all(task, &tri->inputs, x, y);
-}
-
-
-/**
- * Shade all pixels in a 16x16 block.
- */
-static void
-block_full_16(struct lp_rasterizer_task *task,
-              const struct lp_rast_triangle *tri,
-              int x, int y)
-{
-   unsigned ix, iy;
-   assert(x % 16 == 0);
-   assert(y % 16 == 0);
-   for (iy = 0; iy < 16; iy += 4)
-      for (ix = 0; ix < 16; ix += 4)
-	 block_full_4(task, tri, x + ix, y + iy);
-}
-
 static INLINE unsigned
 build_mask_linear(int64_t c, int64_t dcdx, int64_t dcdy)
 {
@@ -556,3 +529,54 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
 #define NR_PLANES 8
 #include "lp_rast_tri_tmp.h"
 
+
+
+const struct lp_rast_tri_funcs lp_rast_tri_funcs_default = {
+#if defined(PIPE_ARCH_SSE)
+   "sse2",
+#else
+   "c",
+#endif
+   {
+      lp_rast_triangle_1,
+      lp_rast_triangle_2,
+      lp_rast_triangle_3,
+      lp_rast_triangle_4,
+      lp_rast_triangle_5,
+      lp_rast_triangle_6,
+      lp_rast_triangle_7,
+      lp_rast_triangle_8
+   },
+   {
+      lp_rast_triangle_32_1,
+      lp_rast_triangle_32_2,
+      lp_rast_triangle_32_3,
+      lp_rast_triangle_32_4,
+      lp_rast_triangle_32_5,
+      lp_rast_triangle_32_6,
+      lp_rast_triangle_32_7,
+      lp_rast_triangle_32_8
+   }
+};
+
+
+/**
+ * Pick the triangle rasterization functions with the widest edge mask
+ * vectors the CPU supports.
+ */
+const struct lp_rast_tri_funcs *
+lp_rast_choose_tri_funcs(void)
+{
+   const struct lp_rast_tri_funcs *funcs = NULL;
+
+   if (util_cpu_caps.has_avx512f)
+      funcs = lp_rast_tri_funcs_avx512();
+
+   if (!funcs && util_cpu_caps.has_avx2)
+      funcs = lp_rast_tri_funcs_avx2();
+
+   if (!funcs)
+      funcs = &lp_rast_tri_funcs_default;
+
+   return funcs;
+}
@@ -0,0 +1,285 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Triangle rasterization with the edge masks built in AVX2 registers.
+ *
+ * This file is compiled with -mavx2 and the functions are only installed
+ * when util_cpu_caps reports AVX2 support.
+ */
+
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+
+/**
+ * Sign bits of four 64-bit integers.
+ */
+static INLINE unsigned
+sign_bits_epi64(__m256i v)
+{
+   return _mm256_movemask_pd(_mm256_castsi256_pd(v));
+}
+
+
+/**
+ * Sign bits of eight 32-bit integers.
+ */
+static INLINE unsigned
+sign_bits_epi32(__m256i v)
+{
+   return _mm256_movemask_ps(_mm256_castsi256_ps(v));
+}
+
+
+static INLINE void
+build_masks_avx2(int64_t c,
+                 int64_t cdiff,
+                 int64_t dcdx,
+                 int64_t dcdy,
+                 unsigned *outmask,
+                 unsigned *partmask)
+{
+   __m256i xdcdy = _mm256_set1_epi64x(dcdy);
+   __m256i xcdiff = _mm256_set1_epi64x(cdiff);
+
+   /* One row of four values per register
+    */
+   __m256i cstep0 = _mm256_setr_epi64x(c, c + dcdx, c + 2*dcdx, c + 3*dcdx);
+   __m256i cstep1 = _mm256_add_epi64(cstep0, xdcdy);
+   __m256i cstep2 = _mm256_add_epi64(cstep1, xdcdy);
+   __m256i cstep3 = _mm256_add_epi64(cstep2, xdcdy);
+
+   *outmask |= (sign_bits_epi64(cstep0) |
+                sign_bits_epi64(cstep1) << 4 |
+                sign_bits_epi64(cstep2) << 8 |
+                sign_bits_epi64(cstep3) << 12);
+
+   *partmask |= (sign_bits_epi64(_mm256_add_epi64(cstep0, xcdiff)) |
+                 sign_bits_epi64(_mm256_add_epi64(cstep1, xcdiff)) << 4 |
+                 sign_bits_epi64(_mm256_add_epi64(cstep2, xcdiff)) << 8 |
+                 sign_bits_epi64(_mm256_add_epi64(cstep3, xcdiff)) << 12);
+}
+
+
+static INLINE unsigned
+build_mask_linear_avx2(int64_t c, int64_t dcdx, int64_t dcdy)
+{
+   __m256i xdcdy = _mm256_set1_epi64x(dcdy);
+   __m256i cstep0 = _mm256_setr_epi64x(c, c + dcdx, c + 2*dcdx, c + 3*dcdx);
+   __m256i cstep1 = _mm256_add_epi64(cstep0, xdcdy);
+   __m256i cstep2 = _mm256_add_epi64(cstep1, xdcdy);
+   __m256i cstep3 = _mm256_add_epi64(cstep2, xdcdy);
+
+   return (sign_bits_epi64(cstep0) |
+           sign_bits_epi64(cstep1) << 4 |
+           sign_bits_epi64(cstep2) << 8 |
+           sign_bits_epi64(cstep3) << 12);
+}
+
+
+static INLINE void
+build_masks_32_avx2(int c,
+                    int cdiff,
+                    int dcdx,
+                    int dcdy,
+                    unsigned *outmask,
+                    unsigned *partmask)
+{
+   /* Two rows of four values per register
+    */
+   __m256i cstep01 = _mm256_setr_epi32(c, c + dcdx, c + 2*dcdx, c + 3*dcdx,
+                                       c + dcdy,
+                                       c + dcdy + dcdx,
+                                       c + dcdy + 2*dcdx,
+                                       c + dcdy + 3*dcdx);
+   __m256i cstep23 = _mm256_add_epi32(cstep01, _mm256_set1_epi32(2*dcdy));
+   __m256i xcdiff = _mm256_set1_epi32(cdiff);
+
+   *outmask |= (sign_bits_epi32(cstep01) |
+                sign_bits_epi32(cstep23) << 8);
+
+   *partmask |= (sign_bits_epi32(_mm256_add_epi32(cstep01, xcdiff)) |
+                 sign_bits_epi32(_mm256_add_epi32(cstep23, xcdiff)) << 8);
+}
+
+
+static INLINE unsigned
+build_mask_linear_32_avx2(int c, int dcdx, int dcdy)
+{
+   __m256i cstep01 = _mm256_setr_epi32(c, c + dcdx, c + 2*dcdx, c + 3*dcdx,
+                                       c + dcdy,
+                                       c + dcdy + dcdx,
+                                       c + dcdy + 2*dcdx,
+                                       c + dcdy + 3*dcdx);
+   __m256i cstep23 = _mm256_add_epi32(cstep01, _mm256_set1_epi32(2*dcdy));
+
+   return (sign_bits_epi32(cstep01) |
+           sign_bits_epi32(cstep23) << 8);
+}
+
+
+#define DECLARE_TRIANGLE(n) \
+   void lp_rast_triangle_avx2_##n(struct lp_rasterizer_task *, \
+                                  const union lp_rast_cmd_arg); \
+   void lp_rast_triangle_avx2_32_##n(struct lp_rasterizer_task *, \
+                                     const union lp_rast_cmd_arg);
+
+DECLARE_TRIANGLE(1)
+DECLARE_TRIANGLE(2)
+DECLARE_TRIANGLE(3)
+DECLARE_TRIANGLE(4)
+DECLARE_TRIANGLE(5)
+DECLARE_TRIANGLE(6)
+DECLARE_TRIANGLE(7)
+DECLARE_TRIANGLE(8)
+
+#undef DECLARE_TRIANGLE
+
+
+#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_avx2(c, cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_avx2(c, dcdx, dcdy)
+
+#define TAG(x) x##_avx2_1
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_2
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_3
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_4
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_5
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_6
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_7
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_8
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+#undef BUILD_MASKS
+#undef BUILD_MASK_LINEAR
+#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_32_avx2((int)c, (int)cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_32_avx2((int)c, dcdx, dcdy)
+
+#define TAG(x) x##_avx2_32_1
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_32_2
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_32_3
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_32_4
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_32_5
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_32_6
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_32_7
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx2_32_8
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+
+static const struct lp_rast_tri_funcs tri_funcs_avx2 = {
+   "avx2",
+   {
+      lp_rast_triangle_avx2_1,
+      lp_rast_triangle_avx2_2,
+      lp_rast_triangle_avx2_3,
+      lp_rast_triangle_avx2_4,
+      lp_rast_triangle_avx2_5,
+      lp_rast_triangle_avx2_6,
+      lp_rast_triangle_avx2_7,
+      lp_rast_triangle_avx2_8
+   },
+   {
+      lp_rast_triangle_avx2_32_1,
+      lp_rast_triangle_avx2_32_2,
+      lp_rast_triangle_avx2_32_3,
+      lp_rast_triangle_avx2_32_4,
+      lp_rast_triangle_avx2_32_5,
+      lp_rast_triangle_avx2_32_6,
+      lp_rast_triangle_avx2_32_7,
+      lp_rast_triangle_avx2_32_8
+   }
+};
+
+
+const struct lp_rast_tri_funcs *
+lp_rast_tri_funcs_avx2(void)
+{
+   return &tri_funcs_avx2;
+}
+
+
+#else /* !__AVX2__ */
+
+
+const struct lp_rast_tri_funcs *
+lp_rast_tri_funcs_avx2(void)
+{
+   return NULL;
+}
+
+
+#endif /* !__AVX2__ */
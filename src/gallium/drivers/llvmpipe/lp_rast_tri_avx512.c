@@ -0,0 +1,264 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Triangle rasterization with the edge masks built in AVX-512 registers.
+ *
+ * This file is compiled with -mavx512f and the functions are only installed
+ * when util_cpu_caps reports AVX-512F support.
+ */
+
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+
+static INLINE void
+build_masks_avx512(int64_t c,
+                   int64_t cdiff,
+                   int64_t dcdx,
+                   int64_t dcdy,
+                   unsigned *outmask,
+                   unsigned *partmask)
+{
+   const __m512i zero = _mm512_setzero_si512();
+   const __m512i xcdiff = _mm512_set1_epi64(cdiff);
+
+   /* Two rows of four values per register
+    */
+   __m512i cstep01 = _mm512_setr_epi64(c, c + dcdx, c + 2*dcdx, c + 3*dcdx,
+                                       c + dcdy,
+                                       c + dcdy + dcdx,
+                                       c + dcdy + 2*dcdx,
+                                       c + dcdy + 3*dcdx);
+   __m512i cstep23 = _mm512_add_epi64(cstep01, _mm512_set1_epi64(2*dcdy));
+
+   *outmask |= (_mm512_cmplt_epi64_mask(cstep01, zero) |
+                _mm512_cmplt_epi64_mask(cstep23, zero) << 8);
+
+   *partmask |= (_mm512_cmplt_epi64_mask(_mm512_add_epi64(cstep01, xcdiff), zero) |
+                 _mm512_cmplt_epi64_mask(_mm512_add_epi64(cstep23, xcdiff), zero) << 8);
+}
+
+
+static INLINE unsigned
+build_mask_linear_avx512(int64_t c, int64_t dcdx, int64_t dcdy)
+{
+   const __m512i zero = _mm512_setzero_si512();
+   __m512i cstep01 = _mm512_setr_epi64(c, c + dcdx, c + 2*dcdx, c + 3*dcdx,
+                                       c + dcdy,
+                                       c + dcdy + dcdx,
+                                       c + dcdy + 2*dcdx,
+                                       c + dcdy + 3*dcdx);
+   __m512i cstep23 = _mm512_add_epi64(cstep01, _mm512_set1_epi64(2*dcdy));
+
+   return (_mm512_cmplt_epi64_mask(cstep01, zero) |
+           _mm512_cmplt_epi64_mask(cstep23, zero) << 8);
+}
+
+
+/**
+ * The whole 4x4 grid of values, c + x*dcdx + y*dcdy, in one register.
+ */
+static INLINE __m512i
+cstep_32_avx512(int c, int dcdx, int dcdy)
+{
+   const __m512i x = _mm512_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3,
+                                       0, 1, 2, 3, 0, 1, 2, 3);
+   const __m512i y = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1,
+                                       2, 2, 2, 2, 3, 3, 3, 3);
+
+   return _mm512_add_epi32(_mm512_set1_epi32(c),
+                           _mm512_add_epi32(_mm512_mullo_epi32(x, _mm512_set1_epi32(dcdx)),
+                                            _mm512_mullo_epi32(y, _mm512_set1_epi32(dcdy))));
+}
+
+
+static INLINE void
+build_masks_32_avx512(int c,
+                      int cdiff,
+                      int dcdx,
+                      int dcdy,
+                      unsigned *outmask,
+                      unsigned *partmask)
+{
+   const __m512i zero = _mm512_setzero_si512();
+   __m512i cstep = cstep_32_avx512(c, dcdx, dcdy);
+
+   *outmask |= _mm512_cmplt_epi32_mask(cstep, zero);
+   *partmask |= _mm512_cmplt_epi32_mask(_mm512_add_epi32(cstep, _mm512_set1_epi32(cdiff)),
+                                        zero);
+}
+
+
+static INLINE unsigned
+build_mask_linear_32_avx512(int c, int dcdx, int dcdy)
+{
+   return _mm512_cmplt_epi32_mask(cstep_32_avx512(c, dcdx, dcdy),
+                                  _mm512_setzero_si512());
+}
+
+
+#define DECLARE_TRIANGLE(n) \
+   void lp_rast_triangle_avx512_##n(struct lp_rasterizer_task *, \
+                                  const union lp_rast_cmd_arg); \
+   void lp_rast_triangle_avx512_32_##n(struct lp_rasterizer_task *, \
+                                     const union lp_rast_cmd_arg);
+
+DECLARE_TRIANGLE(1)
+DECLARE_TRIANGLE(2)
+DECLARE_TRIANGLE(3)
+DECLARE_TRIANGLE(4)
+DECLARE_TRIANGLE(5)
+DECLARE_TRIANGLE(6)
+DECLARE_TRIANGLE(7)
+DECLARE_TRIANGLE(8)
+
+#undef DECLARE_TRIANGLE
+
+
+#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_avx512(c, cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_avx512(c, dcdx, dcdy)
+
+#define TAG(x) x##_avx512_1
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_2
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_3
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_4
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_5
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_6
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_7
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_8
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+#undef BUILD_MASKS
+#undef BUILD_MASK_LINEAR
+#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_32_avx512((int)c, (int)cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_32_avx512((int)c, dcdx, dcdy)
+
+#define TAG(x) x##_avx512_32_1
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_32_2
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_32_3
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_32_4
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_32_5
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_32_6
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_32_7
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) x##_avx512_32_8
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+
+static const struct lp_rast_tri_funcs tri_funcs_avx512 = {
+   "avx512",
+   {
+      lp_rast_triangle_avx512_1,
+      lp_rast_triangle_avx512_2,
+      lp_rast_triangle_avx512_3,
+      lp_rast_triangle_avx512_4,
+      lp_rast_triangle_avx512_5,
+      lp_rast_triangle_avx512_6,
+      lp_rast_triangle_avx512_7,
+      lp_rast_triangle_avx512_8
+   },
+   {
+      lp_rast_triangle_avx512_32_1,
+      lp_rast_triangle_avx512_32_2,
+      lp_rast_triangle_avx512_32_3,
+      lp_rast_triangle_avx512_32_4,
+      lp_rast_triangle_avx512_32_5,
+      lp_rast_triangle_avx512_32_6,
+      lp_rast_triangle_avx512_32_7,
+      lp_rast_triangle_avx512_32_8
+   }
+};
+
+
+const struct lp_rast_tri_funcs *
+lp_rast_tri_funcs_avx512(void)
+{
+   return &tri_funcs_avx512;
+}
+
+
+#else /* !__AVX512F__ */
+
+
+const struct lp_rast_tri_funcs *
+lp_rast_tri_funcs_avx512(void)
+{
+   return NULL;
+}
+
+
+#endif /* !__AVX512F__ */
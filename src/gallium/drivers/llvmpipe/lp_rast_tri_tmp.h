@@ -37,7 +37,6 @@
  *
  * XXX: Varients for more/fewer planes.
  * XXX: Need ways of dropping planes as we descend.
- * XXX: SIMD
  */
 static void
 TAG(do_block_4)(struct lp_rasterizer_task *task,
@@ -82,7 +81,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
       const int64_t dcdx = -IMUL64(plane[j].dcdx, 4);
       const int64_t dcdy = IMUL64(plane[j].dcdy, 4);
       const int64_t cox = IMUL64(plane[j].eo, 4);
-      const int64_t ei = plane[j].dcdy - plane[j].dcdx - plane[j].eo;
+      const int64_t ei = (int64_t)plane[j].dcdy - plane[j].dcdx - plane[j].eo;
       const int64_t cio = IMUL64(ei, 4) - 1;
 
       BUILD_MASKS(c[j] + cox,
@@ -142,57 +141,42 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
       inmask &= ~(1 << i);
 
       LP_COUNT(nr_fully_covered_4);
-      block_full_4(task, tri, px, py);
+      lp_rast_block_full_4(task, tri, px, py);
    }
 }
 
 
 /**
- * Scan the tile in chunks and figure out which pixels to rasterize
- * for this triangle.
+ * Evaluate a 64x64 block of pixels to determine which 16x16 subblocks are
+ * in/out of the triangle's bounds.  Only the subblocks in block_mask are
+ * considered.
  */
-void
-TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
-                      const union lp_rast_cmd_arg arg)
+static void
+TAG(do_block_64)(struct lp_rasterizer_task *task,
+                 const struct lp_rast_triangle *tri,
+                 const struct lp_rast_plane *plane,
+                 int x, int y,
+                 const int64_t *c,
+                 unsigned block_mask)
 {
-   const struct lp_rast_triangle *tri = arg.triangle.tri;
-   unsigned plane_mask = arg.triangle.plane_mask;
-   const struct lp_rast_plane *tri_plane = GET_PLANES(tri);
-   const int x = task->x, y = task->y;
-   struct lp_rast_plane plane[NR_PLANES];
-   int64_t c[NR_PLANES];
    unsigned outmask, inmask, partmask, partial_mask;
-   unsigned j = 0;
-
-   if (tri->inputs.disable) {
-      /* This triangle was partially binned and has been disabled */
-      return;
-   }
+   unsigned j;
 
-   outmask = 0;                 /* outside one or more trivial reject planes */
+   outmask = ~block_mask & 0xffff; /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
-   while (plane_mask) {
-      int i = ffs(plane_mask) - 1;
-      plane[j] = tri_plane[i];
-      plane_mask &= ~(1 << i);
-      c[j] = plane[j].c + IMUL64(plane[j].dcdy, y) - IMUL64(plane[j].dcdx, x);
-
-      {
-         const int64_t dcdx = -IMUL64(plane[j].dcdx, 16);
-         const int64_t dcdy = IMUL64(plane[j].dcdy, 16);
-         const int64_t cox = IMUL64(plane[j].eo, 16);
-         const int64_t ei = plane[j].dcdy - plane[j].dcdx - plane[j].eo;
-         const int64_t cio = IMUL64(ei, 16) - 1;
-
-         BUILD_MASKS(c[j] + cox,
-                     cio - cox,
-                     dcdx, dcdy,
-                     &outmask,   /* sign bits from c[i][0..15] + cox */
-                     &partmask); /* sign bits from c[i][0..15] + cio */
-      }
+   for (j = 0; j < NR_PLANES; j++) {
+      const int64_t dcdx = -IMUL64(plane[j].dcdx, 16);
+      const int64_t dcdy = IMUL64(plane[j].dcdy, 16);
+      const int64_t cox = IMUL64(plane[j].eo, 16);
+      const int64_t ei = (int64_t)plane[j].dcdy - plane[j].dcdx - plane[j].eo;
+      const int64_t cio = IMUL64(ei, 16) - 1;
 
-      j++;
+      BUILD_MASKS(c[j] + cox,
+                  cio - cox,
+                  dcdx, dcdy,
+                  &outmask,   /* sign bits from c[i][0..15] + cox */
+                  &partmask); /* sign bits from c[i][0..15] + cio */
    }
 
    if (outmask == 0xffff)
@@ -200,7 +184,7 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
    /* Mask of sub-blocks which are inside all trivial accept planes:
     */
-   inmask = ~partmask & 0xffff;
+   inmask = ~partmask & ~outmask & 0xffff;
 
    /* Mask of sub-blocks which are inside all trivial reject planes,
     * but outside at least one trivial accept plane:
@@ -209,7 +193,18 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
    assert((partial_mask & inmask) == 0);
 
-   LP_COUNT_ADD(nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
+   LP_COUNT_ADD(nr_empty_16, util_bitcount(block_mask & ~(partial_mask | inmask)));
+
+   /* Drop the sub-blocks which are behind the depth already in the tile:
+    */
+   if (task->hiz_valid && task->state->variant->hiz_cull) {
+      unsigned culled = lp_rast_hiz_cull(task, &tri->inputs, x, y,
+                                         partial_mask | inmask);
+
+      LP_COUNT_ADD(nr_hiz_culled_16, util_bitcount(culled));
+      partial_mask &= ~culled;
+      inmask &= ~culled;
+   }
 
    /* Iterate over partials:
     */
@@ -244,7 +239,70 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       inmask &= ~(1 << i);
 
       LP_COUNT(nr_fully_covered_16);
-      block_full_16(task, tri, px, py);
+      lp_rast_block_full_16(task, tri, px, py);
+   }
+}
+
+
+/**
+ * Scan the tile in chunks and figure out which pixels to rasterize
+ * for this triangle.
+ *
+ * The tile is scanned in 64x64 blocks: a smaller tile only considers the
+ * 16x16 subblocks inside it, and a larger one is split in several blocks.
+ */
+void
+TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
+                      const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   unsigned plane_mask = arg.triangle.plane_mask;
+   const struct lp_rast_plane *tri_plane = GET_PLANES(tri);
+   const int x = task->x, y = task->y;
+   const unsigned tile_order = task->scene->tile_order;
+   struct lp_rast_plane plane[NR_PLANES];
+   int64_t c[NR_PLANES];
+   unsigned j = 0;
+
+   if (tri->inputs.disable) {
+      /* This triangle was partially binned and has been disabled */
+      return;
+   }
+
+   while (plane_mask) {
+      int i = ffs(plane_mask) - 1;
+      plane[j] = tri_plane[i];
+      plane_mask &= ~(1 << i);
+      c[j] = plane[j].c + IMUL64(plane[j].dcdy, y) - IMUL64(plane[j].dcdx, x);
+      j++;
+   }
+
+   if (tile_order == TILE_ORDER) {
+      TAG(do_block_64)(task, tri, plane, x, y, c, 0xffff);
+   }
+   else if (tile_order < TILE_ORDER) {
+      /* The top-left 2x2 subblocks of a 32x32 tile */
+      assert(tile_order == LP_MIN_TILE_ORDER);
+      TAG(do_block_64)(task, tri, plane, x, y, c, 0x0033);
+   }
+   else {
+      int ix, iy;
+
+      /* Skip the blocks past the framebuffer edge, which may be beyond the
+       * end of the (TILE_SIZE aligned) color and depth buffers.
+       */
+      for (iy = 0; iy < task->height; iy += 64) {
+         for (ix = 0; ix < task->width; ix += 64) {
+            int64_t cx[NR_PLANES];
+
+            for (j = 0; j < NR_PLANES; j++)
+               cx[j] = (c[j]
+                        - IMUL64(plane[j].dcdx, ix)
+                        + IMUL64(plane[j].dcdy, iy));
+
+            TAG(do_block_64)(task, tri, plane, x + ix, y + iy, cx, 0xffff);
+         }
+      }
    }
 }
 
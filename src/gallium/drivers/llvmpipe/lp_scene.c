@@ -25,6 +25,7 @@
  *
  **************************************************************************/
 
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -34,6 +35,7 @@
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 
 
 #define RESOURCE_REF_SZ 32
@@ -89,10 +91,19 @@ lp_scene_create( struct pipe_context *pipe )
 void
 lp_scene_destroy(struct lp_scene *scene)
 {
+   struct data_block *block, *tmp;
+
    lp_fence_reference(&scene->fence, NULL);
-   pipe_mutex_destroy(scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
+
+   for (block = scene->free_blocks; block; block = tmp) {
+      tmp = block->next;
+      FREE(block);
+   }
+
+   pipe_mutex_destroy(scene->mutex);
+
    FREE(scene);
 }
 
@@ -201,12 +212,15 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 
 /**
- * Free all the temporary data in a scene.
+ * Unmap the framebuffer surfaces.  Called by the rasterizer once it is
+ * done with the scene.  The scene's bins, data and resource references are
+ * left untouched -- these are released by lp_scene_recycle() when the
+ * setup module reuses the scene.
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -229,16 +243,35 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                               zsbuf->u.tex.first_layer);
       scene->zsbuf.map = NULL;
    }
+}
 
-   /* Reset all command lists:
+
+/**
+ * Free all the temporary data in a scene, so that it can be used for
+ * binning again.  Called by the setup module, either once the scene's
+ * fence has been signalled, or when the scene was never rasterized.
+ */
+void
+lp_scene_recycle(struct lp_scene *scene)
+{
+   unsigned num_words = (lp_scene_get_num_bins(scene) + 31) / 32;
+   unsigned i;
+
+   /* Reset the command lists of the bins that were used:
     */
-   for (i = 0; i < scene->tiles_x; i++) {
-      for (j = 0; j < scene->tiles_y; j++) {
-         struct cmd_bin *bin = lp_scene_get_bin(scene, i, j);
+   for (i = 0; i < num_words; i++) {
+      uint32_t bits = scene->dirty_bins[i];
+
+      while (bits) {
+         unsigned rank = i * 32 + u_bit_scan(&bits);
+         unsigned order = scene->bin_order[rank];
+         struct cmd_bin *bin = lp_scene_get_bin(scene, order & 0xff, order >> 8);
          bin->head = NULL;
          bin->tail = NULL;
          bin->last_state = NULL;
       }
+
+      scene->dirty_bins[i] = 0;
    }
 
    /* If there are any bins which weren't cleared by the loop above,
@@ -271,19 +304,37 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                       j, scene->resource_reference_size);
    }
 
-   /* Free all scene data blocks:
+   /* Release all scene data blocks.  As many as recent scenes needed are
+    * kept for the next ones, the others are freed:
     */
    {
       struct data_block_list *list = &scene->data;
       struct data_block *block, *tmp;
+      unsigned num_blocks = 0;
 
       for (block = list->head->next; block; block = tmp) {
          tmp = block->next;
-	 FREE(block);
+         block->next = scene->free_blocks;
+         scene->free_blocks = block;
+         scene->num_free_blocks++;
+         num_blocks++;
       }
 
       list->head->next = NULL;
       list->head->used = 0;
+
+      memset(scene->jobs, 0, sizeof scene->jobs);
+
+      scene->data_block_high_water =
+         MAX2(num_blocks, scene->data_block_high_water -
+                          scene->data_block_high_water / 8);
+
+      while (scene->num_free_blocks > scene->data_block_high_water) {
+         block = scene->free_blocks;
+         scene->free_blocks = block->next;
+         scene->num_free_blocks--;
+         FREE(block);
+      }
    }
 
    lp_fence_reference(&scene->fence, NULL);
@@ -293,6 +344,9 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    scene->resource_reference_size = 0;
 
    scene->has_depthstencil_clear = FALSE;
+   scene->clear_color = NULL;
+   scene->clear_zsvalue = 0;
+   scene->clear_zsmask = 0;
    scene->alloc_failed = FALSE;
 
    util_unreference_framebuffer_state( &scene->fb );
@@ -305,17 +359,43 @@ lp_scene_end_rasterization(struct lp_scene *scene )
 
 struct cmd_block *
 lp_scene_new_cmd_block( struct lp_scene *scene,
+                        struct lp_scene_job *job,
                         struct cmd_bin *bin )
 {
-   struct cmd_block *block = lp_scene_alloc(scene, sizeof(struct cmd_block));
+   struct cmd_block *block;
+
+   /* Jobs only bin what they have already set up, so don't fail them for
+    * going over the scene's size budget.
+    */
+   if (job)
+      block = lp_scene_job_alloc(scene, job, sizeof(struct cmd_block),
+                                 1, TRUE);
+   else
+      block = lp_scene_alloc(scene, sizeof(struct cmd_block));
+
    if (block) {
       if (bin->tail) {
          bin->tail->next = block;
          bin->tail = block;
       }
       else {
+         unsigned rank = scene->bin_rank[bin - &scene->tile[0][0]];
+         int32_t *bits = (int32_t *) &scene->dirty_bins[rank / 32];
+         int32_t bit = 1 << (rank % 32);
+
          bin->head = block;
          bin->tail = block;
+
+         /* Other jobs may be marking bins in the same word */
+         if (job) {
+            int32_t old;
+            do {
+               old = *bits;
+            } while (p_atomic_cmpxchg(bits, old, old | bit) != old);
+         }
+         else {
+            *bits |= bit;
+         }
       }
       //memset(block, 0, sizeof *block);
       block->next = NULL;
@@ -325,19 +405,30 @@ lp_scene_new_cmd_block( struct lp_scene *scene,
 }
 
 
-struct data_block *
-lp_scene_new_data_block( struct lp_scene *scene )
+static struct data_block *
+new_data_block( struct lp_scene *scene, boolean over_budget )
 {
-   if (scene->scene_size + DATA_BLOCK_SIZE > LP_SCENE_MAX_SIZE) {
+   if (!over_budget &&
+       scene->scene_size + DATA_BLOCK_SIZE > LP_SCENE_MAX_SIZE) {
       if (0) debug_printf("%s: failed\n", __FUNCTION__);
       scene->alloc_failed = TRUE;
       return NULL;
    }
    else {
-      struct data_block *block = MALLOC_STRUCT(data_block);
-      if (block == NULL)
-         return NULL;
-      
+      struct data_block *block = scene->free_blocks;
+
+      if (block) {
+         scene->free_blocks = block->next;
+         scene->num_free_blocks--;
+         LP_COUNT(nr_data_blocks_reused);
+      }
+      else {
+         block = MALLOC_STRUCT(data_block);
+         if (block == NULL)
+            return NULL;
+         LP_COUNT(nr_data_blocks_allocated);
+      }
+
       scene->scene_size += sizeof *block;
 
       block->used = 0;
@@ -349,6 +440,49 @@ lp_scene_new_data_block( struct lp_scene *scene )
 }
 
 
+struct data_block *
+lp_scene_new_data_block( struct lp_scene *scene )
+{
+   return new_data_block(scene, FALSE);
+}
+
+
+/**
+ * Allocate scene data for one of the setup jobs binning in parallel.
+ * Jobs may run concurrently with each other, but never with allocations
+ * from the scene's own block (lp_scene_alloc).
+ *
+ * \param over_budget  allow the scene to grow past LP_SCENE_MAX_SIZE
+ */
+void *
+lp_scene_job_alloc( struct lp_scene *scene,
+                    struct lp_scene_job *job,
+                    unsigned size,
+                    unsigned alignment,
+                    boolean over_budget )
+{
+   struct data_block *block = job->block;
+
+   assert(size + alignment - 1 <= DATA_BLOCK_SIZE);
+
+   if (!block || block->used + size + alignment - 1 > DATA_BLOCK_SIZE) {
+      pipe_mutex_lock(scene->mutex);
+      block = new_data_block(scene, over_budget);
+      pipe_mutex_unlock(scene->mutex);
+      if (!block)
+         return NULL;
+      job->block = block;
+   }
+
+   {
+      ubyte *data = block->data + block->used;
+      unsigned offset = (((uintptr_t)data + alignment - 1) & ~(alignment - 1)) - (uintptr_t)data;
+      block->used += offset + size;
+      return data + offset;
+   }
+}
+
+
 /**
  * Return number of bytes used for all bin data within a scene.
  * This does not include resources (textures) referenced by the scene.
@@ -425,6 +559,33 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 }
 
 
+/**
+ * Make the scene's fence the last one of its context for all the resources
+ * it reads and writes, as it is queued for rasterization.
+ */
+void
+lp_scene_fence_resources(struct lp_scene *scene)
+{
+   const struct resource_ref *ref;
+   unsigned i;
+
+   for (ref = scene->resources; ref; ref = ref->next) {
+      for (i = 0; i < ref->count; i++)
+         llvmpipe_resource_fence(ref->resource[i], scene->pipe,
+                                 scene->fence, FALSE);
+   }
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i])
+         llvmpipe_resource_fence(scene->fb.cbufs[i]->texture, scene->pipe,
+                                 scene->fence, TRUE);
+   }
+   if (scene->fb.zsbuf)
+      llvmpipe_resource_fence(scene->fb.zsbuf->texture, scene->pipe,
+                              scene->fence, TRUE);
+}
+
+
 /**
  * Does this scene have a reference to the given resource?
  */
@@ -447,66 +608,210 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/**
+ * Compute the order in which bins are handed out to the rasterizer
+ * threads.  We walk the bins in Morton (Z) order, so that any contiguous
+ * range of the order covers a compact block of tiles.  This keeps the
+ * tiles processed by a thread (and hence the textures and framebuffer
+ * lines they touch) close together, which is a lot kinder to the caches
+ * than plain raster order.
+ */
+static void
+compute_bin_order(struct lp_scene *scene)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+   unsigned size = util_next_power_of_two(MAX2(scene->tiles_x,
+                                                scene->tiles_y));
+   unsigned num_codes = size * size;
+   unsigned n = 0;
+   unsigned code;
+
+   for (code = 0; code < num_codes; code++) {
+      unsigned x = 0, y = 0;
+      unsigned bit;
+
+      /* de-interleave the bits of the Morton code */
+      for (bit = 0; (1u << (2 * bit)) < num_codes; bit++) {
+         x |= ((code >> (2 * bit)) & 1) << bit;
+         y |= ((code >> (2 * bit + 1)) & 1) << bit;
+      }
+
+      if (x < scene->tiles_x && y < scene->tiles_y) {
+         scene->bin_rank[lp_scene_get_bin(scene, x, y) - &scene->tile[0][0]] =
+            (uint16_t)n;
+         scene->bin_order[n++] = (uint16_t)((y << 8) | x);
+      }
    }
-   return TRUE;
+
+   assert(n == lp_scene_get_num_bins(scene));
+
+   scene->bin_order_tiles_x = scene->tiles_x;
+   scene->bin_order_tiles_y = scene->tiles_y;
 }
 
 
+/**
+ * Prepare for handing out the scene bins to the given number of
+ * rasterizer threads.  Only the bins which hold commands are handed out,
+ * in bin order, unless the scene clears the whole framebuffer.  Each
+ * thread gets an equally sized, contiguous range of them to start with.
+ * Called by one thread, before the other threads start iterating.
+ */
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads )
+{
+   unsigned num_words = (lp_scene_get_num_bins(scene) + 31) / 32;
+   unsigned num_bins = 0;
+   unsigned i;
+
+   if (lp_scene_has_clears(scene)) {
+      num_bins = lp_scene_get_num_bins(scene);
+      memcpy(scene->active_bins, scene->bin_order,
+             num_bins * sizeof scene->active_bins[0]);
+   }
+   else {
+      for (i = 0; i < num_words; i++) {
+         uint32_t bits = scene->dirty_bins[i];
+
+         while (bits) {
+            unsigned rank = i * 32 + u_bit_scan(&bits);
+            scene->active_bins[num_bins++] = scene->bin_order[rank];
+         }
+      }
+   }
+   scene->num_active_bins = num_bins;
+
+   num_threads = CLAMP(num_threads, 1, LP_MAX_THREADS);
+   scene->num_bin_queues = num_threads;
+
+   for (i = 0; i < num_threads; i++) {
+      unsigned head = num_bins * i / num_threads;
+      unsigned tail = num_bins * (i + 1) / num_threads;
+      p_atomic_set(&scene->bin_queue[i].range,
+                   LP_BIN_QUEUE_PACK(head, tail));
+   }
+}
+
+
+/**
+ * Pop the bin at the head of a queue.
+ * Returns the index into the bin order, or -1 if the queue is empty.
+ */
+static int
+bin_queue_pop(struct lp_bin_queue *queue)
 {
-   scene->curr_x = scene->curr_y = -1;
+   int32_t range = p_atomic_read(&queue->range);
+
+   for (;;) {
+      unsigned head = LP_BIN_QUEUE_HEAD(range);
+      unsigned tail = LP_BIN_QUEUE_TAIL(range);
+      int32_t old;
+
+      if (head >= tail)
+         return -1;
+
+      old = p_atomic_cmpxchg(&queue->range, range,
+                             LP_BIN_QUEUE_PACK(head + 1, tail));
+      if (old == range)
+         return head;
+
+      range = old;
+   }
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Steal the second half of the bins remaining in a victim's queue.
+ * The stolen range is returned in *head, *tail.
+ */
+static boolean
+bin_queue_steal(struct lp_bin_queue *victim, unsigned *head, unsigned *tail)
+{
+   int32_t range = p_atomic_read(&victim->range);
+
+   for (;;) {
+      unsigned victim_head = LP_BIN_QUEUE_HEAD(range);
+      unsigned victim_tail = LP_BIN_QUEUE_TAIL(range);
+      unsigned split;
+      int32_t old;
+
+      if (victim_head >= victim_tail)
+         return FALSE;
+
+      split = victim_head + (victim_tail - victim_head) / 2;
+
+      old = p_atomic_cmpxchg(&victim->range, range,
+                             LP_BIN_QUEUE_PACK(victim_head, split));
+      if (old == range) {
+         *head = split;
+         *tail = victim_tail;
+         return TRUE;
+      }
+
+      range = old;
+   }
+}
+
+
+/**
+ * Return pointer to next bin to be rendered by the given thread.
  * Multiple rendering threads will call this function to get a chunk
  * of work (a bin) to work on.
+ *
+ * Each thread first drains its own queue.  Once that is empty it steals
+ * half of the remaining work from another thread's queue, so that the
+ * stolen bins are still neighbours of each other.  No locks are taken.
+ * \param stolen  returns whether the bin was stolen from another thread
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y, boolean *stolen )
 {
-   struct cmd_bin *bin = NULL;
+   struct lp_bin_queue *queue;
+   unsigned num_queues = scene->num_bin_queues;
+   int index;
 
-   pipe_mutex_lock(scene->mutex);
+   assert(thread_index < num_queues);
+   queue = &scene->bin_queue[thread_index];
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   *stolen = FALSE;
+
+   index = bin_queue_pop(queue);
+
+   if (index < 0) {
+      unsigned i;
+
+      for (i = 1; i < num_queues && index < 0; i++) {
+         struct lp_bin_queue *victim =
+            &scene->bin_queue[(thread_index + i) % num_queues];
+         unsigned head, tail;
+
+         if (bin_queue_steal(victim, &head, &tail)) {
+            /* Keep the first stolen bin, and publish the remainder in our
+             * own (empty) queue, where other threads may steal it in turn.
+             */
+            p_atomic_set(&queue->range, LP_BIN_QUEUE_PACK(head + 1, tail));
+            index = head;
+            *stolen = TRUE;
+         }
+      }
+
+      if (index < 0) {
+         /* no more bins left */
+         return NULL;
+      }
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   *x = scene->active_bins[index] & 0xff;
+   *y = scene->active_bins[index] >> 8;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   pipe_mutex_unlock(scene->mutex);
-   return bin;
+   return lp_scene_get_bin(scene, *x, *y);
 }
 
 
 void lp_scene_begin_binning( struct lp_scene *scene,
-                             struct pipe_framebuffer_state *fb, boolean discard )
+                             struct pipe_framebuffer_state *fb,
+                             unsigned tile_order,
+                             boolean discard )
 {
    int i;
    unsigned max_layer = ~0;
@@ -516,11 +821,22 @@ void lp_scene_begin_binning( struct lp_scene *scene,
    scene->discard = discard;
    util_copy_framebuffer_state(&scene->fb, fb);
 
-   scene->tiles_x = align(fb->width, TILE_SIZE) / TILE_SIZE;
-   scene->tiles_y = align(fb->height, TILE_SIZE) / TILE_SIZE;
+   assert(tile_order >= LP_MIN_TILE_ORDER && tile_order <= LP_MAX_TILE_ORDER);
+   scene->tile_order = tile_order;
+   scene->tile_size = 1 << tile_order;
+   scene->tiles_x = align(fb->width, scene->tile_size) >> tile_order;
+   scene->tiles_y = align(fb->height, scene->tile_size) >> tile_order;
    assert(scene->tiles_x <= TILES_X);
    assert(scene->tiles_y <= TILES_Y);
 
+   STATIC_ASSERT(TILES_X <= 256 && TILES_Y <= 256);
+   STATIC_ASSERT(LP_MAX_BINS <= 0xffff);
+
+   if (scene->bin_order_tiles_x != scene->tiles_x ||
+       scene->bin_order_tiles_y != scene->tiles_y) {
+      compute_bin_order(scene);
+   }
+
    /*
     * Determine how many layers the fb has (used for clamping layer value).
     * OpenGL (but not d3d10) permits different amount of layers per rt, however
@@ -555,6 +871,8 @@ void lp_scene_end_binning( struct lp_scene *scene )
                    scene->scene_size);
       debug_printf("  data size: %u\n",
                    lp_scene_data_size(scene));
+      debug_printf("  free data blocks: %u (high water %u)\n",
+                   scene->num_free_blocks, scene->data_block_high_water);
 
       if (0)
          lp_debug_bins( scene );
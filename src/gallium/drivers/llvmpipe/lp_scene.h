@@ -36,18 +36,25 @@
 #define LP_SCENE_H
 
 #include "os/os_thread.h"
+#include "lp_limits.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
 
-struct lp_scene_queue;
 struct lp_rast_state;
 
 /* We're limited to 2K by 2K for 32bit fixed point rasterization.
  * Will need a 64-bit version for larger framebuffers.
+ *
+ * The bins are sized for TILE_SIZE tiles, so scenes with smaller tiles
+ * are limited to smaller framebuffers.
  */
 #define TILES_X (LP_MAX_WIDTH / TILE_SIZE)
 #define TILES_Y (LP_MAX_HEIGHT / TILE_SIZE)
 
+/* Bin indices are packed in 16 bits in the per-thread bin queues.
+ */
+#define LP_MAX_BINS (TILES_X * TILES_Y)
+
 
 /* Commands per command block (ideally so sizeof(cmd_block) is a power of
  * two in size.)
@@ -117,6 +124,64 @@ struct data_block_list {
 
 struct resource_ref;
 
+
+/**
+ * Where the time of a scene went, in os_time_get_nano() nanoseconds.
+ * Binning is timed by the setup module, rasterization by each of the
+ * rasterizer threads that worked on the scene.  Setup reads the rasterizer
+ * times back once the scene's fence is signalled.
+ */
+struct lp_scene_timing {
+   unsigned id;            /**< sequence number within the context */
+   boolean pending;        /**< queued, and not accounted for yet */
+   boolean time_shading;   /**< time the fragment shader calls too */
+
+   int64_t bin_start, bin_end;
+
+   /* per rasterizer thread, zero for the threads which didn't take part */
+   int64_t rast_start[LP_MAX_THREADS];
+   int64_t rast_end[LP_MAX_THREADS];
+   int64_t shade_time[LP_MAX_THREADS];
+   unsigned nr_bins[LP_MAX_THREADS];
+};
+
+
+/**
+ * A per-thread queue of bins to rasterize.
+ *
+ * The queue is a contiguous range [head, tail) of the scene's active_bins[]
+ * array, packed in a single 32-bit word so that it can be updated with a
+ * single compare-and-swap.  The owning thread pops bins from the head,
+ * idle threads steal bins from the tail.
+ */
+struct lp_bin_queue {
+   int32_t range;
+   /* Pad to a cache line to avoid false sharing between the threads */
+   ubyte pad[64 - sizeof(int32_t)];
+};
+
+#define LP_BIN_QUEUE_PACK(head, tail)  ((int32_t)(((tail) << 16) | (head)))
+#define LP_BIN_QUEUE_HEAD(range)       ((unsigned)(range) & 0xffff)
+#define LP_BIN_QUEUE_TAIL(range)       ((unsigned)(range) >> 16)
+
+
+/* Maximum number of setup jobs binning into a scene in parallel.
+ */
+#define LP_MAX_BIN_JOBS 16
+
+
+/**
+ * Where one of the setup jobs binning in parallel allocates scene data.
+ *
+ * Each job fills a data block of its own, and only takes the scene's
+ * mutex to get a new one.  The blocks are linked into the scene's data
+ * list like any other.
+ */
+struct lp_scene_job {
+   struct data_block *block;   /**< current block, or NULL */
+};
+
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -166,18 +231,72 @@ struct lp_scene {
 
    boolean alloc_failed;
    boolean has_depthstencil_clear;
+
+   /**
+    * Clears of the whole framebuffer, before any of the bin commands.
+    * They aren't binned but applied as each tile is rasterized, so all
+    * the bins of a scene with clears are rasterized.
+    */
+   const struct lp_rast_clear_color *clear_color;  /**< or NULL */
+   uint64_t clear_zsvalue;
+   uint64_t clear_zsmask;                          /**< or 0 */
    boolean discard;
+   /**
+    * Size of the tiles the scene is binned in.  This is chosen per scene,
+    * in the range [LP_MIN_TILE_ORDER, LP_MAX_TILE_ORDER].
+    */
+   unsigned tile_order;
+   unsigned tile_size;
+
    /**
     * Number of active tiles in each dimension.
     * This basically the framebuffer size divided by tile size
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   pipe_mutex mutex;
+   /**
+    * Order in which the bins are handed out to the rasterizer threads.
+    * This is Morton (Z) order, so that a contiguous range of bins covers
+    * a compact region of the framebuffer.  Each entry packs the bin's
+    * x position in the low byte and the y position in the high byte.
+    */
+   uint16_t bin_order[LP_MAX_BINS];
+   unsigned bin_order_tiles_x, bin_order_tiles_y;
+
+   /** Position of each bin (indexed like tile[][]) in bin_order[] */
+   uint16_t bin_rank[TILES_X * TILES_Y];
+
+   /** Bitmap of the bins that hold commands, indexed by bin_rank[] */
+   uint32_t dirty_bins[LP_MAX_BINS / 32];
+
+   /** The bin_order[] entries of the dirty bins, see lp_scene_bin_iter_begin */
+   uint16_t active_bins[LP_MAX_BINS];
+   unsigned num_active_bins;
+
+   /** Per-thread bin queues, for iterating over bins */
+   struct lp_bin_queue bin_queue[LP_MAX_THREADS];
+   unsigned num_bin_queues;
+
+   /* Rasterizer bookkeeping, protected by the rasterizer's mutex */
+   struct lp_scene *rast_next;   /**< next scene in the pending list */
+   unsigned rast_workers;        /**< threads working on the scene */
+   boolean rast_exhausted;       /**< no bins left to hand out */
+
+   struct lp_scene_timing timing;
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
+
+   /** Allocators of the parallel binning jobs, see lp_scene_job_alloc */
+   struct lp_scene_job jobs[LP_MAX_BIN_JOBS];
+   pipe_mutex mutex;             /**< protects 'data' while jobs run */
+
+   /** Data blocks kept from previous uses of the scene, for reuse */
+   struct data_block *free_blocks;
+   unsigned num_free_blocks;
+
+   /** Decaying maximum of the data blocks used by recent scenes */
+   unsigned data_block_high_water;
 };
 
 
@@ -193,8 +312,15 @@ boolean lp_scene_is_oom(struct lp_scene *scene );
 struct data_block *lp_scene_new_data_block( struct lp_scene *scene );
 
 struct cmd_block *lp_scene_new_cmd_block( struct lp_scene *scene,
+                                          struct lp_scene_job *job,
                                           struct cmd_bin *bin );
 
+void *lp_scene_job_alloc( struct lp_scene *scene,
+                          struct lp_scene_job *job,
+                          unsigned size,
+                          unsigned alignment,
+                          boolean over_budget );
+
 boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
                                         boolean initializing_scene);
@@ -202,6 +328,8 @@ boolean lp_scene_add_resource_reference(struct lp_scene *scene,
 boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                         const struct pipe_resource *resource );
 
+void lp_scene_fence_resources(struct lp_scene *scene);
+
 
 /**
  * Allocate space for a command/data in the bin's data buffer.
@@ -294,13 +422,15 @@ void
 lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y);
 
 
-/* Add a command to bin[x][y].
+/* Add a command to bin[x][y].  Setup jobs binning in parallel pass
+ * their allocator, and may only touch the bins of their own rows.
  */
 static INLINE boolean
-lp_scene_bin_command( struct lp_scene *scene,
-                      unsigned x, unsigned y,
-                      unsigned cmd,
-                      union lp_rast_cmd_arg arg )
+lp_scene_job_bin_command( struct lp_scene *scene,
+                          struct lp_scene_job *job,
+                          unsigned x, unsigned y,
+                          unsigned cmd,
+                          union lp_rast_cmd_arg arg )
 {
    struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
    struct cmd_block *tail = bin->tail;
@@ -310,7 +440,7 @@ lp_scene_bin_command( struct lp_scene *scene,
    assert(cmd < LP_RAST_OP_MAX);
 
    if (tail == NULL || tail->count == CMD_BLOCK_MAX) {
-      tail = lp_scene_new_cmd_block( scene, bin );
+      tail = lp_scene_new_cmd_block( scene, job, bin );
       if (!tail) {
          return FALSE;
       }
@@ -329,29 +459,51 @@ lp_scene_bin_command( struct lp_scene *scene,
 
 
 static INLINE boolean
-lp_scene_bin_cmd_with_state( struct lp_scene *scene,
-                             unsigned x, unsigned y,
-                             const struct lp_rast_state *state,
-                             unsigned cmd,
-                             union lp_rast_cmd_arg arg )
+lp_scene_job_bin_cmd_with_state( struct lp_scene *scene,
+                                 struct lp_scene_job *job,
+                                 unsigned x, unsigned y,
+                                 const struct lp_rast_state *state,
+                                 unsigned cmd,
+                                 union lp_rast_cmd_arg arg )
 {
    struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
 
    if (state != bin->last_state) {
       bin->last_state = state;
-      if (!lp_scene_bin_command(scene, x, y,
-                                LP_RAST_OP_SET_STATE,
-                                lp_rast_arg_state(state)))
+      if (!lp_scene_job_bin_command(scene, job, x, y,
+                                    LP_RAST_OP_SET_STATE,
+                                    lp_rast_arg_state(state)))
          return FALSE;
    }
 
-   if (!lp_scene_bin_command( scene, x, y, cmd, arg ))
+   if (!lp_scene_job_bin_command( scene, job, x, y, cmd, arg ))
       return FALSE;
 
    return TRUE;
 }
 
 
+static INLINE boolean
+lp_scene_bin_command( struct lp_scene *scene,
+                      unsigned x, unsigned y,
+                      unsigned cmd,
+                      union lp_rast_cmd_arg arg )
+{
+   return lp_scene_job_bin_command(scene, NULL, x, y, cmd, arg);
+}
+
+
+static INLINE boolean
+lp_scene_bin_cmd_with_state( struct lp_scene *scene,
+                             unsigned x, unsigned y,
+                             const struct lp_rast_state *state,
+                             unsigned cmd,
+                             union lp_rast_cmd_arg arg )
+{
+   return lp_scene_job_bin_cmd_with_state(scene, NULL, x, y, state, cmd, arg);
+}
+
+
 /* Add a command to all active bins.
  */
 static INLINE boolean
@@ -378,11 +530,19 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 }
 
 
+static INLINE boolean
+lp_scene_has_clears( const struct lp_scene *scene )
+{
+   return scene->clear_color != NULL || scene->clear_zsmask != 0;
+}
+
+
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y, boolean *stolen );
 
 
 
@@ -391,6 +551,7 @@ lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
 void
 lp_scene_begin_binning( struct lp_scene *scene,
                         struct pipe_framebuffer_state *fb,
+                        unsigned tile_order,
                         boolean discard );
 
 void
@@ -405,6 +566,9 @@ lp_scene_begin_rasterization(struct lp_scene *scene);
 void
 lp_scene_end_rasterization(struct lp_scene *scene );
 
+void
+lp_scene_recycle(struct lp_scene *scene);
+
 
 
 
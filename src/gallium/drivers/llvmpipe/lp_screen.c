@@ -40,6 +40,7 @@
 #include "os/os_time.h"
 #include "lp_texture.h"
 #include "lp_fence.h"
+#include "lp_fs_compiler.h"
 #include "lp_jit.h"
 #include "lp_screen.h"
 #include "lp_context.h"
@@ -47,6 +48,9 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_query.h"
+#include "lp_state_cs.h"
+#include "lp_trace.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -80,6 +84,9 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
+   { "tiled_tex",      PERF_TILED_TEX, NULL },
+   { "spec_consts",    PERF_SPEC_CONSTS, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -202,7 +209,7 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
-      return 0;
+      return 1;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
    case PIPE_CAP_USER_INDEX_BUFFERS:
       return 1;
@@ -275,6 +282,86 @@ llvmpipe_get_shader_param(struct pipe_screen *screen, unsigned shader, enum pipe
       default:
          return draw_get_shader_param(shader, param);
       }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+      /* kernels only access memory with LOAD and STORE: constant
+       * buffers, textures and atomics are not supported
+       */
+      case PIPE_SHADER_CAP_MAX_CONSTS:
+      case PIPE_SHADER_CAP_MAX_CONST_BUFFERS:
+      case PIPE_SHADER_CAP_MAX_INPUTS:
+      case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
+      case PIPE_SHADER_CAP_MAX_SAMPLER_VIEWS:
+         return 0;
+      default:
+         return gallivm_get_shader_param(param);
+      }
+   default:
+      return 0;
+   }
+}
+
+static int
+llvmpipe_get_compute_param(struct pipe_screen *screen,
+                           enum pipe_compute_cap param,
+                           void *data)
+{
+   uint64_t *data64 = (uint64_t *)data;
+
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      {
+         static const char target[] = "llvmpipe";
+
+         if (data)
+            memcpy(data, target, sizeof target);
+         return sizeof target;
+      }
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+      if (data)
+         data64[0] = 3;
+      return 8;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (data) {
+         data64[0] = 65535;
+         data64[1] = 65535;
+         data64[2] = 65535;
+      }
+      return 24;
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      /* BARRIER only synchronizes blocks of one vector */
+      if (data) {
+         data64[0] = lp_cs_max_threads();
+         data64[1] = lp_cs_max_threads();
+         data64[2] = lp_cs_max_threads();
+      }
+      return 24;
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (data)
+         data64[0] = lp_cs_max_threads();
+      return 8;
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+      /* all the global bindings, see llvmpipe_set_global_binding() */
+      if (data)
+         data64[0] = (uint64_t)LP_MAX_CS_GLOBALS << LP_CS_GLOBAL_OFFSET_BITS;
+      return 8;
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (data)
+         data64[0] = LP_MAX_CS_LOCAL_SIZE;
+      return 8;
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+      if (data)
+         data64[0] = LP_MAX_CS_PRIVATE_SIZE;
+      return 8;
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+      if (data)
+         data64[0] = LP_MAX_CS_INPUT_SIZE;
+      return 8;
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+      /* a buffer must be addressable with the offset bits */
+      if (data)
+         data64[0] = 1 << LP_CS_GLOBAL_OFFSET_BITS;
+      return 8;
    default:
       return 0;
    }
@@ -298,9 +385,10 @@ llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
       return 16.0; /* arbitrary */
    case PIPE_CAPF_GUARD_BAND_LEFT:
    case PIPE_CAPF_GUARD_BAND_TOP:
+      return (float) LP_GUARD_BAND_MIN;
    case PIPE_CAPF_GUARD_BAND_RIGHT:
    case PIPE_CAPF_GUARD_BAND_BOTTOM:
-      return 0.0;
+      return (float) LP_GUARD_BAND_MAX;
    }
    /* should only get here on unhandled cases */
    debug_printf("Unexpected PIPE_CAP %d query\n", param);
@@ -308,6 +396,35 @@ llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 }
 
 
+/**
+ * Driver specific queries, exposed to the HUD.
+ */
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   static const struct pipe_driver_query_info queries[] = {
+      {"vertex-indices", LP_QUERY_DRAW_INDICES, 0, FALSE},
+      {"shaded-vertices", LP_QUERY_DRAW_SHADED_VERTICES, 0, FALSE},
+      {"scenes", LP_QUERY_SCENES, 0, FALSE},
+      {"bin-time", LP_QUERY_BIN_TIME, 0, FALSE},
+      {"rasterize-time", LP_QUERY_RAST_TIME, 0, FALSE},
+      {"shade-time", LP_QUERY_SHADE_TIME, 0, FALSE},
+      {"wait-time", LP_QUERY_WAIT_TIME, 0, FALSE},
+   };
+
+   if (!info)
+      return Elements(queries);
+
+   if (index >= Elements(queries))
+      return 0;
+
+   *info = queries[index];
+   return 1;
+}
+
+
 /**
  * Query format support for creating a texture, drawing surface, etc.
  * \param format  the format to test
@@ -421,6 +538,12 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct sw_winsys *winsys = screen->winsys;
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
+
+   /* Scenes are rasterized asynchronously, so wait for any scene still
+    * rendering to the display target before presenting it.
+    */
+   lp_rast_wait_resource(screen->rast, resource, FALSE, FALSE);
+
    assert(texture->dt);
    if (texture->dt)
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
@@ -432,6 +555,9 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
 
+   if (screen->fs_compiler)
+      lp_fs_compiler_destroy(screen->fs_compiler);
+
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
@@ -503,6 +629,8 @@ struct pipe_screen *
 llvmpipe_create_screen(struct sw_winsys *winsys)
 {
    struct llvmpipe_screen *screen;
+   unsigned num_compile_threads;
+   unsigned tile_size;
 
    util_cpu_detect();
 
@@ -531,6 +659,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
    screen->base.context_create = llvmpipe_create_context;
@@ -552,6 +682,14 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   lp_trace_init(screen->num_threads);
+
+   tile_size = debug_get_num_option("LP_TILE_SIZE", 0);
+   if (tile_size) {
+      screen->tile_order = CLAMP(util_logbase2(tile_size),
+                                 LP_MIN_TILE_ORDER, LP_MAX_TILE_ORDER);
+   }
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
       lp_jit_screen_cleanup(screen);
@@ -560,6 +698,22 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    pipe_mutex_init(screen->rast_mutex);
 
+   /* Compile optimized fragment shaders in the background, on machines
+    * where that doesn't compete with the application for a single CPU.
+    * LLVM 2.6 and older only support a single execution engine.
+    */
+#if HAVE_LLVM > 0x0206
+   num_compile_threads = screen->num_threads ? 1 : 0;
+#else
+   num_compile_threads = 0;
+#endif
+   num_compile_threads = debug_get_num_option("LP_COMPILE_THREADS",
+                                              num_compile_threads);
+   num_compile_threads = MIN2(num_compile_threads, LP_MAX_COMPILE_THREADS);
+   if (num_compile_threads) {
+      screen->fs_compiler = lp_fs_compiler_create(num_compile_threads);
+   }
+
    util_format_s3tc_init();
 
    return &screen->base;
@@ -41,6 +41,7 @@
 
 
 struct sw_winsys;
+struct lp_fs_compiler;
 
 
 struct llvmpipe_screen
@@ -51,12 +52,18 @@ struct llvmpipe_screen
 
    unsigned num_threads;
 
+   /** Tile order forced with LP_TILE_SIZE, or zero to choose per scene */
+   unsigned tile_order;
+
    /* Increments whenever textures are modified.  Contexts can track this.
     */
    unsigned timestamp;
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /** Background fragment shader compiler, or NULL */
+   struct lp_fs_compiler *fs_compiler;
 };
 
 
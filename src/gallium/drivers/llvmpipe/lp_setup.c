@@ -35,6 +35,7 @@
 #include <limits.h>
 
 #include "pipe/p_defines.h"
+#include "util/u_format.h"
 #include "util/u_framebuffer.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
@@ -47,11 +48,13 @@
 #include "lp_texture.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
+#include "lp_perf.h"
 #include "lp_query.h"
 #include "lp_rast.h"
 #include "lp_setup_context.h"
 #include "lp_screen.h"
 #include "lp_state.h"
+#include "lp_trace.h"
 #include "state_tracker/sw_winsys.h"
 
 #include "draw/draw_context.h"
@@ -63,25 +66,171 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
+/**
+ * Grow the scene ring by inserting a new scene at the current position,
+ * so that the oldest scene in flight is still the next one to be reused.
+ */
+static struct lp_scene *
+lp_setup_grow_scenes(struct lp_setup_context *setup)
+{
+   struct lp_scene *scene;
+   unsigned idx = setup->scene_idx;
+
+   assert(setup->num_scenes < setup->max_scenes);
+
+   scene = lp_scene_create( setup->pipe );
+   if (!scene)
+      return NULL;
+
+   memmove(&setup->scenes[idx + 1], &setup->scenes[idx],
+           (setup->num_scenes - idx) * sizeof setup->scenes[0]);
+   setup->scenes[idx] = scene;
+   setup->num_scenes++;
+
+   LP_COUNT(nr_scenes_created);
+
+   if (LP_DEBUG & DEBUG_SETUP)
+      debug_printf("%s: %u scenes\n", __FUNCTION__, setup->num_scenes);
+
+   return scene;
+}
+
+
+/** Number of tiles of the given order covering a width x height area */
+static INLINE unsigned
+nr_tiles(unsigned width, unsigned height, unsigned order)
+{
+   return (align(width, 1 << order) >> order) *
+          (align(height, 1 << order) >> order);
+}
+
+
+/**
+ * Choose the tile size to bin the next scene with.
+ *
+ * Every bin has a fixed cost, in setup (triangles overlapping several bins
+ * are binned several times) and in the rasterizer, so large framebuffers
+ * are better binned with large tiles.  But there must be enough bins to
+ * spread over the rasterizer threads, so small framebuffers are binned with
+ * small tiles.
+ */
+static unsigned
+choose_tile_order(const struct lp_setup_context *setup)
+{
+   const unsigned width = setup->fb.width;
+   const unsigned height = setup->fb.height;
+   unsigned order = setup->tile_order;
+
+   if (!order) {
+      order = TILE_ORDER;
+      if (setup->num_threads) {
+         if (nr_tiles(width, height, LP_MAX_TILE_ORDER) >=
+             LP_MAX_BINS_PER_THREAD * setup->num_threads)
+            order = LP_MAX_TILE_ORDER;
+         else if (nr_tiles(width, height, TILE_ORDER) <
+                  LP_MIN_BINS_PER_THREAD * setup->num_threads)
+            order = LP_MIN_TILE_ORDER;
+      }
+   }
+
+   /* The bins are sized for the largest framebuffer at the default tile
+    * size.
+    */
+   while (order < TILE_ORDER &&
+          (align(width, 1 << order) >> order > TILES_X ||
+           align(height, 1 << order) >> order > TILES_Y))
+      order++;
+
+   return order;
+}
+
+
+/**
+ * Add the timing of a scene the rasterizer is done with to the context's
+ * totals, and to the trace.
+ */
+static void
+account_scene_timing(struct lp_setup_context *setup, struct lp_scene *scene)
+{
+   struct lp_scene_timing *timing = &scene->timing;
+   struct lp_scene_stats *stats = &setup->scene_stats;
+   unsigned i;
+
+   if (!timing->pending)
+      return;
+
+   assert(scene->fence && lp_fence_signalled(scene->fence));
+
+   stats->nr_scenes++;
+   stats->bin_time += timing->bin_end - timing->bin_start;
+   for (i = 0; i < LP_MAX_THREADS; i++) {
+      if (timing->rast_start[i]) {
+         stats->rast_time += timing->rast_end[i] - timing->rast_start[i];
+         stats->shade_time += timing->shade_time[i];
+      }
+   }
+
+   lp_trace_scene(scene, setup->num_threads);
+
+   timing->pending = FALSE;
+}
+
+
+/**
+ * Get the next scene of the ring for binning.  If the rasterizer is still
+ * busy with it, grow the ring (within the memory budget) rather than wait.
+ */
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
+   struct lp_scene *scene;
+
    assert(setup->scene == NULL);
 
    setup->scene_idx++;
-   setup->scene_idx %= Elements(setup->scenes);
+   setup->scene_idx %= setup->num_scenes;
 
-   setup->scene = setup->scenes[setup->scene_idx];
+   scene = setup->scenes[setup->scene_idx];
 
-   if (setup->scene->fence) {
-      if (LP_DEBUG & DEBUG_SETUP)
-         debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
+   if (scene->fence &&
+       !lp_fence_signalled(scene->fence) &&
+       setup->num_scenes < setup->max_scenes) {
+      struct lp_scene *new_scene = lp_setup_grow_scenes(setup);
+      if (new_scene)
+         scene = new_scene;
+   }
+
+   if (scene->fence) {
+      if (!lp_fence_signalled(scene->fence)) {
+         int64_t start = os_time_get_nano();
+         int64_t end;
+
+         if (LP_DEBUG & DEBUG_SETUP)
+            debug_printf("%s: wait for scene %d\n",
+                         __FUNCTION__, scene->fence->id);
+
+         lp_fence_wait(scene->fence);
 
-      lp_fence_wait(setup->scene->fence);
+         end = os_time_get_nano();
+         LP_COUNT(nr_scene_stalls);
+         LP_COUNT_ADD(scene_stall_time, (end - start) / 1000);
+         lp_setup_account_wait(setup, "wait scene", start, end);
+      }
+
+      account_scene_timing(setup, scene);
+      lp_scene_recycle(scene);
    }
 
-   lp_scene_begin_binning(setup->scene, &setup->fb, setup->rasterizer_discard);
+   memset(&scene->timing, 0, sizeof scene->timing);
+   scene->timing.id = setup->scene_id++;
+   scene->timing.time_shading = setup->shade_timing_refs || lp_trace_active();
+   scene->timing.bin_start = os_time_get_nano();
+
+   setup->scene = scene;
+
+   lp_scene_begin_binning(setup->scene, &setup->fb,
+                          choose_tile_order(setup),
+                          setup->rasterizer_discard);
 
 }
 
@@ -159,17 +308,26 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 
    lp_scene_end_binning(scene);
 
+   scene->timing.bin_end = os_time_get_nano();
+   scene->timing.pending = scene->fence != NULL;
+
    lp_fence_reference(&setup->last_fence, scene->fence);
 
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
+   /* The scene is rasterized asynchronously.  It will be recycled once
+    * its fence is signalled, when the ring comes back around to it.
+    * Until then CPU access to the resources it references waits on it.
+    */
    pipe_mutex_lock(screen->rast_mutex);
+   if (scene->fence)
+      lp_scene_fence_resources(scene);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    pipe_mutex_unlock(screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
+   LP_COUNT(nr_scenes_queued);
+
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -177,6 +335,50 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 
 
 
+/**
+ * Pack the clear color in the format of each of the scene's color buffers,
+ * so that the rasterizer only has to fill the tiles with it.
+ */
+static const struct lp_rast_clear_color *
+pack_clear_color( struct lp_scene *scene,
+                  const union pipe_color_union *color )
+{
+   struct lp_rast_clear_color *clear_color;
+   unsigned i;
+
+   clear_color = lp_scene_alloc(scene, sizeof *clear_color);
+   if (!clear_color)
+      return NULL;
+
+   memset(clear_color, 0, sizeof *clear_color);
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      union util_color uc;
+      enum pipe_format format;
+
+      if (!scene->fb.cbufs[i])
+         continue;
+
+      format = scene->fb.cbufs[i]->format;
+
+      if (util_format_is_pure_sint(format)) {
+         util_format_write_4i(format, color->i, 0, &uc, 0, 0, 0, 1, 1);
+      }
+      else if (util_format_is_pure_uint(format)) {
+         util_format_write_4ui(format, color->ui, 0, &uc, 0, 0, 0, 1, 1);
+      }
+      else {
+         util_pack_color(color->f, format, &uc);
+      }
+
+      assert(util_format_get_blocksize(format) <= sizeof clear_color->packed[i]);
+      memcpy(clear_color->packed[i], &uc, util_format_get_blocksize(format));
+   }
+
+   return clear_color;
+}
+
+
 static boolean
 begin_binning( struct lp_setup_context *setup )
 {
@@ -189,7 +391,7 @@ begin_binning( struct lp_setup_context *setup )
 
    /* Always create a fence:
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -206,12 +408,13 @@ begin_binning( struct lp_setup_context *setup )
           (setup->clear.flags & PIPE_CLEAR_COLOR) ? "clear": "load",
           need_zsload ? "clear": "load");
 
+   /* Clears at the start of the scene aren't binned, but done lazily by
+    * the rasterizer as it gets to each tile.
+    */
    if (setup->fb.nr_cbufs) {
       if (setup->clear.flags & PIPE_CLEAR_COLOR) {
-         ok = lp_scene_bin_everywhere( scene, 
-                                       LP_RAST_OP_CLEAR_COLOR, 
-                                       setup->clear.color );
-         if (!ok)
+         scene->clear_color = pack_clear_color(scene, &setup->clear.color);
+         if (!scene->clear_color)
             return FALSE;
       }
    }
@@ -221,13 +424,8 @@ begin_binning( struct lp_setup_context *setup )
          if (!need_zsload)
             scene->has_depthstencil_clear = TRUE;
 
-         ok = lp_scene_bin_everywhere( scene,
-                                       LP_RAST_OP_CLEAR_ZSTENCIL,
-                                       lp_rast_arg_clearzs(
-                                          setup->clear.zsvalue,
-                                          setup->clear.zsmask));
-         if (!ok)
-            return FALSE;
+         scene->clear_zsvalue = setup->clear.zsvalue;
+         scene->clear_zsmask = setup->clear.zsmask;
       }
    }
 
@@ -243,9 +441,7 @@ begin_binning( struct lp_setup_context *setup )
 
 
 /* This basically bins and then flushes any outstanding full-screen
- * clears.  
- *
- * TODO: fast path for fullscreen clears and no triangles.
+ * clears.  The rasterizer does them as it visits each tile.
  */
 static boolean
 execute_clears( struct lp_setup_context *setup )
@@ -317,7 +513,7 @@ set_scene_state( struct lp_setup_context *setup,
 
 fail:
    if (setup->scene) {
-      lp_scene_end_rasterization(setup->scene);
+      lp_scene_recycle(setup->scene);
       setup->scene = NULL;
    }
 
@@ -376,16 +572,9 @@ lp_setup_try_clear( struct lp_setup_context *setup,
 {
    uint64_t zsmask = 0;
    uint64_t zsvalue = 0;
-   union lp_rast_cmd_arg color_arg;
-   unsigned i;
 
    LP_DBG(DEBUG_SETUP, "%s state %d\n", __FUNCTION__, setup->state);
 
-   if (flags & PIPE_CLEAR_COLOR) {
-      for (i = 0; i < 4; i++)
-         color_arg.clear_color.i[i] = color->i[i];
-   }
-
    if (flags & PIPE_CLEAR_DEPTHSTENCIL) {
       uint32_t zmask = (flags & PIPE_CLEAR_DEPTH) ? ~0 : 0;
       uint8_t smask = (flags & PIPE_CLEAR_STENCIL) ? ~0 : 0;
@@ -412,9 +601,13 @@ lp_setup_try_clear( struct lp_setup_context *setup,
        * a common usage.
        */
       if (flags & PIPE_CLEAR_COLOR) {
-         if (!lp_scene_bin_everywhere( scene, 
+         const struct lp_rast_clear_color *clear_color =
+            pack_clear_color(scene, color);
+
+         if (!clear_color ||
+             !lp_scene_bin_everywhere( scene,
                                        LP_RAST_OP_CLEAR_COLOR,
-                                       color_arg ))
+                                       lp_rast_arg_clear_color(clear_color) ))
             return FALSE;
       }
 
@@ -442,9 +635,7 @@ lp_setup_try_clear( struct lp_setup_context *setup,
       }
 
       if (flags & PIPE_CLEAR_COLOR) {
-         memcpy(&setup->clear.color.clear_color,
-                &color_arg,
-                sizeof setup->clear.color.clear_color);
+         setup->clear.color = *color;
       }
    }
    
@@ -483,13 +674,16 @@ lp_setup_set_triangle_state( struct lp_setup_context *setup,
    setup->ccw_is_frontface = ccw_is_frontface;
    setup->cullmode = cull_mode;
    setup->triangle = first_triangle;
-   setup->pixel_offset = half_pixel_center ? 0.5f : 0.0f;
-   setup->bottom_edge_rule = bottom_edge_rule;
 
-   if (setup->scissor_test != scissor) {
+   if (setup->scissor_test != scissor ||
+       setup->pixel_offset != (half_pixel_center ? 0.5f : 0.0f) ||
+       setup->bottom_edge_rule != bottom_edge_rule) {
       setup->dirty |= LP_SETUP_NEW_SCISSOR;
       setup->scissor_test = scissor;
    }
+
+   setup->pixel_offset = half_pixel_center ? 0.5f : 0.0f;
+   setup->bottom_edge_rule = bottom_edge_rule;
 }
 
 void 
@@ -505,6 +699,7 @@ void
 lp_setup_set_point_state( struct lp_setup_context *setup,
                           float point_size,                          
                           boolean point_size_per_vertex,
+                          boolean point_tri_clip,
                           uint sprite_coord_enable,
                           uint sprite_coord_origin)
 {
@@ -514,6 +709,7 @@ lp_setup_set_point_state( struct lp_setup_context *setup,
    setup->sprite_coord_enable = sprite_coord_enable;
    setup->sprite_coord_origin = sprite_coord_origin;
    setup->point_size_per_vertex = point_size_per_vertex;
+   setup->point_tri_clip = point_tri_clip;
 }
 
 void
@@ -665,9 +861,25 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
     * For use in lp_state_fs.c, propagate the viewport values for all viewports.
     */
    for (i = 0; i < num_viewports; i++) {
+      const float *scale = viewports[i].scale;
+      const float *translate = viewports[i].translate;
+      float bounds[4];
       float min_depth;
       float max_depth;
 
+      /* The guard band lets triangles extend past the viewport, so setup
+       * must keep them within it.
+       */
+      bounds[0] = translate[0] - fabsf(scale[0]);
+      bounds[1] = translate[1] - fabsf(scale[1]);
+      bounds[2] = translate[0] + fabsf(scale[0]);
+      bounds[3] = translate[1] + fabsf(scale[1]);
+
+      if (memcmp(setup->viewport_bounds[i], bounds, sizeof bounds) != 0) {
+         memcpy(setup->viewport_bounds[i], bounds, sizeof bounds);
+         setup->dirty |= LP_SETUP_NEW_SCISSOR;
+      }
+
       if (lp->rasterizer->clip_halfz == 0) {
          float half_depth = viewports[i].scale[2];
          min_depth = viewports[i].translate[2] - half_depth;
@@ -889,9 +1101,23 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < Elements(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
+   /* check the scenes still in flight */
+   for (i = 0; i < setup->num_scenes; i++) {
+      const struct lp_scene *scene = setup->scenes[i];
+      unsigned j;
+
+      if (!scene->fence || lp_fence_signalled(scene->fence))
+         continue;
+
+      for (j = 0; j < scene->fb.nr_cbufs; j++) {
+         if (scene->fb.cbufs[j] && scene->fb.cbufs[j]->texture == texture)
+            return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+      if (scene->fb.zsbuf && scene->fb.zsbuf->texture == texture) {
+         return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+
+      if (lp_scene_is_resource_referenced(scene, texture)) {
          return LP_REFERENCED_FOR_READ;
       }
    }
@@ -900,6 +1126,30 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
 }
 
 
+/**
+ * Compute the pixels inside the viewport bounds, with the same snapping
+ * and fill convention triangles get, so that cutting a triangle at these
+ * matches clipping it at the viewport edges.
+ */
+static void
+viewport_region(const struct lp_setup_context *setup,
+                const float *bounds,
+                struct u_rect *rect)
+{
+   const int adj = (setup->bottom_edge_rule != 0) ? 1 : 0;
+   const int x0 = util_iround(FIXED_ONE * (bounds[0] - setup->pixel_offset));
+   const int y0 = util_iround(FIXED_ONE * (bounds[1] - setup->pixel_offset));
+   const int x1 = util_iround(FIXED_ONE * (bounds[2] - setup->pixel_offset));
+   const int y1 = util_iround(FIXED_ONE * (bounds[3] - setup->pixel_offset));
+
+   /* Left and top (or bottom, per adj) edges are inclusive */
+   rect->x0 = (x0 + FIXED_ONE - 1) >> FIXED_ORDER;
+   rect->x1 = (x1 - 1) >> FIXED_ORDER;
+   rect->y0 = (y0 + FIXED_ONE - 1 + adj) >> FIXED_ORDER;
+   rect->y1 = (y1 - 1 + adj) >> FIXED_ORDER;
+}
+
+
 /**
  * Called by vbuf code when we're about to draw something.
  *
@@ -1077,11 +1327,24 @@ try_update_scene_state( struct lp_setup_context *setup )
    if (setup->dirty & LP_SETUP_NEW_SCISSOR) {
       unsigned i;
       for (i = 0; i < PIPE_MAX_VIEWPORTS; ++i) {
+         struct u_rect viewport;
+
          setup->draw_regions[i] = setup->framebuffer;
          if (setup->scissor_test) {
             u_rect_possible_intersection(&setup->scissors[i],
                                          &setup->draw_regions[i]);
          }
+
+         /* Not u_rect_possible_intersection(), an empty region must stay
+          * empty when used for the scissor planes.
+          */
+         viewport_region(setup, setup->viewport_bounds[i], &viewport);
+         setup->tri_regions[i] = setup->framebuffer;
+         if (setup->scissor_test) {
+            u_rect_find_intersection(&setup->scissors[i],
+                                     &setup->tri_regions[i]);
+         }
+         u_rect_find_intersection(&viewport, &setup->tri_regions[i]);
       }
    }
 
@@ -1186,18 +1449,24 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < Elements(setup->scenes); i++) {
+   /* wait for the scenes still in flight and free them */
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
-         lp_fence_wait(scene->fence);
+      if (scene->fence) {
+         if (scene->fence->issued) {
+            lp_fence_wait(scene->fence);
+            account_scene_timing(setup, scene);
+         }
+         lp_scene_recycle(scene);
+      }
 
       lp_scene_destroy(scene);
    }
 
    lp_fence_reference(&setup->last_fence, NULL);
 
+   FREE( setup->tri_queue.tris );
    FREE( setup );
 }
 
@@ -1228,6 +1497,7 @@ lp_setup_create( struct pipe_context *pipe,
 
 
    setup->num_threads = screen->num_threads;
+   setup->tile_order = screen->tile_order;
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
@@ -1236,8 +1506,30 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
+   /* Set up and bin triangles in parallel on the draw module's worker
+    * threads, when it has any.
+    */
+   setup->draw = draw;
+   setup->tri_queue.num_jobs = MIN2(draw_get_num_threads(draw) + 1,
+                                    LP_MAX_BIN_JOBS);
+   if (setup->tri_queue.num_jobs > 1) {
+      setup->tri_queue.tris = MALLOC(LP_SETUP_MAX_QUEUED_TRIS *
+                                     sizeof *setup->tri_queue.tris);
+      if (!setup->tri_queue.tris)
+         setup->tri_queue.num_jobs = 1;
+   }
+
+   /* Start with two scenes, so that binning and rasterization can
+    * overlap.  The ring grows on demand, when setup would otherwise have
+    * to wait for the rasterizer, up to max_scenes scenes -- i.e. a budget
+    * of max_scenes * LP_SCENE_MAX_SIZE bytes of bin data.
+    */
+   setup->max_scenes = debug_get_num_option("LP_MAX_SCENES", 4);
+   setup->max_scenes = CLAMP(setup->max_scenes, 1, MAX_SCENES);
+   setup->num_scenes = MIN2(2, setup->max_scenes);
+
    /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       setup->scenes[i] = lp_scene_create( pipe );
       if (!setup->scenes[i]) {
          goto no_scenes;
@@ -1253,7 +1545,7 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       if (setup->scenes[i]) {
          lp_scene_destroy(setup->scenes[i]);
       }
@@ -1400,3 +1692,49 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 }
 
 
+/**
+ * Totals of the scenes of the context which the rasterizer finished.
+ */
+const struct lp_scene_stats *
+lp_setup_get_scene_stats(struct lp_setup_context *setup)
+{
+   unsigned i;
+
+   for (i = 0; i < setup->num_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+
+      if (scene->timing.pending && lp_fence_signalled(scene->fence))
+         account_scene_timing(setup, scene);
+   }
+
+   return &setup->scene_stats;
+}
+
+
+/**
+ * Time the fragment shader calls of the scenes binned from now on, while
+ * at least one caller asks for it.
+ */
+void
+lp_setup_time_shading(struct lp_setup_context *setup, boolean enable)
+{
+   if (enable) {
+      setup->shade_timing_refs++;
+   }
+   else {
+      assert(setup->shade_timing_refs);
+      setup->shade_timing_refs--;
+   }
+}
+
+
+/**
+ * Account for the context waiting on the rasterizer.
+ */
+void
+lp_setup_account_wait(struct lp_setup_context *setup, const char *name,
+                      int64_t start, int64_t end)
+{
+   setup->scene_stats.wait_time += end - start;
+   lp_trace_event(name, LP_TRACE_TID_SETUP, start, end, NULL);
+}
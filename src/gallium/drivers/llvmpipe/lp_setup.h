@@ -88,6 +88,7 @@ void
 lp_setup_set_point_state( struct lp_setup_context *setup,
                           float point_size,                          
                           boolean point_size_per_vertex,
+                          boolean point_tri_clip,
                           uint sprite_coord_enable,
                           uint sprite_coord_origin);
 
@@ -159,6 +160,29 @@ void
 lp_setup_end_query(struct lp_setup_context *setup,
                    struct llvmpipe_query *pq);
 
+
+/**
+ * Totals over the scenes of a context which the rasterizer finished, in
+ * nanoseconds.  See lp_scene_timing.
+ */
+struct lp_scene_stats {
+   uint64_t nr_scenes;
+   uint64_t bin_time;
+   uint64_t rast_time;    /**< summed over the rasterizer threads */
+   uint64_t shade_time;   /**< only while shading is timed */
+   uint64_t wait_time;    /**< waiting for free scenes and for finishes */
+};
+
+const struct lp_scene_stats *
+lp_setup_get_scene_stats(struct lp_setup_context *setup);
+
+void
+lp_setup_time_shading(struct lp_setup_context *setup, boolean enable);
+
+void
+lp_setup_account_wait(struct lp_setup_context *setup, const char *name,
+                      int64_t start, int64_t end);
+
 static INLINE unsigned
 lp_clamp_viewport_idx(int idx)
 {
@@ -53,11 +53,33 @@
 struct lp_setup_variant;
 
 
-/** Max number of scenes */
-#define MAX_SCENES 2
+/** Max number of scenes in flight per context */
+#define MAX_SCENES 16
 
 
 
+/**
+ * A set up triangle, and where to bin it.
+ */
+struct lp_setup_tri_bin {
+   struct lp_rast_triangle *tri;   /**< NULL if the triangle was culled */
+   struct u_rect bbox;
+   const struct u_rect *region;
+   int nr_planes;
+};
+
+
+/**
+ * A triangle queued for setup and binning by parallel jobs.
+ */
+struct lp_setup_queued_tri {
+   const float (*v[3])[4];
+   struct lp_setup_tri_bin bin;
+};
+
+#define LP_SETUP_MAX_QUEUED_TRIS 4096
+
+
 /**
  * Point/line/triangle setup context.
  * Note: "stored" below indicates data which is stored in the bins,
@@ -84,19 +106,28 @@ struct lp_setup_context
     * create/install this itself now.
     */
    struct draw_stage *vbuf;
+   struct draw_context *draw;
    unsigned num_threads;
+   unsigned tile_order;                  /**< forced tile order, or zero */
    unsigned scene_idx;
-   struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
+   unsigned num_scenes;                  /**< current size of the ring */
+   unsigned max_scenes;                  /**< max size the ring may grow to */
+   struct lp_scene *scenes[MAX_SCENES];  /**< ring of scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
    struct lp_fence *last_fence;
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned active_binned_queries;
 
+   struct lp_scene_stats scene_stats;
+   unsigned scene_id;                    /**< timing id of the next scene */
+   unsigned shade_timing_refs;           /**< active shade time queries */
+
    boolean flatshade_first;
    boolean ccw_is_frontface;
    boolean scissor_test;
    boolean point_size_per_vertex;
+   boolean point_tri_clip;
    boolean rasterizer_discard;
    unsigned cullmode;
    unsigned bottom_edge_rule;
@@ -112,11 +143,13 @@ struct lp_setup_context
    struct u_rect framebuffer;
    struct u_rect scissors[PIPE_MAX_VIEWPORTS];
    struct u_rect draw_regions[PIPE_MAX_VIEWPORTS];   /* intersection of fb & scissor */
+   struct u_rect tri_regions[PIPE_MAX_VIEWPORTS];    /* draw_regions within the viewport */
+   float viewport_bounds[PIPE_MAX_VIEWPORTS][4];     /* viewport xmin, ymin, xmax, ymax */
    struct lp_jit_viewport viewports[PIPE_MAX_VIEWPORTS];
 
    struct {
       unsigned flags;
-      union lp_rast_cmd_arg color;    /**< lp_rast_clear_color() cmd */
+      union pipe_color_union color;   /**< lp_rast_clear_color() cmd */
       uint64_t zsmask;
       uint64_t zsvalue;               /**< lp_rast_clear_zstencil() cmd */
    } clear;
@@ -163,9 +196,26 @@ struct lp_setup_context
                      const float (*v0)[4],
                      const float (*v1)[4],
                      const float (*v2)[4]);
+
+   /**
+    * Triangles waiting to be set up and binned in parallel, on the draw
+    * module's worker threads.  Then 'triangle' above just queues them,
+    * and this 'triangle' is the one which culls and bins them.
+    */
+   struct {
+      unsigned num_jobs;      /**< 1 if not binning in parallel */
+      unsigned count;
+      struct lp_setup_queued_tri *tris;
+
+      void (*triangle)( struct lp_setup_context *,
+                        const float (*v0)[4],
+                        const float (*v1)[4],
+                        const float (*v2)[4]);
+   } tri_queue;
 };
 
 void lp_setup_choose_triangle( struct lp_setup_context *setup );
+void lp_setup_flush_triangles( struct lp_setup_context *setup );
 void lp_setup_choose_line( struct lp_setup_context *setup );
 void lp_setup_choose_point( struct lp_setup_context *setup );
 
@@ -192,6 +242,7 @@ lp_setup_print_vertex(struct lp_setup_context *setup,
 
 struct lp_rast_triangle *
 lp_setup_alloc_triangle(struct lp_scene *scene,
+                        struct lp_scene_job *job,
                         unsigned num_inputs,
                         unsigned nr_planes,
                         unsigned *tri_size);
@@ -200,7 +251,7 @@ boolean
 lp_setup_bin_triangle( struct lp_setup_context *setup,
                        struct lp_rast_triangle *tri,
                        const struct u_rect *bbox,
-                       int nr_planes,
-                       unsigned scissor_index );
+                       const struct u_rect *region,
+                       int nr_planes );
 
 #endif
@@ -579,12 +579,7 @@ try_setup_line( struct lp_setup_context *setup,
       return TRUE;
    }
 
-   /* Can safely discard negative regions:
-    */
-   bbox.x0 = MAX2(bbox.x0, 0);
-   bbox.y0 = MAX2(bbox.y0, 0);
-
-   line = lp_setup_alloc_triangle(scene,
+   line = lp_setup_alloc_triangle(scene, NULL,
                                   key->num_inputs,
                                   nr_planes,
                                   &tri_bytes);
@@ -721,7 +716,9 @@ try_setup_line( struct lp_setup_context *setup,
       plane[7].eo = 0;
    }
 
-   return lp_setup_bin_triangle(setup, line, &bbox, nr_planes, viewport_index);
+   return lp_setup_bin_triangle(setup, line, &bbox,
+                                &setup->draw_regions[viewport_index],
+                                nr_planes);
 }
 
 
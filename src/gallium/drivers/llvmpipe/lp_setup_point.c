@@ -344,6 +344,7 @@ try_setup_point( struct lp_setup_context *setup,
    struct lp_rast_triangle *point;
    unsigned bytes;
    struct u_rect bbox;
+   const struct u_rect *region;
    unsigned nr_planes = 4;
    struct point_info info;
    unsigned viewport_index = 0;
@@ -354,6 +355,13 @@ try_setup_point( struct lp_setup_context *setup,
       unsigned *udata = (unsigned*)v0[setup->viewport_index_slot];
       viewport_index = lp_clamp_viewport_idx(*udata);
    }
+   /* With point_tri_clip draw leaves points in its guard band, and they
+    * get clipped to the viewport here like triangles.
+    */
+   if (setup->point_tri_clip)
+      region = &setup->tri_regions[viewport_index];
+   else
+      region = &setup->draw_regions[viewport_index];
    if (setup->layer_slot > 0) {
       layer = *(unsigned*)v0[setup->layer_slot];
       layer = MIN2(layer, scene->fb_max_layer);
@@ -436,15 +444,15 @@ try_setup_point( struct lp_setup_context *setup,
                    bbox.x1, bbox.y1);
    }
 
-   if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
+   if (!u_rect_test_intersection(region, &bbox)) {
       if (0) debug_printf("offscreen\n");
       LP_COUNT(nr_culled_tris);
       return TRUE;
    }
 
-   u_rect_find_intersection(&setup->draw_regions[viewport_index], &bbox);
+   u_rect_find_intersection(region, &bbox);
 
-   point = lp_setup_alloc_triangle(scene,
+   point = lp_setup_alloc_triangle(scene, NULL,
                                    key->num_inputs,
                                    nr_planes,
                                    &bytes);
@@ -513,7 +521,7 @@ try_setup_point( struct lp_setup_context *setup,
       plane[3].eo = 0;
    }
 
-   return lp_setup_bin_triangle(setup, point, &bbox, nr_planes, viewport_index);
+   return lp_setup_bin_triangle(setup, point, &bbox, region, nr_planes);
 }
 
 
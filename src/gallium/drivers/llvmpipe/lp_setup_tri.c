@@ -33,6 +33,7 @@
 #include "util/u_memory.h"
 #include "util/u_rect.h"
 #include "util/u_sse.h"
+#include "draw/draw_context.h"
 #include "lp_perf.h"
 #include "lp_setup_context.h"
 #include "lp_rast.h"
@@ -77,12 +78,14 @@ struct fixed_position {
  * Alloc space for a new triangle plus the input.a0/dadx/dady arrays
  * immediately after it.
  * The memory is allocated from the per-scene pool, not per-tile.
+ * \param job  the allocator of the parallel setup job, or NULL
  * \param tri_size  returns number of bytes allocated
  * \param num_inputs  number of fragment shader inputs
  * \return pointer to triangle space
  */
 struct lp_rast_triangle *
 lp_setup_alloc_triangle(struct lp_scene *scene,
+                        struct lp_scene_job *job,
                         unsigned nr_inputs,
                         unsigned nr_planes,
                         unsigned *tri_size)
@@ -95,7 +98,10 @@ lp_setup_alloc_triangle(struct lp_scene *scene,
                 3 * input_array_sz +
                 plane_sz);
 
-   tri = lp_scene_alloc_aligned( scene, *tri_size, 16 );
+   if (job)
+      tri = lp_scene_job_alloc( scene, job, *tri_size, 16, FALSE );
+   else
+      tri = lp_scene_alloc_aligned( scene, *tri_size, 16 );
    if (tri == NULL)
       return NULL;
 
@@ -211,6 +217,7 @@ lp_rast_32_tri_tab[MAX_PLANES+1] = {
  */
 static boolean
 lp_setup_whole_tile(struct lp_setup_context *setup,
+                    struct lp_scene_job *job,
                     const struct lp_rast_shader_inputs *inputs,
                     int tx, int ty)
 {
@@ -240,37 +247,43 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
       }
 
       LP_COUNT(nr_shade_opaque_64);
-      return lp_scene_bin_cmd_with_state( scene, tx, ty,
-                                          setup->fs.stored,
-                                          LP_RAST_OP_SHADE_TILE_OPAQUE,
-                                          lp_rast_arg_inputs(inputs) );
+      return lp_scene_job_bin_cmd_with_state( scene, job, tx, ty,
+                                              setup->fs.stored,
+                                              LP_RAST_OP_SHADE_TILE_OPAQUE,
+                                              lp_rast_arg_inputs(inputs) );
    } else {
       LP_COUNT(nr_shade_64);
-      return lp_scene_bin_cmd_with_state( scene, tx, ty,
-                                          setup->fs.stored, 
-                                          LP_RAST_OP_SHADE_TILE,
-                                          lp_rast_arg_inputs(inputs) );
+      return lp_scene_job_bin_cmd_with_state( scene, job, tx, ty,
+                                              setup->fs.stored, 
+                                              LP_RAST_OP_SHADE_TILE,
+                                              lp_rast_arg_inputs(inputs) );
    }
 }
 
 
 /**
- * Do basic setup for triangle rasterization and determine which
- * framebuffer tiles are touched.  Put the triangle in the scene's
- * bins for the tiles which we overlap.
+ * Do basic setup for triangle rasterization: allocate the triangle in the
+ * scene, and work out its bounding box and planes for binning.
+ * \param job  the allocator of the parallel setup job, or NULL
+ * \param out  returns the triangle and where to bin it; out->tri is NULL
+ *             if the triangle was culled
+ * \return FALSE if the scene is out of space
  */
 static boolean
-do_triangle_ccw(struct lp_setup_context *setup,
-                struct fixed_position* position,
-                const float (*v0)[4],
-                const float (*v1)[4],
-                const float (*v2)[4],
-                boolean frontfacing )
+setup_triangle_ccw(struct lp_setup_context *setup,
+                   struct lp_scene_job *job,
+                   struct fixed_position* position,
+                   const float (*v0)[4],
+                   const float (*v1)[4],
+                   const float (*v2)[4],
+                   boolean frontfacing,
+                   struct lp_setup_tri_bin *out)
 {
    struct lp_scene *scene = setup->scene;
    const struct lp_setup_variant_key *key = &setup->setup.variant->key;
    struct lp_rast_triangle *tri;
    struct lp_rast_plane *plane;
+   const struct u_rect *region;
    struct u_rect bbox;
    unsigned tri_bytes;
    int nr_planes = 3;
@@ -283,16 +296,11 @@ do_triangle_ccw(struct lp_setup_context *setup,
    if (0)
       lp_setup_print_triangle(setup, v0, v1, v2);
 
-   if (setup->scissor_test) {
-      nr_planes = 7;
-      if (setup->viewport_index_slot > 0) {
-         unsigned *udata = (unsigned*)v0[setup->viewport_index_slot];
-         viewport_index = lp_clamp_viewport_idx(*udata);
-      }
-   }
-   else {
-      nr_planes = 3;
+   if (setup->viewport_index_slot > 0) {
+      unsigned *udata = (unsigned*)v0[setup->viewport_index_slot];
+      viewport_index = lp_clamp_viewport_idx(*udata);
    }
+   region = &setup->tri_regions[viewport_index];
    if (setup->layer_slot > 0) {
       layer = *(unsigned*)v1[setup->layer_slot];
       layer = MIN2(layer, scene->fb_max_layer);
@@ -320,23 +328,38 @@ do_triangle_ccw(struct lp_setup_context *setup,
        bbox.y1 < bbox.y0) {
       if (0) debug_printf("empty bounding box\n");
       LP_COUNT(nr_culled_tris);
+      out->tri = NULL;
       return TRUE;
    }
 
-   if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
+   if (!u_rect_test_intersection(region, &bbox)) {
       if (0) debug_printf("offscreen\n");
       LP_COUNT(nr_culled_tris);
+      out->tri = NULL;
       return TRUE;
    }
 
-   /* Can safely discard negative regions, but need to keep hold of
-    * information about when the triangle extends past screen
-    * boundaries.  See trimmed_box in lp_setup_bin_triangle().
+   /* Triangles may extend past the viewport into the guard band, so
+    * whenever they cover framebuffer pixels outside of it, cut them at
+    * the viewport edges with the scissor planes.
     */
-   bbox.x0 = MAX2(bbox.x0, 0);
-   bbox.y0 = MAX2(bbox.y0, 0);
+   if (setup->scissor_test) {
+      nr_planes = 7;
+   }
+   else {
+      const struct u_rect *fb = &setup->framebuffer;
+
+      if (MAX2(bbox.x0, fb->x0) < region->x0 ||
+          MIN2(bbox.x1, fb->x1) > region->x1 ||
+          MAX2(bbox.y0, fb->y0) < region->y0 ||
+          MIN2(bbox.y1, fb->y1) > region->y1) {
+         LP_COUNT(nr_guard_band_tris);
+         nr_planes = 7;
+      }
+   }
 
    tri = lp_setup_alloc_triangle(scene,
+                                 job,
                                  key->num_inputs,
                                  nr_planes,
                                  &tri_bytes);
@@ -381,8 +404,8 @@ do_triangle_ccw(struct lp_setup_context *setup,
 #if defined(PIPE_ARCH_SSE)
    if (setup->fb.width <= MAX_FIXED_LENGTH32 &&
        setup->fb.height <= MAX_FIXED_LENGTH32 &&
-       (bbox.x1 - bbox.x0) <= MAX_FIXED_LENGTH32 &&
-       (bbox.y1 - bbox.y0) <= MAX_FIXED_LENGTH32) {
+       bbox.x0 >= 0 && bbox.x1 < MAX_FIXED_LENGTH32 &&
+       bbox.y0 >= 0 && bbox.y1 < MAX_FIXED_LENGTH32) {
       __m128i vertx, verty;
       __m128i shufx, shufy;
       __m128i dcdx, dcdy, c;
@@ -531,8 +554,8 @@ do_triangle_ccw(struct lp_setup_context *setup,
 
    /* 
     * When rasterizing scissored tris, use the intersection of the
-    * triangle bounding box and the scissor rect to generate the
-    * scissor planes.
+    * triangle bounding box and the scissor rect (and viewport) to
+    * generate the scissor planes.
     *
     * This permits us to cut off the triangle "tails" that are present
     * in the intermediate recursive levels caused when two of the
@@ -548,7 +571,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
     * these planes elsewhere.
     */
    if (nr_planes == 7) {
-      const struct u_rect *scissor = &setup->scissors[viewport_index];
+      const struct u_rect *scissor = region;
 
       plane[3].dcdx = -1;
       plane[3].dcdy = 0;
@@ -571,7 +594,11 @@ do_triangle_ccw(struct lp_setup_context *setup,
       plane[6].eo = 0;
    }
 
-   return lp_setup_bin_triangle(setup, tri, &bbox, nr_planes, viewport_index);
+   out->tri = tri;
+   out->bbox = bbox;
+   out->region = region;
+   out->nr_planes = nr_planes;
+   return TRUE;
 }
 
 /*
@@ -601,62 +628,98 @@ floor_pot(uint32_t n)
 }
 
 
-boolean
-lp_setup_bin_triangle( struct lp_setup_context *setup,
-                       struct lp_rast_triangle *tri,
-                       const struct u_rect *bbox,
-                       int nr_planes,
-                       unsigned viewport_index )
+/**
+ * Put the triangle in the scene's bins for the tiles which it overlaps.
+ * Parallel setup jobs pass their allocator, and only bin into the tile
+ * rows y with y % num_stripes == stripe.
+ */
+static boolean
+bin_triangle( struct lp_setup_context *setup,
+              struct lp_scene_job *job,
+              struct lp_rast_triangle *tri,
+              const struct u_rect *full_bbox,
+              const struct u_rect *region,
+              int nr_planes,
+              unsigned stripe,
+              unsigned num_stripes )
 {
    struct lp_scene *scene = setup->scene;
-   struct u_rect trimmed_box = *bbox;   
+   const unsigned tile_order = scene->tile_order;
+   const int tile_size = scene->tile_size;
+   struct u_rect box;
+   const struct u_rect *bbox = &box;
+   struct u_rect trimmed_box;
    int i;
+   int dx, max_sz, sz;
+   boolean use_32bits, use_32bits_tile;
+
+   /* The 32-bit rasterizers need the extents of the whole triangle,
+    * including any part in the guard band, to stay in range.
+    */
+   use_32bits = ((full_bbox->x1 - (full_bbox->x0 & ~3)) |
+                 (full_bbox->y1 - (full_bbox->y0 & ~3))) <= MAX_FIXED_LENGTH32;
+
+   /* Can safely discard negative regions, but need to keep hold of
+    * information about when the triangle extends past screen
+    * boundaries.  See trimmed_box below.
+    */
+   box = *full_bbox;
+   box.x0 = MAX2(box.x0, 0);
+   box.y0 = MAX2(box.y0, 0);
+   trimmed_box = box;
+
    /* What is the largest power-of-two boundary this triangle crosses:
     */
-   int dx = floor_pot((bbox->x0 ^ bbox->x1) |
-		      (bbox->y0 ^ bbox->y1));
+   dx = floor_pot((bbox->x0 ^ bbox->x1) |
+                  (bbox->y0 ^ bbox->y1));
 
    /* The largest dimension of the rasterized area of the triangle
     * (aligned to a 4x4 grid), rounded down to the nearest power of two:
     */
-   int max_sz = ((bbox->x1 - (bbox->x0 & ~3)) |
-                 (bbox->y1 - (bbox->y0 & ~3)));
-   int sz = floor_pot(max_sz);
-   boolean use_32bits = max_sz <= MAX_FIXED_LENGTH32;
+   max_sz = ((bbox->x1 - (bbox->x0 & ~3)) |
+             (bbox->y1 - (bbox->y0 & ~3)));
+   sz = floor_pot(max_sz);
+
+   /* The 32-bit rasterizers evaluate the edge functions over whole tiles,
+    * which only stays within range up to the default tile size.
+    */
+   use_32bits_tile = use_32bits && tile_order <= TILE_ORDER;
 
    /* Now apply scissor, etc to the bounding box.  Could do this
     * earlier, but it confuses the logic for tri-16 and would force
     * the rasterizer to also respect scissor, etc, just for the rare
     * cases where a small triangle extends beyond the scissor.
     */
-   u_rect_find_intersection(&setup->draw_regions[viewport_index],
-                            &trimmed_box);
+   u_rect_find_intersection(region, &trimmed_box);
 
    /* Determine which tile(s) intersect the triangle's bounding box
     */
-   if (dx < TILE_SIZE)
+   if (dx < tile_size)
    {
-      int ix0 = bbox->x0 / TILE_SIZE;
-      int iy0 = bbox->y0 / TILE_SIZE;
-      unsigned px = bbox->x0 & 63 & ~3;
-      unsigned py = bbox->y0 & 63 & ~3;
+      int ix0 = bbox->x0 / tile_size;
+      int iy0 = bbox->y0 / tile_size;
+      unsigned px = bbox->x0 & (tile_size - 1) & ~3;
+      unsigned py = bbox->y0 & (tile_size - 1) & ~3;
+
+      assert(iy0 == bbox->y1 / tile_size &&
+	     ix0 == bbox->x1 / tile_size);
 
-      assert(iy0 == bbox->y1 / TILE_SIZE &&
-	     ix0 == bbox->x1 / TILE_SIZE);
+      if (iy0 % num_stripes != stripe)
+         return TRUE;
 
       if (nr_planes == 3) {
          if (sz < 4)
          {
             /* Triangle is contained in a single 4x4 stamp:
              */
-            assert(px + 4 <= TILE_SIZE);
-            assert(py + 4 <= TILE_SIZE);
-            return lp_scene_bin_cmd_with_state( scene, ix0, iy0,
-                                                setup->fs.stored,
-                                                use_32bits ?
-                                                LP_RAST_OP_TRIANGLE_32_3_4 :
-                                                LP_RAST_OP_TRIANGLE_3_4,
-                                                lp_rast_arg_triangle_contained(tri, px, py) );
+            assert(px + 4 <= tile_size);
+            assert(py + 4 <= tile_size);
+            return lp_scene_job_bin_cmd_with_state( scene, job, ix0, iy0,
+                                                    setup->fs.stored,
+                                                    use_32bits ?
+                                                    LP_RAST_OP_TRIANGLE_32_3_4 :
+                                                    LP_RAST_OP_TRIANGLE_3_4,
+                                                    lp_rast_arg_triangle_contained(tri, px, py) );
          }
 
          if (sz < 16)
@@ -669,42 +732,42 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
              * dimensions if the triangle is 16 pixels in one dimension but 4
              * in the other. So budge the 16x16 back inside the tile.
              */
-            px = MIN2(px, TILE_SIZE - 16);
-            py = MIN2(py, TILE_SIZE - 16);
-
-            assert(px + 16 <= TILE_SIZE);
-            assert(py + 16 <= TILE_SIZE);
-
-            return lp_scene_bin_cmd_with_state( scene, ix0, iy0,
-                                                setup->fs.stored,
-                                                use_32bits ?
-                                                LP_RAST_OP_TRIANGLE_32_3_16 :
-                                                LP_RAST_OP_TRIANGLE_3_16,
-                                                lp_rast_arg_triangle_contained(tri, px, py) );
+            px = MIN2(px, tile_size - 16);
+            py = MIN2(py, tile_size - 16);
+
+            assert(px + 16 <= tile_size);
+            assert(py + 16 <= tile_size);
+
+            return lp_scene_job_bin_cmd_with_state( scene, job, ix0, iy0,
+                                                    setup->fs.stored,
+                                                    use_32bits ?
+                                                    LP_RAST_OP_TRIANGLE_32_3_16 :
+                                                    LP_RAST_OP_TRIANGLE_3_16,
+                                                    lp_rast_arg_triangle_contained(tri, px, py) );
          }
       }
       else if (nr_planes == 4 && sz < 16) 
       {
-         px = MIN2(px, TILE_SIZE - 16);
-         py = MIN2(py, TILE_SIZE - 16);
-
-         assert(px + 16 <= TILE_SIZE);
-         assert(py + 16 <= TILE_SIZE);
-
-         return lp_scene_bin_cmd_with_state(scene, ix0, iy0,
-                                            setup->fs.stored,
-                                            use_32bits ?
-                                            LP_RAST_OP_TRIANGLE_32_4_16 :
-                                            LP_RAST_OP_TRIANGLE_4_16,
-                                            lp_rast_arg_triangle_contained(tri, px, py));
+         px = MIN2(px, tile_size - 16);
+         py = MIN2(py, tile_size - 16);
+
+         assert(px + 16 <= tile_size);
+         assert(py + 16 <= tile_size);
+
+         return lp_scene_job_bin_cmd_with_state(scene, job, ix0, iy0,
+                                                setup->fs.stored,
+                                                use_32bits ?
+                                                LP_RAST_OP_TRIANGLE_32_4_16 :
+                                                LP_RAST_OP_TRIANGLE_4_16,
+                                                lp_rast_arg_triangle_contained(tri, px, py));
       }
 
 
       /* Triangle is contained in a single tile:
        */
-      return lp_scene_bin_cmd_with_state(
-         scene, ix0, iy0, setup->fs.stored,
-         use_32bits ? lp_rast_32_tri_tab[nr_planes] : lp_rast_tri_tab[nr_planes],
+      return lp_scene_job_bin_cmd_with_state(
+         scene, job, ix0, iy0, setup->fs.stored,
+         use_32bits_tile ? lp_rast_32_tri_tab[nr_planes] : lp_rast_tri_tab[nr_planes],
          lp_rast_arg_triangle(tri, (1<<nr_planes)-1));
    }
    else
@@ -718,23 +781,23 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
       int64_t ystep[MAX_PLANES];
       int x, y;
 
-      int ix0 = trimmed_box.x0 / TILE_SIZE;
-      int iy0 = trimmed_box.y0 / TILE_SIZE;
-      int ix1 = trimmed_box.x1 / TILE_SIZE;
-      int iy1 = trimmed_box.y1 / TILE_SIZE;
+      int ix0 = trimmed_box.x0 / tile_size;
+      int iy0 = trimmed_box.y0 / tile_size;
+      int ix1 = trimmed_box.x1 / tile_size;
+      int iy1 = trimmed_box.y1 / tile_size;
       
       for (i = 0; i < nr_planes; i++) {
          c[i] = (plane[i].c + 
-                 IMUL64(plane[i].dcdy, iy0) * TILE_SIZE -
-                 IMUL64(plane[i].dcdx, ix0) * TILE_SIZE);
+                 IMUL64(plane[i].dcdy, iy0) * tile_size -
+                 IMUL64(plane[i].dcdx, ix0) * tile_size);
 
-         ei[i] = (plane[i].dcdy - 
-                  plane[i].dcdx - 
-                  plane[i].eo) << TILE_ORDER;
+         ei[i] = ((int64_t)plane[i].dcdy -
+                  plane[i].dcdx -
+                  plane[i].eo) << tile_order;
 
-         eo[i] = plane[i].eo << TILE_ORDER;
-         xstep[i] = -(((int64_t)plane[i].dcdx) << TILE_ORDER);
-         ystep[i] = ((int64_t)plane[i].dcdy) << TILE_ORDER;
+         eo[i] = plane[i].eo << tile_order;
+         xstep[i] = -(((int64_t)plane[i].dcdx) << tile_order);
+         ystep[i] = ((int64_t)plane[i].dcdy) << tile_order;
       }
 
 
@@ -749,6 +812,13 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
          boolean in = FALSE;  /* are we inside the triangle? */
          int64_t cx[MAX_PLANES];
 
+         if (y % num_stripes != stripe) {
+            /* Another job bins this row */
+            for (i = 0; i < nr_planes; i++)
+               c[i] += ystep[i];
+            continue;
+         }
+
          for (i = 0; i < nr_planes; i++)
             cx[i] = c[i];
 
@@ -777,12 +847,12 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                int count = util_bitcount(partial);
                in = TRUE;
                
-               if (!lp_scene_bin_cmd_with_state( scene, x, y,
-                                                 setup->fs.stored,
-                                                 use_32bits ?
-                                                 lp_rast_32_tri_tab[count] :
-                                                 lp_rast_tri_tab[count],
-                                                 lp_rast_arg_triangle(tri, partial) ))
+               if (!lp_scene_job_bin_cmd_with_state( scene, job, x, y,
+                                                     setup->fs.stored,
+                                                     use_32bits_tile ?
+                                                     lp_rast_32_tri_tab[count] :
+                                                     lp_rast_tri_tab[count],
+                                                     lp_rast_arg_triangle(tri, partial) ))
                   goto fail;
 
                LP_COUNT(nr_partially_covered_64);
@@ -791,7 +861,7 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                /* triangle covers the whole tile- shade whole tile */
                LP_COUNT(nr_fully_covered_64);
                in = TRUE;
-               if (!lp_setup_whole_tile(setup, &tri->inputs, x, y))
+               if (!lp_setup_whole_tile(setup, job, &tri->inputs, x, y))
                   goto fail;
             }
 
@@ -818,6 +888,44 @@ fail:
 }
 
 
+boolean
+lp_setup_bin_triangle( struct lp_setup_context *setup,
+                       struct lp_rast_triangle *tri,
+                       const struct u_rect *full_bbox,
+                       const struct u_rect *region,
+                       int nr_planes )
+{
+   return bin_triangle(setup, NULL, tri, full_bbox, region, nr_planes, 0, 1);
+}
+
+
+/**
+ * Do basic setup for triangle rasterization and determine which
+ * framebuffer tiles are touched.  Put the triangle in the scene's
+ * bins for the tiles which we overlap.
+ */
+static boolean
+do_triangle_ccw(struct lp_setup_context *setup,
+                struct fixed_position* position,
+                const float (*v0)[4],
+                const float (*v1)[4],
+                const float (*v2)[4],
+                boolean frontfacing )
+{
+   struct lp_setup_tri_bin bin;
+
+   if (!setup_triangle_ccw(setup, NULL, position, v0, v1, v2, frontfacing,
+                           &bin))
+      return FALSE;
+
+   if (!bin.tri)
+      return TRUE;
+
+   return lp_setup_bin_triangle(setup, bin.tri, &bin.bbox, bin.region,
+                                bin.nr_planes);
+}
+
+
 /**
  * Try to draw the triangle, restart the scene on failure.
  */
@@ -1007,6 +1115,203 @@ static void triangle_nop( struct lp_setup_context *setup,
 }
 
 
+/**
+ * Queue the triangle, to be set up and binned in parallel by
+ * lp_setup_flush_triangles().
+ */
+static void triangle_queue( struct lp_setup_context *setup,
+                            const float (*v0)[4],
+                            const float (*v1)[4],
+                            const float (*v2)[4] )
+{
+   struct lp_setup_queued_tri *qt;
+
+   if (setup->tri_queue.count == LP_SETUP_MAX_QUEUED_TRIS)
+      lp_setup_flush_triangles(setup);
+
+   qt = &setup->tri_queue.tris[setup->tri_queue.count++];
+   qt->v[0] = v0;
+   qt->v[1] = v1;
+   qt->v[2] = v2;
+}
+
+
+/* Fewer triangles than this are not worth a parallel job */
+#define MIN_JOB_TRIS 128
+
+
+/**
+ * Triangles lp_setup_flush_triangles() hands out to the parallel jobs.
+ */
+struct tri_jobs {
+   struct lp_setup_context *setup;
+   struct lp_setup_queued_tri *tris;
+   unsigned start, end;      /**< range of tris to set up, or to bin */
+   unsigned num_jobs;
+   boolean keep_ccw, keep_cw;
+
+   /** First triangle each setup job ran out of scene space on, or 'end' */
+   unsigned failed[LP_MAX_BIN_JOBS];
+};
+
+
+/**
+ * Set up a contiguous range of the queued triangles.
+ */
+static void
+setup_triangles_job(void *data, unsigned job)
+{
+   struct tri_jobs *jobs = (struct tri_jobs *) data;
+   struct lp_setup_context *setup = jobs->setup;
+   struct lp_scene_job *alloc = &setup->scene->jobs[job];
+   unsigned count = jobs->end - jobs->start;
+   unsigned begin = jobs->start + count * job / jobs->num_jobs;
+   unsigned end = jobs->start + count * (job + 1) / jobs->num_jobs;
+   unsigned i;
+
+   jobs->failed[job] = jobs->end;
+
+   for (i = begin; i < end; i++) {
+      struct lp_setup_queued_tri *qt = &jobs->tris[i];
+      struct fixed_position position;
+      boolean ok = TRUE;
+
+      calc_fixed_position(setup, &position, qt->v[0], qt->v[1], qt->v[2]);
+
+      qt->bin.tri = NULL;
+
+      /* Cull and orient like triangle_cw/ccw/both */
+      if (position.area > 0 && jobs->keep_ccw) {
+         ok = setup_triangle_ccw(setup, alloc, &position,
+                                 qt->v[0], qt->v[1], qt->v[2],
+                                 setup->ccw_is_frontface, &qt->bin);
+      }
+      else if (position.area < 0 && jobs->keep_cw) {
+         if (setup->flatshade_first) {
+            rotate_fixed_position_12(&position);
+            ok = setup_triangle_ccw(setup, alloc, &position,
+                                    qt->v[0], qt->v[2], qt->v[1],
+                                    !setup->ccw_is_frontface, &qt->bin);
+         } else {
+            rotate_fixed_position_01(&position);
+            ok = setup_triangle_ccw(setup, alloc, &position,
+                                    qt->v[1], qt->v[0], qt->v[2],
+                                    !setup->ccw_is_frontface, &qt->bin);
+         }
+      }
+
+      if (!ok) {
+         jobs->failed[job] = i;
+         return;
+      }
+   }
+}
+
+
+/**
+ * Bin all the set up triangles into one stripe of tile rows.  Each job
+ * walks the triangles in order, so the commands in every bin come out in
+ * the same order as when binning on a single thread.
+ */
+static void
+bin_triangles_job(void *data, unsigned job)
+{
+   struct tri_jobs *jobs = (struct tri_jobs *) data;
+   struct lp_setup_context *setup = jobs->setup;
+   struct lp_scene_job *alloc = &setup->scene->jobs[job];
+   unsigned i;
+
+   for (i = jobs->start; i < jobs->end; i++) {
+      const struct lp_setup_tri_bin *bin = &jobs->tris[i].bin;
+
+      /* Failing here means malloc failed, as jobs may go over the scene's
+       * budget.  The triangle is disabled then, like in retry_triangle_ccw.
+       */
+      if (bin->tri)
+         bin_triangle(setup, alloc, bin->tri, &bin->bbox, bin->region,
+                      bin->nr_planes, job, jobs->num_jobs);
+   }
+}
+
+
+/**
+ * Set up and bin the queued triangles.  This is done in two passes of
+ * parallel jobs on the draw module's worker threads: the first sets up
+ * ranges of triangles, the second bins all of them into stripes of tile
+ * rows.  When the scene fills up during setup, the triangles which made
+ * it are binned, and the rest go into a new scene.
+ */
+void
+lp_setup_flush_triangles( struct lp_setup_context *setup )
+{
+   struct lp_setup_queued_tri *tris = setup->tri_queue.tris;
+   unsigned count = setup->tri_queue.count;
+   boolean restarted = FALSE;
+   struct tri_jobs jobs;
+   unsigned i;
+
+   if (!count)
+      return;
+
+   setup->tri_queue.count = 0;
+
+   if (count < 2 * MIN_JOB_TRIS) {
+      for (i = 0; i < count; i++)
+         setup->tri_queue.triangle(setup, tris[i].v[0], tris[i].v[1],
+                                   tris[i].v[2]);
+      return;
+   }
+
+   if (setup->tri_queue.triangle == triangle_both) {
+      struct llvmpipe_context *lp_context = (struct llvmpipe_context *)setup->pipe;
+
+      if (lp_context->active_statistics_queries &&
+          !llvmpipe_rasterization_disabled(lp_context)) {
+         lp_context->pipeline_statistics.c_primitives += count;
+      }
+   }
+
+   jobs.setup = setup;
+   jobs.tris = tris;
+   jobs.keep_ccw = (setup->tri_queue.triangle == triangle_both ||
+                    setup->tri_queue.triangle == triangle_ccw);
+   jobs.keep_cw = (setup->tri_queue.triangle == triangle_both ||
+                   setup->tri_queue.triangle == triangle_cw);
+
+   jobs.start = 0;
+   while (jobs.start < count) {
+      unsigned end = count;
+
+      jobs.end = count;
+      jobs.num_jobs = MIN2(setup->tri_queue.num_jobs,
+                           MAX2((count - jobs.start) / MIN_JOB_TRIS, 1));
+      draw_run_jobs(setup->draw, setup_triangles_job, &jobs, jobs.num_jobs);
+
+      for (i = 0; i < jobs.num_jobs; i++)
+         end = MIN2(end, jobs.failed[i]);
+
+      jobs.end = end;
+      jobs.num_jobs = MIN2(setup->tri_queue.num_jobs, setup->scene->tiles_y);
+      draw_run_jobs(setup->draw, bin_triangles_job, &jobs, jobs.num_jobs);
+
+      if (end == count)
+         break;
+
+      /* A triangle which doesn't fit in a new scene is dropped, like in
+       * retry_triangle_ccw.
+       */
+      if (end == jobs.start && restarted)
+         end++;
+
+      if (!lp_setup_flush_and_restart(setup))
+         return;
+
+      restarted = TRUE;
+      jobs.start = end;
+   }
+}
+
+
 void 
 lp_setup_choose_triangle( struct lp_setup_context *setup )
 {
@@ -1024,4 +1329,10 @@ lp_setup_choose_triangle( struct lp_setup_context *setup )
       setup->triangle = triangle_nop;
       break;
    }
+
+   if (setup->tri_queue.num_jobs > 1 &&
+       setup->triangle != triangle_nop) {
+      setup->tri_queue.triangle = setup->triangle;
+      setup->triangle = triangle_queue;
+   }
 }
@@ -43,7 +43,7 @@
 #include "util/u_memory.h"
 
 
-#define LP_MAX_VBUF_INDEXES 1024
+#define LP_MAX_VBUF_INDEXES 16384
 #define LP_MAX_VBUF_SIZE    4096
 
   
@@ -324,6 +324,9 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   /* Bin the triangles queued for parallel binning, if any */
+   lp_setup_flush_triangles(setup);
 }
 
 
@@ -519,6 +522,9 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   /* Bin the triangles queued for parallel binning, if any */
+   lp_setup_flush_triangles(setup);
 }
 
 
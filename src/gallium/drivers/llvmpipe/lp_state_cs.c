@@ -0,0 +1,726 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * Kernels are TGSI, as produced by clover's TGSI front end.  Each kernel
+ * entry point is compiled into a function which runs all the threads of
+ * one block, a vector of threads at a time.  launch_grid() hands the blocks
+ * out to the rasterizer threads as a job, see lp_rast_run_job().
+ *
+ * Since the threads of a block run one vector after the other, BARRIER
+ * only synchronizes blocks no larger than the native vector length, which
+ * is why the screen reports that as the block size limit.
+ */
+
+#include "pipe/p_defines.h"
+#include "util/u_format.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_inlines.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_swizzle.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_type.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_flush.h"
+#include "lp_limits.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_texture.h"
+
+
+/** shader number (for debugging) */
+static unsigned cs_no = 0;
+
+
+/**
+ * Max threads per block: one vector, see the comment at the top.
+ */
+unsigned
+lp_cs_max_threads(void)
+{
+   return MIN2(lp_native_vector_width / 32, 16);
+}
+
+
+/**
+ * lp_build_tgsi_cs_iface with the values mem_pointer() needs.
+ */
+struct lp_cs_iface
+{
+   struct lp_build_tgsi_cs_iface base;
+
+   LLVMValueRef context_ptr;
+   LLVMValueRef local_ptr;
+   LLVMValueRef private_ptr;
+};
+
+
+static LLVMValueRef
+cs_mem_pointer(const struct lp_build_tgsi_cs_iface *cs_iface,
+               struct lp_build_tgsi_context *bld_base,
+               unsigned resource,
+               unsigned lane,
+               LLVMValueRef address)
+{
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef indices[2];
+   LLVMValueRef base;
+
+   indices[0] = lp_build_const_int32(gallivm, 0);
+
+   switch (resource) {
+   case TGSI_RESOURCE_GLOBAL:
+      /* the binding slot is in the upper bits, see set_global_binding() */
+      indices[1] = LLVMBuildLShr(builder, address,
+                                 lp_build_const_int32(gallivm,
+                                                      LP_CS_GLOBAL_OFFSET_BITS),
+                                 "");
+      base = lp_jit_cs_context_globals(gallivm, iface->context_ptr);
+      base = LLVMBuildGEP(builder, base, indices, 2, "");
+      base = LLVMBuildLoad(builder, base, "global");
+      address = LLVMBuildAnd(builder, address,
+                             lp_build_const_int32(gallivm,
+                                     (1 << LP_CS_GLOBAL_OFFSET_BITS) - 1),
+                             "");
+      break;
+
+   case TGSI_RESOURCE_LOCAL:
+      base = iface->local_ptr;
+      break;
+
+   case TGSI_RESOURCE_PRIVATE:
+      {
+         LLVMValueRef offset;
+
+         offset = lp_jit_cs_context_private_size(gallivm, iface->context_ptr);
+         offset = LLVMBuildMul(builder, offset,
+                               lp_build_const_int32(gallivm, lane), "");
+         base = LLVMBuildGEP(builder, iface->private_ptr, &offset, 1, "");
+      }
+      break;
+
+   case TGSI_RESOURCE_INPUT:
+      base = lp_jit_cs_context_input(gallivm, iface->context_ptr);
+      break;
+
+   default:
+      assert(resource < PIPE_MAX_SHADER_RESOURCES);
+      indices[1] = lp_build_const_int32(gallivm, resource);
+      base = lp_jit_cs_context_resources(gallivm, iface->context_ptr);
+      base = LLVMBuildGEP(builder, base, indices, 2, "");
+      base = LLVMBuildLoad(builder, base, "resource");
+      break;
+   }
+
+   return LLVMBuildGEP(builder, base, &address, 1, "");
+}
+
+
+/**
+ * Load component i of the context's array of 3 integers.
+ */
+static LLVMValueRef
+load_dim(struct gallivm_state *gallivm, LLVMValueRef array_ptr, unsigned i)
+{
+   LLVMValueRef indices[2];
+
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   indices[1] = lp_build_const_int32(gallivm, i);
+
+   return LLVMBuildLoad(gallivm->builder,
+                        LLVMBuildGEP(gallivm->builder, array_ptr,
+                                     indices, 2, ""), "");
+}
+
+
+/**
+ * Generate the function running all the threads of a block.
+ */
+static void
+generate_compute(struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(lc);
+   LLVMTypeRef int8_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   LLVMTypeRef arg_types[6];
+   LLVMTypeRef func_type;
+   LLVMTypeRef vec_ptr_type;
+   LLVMValueRef function;
+   LLVMValueRef context_ptr;
+   LLVMValueRef grid_size_ptr, block_size_ptr;
+   LLVMValueRef num_threads, thread_ids;
+   LLVMValueRef lane_index[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef lanes;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_for_loop_state loop_state;
+   struct lp_build_mask_context mask;
+   struct lp_cs_iface iface;
+   struct lp_type cs_type;
+   struct lp_type uint_type;
+   char func_name[64];
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = lp_cs_max_threads();
+
+   uint_type = lp_uint_type(cs_type);
+
+   util_snprintf(func_name, sizeof(func_name), "cs%u_pc%u",
+                 shader->no, variant->pc);
+
+   /*
+    * Generate the function prototype. Any change here must be reflected in
+    * lp_jit.h's lp_jit_cs_func function pointer type, and vice-versa.
+    */
+
+   arg_types[0] = variant->jit_context_ptr_type;  /* context */
+   arg_types[1] = int32_type;                     /* block_x */
+   arg_types[2] = int32_type;                     /* block_y */
+   arg_types[3] = int32_type;                     /* block_z */
+   arg_types[4] = int8_ptr_type;                  /* local_mem */
+   arg_types[5] = int8_ptr_type;                  /* private_mem */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(lc),
+                                arg_types, Elements(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   variant->function = function;
+
+   memset(&system_values, 0, sizeof system_values);
+   memset(&iface, 0, sizeof iface);
+
+   context_ptr = LLVMGetParam(function, 0);
+   system_values.block_id[0] = LLVMGetParam(function, 1);
+   system_values.block_id[1] = LLVMGetParam(function, 2);
+   system_values.block_id[2] = LLVMGetParam(function, 3);
+   iface.local_ptr = LLVMGetParam(function, 4);
+   iface.private_ptr = LLVMGetParam(function, 5);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(system_values.block_id[0], "block_x");
+   lp_build_name(system_values.block_id[1], "block_y");
+   lp_build_name(system_values.block_id[2], "block_z");
+   lp_build_name(iface.local_ptr, "local_mem");
+   lp_build_name(iface.private_ptr, "private_mem");
+
+   iface.base.pc = variant->pc;
+   iface.base.mem_pointer = cs_mem_pointer;
+   iface.context_ptr = context_ptr;
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(lc, function, "entry");
+   builder = gallivm->builder;
+   assert(builder);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   grid_size_ptr = lp_jit_cs_context_grid_size(gallivm, context_ptr);
+   block_size_ptr = lp_jit_cs_context_block_size(gallivm, context_ptr);
+   for (i = 0; i < 3; i++) {
+      system_values.grid_size[i] = load_dim(gallivm, grid_size_ptr, i);
+      system_values.block_size[i] = load_dim(gallivm, block_size_ptr, i);
+   }
+
+   num_threads = lp_jit_cs_context_num_threads(gallivm, context_ptr);
+   thread_ids = lp_jit_cs_context_thread_ids(gallivm, context_ptr);
+   vec_ptr_type = LLVMPointerType(lp_build_int_vec_type(gallivm, uint_type), 0);
+
+   for (i = 0; i < cs_type.length; i++)
+      lane_index[i] = lp_build_const_int32(gallivm, i);
+   lanes = LLVMConstVector(lane_index, cs_type.length);
+
+   lp_build_for_loop_begin(&loop_state, gallivm,
+                           lp_build_const_int32(gallivm, 0),
+                           LLVMIntULT,
+                           num_threads,
+                           lp_build_const_int32(gallivm, cs_type.length));
+   {
+      LLVMValueRef thread, mask_val;
+      unsigned chan;
+
+      /* thread ids of this vector of threads */
+      for (chan = 0; chan < 3; chan++) {
+         LLVMValueRef offset, ptr;
+
+         offset = LLVMBuildMul(builder, loop_state.counter,
+                               lp_build_const_int32(gallivm, 3), "");
+         offset = LLVMBuildAdd(builder, offset,
+                               lp_build_const_int32(gallivm,
+                                                    chan * cs_type.length),
+                               "");
+         ptr = LLVMBuildGEP(builder, thread_ids, &offset, 1, "");
+         ptr = LLVMBuildBitCast(builder, ptr, vec_ptr_type, "");
+         system_values.thread_id[chan] = LLVMBuildLoad(builder, ptr, "");
+      }
+
+      /* only the lanes below num_threads are active */
+      thread = lp_build_broadcast(gallivm,
+                                  lp_build_int_vec_type(gallivm, uint_type),
+                                  loop_state.counter);
+      thread = LLVMBuildAdd(builder, thread, lanes, "");
+      mask_val = lp_build_compare(gallivm, uint_type, PIPE_FUNC_LESS, thread,
+                                  lp_build_broadcast(gallivm,
+                                          lp_build_int_vec_type(gallivm,
+                                                                uint_type),
+                                          num_threads));
+
+      lp_build_mask_begin(&mask, gallivm, cs_type, mask_val);
+
+      lp_build_tgsi_soa(gallivm, shader->base.prog, cs_type, &mask,
+                        NULL, NULL, &system_values,
+                        NULL, NULL, NULL, &shader->info,
+                        NULL, &iface.base);
+
+      lp_build_mask_end(&mask);
+   }
+   lp_build_for_loop_end(&loop_state);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct lp_compute_shader *shader, unsigned pc)
+{
+   struct lp_compute_shader_variant *variant;
+
+   variant = CALLOC_STRUCT(lp_compute_shader_variant);
+   if (!variant)
+      return NULL;
+
+   variant->pc = pc;
+
+   variant->gallivm = gallivm_create();
+   if (!variant->gallivm) {
+      FREE(variant);
+      return NULL;
+   }
+
+   lp_jit_init_cs_types(variant);
+
+   generate_compute(shader, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_function = (lp_jit_cs_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   return variant;
+}
+
+
+static void
+destroy_variant(struct lp_compute_shader_variant *variant)
+{
+   gallivm_free_function(variant->gallivm,
+                         variant->function,
+                         variant->jit_function);
+   gallivm_destroy(variant->gallivm);
+   FREE(variant);
+}
+
+
+/**
+ * Find or compile the variant for the kernel starting at pc.
+ */
+static struct lp_compute_shader_variant *
+get_variant(struct lp_compute_shader *shader, unsigned pc)
+{
+   struct lp_compute_shader_variant *variant;
+
+   for (variant = shader->variants; variant; variant = variant->next) {
+      if (variant->pc == pc)
+         return variant;
+   }
+
+   variant = generate_variant(shader, pc);
+   if (variant) {
+      variant->next = shader->variants;
+      shader->variants = variant;
+   }
+
+   return variant;
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct lp_compute_shader *shader;
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->no = cs_no++;
+   shader->base = *templ;
+
+   /* we need to keep a local copy of the tokens */
+   shader->base.prog = tgsi_dup_tokens(templ->prog);
+   if (!shader->base.prog) {
+      FREE(shader);
+      return NULL;
+   }
+
+   tgsi_scan_shader(shader->base.prog, &shader->info);
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      tgsi_dump(shader->base.prog, 0);
+   }
+
+   return shader;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *)cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct lp_compute_shader *shader = (struct lp_compute_shader *)cs;
+   struct lp_compute_shader_variant *variant, *next;
+
+   /* the shader can only be running inside launch_grid() */
+   for (variant = shader->variants; variant; variant = next) {
+      next = variant->next;
+      destroy_variant(variant);
+   }
+
+   FREE((void *) shader->base.prog);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_compute_resources(struct pipe_context *pipe,
+                               unsigned start, unsigned count,
+                               struct pipe_surface **resources)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(start + count <= Elements(llvmpipe->cs_resources));
+
+   for (i = 0; i < count; i++) {
+      pipe_surface_reference(&llvmpipe->cs_resources[start + i],
+                             resources ? resources[i] : NULL);
+   }
+}
+
+
+/**
+ * Global buffers are addressed with the binding slot in the upper bits of
+ * the 32 bit address, and the offset in the buffer in the lower bits.
+ */
+static void
+llvmpipe_set_global_binding(struct pipe_context *pipe,
+                            unsigned first, unsigned count,
+                            struct pipe_resource **resources,
+                            uint32_t **handles)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(first + count <= Elements(llvmpipe->cs_globals));
+
+   for (i = 0; i < count; i++) {
+      pipe_resource_reference(&llvmpipe->cs_globals[first + i],
+                              resources ? resources[i] : NULL);
+
+      if (resources && handles) {
+         /* llvmpipe_resource_create() refuses larger global buffers, but
+          * others could still be bound.
+          */
+         if (resources[i]->width0 > (1 << LP_CS_GLOBAL_OFFSET_BITS)) {
+            debug_printf("llvmpipe: global buffer of %u bytes can't be "
+                         "addressed\n", resources[i]->width0);
+            pipe_resource_reference(&llvmpipe->cs_globals[first + i], NULL);
+            continue;
+         }
+         *handles[i] += (first + i) << LP_CS_GLOBAL_OFFSET_BITS;
+      }
+   }
+}
+
+
+/**
+ * The blocks of a grid, as a rasterizer job.
+ */
+struct lp_cs_job
+{
+   struct lp_rast_job base;
+
+   lp_jit_cs_func jit_function;
+   const struct lp_jit_cs_context *context;
+
+   /** Per rasterizer thread scratch memory */
+   uint8_t *local_mem;
+   unsigned local_size;
+   uint8_t *private_mem;
+   unsigned private_size;
+};
+
+
+static void
+run_block(void *data, unsigned thread_index, unsigned item)
+{
+   const struct lp_cs_job *job = (const struct lp_cs_job *)data;
+   const uint32_t *grid_size = job->context->grid_size;
+   unsigned x, y, z;
+
+   x = item % grid_size[0];
+   y = (item / grid_size[0]) % grid_size[1];
+   z = item / (grid_size[0] * grid_size[1]);
+
+   job->jit_function(job->context, x, y, z,
+                     job->local_mem + thread_index * job->local_size,
+                     job->private_mem + thread_index * job->private_size);
+}
+
+
+/**
+ * Pointer to the memory a compute resource surface refers to, or NULL if
+ * out of memory.
+ */
+static uint8_t *
+surface_data(struct pipe_context *pipe, struct pipe_surface *surf)
+{
+   struct pipe_resource *pt = surf->texture;
+   struct llvmpipe_resource *lpr = llvmpipe_resource(pt);
+
+   if (!llvmpipe_resource_is_texture(pt)) {
+      return (uint8_t *)llvmpipe_resource_data(pt) +
+             surf->u.buf.first_element * util_format_get_blocksize(surf->format);
+   }
+
+   /* kernels address images linearly */
+   if (!llvmpipe_resource_untile(pipe, pt))
+      return NULL;
+
+   return llvmpipe_get_texture_image_address(lpr, surf->u.tex.first_layer,
+                                             surf->u.tex.level);
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const uint *block_layout, const uint *grid_layout,
+                     uint32_t pc, const void *input)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_compute_shader_variant *variant;
+   struct lp_jit_cs_context context;
+   struct lp_cs_job job;
+   const unsigned length = lp_cs_max_threads();
+   unsigned num_threads, num_blocks, num_workers;
+   unsigned x, y, z, i;
+   uint32_t *thread_ids;
+
+   if (!shader)
+      return;
+
+   num_threads = block_layout[0] * block_layout[1] * block_layout[2];
+   num_blocks = grid_layout[0] * grid_layout[1] * grid_layout[2];
+   if (!num_threads || !num_blocks)
+      return;
+
+   /* Larger blocks than reported still work without barriers */
+   if (num_threads > LP_MAX_CS_THREADS ||
+       (num_threads > length &&
+        shader->info.opcode_count[TGSI_OPCODE_BARRIER])) {
+      debug_printf("llvmpipe: can't synchronize a compute block of %u "
+                   "threads\n", num_threads);
+      return;
+   }
+
+   variant = get_variant(shader, pc);
+   if (!variant)
+      return;
+
+   memset(&context, 0, sizeof context);
+
+   /*
+    * Wait for any rendering to the memory the kernel may touch.  Kernels
+    * may write anywhere in their buffers, so treat them all as written.
+    */
+   for (i = 0; i < Elements(llvmpipe->cs_globals); i++) {
+      struct pipe_resource *pt = llvmpipe->cs_globals[i];
+
+      if (pt) {
+         llvmpipe_flush_resource(pipe, pt, 0,
+                                 FALSE, /* read_only */
+                                 TRUE, /* cpu_access */
+                                 FALSE, /* do_not_block */
+                                 __FUNCTION__);
+         context.globals[i] = llvmpipe_resource_data(pt);
+      }
+   }
+
+   for (i = 0; i < Elements(llvmpipe->cs_resources); i++) {
+      struct pipe_surface *surf = llvmpipe->cs_resources[i];
+
+      if (surf) {
+         llvmpipe_flush_resource(pipe, surf->texture, 0,
+                                 FALSE, /* read_only */
+                                 TRUE, /* cpu_access */
+                                 FALSE, /* do_not_block */
+                                 __FUNCTION__);
+         context.resources[i] = surface_data(pipe, surf);
+         if (!context.resources[i])
+            return;
+      }
+   }
+
+   context.input = (uint8_t *)input;
+
+   for (i = 0; i < 3; i++) {
+      context.grid_size[i] = grid_layout[i];
+      context.block_size[i] = block_layout[i];
+   }
+   context.num_threads = num_threads;
+   context.private_size = align(shader->base.req_private_mem, 16);
+
+   /*
+    * Thread ids, a vector of x, then y, then z for each vector of threads.
+    * The padding of the last vector is never active.
+    */
+   thread_ids = align_malloc(align(num_threads, length) * 3 * sizeof(uint32_t),
+                             64);
+   if (!thread_ids)
+      return;
+
+   i = 0;
+   for (z = 0; z < block_layout[2]; z++) {
+      for (y = 0; y < block_layout[1]; y++) {
+         for (x = 0; x < block_layout[0]; x++) {
+            uint32_t *ids = thread_ids + (i / length) * 3 * length + i % length;
+
+            ids[0] = x;
+            ids[length] = y;
+            ids[2 * length] = z;
+            i++;
+         }
+      }
+   }
+   for (; i % length; i++) {
+      uint32_t *ids = thread_ids + (i / length) * 3 * length + i % length;
+
+      ids[0] = ids[length] = ids[2 * length] = 0;
+   }
+   context.thread_ids = thread_ids;
+
+   /* scratch memory for each rasterizer thread, and the calling thread */
+   num_workers = lp_rast_num_threads(screen->rast) + 1;
+
+   memset(&job, 0, sizeof job);
+   job.jit_function = variant->jit_function;
+   job.context = &context;
+   job.local_size = align(shader->base.req_local_mem, 16);
+   job.private_size = context.private_size * length;
+   job.local_mem = align_malloc(MAX2(num_workers * job.local_size, 16), 16);
+   job.private_mem = align_malloc(MAX2(num_workers * job.private_size, 16), 16);
+
+   if (job.local_mem && job.private_mem) {
+      job.base.run = run_block;
+      job.base.data = &job;
+      job.base.num_items = num_blocks;
+
+      lp_rast_run_job(screen->rast, &job.base);
+   }
+
+   align_free(job.private_mem);
+   align_free(job.local_mem);
+   align_free(thread_ids);
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_compute_resources = llvmpipe_set_compute_resources;
+   llvmpipe->pipe.set_global_binding = llvmpipe_set_global_binding;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
+
+
+void
+llvmpipe_cleanup_compute(struct llvmpipe_context *llvmpipe)
+{
+   unsigned i;
+
+   for (i = 0; i < Elements(llvmpipe->cs_resources); i++)
+      pipe_surface_reference(&llvmpipe->cs_resources[i], NULL);
+
+   for (i = 0; i < Elements(llvmpipe->cs_globals); i++)
+      pipe_resource_reference(&llvmpipe->cs_globals[i], NULL);
+}
@@ -174,7 +174,14 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
                           LP_NEW_VS))
       compute_vertex_info( llvmpipe );
 
+   /* the variant key depends on the constants' draw count */
+   if (llvmpipe->dirty & (LP_NEW_FS | LP_NEW_CONSTANTS)) {
+      if (llvmpipe_find_fs_constants( llvmpipe ))
+         llvmpipe->dirty |= LP_NEW_FS_SPEC;
+   }
+
    if (llvmpipe->dirty & (LP_NEW_FS |
+                          LP_NEW_FS_SPEC |
                           LP_NEW_FRAMEBUFFER |
                           LP_NEW_BLEND |
                           LP_NEW_SCISSOR |
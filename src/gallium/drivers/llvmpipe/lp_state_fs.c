@@ -67,6 +67,7 @@
 #include "util/u_string.h"
 #include "util/u_simple_list.h"
 #include "util/u_dual_blend.h"
+#include "util/u_hash.h"
 #include "os/os_time.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
@@ -77,6 +78,7 @@
 #include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_conv.h"
 #include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_cache.h"
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_logic.h"
 #include "gallivm/lp_bld_tgsi.h"
@@ -99,6 +101,8 @@
 #include "lp_state.h"
 #include "lp_tex_sample.h"
 #include "lp_flush.h"
+#include "lp_fs_compiler.h"
+#include "lp_screen.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
 
@@ -238,6 +242,54 @@ lp_llvm_viewport(LLVMValueRef context_ptr,
 }
 
 
+/**
+ * Return a copy of the constant buffer pointer array, with buffer 0
+ * replaced by the given values, as an LLVM constant, so that the values
+ * fold into the shader code.
+ */
+static LLVMValueRef
+build_spec_consts_ptr(struct gallivm_state *gallivm,
+                      LLVMValueRef consts_ptr,
+                      const uint32_t *values,
+                      unsigned num_values)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef float_ptr_type =
+      LLVMPointerType(LLVMFloatTypeInContext(gallivm->context), 0);
+   LLVMValueRef elems[LP_MAX_SPEC_CONSTS * 4];
+   LLVMValueRef values_global;
+   LLVMValueRef consts;
+   LLVMValueRef ptr;
+   unsigned i;
+
+   assert(num_values <= Elements(elems));
+
+   /* integer constants, to keep the bits of NaN values intact */
+   for (i = 0; i < num_values; i++) {
+      elems[i] = LLVMConstInt(int32_type, values[i], 0);
+   }
+
+   values_global = LLVMAddGlobal(gallivm->module,
+                                 LLVMArrayType(int32_type, num_values),
+                                 "spec_consts");
+   LLVMSetGlobalConstant(values_global, TRUE);
+   LLVMSetLinkage(values_global, LLVMInternalLinkage);
+   LLVMSetInitializer(values_global,
+                      LLVMConstArray(int32_type, elems, num_values));
+
+   consts = LLVMBuildLoad(builder, consts_ptr, "");
+   consts = LLVMBuildInsertValue(builder, consts,
+                                 LLVMConstBitCast(values_global, float_ptr_type),
+                                 0, "");
+
+   ptr = lp_build_alloca(gallivm, LLVMTypeOf(consts), "spec_consts_ptr");
+   LLVMBuildStore(builder, consts, ptr);
+
+   return ptr;
+}
+
+
 /**
  * Generate the fragment shader, depth/stencil test, and alpha tests.
  */
@@ -245,6 +297,7 @@ static void
 generate_fs_loop(struct gallivm_state *gallivm,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key,
+                 const uint32_t *spec_consts,
                  LLVMBuilderRef builder,
                  struct lp_type type,
                  LLVMValueRef context_ptr,
@@ -338,6 +391,11 @@ generate_fs_loop(struct gallivm_state *gallivm,
    consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
    num_consts_ptr = lp_jit_context_num_constants(gallivm, context_ptr);
 
+   if (key->spec_consts) {
+      consts_ptr = build_spec_consts_ptr(gallivm, consts_ptr, spec_consts,
+                                         shader->spec_const_size / 4);
+   }
+
    lp_build_for_loop_begin(&loop_state, gallivm,
                            lp_build_const_int32(gallivm, 0),
                            LLVMIntULT,
@@ -417,7 +475,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
    lp_build_tgsi_soa(gallivm, tokens, type, &mask,
                      consts_ptr, num_consts_ptr, &system_values,
                      interp->inputs,
-                     outputs, sampler, &shader->info.base, NULL);
+                     outputs, sampler, &shader->info.base, NULL, NULL);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -2121,8 +2179,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2331,6 +2388,7 @@ generate_fragment(struct llvmpipe_context *lp,
 
       generate_fs_loop(gallivm,
                        shader, key,
+                       variant->spec_consts,
                        builder,
                        fs_type,
                        context_ptr,
@@ -2450,6 +2508,10 @@ dump_fs_variant_key(const struct lp_fragment_shader_variant_key *key)
       debug_printf("occlusion_count = 1\n");
    }
 
+   if (key->spec_consts) {
+      debug_printf("spec_const_hash = 0x%08x\n", key->spec_const_hash);
+   }
+
    if (key->blend.logicop_enable) {
       debug_printf("blend.logicop_func = %s\n", util_dump_logicop(key->blend.logicop_func, TRUE));
    }
@@ -2499,6 +2561,7 @@ dump_fs_variant_key(const struct lp_fragment_shader_variant_key *key)
                    texture->pot_width,
                    texture->pot_height,
                    texture->pot_depth);
+      debug_printf("  .tiled = %u\n", texture->tiled);
    }
 }
 
@@ -2516,13 +2579,14 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 
 
 /**
- * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * Allocate a new shader variant for the given shader and key, without any
+ * code.
+ * \param spec_consts  constant buffer 0 contents, if key->spec_consts
  */
 static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+create_variant(struct lp_fragment_shader *shader,
+               const struct lp_fragment_shader_variant_key *key,
+               const uint32_t *spec_consts)
 {
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc;
@@ -2532,19 +2596,21 @@ generate_variant(struct llvmpipe_context *lp,
    if(!variant)
       return NULL;
 
-   variant->gallivm = gallivm_create();
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
-
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
+   if (key->spec_consts) {
+      variant->spec_consts = MALLOC(shader->spec_const_size);
+      if (!variant->spec_consts) {
+         FREE(variant);
+         return NULL;
+      }
+      memcpy(variant->spec_consts, spec_consts, shader->spec_const_size);
+   }
+
    /*
     * Determine whether we are touching all channels in the color buffer.
     */
@@ -2572,19 +2638,75 @@ generate_variant(struct llvmpipe_context *lp,
       variant->ps_inv_multiplier = 1;
    }
 
-   if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
-      lp_debug_fs_variant(variant);
+   /*
+    * A LESS/LEQUAL depth test rejects fragments behind the tile's depth
+    * bounds, unless they may still update the stencil buffer or the shader
+    * computes its own depth.  Whole blocks covered by such a triangle also
+    * end up no deeper than the triangle, if no fragment can be discarded.
+    */
+   if (key->depth.enabled &&
+       (key->depth.func == PIPE_FUNC_LESS ||
+        key->depth.func == PIPE_FUNC_LEQUAL) &&
+       !key->stencil[0].enabled &&
+       !shader->info.base.writes_z &&
+       !(LP_PERF & PERF_NO_HIZ)) {
+      variant->hiz_cull = TRUE;
+      variant->hiz_tighten =
+         key->depth.writemask &&
+         !key->alpha.enabled &&
+         !key->blend.alpha_to_coverage &&
+         !shader->info.base.uses_kill;
+   }
+
+   variant->hiz_invalidate =
+      key->depth.enabled &&
+      key->depth.writemask &&
+      key->depth.func != PIPE_FUNC_NEVER &&
+      key->depth.func != PIPE_FUNC_LESS &&
+      key->depth.func != PIPE_FUNC_LEQUAL &&
+      key->depth.func != PIPE_FUNC_EQUAL;
+
+   return variant;
+}
+
+
+/**
+ * Generate and compile the code of a shader variant, in the variant's LLVM
+ * context.  Only reads the shader and the variant, so may be called from
+ * any thread.
+ * \param flags  bitmask of GALLIVM_CREATE_x flags
+ * \return TRUE for success, FALSE for failure
+ */
+boolean
+llvmpipe_compile_fs_variant(struct lp_fragment_shader_variant *variant,
+                            unsigned flags)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+
+   variant->gallivm = gallivm_create_ex(variant->context, flags);
+   if (!variant->gallivm)
+      return FALSE;
+
+   lp_build_cache_key(variant->gallivm, "fs", 2);
+   lp_build_cache_key(variant->gallivm, shader->base.tokens,
+                      tgsi_num_tokens(shader->base.tokens) *
+                      sizeof(struct tgsi_token));
+   lp_build_cache_key(variant->gallivm, &variant->key,
+                      shader->variant_key_size);
+   if (variant->key.spec_consts) {
+      lp_build_cache_key(variant->gallivm, variant->spec_consts,
+                         shader->spec_const_size);
    }
 
    lp_jit_init_types(variant);
    
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
 
    if (variant->jit_function[RAST_WHOLE] == NULL) {
       if (variant->opaque) {
          /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
+         generate_fragment(shader, variant, RAST_WHOLE);
       }
    }
 
@@ -2608,6 +2730,82 @@ generate_variant(struct llvmpipe_context *lp,
       variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
    }
 
+   return TRUE;
+}
+
+
+/**
+ * Free the code of a shader variant, and the variant itself.
+ */
+static void
+destroy_variant(struct lp_fragment_shader_variant *variant)
+{
+   unsigned i;
+
+   if (variant->gallivm) {
+      /* free all the variant's JIT'd functions */
+      for (i = 0; i < Elements(variant->function); i++) {
+         if (variant->function[i]) {
+            gallivm_free_function(variant->gallivm,
+                                  variant->function[i],
+                                  variant->jit_function[i]);
+         }
+      }
+
+      gallivm_destroy(variant->gallivm);
+   }
+
+   if (variant->context)
+      LLVMContextDispose(variant->context);
+
+   FREE(variant->spec_consts);
+   FREE(variant);
+}
+
+
+/**
+ * Generate a new fragment shader variant from the shader code and
+ * other state indicated by the key.
+ *
+ * With background compilation, the variant gets quick, unoptimized code,
+ * and optimized code is queued for compilation on the compiler threads.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key,
+                 const uint32_t *spec_consts)
+{
+   struct lp_fs_compiler *compiler = llvmpipe_screen(lp->pipe.screen)->fs_compiler;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_fragment_shader_variant *optimized;
+
+   variant = create_variant(shader, key, spec_consts);
+   if (!variant)
+      return NULL;
+
+   variant->no = shader->variants_created++;
+
+   if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
+      lp_debug_fs_variant(variant);
+   }
+
+   if (!llvmpipe_compile_fs_variant(variant,
+                                    compiler ? GALLIVM_CREATE_NO_OPT : 0)) {
+      destroy_variant(variant);
+      return NULL;
+   }
+
+   if (compiler) {
+      optimized = create_variant(shader, key, spec_consts);
+      if (optimized) {
+         optimized->no = variant->no;
+         variant->job = lp_fs_compiler_queue(compiler, variant, optimized);
+         if (!variant->job)
+            destroy_variant(optimized);
+      }
+   }
+
    return variant;
 }
 
@@ -2648,6 +2846,18 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    shader->variant_key_size = Offset(struct lp_fragment_shader_variant_key,
                                      state[MAX2(nr_samplers, nr_sampler_views)]);
 
+   /*
+    * Shaders reading a few constants at fixed indices may get variants
+    * specialized on the constant values, see llvmpipe_count_fs_constants().
+    */
+   if ((LP_PERF & PERF_SPEC_CONSTS) &&
+       shader->info.base.file_max[TGSI_FILE_CONSTANT] >= 0 &&
+       shader->info.base.file_max[TGSI_FILE_CONSTANT] < LP_MAX_SPEC_CONSTS &&
+       !(shader->info.base.indirect_files & (1 << TGSI_FILE_CONSTANT))) {
+      shader->spec_const_size =
+         (shader->info.base.file_max[TGSI_FILE_CONSTANT] + 1) * 4 * sizeof(float);
+   }
+
    for (i = 0; i < shader->info.base.num_inputs; i++) {
       shader->inputs[i].usage_mask = shader->info.base.input_usage_mask[i];
       shader->inputs[i].cyl_wrap = shader->info.base.input_cylindrical_wrap[i];
@@ -2732,7 +2942,7 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
-   unsigned i;
+   struct lp_fragment_shader_variant *optimized = NULL;
 
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       debug_printf("llvmpipe: del fs #%u var #%u v created #%u v cached"
@@ -2744,27 +2954,38 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants);
    }
 
-   /* free all the variant's JIT'd functions */
-   for (i = 0; i < Elements(variant->function); i++) {
-      if (variant->function[i]) {
-         gallivm_free_function(variant->gallivm,
-                               variant->function[i],
-                               variant->jit_function[i]);
-      }
+   /* wait for or cancel the background compilation */
+   if (variant->job) {
+      struct lp_fs_compiler *compiler = llvmpipe_screen(lp->pipe.screen)->fs_compiler;
+      optimized = lp_fs_compiler_finish(compiler, variant->job);
+      variant->job = NULL;
    }
 
-   gallivm_destroy(variant->gallivm);
-
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
 
+   /* the constants need to get hot again before being baked in again */
+   if (variant->key.spec_consts) {
+      struct lp_fragment_shader *shader = variant->shader;
+      unsigned i;
+
+      shader->spec_variants_cached--;
+      for (i = 0; i < LP_SPEC_CONST_CANDIDATES; i++) {
+         if (shader->spec_candidates[i].hash == variant->key.spec_const_hash)
+            shader->spec_candidates[i].draws = 0;
+      }
+   }
+
    /* remove from context's list */
    remove_from_list(&variant->list_item_global);
    lp->nr_fs_variants--;
    lp->nr_fs_instrs -= variant->nr_instrs;
 
-   FREE(variant);
+   /* the variant may point to the optimized code, so free it last */
+   destroy_variant(variant);
+   if (optimized)
+      destroy_variant(optimized);
 }
 
 
@@ -2869,6 +3090,22 @@ force_dst_alpha_one(unsigned factor, boolean clamped_zero)
 }
 
 
+/**
+ * Static texture state of a fragment sampler view, including the llvmpipe
+ * texture layout.
+ */
+static void
+make_texture_state(struct lp_static_texture_state *state,
+                   const struct pipe_sampler_view *view)
+{
+   lp_sampler_static_texture_state(state, view);
+
+   if (view && view->texture) {
+      state->tiled = llvmpipe_resource_const(view->texture)->tiled;
+   }
+}
+
+
 /**
  * We need to generate several variants of the fragment pipeline to match
  * all the combinations of the contributing state atoms.
@@ -3038,8 +3275,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            make_texture_state(&key->state[i].texture_state,
+                               lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3047,11 +3284,152 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
-            lp_sampler_static_texture_state(&key->state[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            make_texture_state(&key->state[i].texture_state,
+                               lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
+
+   /*
+    * Bake in the constants once they have been drawn with often enough.
+    */
+   if (shader->spec_const_size && lp->fs_spec_candidate >= 0) {
+      const struct lp_fs_spec_candidate *candidate =
+         &shader->spec_candidates[lp->fs_spec_candidate];
+
+      if (candidate->draws >= LP_SPEC_CONST_MIN_DRAWS) {
+         key->spec_consts = 1;
+         key->spec_const_hash = candidate->hash;
+      }
+   }
+}
+
+
+/**
+ * Return the contents of fragment constant buffer 0 which the shader may be
+ * specialized on, or NULL if it isn't big enough.
+ */
+static const uint32_t *
+get_spec_consts(const struct llvmpipe_context *lp,
+                const struct lp_fragment_shader *shader)
+{
+   const struct pipe_constant_buffer *cb =
+      &lp->constants[PIPE_SHADER_FRAGMENT][0];
+   const ubyte *data;
+
+   if (!shader->spec_const_size ||
+       cb->buffer_size < shader->spec_const_size)
+      return NULL;
+
+   if (cb->buffer)
+      data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+   else
+      data = (const ubyte *) cb->user_buffer;
+
+   if (!data)
+      return NULL;
+
+   return (const uint32_t *) (data + cb->buffer_offset);
+}
+
+
+/**
+ * Find the draw counter of the current fragment constants, after the
+ * shader or its constants changed.  See llvmpipe_count_fs_constants().
+ *
+ * Each shader counts the draws of the last LP_SPEC_CONST_CANDIDATES
+ * distinct constant buffer contents it was drawn with, replacing the least
+ * drawn ones.  Contents drawn with LP_SPEC_CONST_MIN_DRAWS times get their
+ * own variant.
+ *
+ * \return TRUE if the fragment shader variant needs to be looked up again
+ */
+boolean
+llvmpipe_find_fs_constants(struct llvmpipe_context *lp)
+{
+   struct lp_fragment_shader *shader = lp->fs;
+   const uint32_t *data;
+
+   lp->fs_spec_candidate = -1;
+
+   if (!shader || !shader->spec_const_size)
+      return FALSE;
+
+   data = get_spec_consts(lp, shader);
+   if (data) {
+      uint32_t hash = util_hash_crc32(data, shader->spec_const_size);
+      unsigned lfu = 0;
+      unsigned i;
+
+      for (i = 0; i < LP_SPEC_CONST_CANDIDATES; i++) {
+         const struct lp_fs_spec_candidate *candidate =
+            &shader->spec_candidates[i];
+
+         if (candidate->hash == hash)
+            break;
+         if (candidate->draws < shader->spec_candidates[lfu].draws)
+            lfu = i;
+      }
+
+      if (i == LP_SPEC_CONST_CANDIDATES) {
+         i = lfu;
+         shader->spec_candidates[i].hash = hash;
+         shader->spec_candidates[i].draws = 0;
+      }
+
+      lp->fs_spec_candidate = i;
+   }
+
+   /* a specialized variant may be bound, or exist for the new contents */
+   return shader->spec_variants_cached != 0;
+}
+
+
+/**
+ * Count a draw with the current fragment constants, to find the ones worth
+ * specializing the fragment shader on.  Called for every draw, whether it
+ * changed any state or not, once the state is up to date.
+ *
+ * \return TRUE if the fragment shader variant needs to be looked up again
+ */
+boolean
+llvmpipe_count_fs_constants(struct llvmpipe_context *lp)
+{
+   struct lp_fs_spec_candidate *candidate;
+
+   if (!lp->fs || lp->fs_spec_candidate < 0)
+      return FALSE;
+
+   candidate = &lp->fs->spec_candidates[lp->fs_spec_candidate];
+   if (candidate->draws >= LP_SPEC_CONST_MIN_DRAWS)
+      return FALSE;
+
+   candidate->draws++;
+
+   return candidate->draws == LP_SPEC_CONST_MIN_DRAWS;
+}
+
+
+/**
+ * Remove the least recently used variant of the shader which is specialized
+ * on constants.
+ */
+static void
+cull_spec_variant(struct llvmpipe_context *lp,
+                  struct lp_fragment_shader *shader)
+{
+   struct lp_fs_variant_list_item *li;
+
+   li = last_elem(&lp->fs_variants_list);
+   while (!at_end(&lp->fs_variants_list, li)) {
+      if (li->base->shader == shader && li->base->key.spec_consts) {
+         /* the variant may still be binned, see llvmpipe_update_fs() */
+         llvmpipe_finish(&lp->pipe, __FUNCTION__);
+         llvmpipe_remove_shader_variant(lp, li->base);
+         return;
+      }
+      li = prev_elem(li);
+   }
 }
 
 
@@ -3067,13 +3445,25 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    struct lp_fragment_shader_variant_key key;
    struct lp_fragment_shader_variant *variant = NULL;
    struct lp_fs_variant_list_item *li;
+   const uint32_t *spec_consts = NULL;
 
    make_variant_key(lp, shader, &key);
 
+   if (key.spec_consts) {
+      spec_consts = get_spec_consts(lp, shader);
+      if (!spec_consts) {
+         key.spec_consts = 0;
+         key.spec_const_hash = 0;
+      }
+   }
+
    /* Search the variants for one which matches the key */
    li = first_elem(&shader->variants);
    while(!at_end(&shader->variants, li)) {
-      if(memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
+      if(memcmp(&li->base->key, &key, shader->variant_key_size) == 0 &&
+         (!key.spec_consts ||
+          memcmp(li->base->spec_consts, spec_consts,
+                 shader->spec_const_size) == 0)) {
          variant = li->base;
          break;
       }
@@ -3133,11 +3523,20 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          }
       }
 
+      /*
+       * Don't let the constants of one shader take over the cache, but
+       * replace its least recently used specialized variant.
+       */
+      if (key.spec_consts &&
+          shader->spec_variants_cached >= LP_MAX_SPEC_VARIANTS) {
+         cull_spec_variant(lp, shader);
+      }
+
       /*
        * Generate the new variant.
        */
       t0 = os_time_get();
-      variant = generate_variant(lp, shader, &key);
+      variant = generate_variant(lp, shader, &key, spec_consts);
       t1 = os_time_get();
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
@@ -3152,6 +3551,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          lp->nr_fs_variants++;
          lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
+         if (key.spec_consts)
+            shader->spec_variants_cached++;
       }
    }
 
@@ -36,10 +36,12 @@
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
+#include "lp_limits.h"
 
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct lp_fs_compile_job;
 
 
 /** Indexes into jit_function[] array */
@@ -77,10 +79,13 @@ struct lp_fragment_shader_variant_key
    unsigned occlusion_count:1;
    unsigned resource_1d:1;
    unsigned depth_clamp:1;
+   unsigned spec_consts:1;      /**< constant buffer 0 is baked in */
 
    enum pipe_format zsbuf_format;
    enum pipe_format cbuf_format[PIPE_MAX_COLOR_BUFS];
 
+   uint32_t spec_const_hash;    /**< hash of the baked in constants */
+
    struct lp_sampler_static_state state[PIPE_MAX_SHADER_SAMPLER_VIEWS];
 };
 
@@ -100,8 +105,19 @@ struct lp_fragment_shader_variant
    boolean opaque;
    uint8_t ps_inv_multiplier;
 
+   /* How the variant uses and affects the rasterizer's hierarchical Z */
+   boolean hiz_cull;       /**< skip blocks beyond the depth bounds */
+   boolean hiz_tighten;    /**< covered blocks take the triangle's depth */
+   boolean hiz_invalidate; /**< may raise depth values */
+
    struct gallivm_state *gallivm;
 
+   /** Private LLVM context of the gallivm, or NULL for the global one */
+   LLVMContextRef context;
+
+   /** Background compilation of optimized code, see lp_fs_compiler.c */
+   struct lp_fs_compile_job *job;
+
    LLVMTypeRef jit_context_ptr_type;
    LLVMTypeRef jit_thread_data_ptr_type;
    LLVMTypeRef jit_linear_context_ptr_type;
@@ -110,6 +126,9 @@ struct lp_fragment_shader_variant
 
    lp_jit_frag_func jit_function[2];
 
+   /** Constant buffer 0 contents if key.spec_consts, spec_const_size bytes */
+   uint32_t *spec_consts;
+
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
@@ -121,6 +140,14 @@ struct lp_fragment_shader_variant
 };
 
 
+/** Constant buffer contents counted for specialization */
+struct lp_fs_spec_candidate
+{
+   uint32_t hash;
+   unsigned draws;
+};
+
+
 /** Subclass of pipe_shader_state */
 struct lp_fragment_shader
 {
@@ -138,6 +165,14 @@ struct lp_fragment_shader
    unsigned variants_created;
    unsigned variants_cached;
 
+   /**
+    * Constant specialization: bytes of constant buffer 0 read by the shader,
+    * or zero if the shader is never specialized.
+    */
+   unsigned spec_const_size;
+   unsigned spec_variants_cached;
+   struct lp_fs_spec_candidate spec_candidates[LP_SPEC_CONST_CANDIDATES];
+
    /** Fragment shader input interpolation info */
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
 };
@@ -146,6 +181,10 @@ struct lp_fragment_shader
 void
 lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant);
 
+boolean
+llvmpipe_compile_fs_variant(struct lp_fragment_shader_variant *variant,
+                            unsigned flags);
+
 void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant);
@@ -124,6 +124,7 @@ llvmpipe_bind_rasterizer_state(struct pipe_context *pipe, void *handle)
       lp_setup_set_point_state( llvmpipe->setup,
                                state->lp_state.point_size,
                                state->lp_state.point_size_per_vertex,
+                               state->lp_state.point_tri_clip,
                                state->lp_state.sprite_coord_enable,
                                state->lp_state.sprite_coord_mode);
    }
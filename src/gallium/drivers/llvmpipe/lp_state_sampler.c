@@ -136,6 +136,13 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
 
    /* set the new sampler views */
    for (i = 0; i < num; i++) {
+      /* Vertex and geometry texturing is done by draw, which only knows
+       * the linear layout.
+       */
+      if (shader != PIPE_SHADER_FRAGMENT && views[i] && views[i]->texture &&
+          !llvmpipe_resource_untile(pipe, views[i]->texture))
+         debug_printf("llvmpipe: out of memory untiling a vertex texture\n");
+
       /* Note: we're using pipe_sampler_view_release() here to work around
        * a possible crash when the old view belongs to another context that
        * was already destroyed.
@@ -35,6 +35,7 @@
 #include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_cache.h"
 #include "gallivm/lp_bld_logic.h"
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_flow.h"
@@ -727,6 +728,9 @@ generate_setup_variant(struct lp_setup_variant_key *key,
       goto fail;
    }
 
+   lp_build_cache_key(gallivm, "setup", 5);
+   lp_build_cache_key(gallivm, key, key->size);
+
    builder = gallivm->builder;
 
    if (LP_DEBUG & DEBUG_COUNTERS) {
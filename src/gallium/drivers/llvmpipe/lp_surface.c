@@ -87,6 +87,13 @@ lp_resource_copy(struct pipe_context *pipe,
       return;
    }
 
+   /* Tiled textures go through transfers, which convert the layout. */
+   if (src_tex->tiled || dst_tex->tiled) {
+      util_resource_copy_region(pipe, dst, dst_level, dstx, dsty, dstz,
+                                src, src_level, src_box);
+      return;
+   }
+
    /*
    printf("surface copy from %u lvl %u to %u lvl %u: %u,%u,%u to %u,%u,%u %u x %u x %u\n",
           src_tex->id, src_level, dst_tex->id, dst_level,
@@ -249,6 +256,11 @@ llvmpipe_create_surface(struct pipe_context *pipe,
    if (!(pt->bind & (PIPE_BIND_DEPTH_STENCIL | PIPE_BIND_RENDER_TARGET)))
       debug_printf("Illegal surface creation without bind flag\n");
 
+   /* Rendering only knows the linear layout */
+   if (llvmpipe_resource_is_texture(pt) &&
+       !llvmpipe_resource_untile(pipe, pt))
+      return NULL;
+
    ps = CALLOC_STRUCT(pipe_surface);
    if (ps) {
       pipe_reference_init(&ps->reference, 1);
@@ -0,0 +1,642 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests and texel fetch throughput benchmark for lp_build_gather(),
+ * the SoA format fetch built on it, and the linear and tiled texture layouts.
+ *
+ * Each test function fetches a number of vectors of texels at random
+ * offsets in a texture sized buffer, so the cycles measured include the
+ * cache misses of real texturing.  The footprint tests instead fetch the
+ * 2x2 texels of bilinear filtering along a rotated and minified walk of
+ * the texture, as texture bound scenes do.  In debug builds the tests are
+ * run a second time with GALLIVM_DEBUG=no_gather, to compare the gather
+ * instructions with one load per element.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+#include "util/u_string.h"
+#include "util/u_format.h"
+#include "util/u_cpu_detect.h"
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_gather.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_type.h"
+
+#include "lp_test.h"
+
+
+/** Size of the fetched buffer, as big as a 512x512 rgba8 texture */
+#define TEXTURE_SIZE 512
+#define BUFFER_SIZE (TEXTURE_SIZE * TEXTURE_SIZE * 4)
+
+/** Number of vectors fetched by each function call when benchmarking */
+#define NUM_FETCHES 4096
+
+
+enum gather_test_kind
+{
+   GATHER_TEST_ELEMENTS,   /**< lp_build_gather() itself */
+   GATHER_TEST_FORMAT,     /**< lp_build_fetch_rgba_soa() */
+   GATHER_TEST_FOOTPRINT   /**< 2x2 texel footprints, from x, y coords */
+};
+
+
+struct gather_test_case
+{
+   enum gather_test_kind kind;
+
+   /** Texel format, for GATHER_TEST_FORMAT */
+   enum pipe_format format;
+
+   /** Element width in bits for lp_build_gather() */
+   unsigned src_width;
+
+   /** Vector length, or zero for the native one */
+   unsigned length;
+
+   /** Texels in LP_SAMPLER_TILE_SIZE tiles, for GATHER_TEST_FOOTPRINT */
+   boolean tiled;
+};
+
+
+static const struct gather_test_case test_cases[] = {
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 8, 1, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 8, 4, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 8, 8, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 16, 1, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 16, 4, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 16, 8, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 32, 1, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 32, 4, FALSE },
+   { GATHER_TEST_ELEMENTS, PIPE_FORMAT_NONE, 32, 8, FALSE },
+   { GATHER_TEST_FORMAT, PIPE_FORMAT_B8G8R8A8_UNORM, 0, 0, FALSE },
+   { GATHER_TEST_FORMAT, PIPE_FORMAT_R8G8B8A8_UNORM, 0, 0, FALSE },
+   { GATHER_TEST_FORMAT, PIPE_FORMAT_R10G10B10A2_UNORM, 0, 0, FALSE },
+   { GATHER_TEST_FORMAT, PIPE_FORMAT_R16G16_UNORM, 0, 0, FALSE },
+   { GATHER_TEST_FORMAT, PIPE_FORMAT_B5G6R5_UNORM, 0, 0, FALSE },
+   { GATHER_TEST_FOOTPRINT, PIPE_FORMAT_B8G8R8A8_UNORM, 32, 0, FALSE },
+   { GATHER_TEST_FOOTPRINT, PIPE_FORMAT_B8G8R8A8_UNORM, 32, 0, TRUE },
+};
+
+
+typedef void
+(*fetch_ptr_t)(void *dst, const void *base, const int32_t *offsets,
+               int32_t count);
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_texel\t"
+           "test\t"
+           "length\t"
+           "no_gather\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const char *name,
+              unsigned length,
+              boolean no_gather,
+              double cycles,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.1f\t", cycles);
+
+   fprintf(fp, "%s\t%u\t%u\n", name, length, no_gather);
+
+   fflush(fp);
+}
+
+
+/**
+ * The type of the fetched vectors.
+ */
+static struct lp_type
+test_type(const struct gather_test_case *test)
+{
+   switch (test->kind) {
+   case GATHER_TEST_ELEMENTS:
+      {
+         struct lp_type type = lp_type_uint(32);
+         type.length = test->length;
+         return type;
+      }
+   case GATHER_TEST_FOOTPRINT:
+      return lp_type_uint_vec(32, lp_native_vector_width);
+   case GATHER_TEST_FORMAT:
+   default:
+      return lp_type_float_vec(32, lp_native_vector_width);
+   }
+}
+
+
+/**
+ * Number of int32 vectors of input per fetch: offsets, or x and y.
+ */
+static unsigned
+test_inputs(const struct gather_test_case *test)
+{
+   return test->kind == GATHER_TEST_FOOTPRINT ? 2 : 1;
+}
+
+
+/**
+ * Number of texels fetched per vector element.
+ */
+static unsigned
+test_texels(const struct gather_test_case *test)
+{
+   return test->kind == GATHER_TEST_FOOTPRINT ? 4 : 1;
+}
+
+
+static void
+test_name(const struct gather_test_case *test, char *name, size_t size)
+{
+   switch (test->kind) {
+   case GATHER_TEST_ELEMENTS:
+      util_snprintf(name, size, "gather_%u", test->src_width);
+      break;
+   case GATHER_TEST_FORMAT:
+      util_snprintf(name, size, "%s",
+                    util_format_description(test->format)->short_name);
+      break;
+   case GATHER_TEST_FOOTPRINT:
+      util_snprintf(name, size, "footprint_%s",
+                    test->tiled ? "tiled" : "linear");
+      break;
+   }
+}
+
+
+/**
+ * Byte offset of texel (x, y) of the test texture, like the texture
+ * layouts of llvmpipe_texture_layout().
+ */
+static unsigned
+texel_offset(const struct gather_test_case *test, unsigned x, unsigned y)
+{
+   const unsigned bpp = 4;
+   const unsigned row_stride = TEXTURE_SIZE * bpp;
+   const unsigned mask = LP_SAMPLER_TILE_SIZE - 1;
+
+   if (!test->tiled)
+      return y * row_stride + x * bpp;
+
+   return (y & ~mask) * row_stride +
+          ((x & ~mask) * LP_SAMPLER_TILE_SIZE +
+           (y & mask) * LP_SAMPLER_TILE_SIZE +
+           (x & mask)) * bpp;
+}
+
+
+/**
+ * Load a vector of int32 inputs at offsets_ptr[index].
+ */
+static LLVMValueRef
+load_input(struct gallivm_state *gallivm,
+           LLVMTypeRef int_vec_type,
+           LLVMValueRef offsets_ptr,
+           LLVMValueRef index)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef ptr, res;
+
+   ptr = LLVMBuildGEP(builder, offsets_ptr, &index, 1, "");
+   if (LLVMGetTypeKind(int_vec_type) == LLVMVectorTypeKind) {
+      ptr = LLVMBuildBitCast(builder, ptr,
+                             LLVMPointerType(int_vec_type, 0), "");
+   }
+   res = LLVMBuildLoad(builder, ptr, "");
+   LLVMSetAlignment(res, 4);
+
+   return res;
+}
+
+
+/**
+ * Build
+ *
+ *    void fetch(dst, base, offsets, count)
+ *
+ * which fetches count vectors of texels, at the offsets[] relative to base,
+ * and stores the xor (or sum, for formats) of all in dst.  For footprints
+ * offsets[] holds vectors of x and y coordinates instead.
+ */
+static LLVMValueRef
+add_fetch_test(struct gallivm_state *gallivm,
+               const struct gather_test_case *test)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMModuleRef module = gallivm->module;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct lp_type type = test_type(test);
+   struct lp_type int_type = lp_int_type(type);
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef int_vec_type = lp_build_vec_type(gallivm, int_type);
+   LLVMTypeRef args[4];
+   LLVMValueRef func;
+   LLVMValueRef dst_ptr, base_ptr, offsets_ptr, count;
+   LLVMValueRef acc_var, acc, offsets, index;
+   LLVMBasicBlockRef block;
+   struct lp_build_loop_state loop;
+
+   args[0] = LLVMPointerType(vec_type, 0);
+   args[1] = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   args[2] = LLVMPointerType(LLVMInt32TypeInContext(context), 0);
+   args[3] = LLVMInt32TypeInContext(context);
+
+   func = LLVMAddFunction(module, "fetch",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, Elements(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   dst_ptr = LLVMGetParam(func, 0);
+   base_ptr = LLVMGetParam(func, 1);
+   offsets_ptr = LLVMGetParam(func, 2);
+   count = LLVMGetParam(func, 3);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   acc_var = lp_build_alloca(gallivm, vec_type, "acc");
+
+   lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      LLVMValueRef texels;
+
+      index = LLVMBuildMul(builder, loop.counter,
+                           lp_build_const_int32(gallivm,
+                                                type.length *
+                                                test_inputs(test)), "");
+      offsets = load_input(gallivm, int_vec_type, offsets_ptr, index);
+
+      acc = LLVMBuildLoad(builder, acc_var, "");
+
+      if (test->kind == GATHER_TEST_ELEMENTS) {
+         texels = lp_build_gather(gallivm, type.length, test->src_width, 32,
+                                  base_ptr, offsets, FALSE);
+         acc = LLVMBuildXor(builder, acc, texels, "");
+      }
+      else if (test->kind == GATHER_TEST_FOOTPRINT) {
+         const struct util_format_description *desc =
+            util_format_description(test->format);
+         struct lp_build_context bld;
+         LLVMValueRef x, y, row_stride;
+         unsigned dx, dy;
+
+         lp_build_context_init(&bld, gallivm, int_type);
+
+         x = offsets;
+         index = LLVMBuildAdd(builder, index,
+                              lp_build_const_int32(gallivm, type.length), "");
+         y = load_input(gallivm, int_vec_type, offsets_ptr, index);
+         row_stride = lp_build_const_int_vec(gallivm, int_type,
+                                             TEXTURE_SIZE * 4);
+
+         for (dy = 0; dy < 2; dy++) {
+            for (dx = 0; dx < 2; dx++) {
+               LLVMValueRef offset, i, j;
+
+               lp_build_sample_offset(&bld, desc, test->tiled,
+                                      lp_build_add(&bld, x,
+                                         lp_build_const_int_vec(gallivm, int_type, dx)),
+                                      lp_build_add(&bld, y,
+                                         lp_build_const_int_vec(gallivm, int_type, dy)),
+                                      NULL, row_stride, NULL,
+                                      &offset, &i, &j);
+
+               texels = lp_build_gather(gallivm, type.length, 32, 32,
+                                        base_ptr, offset, FALSE);
+               acc = LLVMBuildXor(builder, acc, texels, "");
+            }
+         }
+      }
+      else {
+         LLVMValueRef rgba[4];
+         LLVMValueRef zero = lp_build_const_int_vec(gallivm, int_type, 0);
+         unsigned chan;
+
+         lp_build_fetch_rgba_soa(gallivm,
+                                 util_format_description(test->format),
+                                 type, base_ptr, offsets, zero, zero, rgba);
+         for (chan = 0; chan < 4; chan++)
+            acc = LLVMBuildFAdd(builder, acc, rgba[chan], "");
+      }
+
+      LLVMBuildStore(builder, acc, acc_var);
+   }
+   lp_build_loop_end_cond(&loop, count, lp_build_const_int32(gallivm, 1),
+                          LLVMIntUGE);
+
+   acc = LLVMBuildLoad(builder, acc_var, "");
+   LLVMSetAlignment(LLVMBuildStore(builder, acc, dst_ptr), 4);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Run one test case, returning the vectors fetched by the first calls in
+ * results[], and the cycles per texel of the benchmark.
+ */
+PIPE_ALIGN_STACK
+static boolean
+run_fetch_test(const struct gather_test_case *test,
+               const uint8_t *buffer,
+               const int32_t *offsets,
+               uint32_t results[LP_TEST_NUM_SAMPLES][LP_MAX_VECTOR_LENGTH],
+               double *cycles_per_texel)
+{
+   struct gallivm_state *gallivm;
+   LLVMValueRef func;
+   fetch_ptr_t fetch_ptr;
+   const struct lp_type type = test_type(test);
+   int64_t cycles, min_cycles = INT64_MAX;
+   unsigned i;
+
+   gallivm = gallivm_create();
+   if (!gallivm)
+      return FALSE;
+
+   func = add_fetch_test(gallivm, test);
+
+   gallivm_compile_module(gallivm);
+
+   fetch_ptr = (fetch_ptr_t)gallivm_jit_function(gallivm, func);
+
+   /* Fetch each sample vector on its own, to check the values */
+   for (i = 0; i < LP_TEST_NUM_SAMPLES; i++) {
+      memset(results[i], 0, sizeof results[i]);
+      fetch_ptr(results[i], buffer,
+                offsets + i * type.length * test_inputs(test), 1);
+   }
+
+   for (i = 0; i < 4; i++) {
+      PIPE_ALIGN_VAR(32) uint32_t dst[LP_MAX_VECTOR_LENGTH];
+      int64_t start = rdtsc();
+      fetch_ptr(dst, buffer, offsets, NUM_FETCHES);
+      cycles = rdtsc() - start;
+      min_cycles = MIN2(min_cycles, cycles);
+   }
+
+   *cycles_per_texel = (double)min_cycles /
+                       (NUM_FETCHES * type.length * test_texels(test));
+
+   gallivm_free_function(gallivm, func, fetch_ptr);
+
+   gallivm_destroy(gallivm);
+
+   return TRUE;
+}
+
+
+static boolean
+test_one(unsigned verbose, FILE *fp,
+         const struct gather_test_case *test)
+{
+   static uint32_t results[2][LP_TEST_NUM_SAMPLES][LP_MAX_VECTOR_LENGTH];
+   const struct lp_type type = test_type(test);
+   const unsigned texel_size = test->kind == GATHER_TEST_FORMAT ?
+      util_format_get_blocksize(test->format) :
+      test->src_width / 8;
+   const unsigned num_inputs = NUM_FETCHES * type.length * test_inputs(test);
+   uint8_t *buffer;
+   int32_t *offsets;
+   char name[64];
+   double cycles[2];
+   unsigned num_runs = 1;
+   boolean success = TRUE;
+   unsigned i, j, run;
+
+   if (type.length * type.width > lp_native_vector_width) {
+      /* Not a vector length the shaders use on this machine */
+      return TRUE;
+   }
+
+   test_name(test, name, sizeof name);
+
+   if (verbose >= 1)
+      fprintf(stdout, "%s length=%u ...\n", name, type.length);
+
+   buffer = align_malloc(BUFFER_SIZE, 16);
+   offsets = align_malloc(num_inputs * sizeof *offsets, 16);
+   if (!buffer || !offsets) {
+      align_free(buffer);
+      align_free(offsets);
+      return FALSE;
+   }
+
+   for (i = 0; i < BUFFER_SIZE; i++)
+      buffer[i] = rand();
+
+   if (test->kind == GATHER_TEST_FOOTPRINT) {
+      /*
+       * Walk 2x2 pixel quads of the screen in rows, with the texture
+       * rotated by 30 degrees and minified by 1.5, like a textured floor.
+       */
+      const float c = 0.866f * 1.5f, s = 0.5f * 1.5f;
+      unsigned quad = 0;
+
+      for (i = 0; i < num_inputs; i += 2 * type.length) {
+         for (j = 0; j < type.length; j++) {
+            const unsigned sx = (quad % 64) * 2 + (j & 1);
+            const unsigned sy = (quad / 64) * 2 + ((j >> 1) & 1);
+            const float u = 4 * TEXTURE_SIZE + sx * c - sy * s;
+            const float v = sx * s + sy * c;
+
+            /* Wrap, keeping the 2x2 footprint inside the texture */
+            offsets[i + j] = (unsigned)u % (TEXTURE_SIZE - 1);
+            offsets[i + type.length + j] = (unsigned)v % (TEXTURE_SIZE - 1);
+
+            if ((j & 3) == 3)
+               quad++;
+         }
+      }
+   }
+   else {
+      for (i = 0; i < num_inputs; i++)
+         offsets[i] = (rand() % (BUFFER_SIZE / texel_size)) * texel_size;
+   }
+
+#ifdef DEBUG
+   /* Compare with the per element loads */
+   if (!(gallivm_debug & GALLIVM_DEBUG_NO_GATHER))
+      num_runs = 2;
+#endif
+
+   for (run = 0; run < num_runs; run++) {
+#ifdef DEBUG
+      if (run == 1)
+         gallivm_debug |= GALLIVM_DEBUG_NO_GATHER;
+#endif
+
+      if (!run_fetch_test(test, buffer, offsets, results[run], &cycles[run]))
+         success = FALSE;
+
+#ifdef DEBUG
+      if (run == 1)
+         gallivm_debug &= ~GALLIVM_DEBUG_NO_GATHER;
+#endif
+   }
+
+   /* lp_build_gather() must match the C reference, and the formats must
+    * fetch the same with and without gathers.
+    */
+   for (i = 0; i < LP_TEST_NUM_SAMPLES && success; i++) {
+      for (j = 0; j < type.length; j++) {
+         const int32_t *inputs = offsets + i * type.length * test_inputs(test);
+         const int32_t offset = inputs[j];
+
+         if (test->kind == GATHER_TEST_FOOTPRINT) {
+            const unsigned x = inputs[j];
+            const unsigned y = inputs[type.length + j];
+            uint32_t expected = 0, texel;
+            unsigned dx, dy;
+
+            for (dy = 0; dy < 2; dy++) {
+               for (dx = 0; dx < 2; dx++) {
+                  memcpy(&texel,
+                         buffer + texel_offset(test, x + dx, y + dy),
+                         sizeof texel);
+                  expected ^= texel;
+               }
+            }
+
+            if (results[0][i][j] != expected) {
+               fprintf(stderr, "%s length=%u: footprint at %u,%u fetched "
+                       "0x%08x, expected 0x%08x\n",
+                       name, type.length, x, y, results[0][i][j], expected);
+               success = FALSE;
+            }
+         }
+         else if (test->kind == GATHER_TEST_ELEMENTS) {
+            uint32_t expected = 0;
+
+            memcpy(&expected, buffer + offset, texel_size);
+#ifdef PIPE_ARCH_BIG_ENDIAN
+            expected >>= 32 - test->src_width;
+#endif
+            if (results[0][i][j] != expected) {
+               fprintf(stderr, "%s length=%u: element %u fetched 0x%08x, "
+                       "expected 0x%08x\n",
+                       name, type.length, j, results[0][i][j], expected);
+               success = FALSE;
+            }
+         }
+
+         if (num_runs > 1 && results[0][i][j] != results[1][i][j]) {
+            fprintf(stderr, "%s length=%u: element %u fetched 0x%08x with "
+                    "gathers, 0x%08x without\n",
+                    name, type.length, j, results[0][i][j], results[1][i][j]);
+            success = FALSE;
+         }
+      }
+   }
+
+   if (fp) {
+      for (run = 0; run < num_runs; run++) {
+         write_tsv_row(fp, name, type.length,
+                       run == 1 || (gallivm_debug & GALLIVM_DEBUG_NO_GATHER),
+                       cycles[run], success);
+      }
+   }
+
+   align_free(buffer);
+   align_free(offsets);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < Elements(test_cases); i++) {
+      if (!test_one(verbose, fp, &test_cases[i]))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   boolean success = TRUE;
+   unsigned long i;
+
+   for (i = 0; i < n; i++) {
+      if (!test_one(verbose, fp, &test_cases[rand() % Elements(test_cases)]))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   const struct gather_test_case test = {
+      GATHER_TEST_FOOTPRINT, PIPE_FORMAT_B8G8R8A8_UNORM, 32, 0, TRUE
+   };
+
+   return test_one(verbose, fp, &test);
+}
@@ -0,0 +1,447 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests and benchmark for the triangle rasterizers of each instruction
+ * set.
+ *
+ * The triangles are rasterized in a single tile with a dummy shader which
+ * only records the coverage masks, so the cycles measured are the edge mask
+ * evaluation and the block traversal.
+ */
+
+
+#include "util/u_memory.h"
+#include "util/u_cpu_detect.h"
+#include "lp_rast_priv.h"
+#include "lp_scene.h"
+#include "lp_state_fs.h"
+#include "lp_test.h"
+
+
+#define NUM_TRIS 256
+
+#define NUM_ISAS 3
+
+
+/** Coverage mask of each 4x4 block of the tile */
+static unsigned coverage[TILE_SIZE/4][TILE_SIZE/4];
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_triangle\t"
+           "isa\t"
+           "bits\t"
+           "size\t"
+           "planes\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct lp_rast_tri_funcs *funcs,
+              unsigned bits,
+              boolean large,
+              unsigned nr_planes,
+              double cycles,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.1f\t", cycles);
+
+   fprintf(fp, "%s\t%u\t%s\t%u\n",
+           funcs->name, bits, large ? "large" : "small", nr_planes);
+
+   fflush(fp);
+}
+
+
+static void
+record_coverage(const struct lp_jit_context *context,
+                uint32_t x,
+                uint32_t y,
+                uint32_t facing,
+                const void *a0,
+                const void *dadx,
+                const void *dady,
+                uint8_t **color,
+                uint8_t *depth,
+                uint32_t mask,
+                struct lp_jit_thread_data *thread_data,
+                unsigned *stride,
+                unsigned depth_stride)
+{
+   coverage[y/4][x/4] |= mask;
+}
+
+
+/**
+ * The functions of the i-th instruction set, or NULL if this build or CPU
+ * lacks it.
+ */
+static const struct lp_rast_tri_funcs *
+isa_funcs(unsigned i)
+{
+   switch (i) {
+   case 0:
+      return &lp_rast_tri_funcs_default;
+   case 1:
+      return util_cpu_caps.has_avx2 ? lp_rast_tri_funcs_avx2() : NULL;
+   case 2:
+      return util_cpu_caps.has_avx512f ? lp_rast_tri_funcs_avx512() : NULL;
+   default:
+      assert(0);
+      return NULL;
+   }
+}
+
+
+/**
+ * Half-plane on the left of the edge from (x0, y0) to (x1, y1), set up as
+ * lp_setup_tri.c does for the top-left fill convention.
+ */
+static void
+init_plane(struct lp_rast_plane *plane,
+           int x0, int y0, int x1, int y1)
+{
+   plane->dcdx = y0 - y1;
+   plane->dcdy = x0 - x1;
+   plane->c = IMUL64(plane->dcdx, x0) - IMUL64(plane->dcdy, y0);
+
+   if (plane->dcdx < 0 || (plane->dcdx == 0 && plane->dcdy > 0))
+      plane->c++;
+
+   plane->dcdx <<= FIXED_ORDER;
+   plane->dcdy <<= FIXED_ORDER;
+
+   plane->eo = 0;
+   if (plane->dcdx < 0) plane->eo -= plane->dcdx;
+   if (plane->dcdy > 0) plane->eo += plane->dcdy;
+}
+
+
+static int
+random_coord(int center, int radius)
+{
+   int v = center + rand() % (2 * radius) - radius;
+   return CLAMP(v, 0, (TILE_SIZE << FIXED_ORDER) - 1);
+}
+
+
+/**
+ * Random counter-clockwise triangle in the tile, plus five random
+ * half-planes in place of the scissor planes.
+ *
+ * Small triangles fit in 16x16 pixels, large ones span the whole tile.
+ * The coordinates are kept in the tile so that the 32-bit rasterizers
+ * apply to the triangles too.
+ */
+static struct lp_rast_triangle *
+random_triangle(boolean large)
+{
+   const unsigned input_array_sz = 4 * sizeof(float);
+   const int half_tile = (TILE_SIZE / 2) << FIXED_ORDER;
+   const int radius = large ? half_tile : 8 << FIXED_ORDER;
+   struct lp_rast_triangle *tri;
+   struct lp_rast_plane *plane;
+   int cx, cy, x[3], y[3];
+   int64_t area;
+   unsigned i;
+
+   tri = align_malloc(sizeof *tri + 3 * input_array_sz +
+                      8 * sizeof(struct lp_rast_plane), 16);
+   if (!tri)
+      return NULL;
+
+   memset(tri, 0, sizeof *tri);
+   tri->inputs.stride = input_array_sz;
+
+   cx = large ? half_tile : random_coord(half_tile, half_tile);
+   cy = large ? half_tile : random_coord(half_tile, half_tile);
+
+   do {
+      for (i = 0; i < 3; i++) {
+         x[i] = random_coord(cx, radius);
+         y[i] = random_coord(cy, radius);
+      }
+      area = IMUL64(x[0] - x[1], y[2] - y[0]) - IMUL64(x[2] - x[0], y[0] - y[1]);
+   } while (area == 0);
+
+   if (area < 0) {
+      int t;
+      t = x[1]; x[1] = x[2]; x[2] = t;
+      t = y[1]; y[1] = y[2]; y[2] = t;
+   }
+
+   plane = GET_PLANES(tri);
+   for (i = 0; i < 3; i++)
+      init_plane(&plane[i], x[i], y[i], x[(i + 1) % 3], y[(i + 1) % 3]);
+
+   for (i = 3; i < 8; i++)
+      init_plane(&plane[i],
+                 random_coord(half_tile, half_tile),
+                 random_coord(half_tile, half_tile),
+                 random_coord(half_tile, half_tile),
+                 random_coord(half_tile, half_tile));
+
+   return tri;
+}
+
+
+static void
+rasterize(struct lp_rasterizer_task *task,
+          lp_rast_cmd_func func,
+          const struct lp_rast_triangle *tri,
+          unsigned nr_planes)
+{
+   union lp_rast_cmd_arg arg;
+
+   arg.triangle.tri = tri;
+   arg.triangle.plane_mask = (1 << nr_planes) - 1;
+
+   func(task, arg);
+}
+
+
+static boolean
+test_one(unsigned verbose,
+         FILE *fp,
+         struct lp_rasterizer_task *task,
+         const struct lp_rast_tri_funcs *funcs,
+         boolean large,
+         unsigned nr_planes)
+{
+   static unsigned ref[TILE_SIZE/4][TILE_SIZE/4];
+   struct lp_rast_triangle *tris[NUM_TRIS];
+   lp_rast_cmd_func func[2];
+   int64_t cycles[2];
+   boolean success = TRUE;
+   unsigned i, j;
+
+   if (verbose >= 1)
+      fprintf(stdout, "isa=%s size=%s planes=%u ...\n",
+              funcs->name, large ? "large" : "small", nr_planes);
+
+   func[0] = funcs->tri_32[nr_planes - 1];
+   func[1] = funcs->tri[nr_planes - 1];
+
+   for (i = 0; i < NUM_TRIS; i++) {
+      tris[i] = random_triangle(large);
+      if (!tris[i]) {
+         while (i--)
+            align_free(tris[i]);
+         return FALSE;
+      }
+   }
+
+   /* Both widths must produce the same coverage as the default 64-bit
+    * rasterizer.
+    */
+   for (i = 0; i < NUM_TRIS && success; i++) {
+      memset(coverage, 0, sizeof coverage);
+      rasterize(task, lp_rast_tri_funcs_default.tri[nr_planes - 1],
+                tris[i], nr_planes);
+      memcpy(ref, coverage, sizeof ref);
+
+      for (j = 0; j < 2; j++) {
+         memset(coverage, 0, sizeof coverage);
+         rasterize(task, func[j], tris[i], nr_planes);
+
+         if (memcmp(coverage, ref, sizeof ref) != 0) {
+            const struct lp_rast_plane *plane = GET_PLANES(tris[i]);
+            unsigned k;
+
+            fprintf(stderr, "%s (%u bits) rasterized triangle %u differently:\n",
+                    funcs->name, j ? 64 : 32, i);
+            for (k = 0; k < nr_planes; k++)
+               fprintf(stderr, "  plane %u: c=%"PRIi64" dcdx=%d dcdy=%d eo=%"PRIi64"\n",
+                       k, plane[k].c, plane[k].dcdx, plane[k].dcdy, plane[k].eo);
+            success = FALSE;
+         }
+      }
+   }
+
+   for (j = 0; j < 2; j++) {
+      int64_t start = rdtsc();
+      for (i = 0; i < NUM_TRIS; i++)
+         rasterize(task, func[j], tris[i], nr_planes);
+      cycles[j] = rdtsc() - start;
+   }
+
+   if (fp) {
+      write_tsv_row(fp, funcs, 32, large, nr_planes,
+                    (double)cycles[0] / NUM_TRIS, success);
+      write_tsv_row(fp, funcs, 64, large, nr_planes,
+                    (double)cycles[1] / NUM_TRIS, success);
+   }
+
+   for (i = 0; i < NUM_TRIS; i++)
+      align_free(tris[i]);
+
+   return success;
+}
+
+
+/**
+ * Rasterizer task of a scene made of a single tile, with no color or depth
+ * buffers.
+ */
+static struct lp_rasterizer_task *
+create_task(void)
+{
+   static PIPE_ALIGN_VAR(16) uint8_t blend_color[16];
+   struct lp_rasterizer_task *task;
+   struct lp_scene *scene;
+   struct lp_rast_state *state;
+   struct lp_fragment_shader_variant *variant;
+
+   task = CALLOC_STRUCT(lp_rasterizer_task);
+   scene = CALLOC_STRUCT(lp_scene);
+   state = CALLOC_STRUCT(lp_rast_state);
+   variant = CALLOC_STRUCT(lp_fragment_shader_variant);
+   if (!task || !scene || !state || !variant) {
+      FREE(task);
+      FREE(scene);
+      FREE(state);
+      FREE(variant);
+      return NULL;
+   }
+
+   variant->jit_function[RAST_WHOLE] = record_coverage;
+   variant->jit_function[RAST_EDGE_TEST] = record_coverage;
+
+   state->variant = variant;
+   state->jit_context.u8_blend_color = blend_color;
+
+   scene->tile_order = TILE_ORDER;
+   scene->tile_size = TILE_SIZE;
+   scene->tiles_x = 1;
+   scene->tiles_y = 1;
+
+   task->scene = scene;
+   task->state = state;
+   task->width = TILE_SIZE;
+   task->height = TILE_SIZE;
+
+   return task;
+}
+
+
+static void
+destroy_task(struct lp_rasterizer_task *task)
+{
+   FREE(task->state->variant);
+   FREE((void *)task->state);
+   FREE(task->scene);
+   FREE(task);
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   struct lp_rasterizer_task *task;
+   boolean success = TRUE;
+   unsigned isa, large, nr_planes;
+
+   task = create_task();
+   if (!task)
+      return FALSE;
+
+   for (isa = 0; isa < NUM_ISAS; isa++) {
+      const struct lp_rast_tri_funcs *funcs = isa_funcs(isa);
+      if (!funcs)
+         continue;
+
+      for (large = 0; large < 2; large++) {
+         for (nr_planes = 1; nr_planes <= 8; nr_planes++) {
+            if (!test_one(verbose, fp, task, funcs, large, nr_planes))
+               success = FALSE;
+         }
+      }
+   }
+
+   destroy_task(task);
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   struct lp_rasterizer_task *task;
+   boolean success = TRUE;
+   unsigned long i;
+
+   task = create_task();
+   if (!task)
+      return FALSE;
+
+   for (i = 0; i < n; i++) {
+      const struct lp_rast_tri_funcs *funcs;
+
+      do {
+         funcs = isa_funcs(rand() % NUM_ISAS);
+      } while (!funcs);
+
+      if (!test_one(verbose, fp, task, funcs, rand() & 1, 1 + rand() % 8))
+         success = FALSE;
+   }
+
+   destroy_task(task);
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   struct lp_rasterizer_task *task;
+   boolean success;
+
+   task = create_task();
+   if (!task)
+      return FALSE;
+
+   success = test_one(verbose, fp, task, lp_rast_choose_tri_funcs(), TRUE, 3);
+
+   destroy_task(task);
+
+   return success;
+}
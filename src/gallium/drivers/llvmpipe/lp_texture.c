@@ -35,18 +35,25 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 
+#include "os/os_time.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_simple_list.h"
+#include "util/u_surface.h"
 #include "util/u_transfer.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
+#include "lp_debug.h"
+#include "lp_fence.h"
+#include "lp_perf.h"
 #include "lp_setup.h"
 #include "lp_state.h"
 #include "lp_rast.h"
@@ -60,6 +67,34 @@ static struct llvmpipe_resource resource_list;
 static unsigned id_counter = 0;
 
 
+/**
+ * Fences of the last scenes of one context to access, and to write, a
+ * resource.  The scenes of a context finish in the order they are queued,
+ * but those of different contexts don't, so there is one of these per
+ * context with scenes in flight.
+ */
+struct lp_resource_fence
+{
+   const struct pipe_context *pipe;
+   struct lp_fence *fence;
+   struct lp_fence *write_fence;
+   struct lp_resource_fence *next;
+};
+
+
+/**
+ * Buffer storage replaced by a discarding map while scenes were still
+ * using it.  Freed once the fences of all those scenes are signalled.
+ */
+struct lp_retired_data
+{
+   void *data;
+   struct lp_fence **fences;
+   unsigned num_fences;
+   struct lp_retired_data *next;
+};
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Just compute row strides here.  Storage is allocated on demand later.
@@ -181,6 +216,44 @@ llvmpipe_can_create_resource(struct pipe_screen *screen,
 }
 
 
+/**
+ * Whether to store a texture in the tiled layout.
+ *
+ * The 2x2 texel footprints of bilinear sampling mostly fall within one
+ * LP_SAMPLER_TILE_SIZE tile, which is one or two cache lines, where with
+ * linear rows they always span two.  The layout is only understood by the
+ * fragment shader samplers, so textures which could be anything else than
+ * sampled from are never tiled, and those used as surfaces or for vertex
+ * texturing later are untiled then.
+ */
+static boolean
+llvmpipe_texture_use_tiling(const struct llvmpipe_resource *lpr)
+{
+   const struct pipe_resource *pt = &lpr->base;
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+
+   if (!(LP_PERF & PERF_TILED_TEX))
+      return FALSE;
+
+   if (!(pt->bind & PIPE_BIND_SAMPLER_VIEW) ||
+       (pt->bind & (PIPE_BIND_DEPTH_STENCIL |
+                    PIPE_BIND_SHADER_RESOURCE |
+                    PIPE_BIND_COMPUTE_RESOURCE |
+                    PIPE_BIND_LINEAR)))
+      return FALSE;
+
+   if (llvmpipe_resource_is_1d(pt))
+      return FALSE;
+
+   /* Only plain pixels, and no block compressed or subsampled formats */
+   if (!desc || desc->block.width != 1 || desc->block.height != 1)
+      return FALSE;
+
+   return TRUE;
+}
+
+
 static boolean
 llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
                               struct llvmpipe_resource *lpr)
@@ -220,6 +293,86 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
 }
 
 
+/**
+ * Allocate the storage of a buffer of the given size.
+ */
+static void *
+alloc_buffer_data(unsigned bytes)
+{
+   /*
+    * Reserve some extra storage since if we'd render to a buffer we
+    * read/write always LP_RASTER_BLOCK_SIZE pixels, but the element
+    * offset doesn't need to be aligned to LP_RASTER_BLOCK_SIZE.
+    */
+   return align_malloc(bytes + (LP_RASTER_BLOCK_SIZE - 1) * 4 * sizeof(float), 64);
+}
+
+
+static void
+free_retired(struct lp_retired_data *retired)
+{
+   unsigned i;
+
+   if (retired->fences) {
+      for (i = 0; i < retired->num_fences; i++)
+         lp_fence_reference(&retired->fences[i], NULL);
+      FREE(retired->fences);
+   }
+   align_free(retired->data);
+   FREE(retired);
+}
+
+
+static boolean
+retired_data_busy(const struct lp_retired_data *retired)
+{
+   unsigned i;
+
+   for (i = 0; i < retired->num_fences; i++) {
+      if (!lp_fence_signalled(retired->fences[i]))
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+
+/**
+ * Free the retired buffer storage which is no longer in use, or all of it.
+ */
+static void
+free_retired_data(struct llvmpipe_resource *lpr, boolean all)
+{
+   struct lp_retired_data **link = &lpr->retired;
+
+   while (*link) {
+      struct lp_retired_data *retired = *link;
+
+      if (all || !retired_data_busy(retired)) {
+         *link = retired->next;
+         free_retired(retired);
+      }
+      else {
+         link = &retired->next;
+      }
+   }
+}
+
+
+static void
+free_resource_fences(struct llvmpipe_resource *lpr)
+{
+   while (lpr->fences) {
+      struct lp_resource_fence *entry = lpr->fences;
+
+      lpr->fences = entry->next;
+      lp_fence_reference(&entry->fence, NULL);
+      lp_fence_reference(&entry->write_fence, NULL);
+      FREE(entry);
+   }
+}
+
+
 static struct pipe_resource *
 llvmpipe_resource_create(struct pipe_screen *_screen,
                          const struct pipe_resource *templat)
@@ -247,6 +400,8 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
          /* texture map */
          if (!llvmpipe_texture_layout(screen, lpr))
             goto fail;
+
+         lpr->tiled = llvmpipe_texture_use_tiling(lpr);
       }
    }
    else {
@@ -256,12 +411,11 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
       assert(templat->height0 == 1);
       assert(templat->depth0 == 1);
       assert(templat->last_level == 0);
-      /*
-       * Reserve some extra storage since if we'd render to a buffer we
-       * read/write always LP_RASTER_BLOCK_SIZE pixels, but the element
-       * offset doesn't need to be aligned to LP_RASTER_BLOCK_SIZE.
-       */
-      lpr->data = align_malloc(bytes + (LP_RASTER_BLOCK_SIZE - 1) * 4 * sizeof(float), 64);
+      /* compute kernels can't address more, see LP_CS_GLOBAL_OFFSET_BITS */
+      if ((templat->bind & PIPE_BIND_GLOBAL) &&
+          bytes > (1 << LP_CS_GLOBAL_OFFSET_BITS))
+         goto fail;
+      lpr->data = alloc_buffer_data(bytes);
       /*
        * buffers don't really have stride but it's probably safer
        * (for code doing same calculations for buffers and textures)
@@ -305,12 +459,17 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
          align_free(lpr->linear_img.data);
          lpr->linear_img.data = NULL;
       }
+      align_free(lpr->tiled_data);
    }
    else if (!lpr->userBuffer) {
       assert(lpr->data);
       align_free(lpr->data);
    }
 
+   /* All scenes referencing the resource are done by now */
+   free_retired_data(lpr, TRUE);
+   free_resource_fences(lpr);
+
 #ifdef DEBUG
    if (lpr->next)
       remove_from_list(lpr);
@@ -408,6 +567,139 @@ llvmpipe_resource_data(struct pipe_resource *resource)
 }
 
 
+/**
+ * Byte offset of texel (x, y) in an image in the tiled layout.
+ * See LP_SAMPLER_TILE_SIZE.
+ */
+static INLINE unsigned
+tiled_offset(const struct llvmpipe_resource *lpr, unsigned level,
+             unsigned x, unsigned y, unsigned bpp)
+{
+   const unsigned mask = LP_SAMPLER_TILE_SIZE - 1;
+
+   return (y & ~mask) * lpr->row_stride[level] +
+          ((x & ~mask) * LP_SAMPLER_TILE_SIZE +
+           (y & mask) * LP_SAMPLER_TILE_SIZE +
+           (x & mask)) * bpp;
+}
+
+
+/**
+ * Copy a box of texels between a texture in the tiled layout and a linear
+ * buffer, in either direction.
+ */
+static void
+tiled_copy_box(struct llvmpipe_resource *lpr, unsigned level,
+               const struct pipe_box *box,
+               ubyte *linear, unsigned stride, unsigned layer_stride,
+               boolean to_tiled)
+{
+   const unsigned bpp = util_format_get_blocksize(lpr->base.format);
+   const unsigned mask = LP_SAMPLER_TILE_SIZE - 1;
+   unsigned x, y, z;
+
+   for (z = 0; z < box->depth; z++) {
+      ubyte *image = llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                        level);
+
+      for (y = 0; y < box->height; y++) {
+         ubyte *row = linear + z * layer_stride + y * stride;
+
+         /* Texels are only contiguous up to the end of a tile row */
+         x = 0;
+         while (x < box->width) {
+            const unsigned tx = box->x + x;
+            const unsigned n = MIN2(LP_SAMPLER_TILE_SIZE - (tx & mask),
+                                    box->width - x);
+            ubyte *texel = image + tiled_offset(lpr, level, tx, box->y + y,
+                                                bpp);
+
+            if (to_tiled)
+               memcpy(texel, row + x * bpp, n * bpp);
+            else
+               memcpy(row + x * bpp, texel, n * bpp);
+
+            x += n;
+         }
+      }
+   }
+}
+
+
+/**
+ * Convert a texture from the tiled to the linear layout, before accessing
+ * it any other way than with the fragment samplers.
+ *
+ * This is permanent.  The screen timestamp makes all contexts rebuild
+ * their fragment shader keys with the new layout.
+ *
+ * The linear copy goes into new storage.  Scenes binned with the tiled
+ * layout, by any context, keep sampling the old storage through their
+ * texture state, whether they are queued yet or not.  The ones still
+ * being binned can't be known, so the old storage is only freed with the
+ * resource.  Tiled textures are only ever sampled, so nothing writes to
+ * it in the meantime.
+ *
+ * Returns FALSE, leaving the texture tiled, if out of memory.
+ */
+boolean
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(resource->screen);
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   unsigned level;
+
+   if (!lpr->tiled)
+      return TRUE;
+
+   if (lpr->linear_img.data) {
+      const unsigned last_level = resource->last_level;
+      const unsigned size = lpr->linear_mip_offsets[last_level] +
+         lpr->img_stride[last_level] * lpr->num_slices_faces[last_level];
+      ubyte *tiled = lpr->linear_img.data;
+      ubyte *linear;
+
+      linear = align_malloc(size, MAX2(64, util_cpu_caps.cacheline));
+      if (!linear)
+         return FALSE;
+
+      memset(linear, 0, size);
+
+      for (level = 0; level <= last_level; level++) {
+         const unsigned img_stride = lpr->img_stride[level];
+         struct pipe_box box;
+         unsigned slice;
+
+         box.x = 0;
+         box.y = 0;
+         box.width = u_minify(resource->width0, level);
+         box.height = u_minify(resource->height0, level);
+         box.depth = 1;
+
+         for (slice = 0; slice < lpr->num_slices_faces[level]; slice++) {
+            ubyte *image = llvmpipe_get_texture_image_address(lpr, slice,
+                                                              level);
+
+            box.z = slice;
+            tiled_copy_box(lpr, level, &box, linear + (image - tiled),
+                           lpr->row_stride[level], img_stride, FALSE);
+         }
+      }
+
+      assert(!lpr->tiled_data);
+      lpr->tiled_data = tiled;
+      lpr->linear_img.data = linear;
+   }
+
+   lpr->tiled = FALSE;
+
+   screen->timestamp++;
+
+   return TRUE;
+}
+
+
 static struct pipe_resource *
 llvmpipe_resource_from_handle(struct pipe_screen *screen,
                               const struct pipe_resource *template,
@@ -478,6 +770,92 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
 }
 
 
+/**
+ * Give a buffer mapped with PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE new
+ * storage if scenes in flight still use the current one, rather than
+ * waiting for them.
+ *
+ * Returns FALSE if the map needs to synchronize as usual.
+ */
+static boolean
+llvmpipe_resource_discard(struct pipe_context *pipe,
+                          struct llvmpipe_resource *lpr)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_retired_data *retired;
+   const struct lp_resource_fence *entry;
+   unsigned num_fences = 0;
+   boolean incomplete;
+   void *data;
+
+   if (llvmpipe_resource_is_texture(&lpr->base) || lpr->userBuffer)
+      return FALSE;
+
+   /* Queue the current scene, so that its fence covers the old storage */
+   if (llvmpipe_is_resource_referenced(pipe, &lpr->base, 0))
+      llvmpipe_flush(pipe, NULL, __FUNCTION__);
+
+   retired = CALLOC_STRUCT(lp_retired_data);
+   if (!retired)
+      return FALSE;
+
+   /* The old storage stays around until the scenes of every context
+    * which use it are done.
+    */
+   pipe_mutex_lock(screen->rast_mutex);
+   incomplete = lpr->fences_incomplete;
+   for (entry = lpr->fences; entry; entry = entry->next) {
+      if (!lp_fence_signalled(entry->fence))
+         num_fences++;
+   }
+   if (num_fences && !incomplete) {
+      retired->fences = CALLOC(num_fences, sizeof *retired->fences);
+      if (retired->fences) {
+         for (entry = lpr->fences; entry; entry = entry->next) {
+            if (!lp_fence_signalled(entry->fence))
+               lp_fence_reference(&retired->fences[retired->num_fences++],
+                                  entry->fence);
+         }
+      }
+   }
+   pipe_mutex_unlock(screen->rast_mutex);
+
+   if (incomplete) {
+      /* not every scene using the storage is known */
+      free_retired(retired);
+      return FALSE;
+   }
+
+   if (!num_fences) {
+      /* idle */
+      free_retired(retired);
+      return TRUE;
+   }
+
+   data = alloc_buffer_data(lpr->base.width0);
+   if (!retired->fences || !data) {
+      align_free(data);
+      free_retired(retired);
+      return FALSE;
+   }
+
+   free_retired_data(lpr, FALSE);
+
+   retired->data = lpr->data;
+   retired->next = lpr->retired;
+   lpr->retired = retired;
+
+   lpr->data = data;
+
+   /* The new storage is picked up through the screen timestamp, which
+    * the write map bumps.
+    */
+   LP_COUNT(nr_buffer_renames);
+
+   return TRUE;
+}
+
+
 static void *
 llvmpipe_transfer_map( struct pipe_context *pipe,
                        struct pipe_resource *resource,
@@ -499,11 +877,17 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   /* Tiled textures can only be mapped through a linear copy */
+   if (lpr->tiled && (usage & PIPE_TRANSFER_MAP_DIRECTLY))
+      return NULL;
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush the
     * context if necessary.
     */
-   if (!(usage & PIPE_TRANSFER_UNSYNCHRONIZED)) {
+   if (!(usage & PIPE_TRANSFER_UNSYNCHRONIZED) &&
+       !((usage & PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE) &&
+         llvmpipe_resource_discard(pipe, lpr))) {
       boolean read_only = !(usage & PIPE_TRANSFER_WRITE);
       boolean do_not_block = !!(usage & PIPE_TRANSFER_DONTBLOCK);
       if (!llvmpipe_flush_resource(pipe, resource,
@@ -585,6 +969,31 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       screen->timestamp++;
    }
 
+   if (lpr->tiled) {
+      /*
+       * Map a linear copy of the box, written back to the tiles on unmap.
+       * The texel data is only needed if the box isn't discarded.
+       */
+      pt->stride = align(box->width * util_format_get_blocksize(format), 16);
+      pt->layer_stride = pt->stride * box->height;
+
+      lpt->staging = align_malloc(pt->layer_stride * box->depth, 16);
+      if (!lpt->staging || !map) {
+         align_free(lpt->staging);
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))) {
+         tiled_copy_box(lpr, level, box, lpt->staging,
+                        pt->stride, pt->layer_stride, FALSE);
+      }
+
+      return lpt->staging;
+   }
+
    map +=
       box->y / util_format_get_blockheight(format) * pt->stride +
       box->x / util_format_get_blockwidth(format) * util_format_get_blocksize(format);
@@ -597,8 +1006,37 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   if (lpt->staging) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(transfer->resource);
+
+      if (transfer->usage & PIPE_TRANSFER_WRITE) {
+         if (lpr->tiled) {
+            tiled_copy_box(lpr, transfer->level, &transfer->box,
+                           lpt->staging, transfer->stride,
+                           transfer->layer_stride, TRUE);
+         }
+         else {
+            /* untiled while mapped */
+            util_copy_box(llvmpipe_get_texture_image_address(lpr, 0,
+                                                             transfer->level),
+                          lpr->base.format,
+                          lpr->row_stride[transfer->level],
+                          lpr->img_stride[transfer->level],
+                          transfer->box.x, transfer->box.y, transfer->box.z,
+                          transfer->box.width, transfer->box.height,
+                          transfer->box.depth,
+                          lpt->staging, transfer->stride,
+                          transfer->layer_stride, 0, 0, 0);
+         }
+      }
+
+      align_free(lpt->staging);
+   }
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
@@ -634,6 +1072,133 @@ llvmpipe_is_resource_referenced( struct pipe_context *pipe,
 }
 
 
+/**
+ * Record that the scene with the given fence, queued by the given context,
+ * reads, or also writes, the resource.  Called with the screen's
+ * rast_mutex held, as scenes are queued.
+ */
+void
+llvmpipe_resource_fence(struct pipe_resource *resource,
+                        const struct pipe_context *pipe,
+                        struct lp_fence *fence,
+                        boolean write)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   struct lp_resource_fence **link = &lpr->fences;
+   struct lp_resource_fence *entry = NULL;
+
+   /* Find the context's entry, dropping those of contexts gone idle */
+   while (*link) {
+      struct lp_resource_fence *f = *link;
+
+      if (f->pipe == pipe) {
+         entry = f;
+         link = &f->next;
+      }
+      else if (lp_fence_signalled(f->fence)) {
+         *link = f->next;
+         lp_fence_reference(&f->fence, NULL);
+         lp_fence_reference(&f->write_fence, NULL);
+         FREE(f);
+      }
+      else {
+         link = &f->next;
+      }
+   }
+
+   if (!entry) {
+      entry = CALLOC_STRUCT(lp_resource_fence);
+      if (!entry) {
+         /* CPU access falls back to looking through all queued scenes */
+         lpr->fences_incomplete = TRUE;
+         return;
+      }
+      entry->pipe = pipe;
+      entry->next = lpr->fences;
+      lpr->fences = entry;
+   }
+
+   lp_fence_reference(&entry->fence, fence);
+   if (write)
+      lp_fence_reference(&entry->write_fence, fence);
+}
+
+
+/**
+ * Return a reference to the fence of an unfinished scene, of any context,
+ * which accesses the resource, or just writes it if write is FALSE.
+ * Called with the screen's rast_mutex held.
+ */
+static struct lp_fence *
+get_busy_fence(const struct llvmpipe_resource *lpr, boolean write)
+{
+   const struct lp_resource_fence *entry;
+   struct lp_fence *fence = NULL;
+
+   for (entry = lpr->fences; entry; entry = entry->next) {
+      struct lp_fence *f = write ? entry->fence : entry->write_fence;
+
+      if (f && !lp_fence_signalled(f)) {
+         lp_fence_reference(&fence, f);
+         break;
+      }
+   }
+
+   return fence;
+}
+
+
+/**
+ * Wait for the scenes of all contexts which access the resource, or just
+ * write it if write is FALSE.  That is what CPU writes, or reads, have to
+ * wait for.
+ *
+ * Returns FALSE if it would have to wait, but do_not_block is set.
+ */
+boolean
+llvmpipe_resource_wait(struct pipe_resource *resource,
+                       boolean write,
+                       boolean do_not_block)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(resource->screen);
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   boolean incomplete;
+
+   for (;;) {
+      struct lp_fence *fence;
+      int64_t start;
+
+      pipe_mutex_lock(screen->rast_mutex);
+      fence = get_busy_fence(lpr, write);
+      incomplete = lpr->fences_incomplete;
+      pipe_mutex_unlock(screen->rast_mutex);
+
+      if (!fence)
+         break;
+
+      if (do_not_block) {
+         lp_fence_reference(&fence, NULL);
+         return FALSE;
+      }
+
+      start = os_time_get();
+
+      lp_fence_wait(fence);
+
+      LP_COUNT(nr_resource_waits);
+      LP_COUNT_ADD(resource_wait_time, os_time_get() - start);
+
+      lp_fence_reference(&fence, NULL);
+   }
+
+   if (incomplete)
+      return lp_rast_wait_resource(screen->rast, resource, write,
+                                   do_not_block);
+
+   return TRUE;
+}
+
+
 /**
  * Returns the largest possible alignment for a format in llvmpipe
  */
@@ -45,6 +45,9 @@ enum lp_texture_usage
 struct pipe_context;
 struct pipe_screen;
 struct llvmpipe_context;
+struct lp_fence;
+struct lp_resource_fence;
+struct lp_retired_data;
 
 struct sw_displaytarget;
 
@@ -92,6 +95,32 @@ struct llvmpipe_resource
     */
    void *data;
 
+   /**
+    * Buffer data orphaned by discarding maps, but still read or written by
+    * scenes in flight.
+    */
+   struct lp_retired_data *retired;
+
+   /**
+    * Fences of the last scenes of each context to access and to write the
+    * resource, and whether some of them couldn't be recorded.  Protected
+    * by the screen's rast_mutex.
+    */
+   struct lp_resource_fence *fences;
+   boolean fences_incomplete;
+
+   /**
+    * Texels are stored in LP_SAMPLER_TILE_SIZE tiles rather than in linear
+    * rows.  Only ever set for textures that so far were just sampled from.
+    */
+   boolean tiled;
+
+   /**
+    * Tiled storage replaced by llvmpipe_resource_untile(), which scenes
+    * binned before may still sample.
+    */
+   void *tiled_data;
+
    boolean userBuffer;  /** Is this a user-space buffer? */
    unsigned timestamp;
 
@@ -109,6 +138,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the box, for mapping tiled textures */
+   ubyte *staging;
 };
 
 
@@ -216,6 +248,11 @@ void *
 llvmpipe_resource_data(struct pipe_resource *resource);
 
 
+boolean
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource);
+
+
 unsigned
 llvmpipe_resource_size(const struct pipe_resource *resource);
 
@@ -254,6 +291,17 @@ llvmpipe_is_resource_referenced( struct pipe_context *pipe,
                                  struct pipe_resource *presource,
                                  unsigned level);
 
+void
+llvmpipe_resource_fence(struct pipe_resource *resource,
+                        const struct pipe_context *pipe,
+                        struct lp_fence *fence,
+                        boolean write);
+
+boolean
+llvmpipe_resource_wait(struct pipe_resource *resource,
+                       boolean write,
+                       boolean do_not_block);
+
 unsigned
 llvmpipe_get_format_alignment(enum pipe_format format);
 
@@ -0,0 +1,190 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+/**
+ * Chrome trace event writer, see lp_trace.h.
+ */
+
+
+#include "util/u_debug.h"
+#include "util/u_string.h"
+#include "os/os_thread.h"
+#include "os/os_time.h"
+#include "lp_limits.h"
+#include "lp_scene.h"
+#include "lp_trace.h"
+
+
+FILE *lp_trace_stream = NULL;
+
+/* The events of all contexts and threads go to the same stream */
+pipe_static_mutex(lp_trace_mutex);
+
+static int64_t lp_trace_time_base;
+static boolean lp_trace_first_event = TRUE;
+
+
+/**
+ * Write an event, separated from the previous one.
+ * Called with the trace mutex held.
+ */
+static void
+write_event(const char *event)
+{
+   fprintf(lp_trace_stream, "%s%s", lp_trace_first_event ? "" : ",\n", event);
+   lp_trace_first_event = FALSE;
+}
+
+
+static void
+write_thread_name(unsigned tid, const char *name)
+{
+   char event[256];
+
+   util_snprintf(event, sizeof event,
+                 "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                 "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 tid, name);
+   write_event(event);
+}
+
+
+/**
+ * Open the trace file named by LP_TRACE, if any.  Only the first screen
+ * opens it, the others share it.
+ */
+void
+lp_trace_init(unsigned num_threads)
+{
+   static boolean initialized = FALSE;
+   const char *filename;
+   unsigned i;
+
+   pipe_mutex_lock(lp_trace_mutex);
+
+   if (!initialized) {
+      initialized = TRUE;
+
+      filename = debug_get_option("LP_TRACE", NULL);
+      if (filename) {
+         lp_trace_stream = fopen(filename, "w");
+         if (!lp_trace_stream)
+            debug_printf("llvmpipe: couldn't open trace file %s\n", filename);
+      }
+
+      if (lp_trace_stream) {
+         lp_trace_time_base = os_time_get_nano();
+
+         fprintf(lp_trace_stream, "[\n");
+         write_thread_name(LP_TRACE_TID_SETUP, "setup");
+         for (i = 0; i < num_threads; i++) {
+            char name[32];
+            util_snprintf(name, sizeof name, "rasterizer %u", i);
+            write_thread_name(LP_TRACE_TID_RAST(i), name);
+         }
+      }
+   }
+
+   pipe_mutex_unlock(lp_trace_mutex);
+}
+
+
+/**
+ * Add a complete event.
+ * \param start, end  os_time_get_nano() times
+ * \param args  members of the event's args object, or NULL
+ */
+void
+lp_trace_event(const char *name, unsigned tid,
+               int64_t start, int64_t end,
+               const char *args)
+{
+   char event[512];
+
+   if (!lp_trace_stream)
+      return;
+
+   util_snprintf(event, sizeof event,
+                 "{\"name\":\"%s\",\"cat\":\"llvmpipe\",\"ph\":\"X\","
+                 "\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"args\":{%s}}",
+                 name, tid,
+                 (start - lp_trace_time_base) / 1000.0,
+                 (end - start) / 1000.0,
+                 args ? args : "");
+
+   pipe_mutex_lock(lp_trace_mutex);
+   write_event(event);
+   pipe_mutex_unlock(lp_trace_mutex);
+}
+
+
+/**
+ * Add the binning and the rasterization of a finished scene.
+ * \param num_threads  number of rasterizer threads, zero when the scene
+ *                     was rasterized by the setup thread
+ */
+void
+lp_trace_scene(const struct lp_scene *scene, unsigned num_threads)
+{
+   const struct lp_scene_timing *timing = &scene->timing;
+   char args[128];
+   unsigned i;
+
+   if (!lp_trace_stream)
+      return;
+
+   util_snprintf(args, sizeof args,
+                 "\"scene\":%u,\"tile_size\":%u,\"bins\":%u",
+                 timing->id, scene->tile_size, scene->num_active_bins);
+   lp_trace_event("bin", LP_TRACE_TID_SETUP,
+                  timing->bin_start, timing->bin_end, args);
+
+   for (i = 0; i < LP_MAX_THREADS; i++) {
+      if (!timing->rast_start[i])
+         continue;
+
+      if (timing->time_shading)
+         util_snprintf(args, sizeof args,
+                       "\"scene\":%u,\"bins\":%u,\"shade_us\":%.3f",
+                       timing->id, timing->nr_bins[i],
+                       timing->shade_time[i] / 1000.0);
+      else
+         util_snprintf(args, sizeof args,
+                       "\"scene\":%u,\"bins\":%u",
+                       timing->id, timing->nr_bins[i]);
+
+      lp_trace_event("rasterize",
+                     num_threads ? LP_TRACE_TID_RAST(i) : LP_TRACE_TID_SETUP,
+                     timing->rast_start[i], timing->rast_end[i], args);
+   }
+
+   pipe_mutex_lock(lp_trace_mutex);
+   fflush(lp_trace_stream);
+   pipe_mutex_unlock(lp_trace_mutex);
+}
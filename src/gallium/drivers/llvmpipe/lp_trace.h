@@ -0,0 +1,79 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+/**
+ * Timeline trace of the scenes, in the Chrome trace event format.
+ *
+ * Set LP_TRACE=<file> and load the file in chrome://tracing.  Binning
+ * and waits of the contexts show on the "setup" row, each rasterizer
+ * thread gets its own row.  The file is written in the JSON array format,
+ * whose closing bracket is optional, so it can be read while the
+ * application is still running.
+ */
+
+
+#ifndef LP_TRACE_H
+#define LP_TRACE_H
+
+#include <stdio.h>
+#include "pipe/p_compiler.h"
+
+
+struct lp_scene;
+
+
+/** Row of the setup module, i.e. the application threads */
+#define LP_TRACE_TID_SETUP 0
+
+/** Row of a rasterizer thread */
+#define LP_TRACE_TID_RAST(thread_index) (1 + (thread_index))
+
+
+extern FILE *lp_trace_stream;
+
+
+static INLINE boolean
+lp_trace_active(void)
+{
+   return lp_trace_stream != NULL;
+}
+
+
+void
+lp_trace_init(unsigned num_threads);
+
+void
+lp_trace_event(const char *name, unsigned tid,
+               int64_t start, int64_t end,
+               const char *args);
+
+void
+lp_trace_scene(const struct lp_scene *scene, unsigned num_threads);
+
+
+#endif /* LP_TRACE_H */
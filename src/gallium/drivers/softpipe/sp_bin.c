@@ -0,0 +1,918 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Binned, multithreaded rasterization.
+ *
+ * The main thread bins the primitives setup hands it to the screen tiles
+ * their bounding boxes overlap, keeping the order they were drawn in.
+ * The tiles are statically distributed over the threads, in a diagonal
+ * pattern so that neighbouring tiles go to different threads.  A thread
+ * sets up each primitive binned to one of its tiles again, with the
+ * cliprect narrowed to the tile, and only ever touches the tiles it owns
+ * in its color/depth tile caches, so no locking is needed.  The caches
+ * are written back when the context is flushed or the framebuffer changes.
+ */
+
+
+#include "pipe/p_defines.h"
+#include "os/os_thread.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "tgsi/tgsi_exec.h"
+#include "sp_bin.h"
+#include "sp_context.h"
+#include "sp_flush.h"
+#include "sp_quad_pipe.h"
+#include "sp_setup.h"
+#include "sp_state.h"
+#include "sp_texture.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_tile_cache.h"
+
+
+/** Size of the blocks the binned vertices are copied to */
+#define SP_BIN_BLOCK_SIZE (64 * 1024)
+
+/** Rasterize when this many primitives or vertex blocks are binned */
+#define SP_BIN_MAX_PRIMS (64 * 1024)
+#define SP_BIN_MAX_BLOCKS 64
+
+#define SP_BIN_TILES_PER_ROW (MAX_WIDTH / TILE_SIZE)
+
+
+enum sp_bin_job
+{
+   SP_BIN_JOB_RASTERIZE,
+   SP_BIN_JOB_FLUSH
+};
+
+
+struct sp_bin_prim
+{
+   unsigned type;   /**< PIPE_PRIM_POINTS, LINES or TRIANGLES */
+   const float (*v[3])[4];
+};
+
+
+/**
+ * The primitives binned to a tile, as indices into sp_binner::prims.
+ */
+struct sp_bin_tile
+{
+   unsigned *prims;
+   unsigned count;
+   unsigned size;
+};
+
+
+struct sp_bin_block
+{
+   struct sp_bin_block *next;
+   ubyte *data;
+};
+
+
+struct sp_bin_thread
+{
+   struct sp_binner *bin;
+   unsigned index;
+   pipe_thread thread;
+   pipe_semaphore work_ready;
+
+   /** Set when primitives were binned to the tiles of this thread */
+   boolean has_work;
+
+   struct sp_quad_pipeline quad;
+   struct setup_context *setup;
+   struct pipe_scissor_state cliprect;
+
+   struct tgsi_exec_machine *fs_machine;
+   struct sp_tgsi_sampler *fs_sampler;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+
+   /** The tiles owned by the thread, laid out like the clear flags */
+   uint tile_mask[SP_BIN_TILES_PER_ROW * (MAX_HEIGHT / TILE_SIZE) / 32];
+
+   uint64_t occlusion_count;
+   uint64_t ps_invocations;
+};
+
+
+struct sp_binner
+{
+   struct softpipe_context *softpipe;
+
+   unsigned num_threads;
+   struct sp_bin_thread *threads[SP_MAX_THREADS];
+   pipe_semaphore work_done;
+   enum sp_bin_job job;
+   boolean exit_flag;
+
+   struct sp_bin_prim *prims;
+   unsigned num_prims;
+   unsigned max_prims;
+
+   /** Bins of the tiles covering the framebuffer */
+   struct sp_bin_tile *tiles;
+   unsigned tiles_x, tiles_y;
+   unsigned max_tiles;
+
+   /** Storage for the binned vertices, the blocks are kept for reuse */
+   struct sp_bin_block *blocks;
+   struct sp_bin_block *block;   /**< current block, NULL if none used */
+   unsigned block_used;
+   unsigned num_blocks;
+
+   /** Set when the thread tile caches may hold rendering */
+   boolean dirty;
+};
+
+
+static INLINE unsigned
+tile_owner(const struct sp_binner *bin, unsigned tx, unsigned ty)
+{
+   return (tx + ty) % bin->num_threads;
+}
+
+
+/**
+ * Rasterize the primitives binned to one tile.
+ */
+static void
+rasterize_tile(struct sp_bin_thread *thread, struct sp_bin_tile *tile,
+               unsigned tx, unsigned ty)
+{
+   const struct sp_binner *bin = thread->bin;
+   const struct pipe_scissor_state *cliprect = &bin->softpipe->cliprect;
+   unsigned i;
+
+   thread->cliprect.minx = MAX2(cliprect->minx, tx * TILE_SIZE);
+   thread->cliprect.miny = MAX2(cliprect->miny, ty * TILE_SIZE);
+   thread->cliprect.maxx = MIN2(cliprect->maxx, (tx + 1) * TILE_SIZE);
+   thread->cliprect.maxy = MIN2(cliprect->maxy, (ty + 1) * TILE_SIZE);
+
+   for (i = 0; i < tile->count; i++) {
+      const struct sp_bin_prim *prim = &bin->prims[tile->prims[i]];
+
+      switch (prim->type) {
+      case PIPE_PRIM_TRIANGLES:
+         sp_setup_tri(thread->setup, prim->v[0], prim->v[1], prim->v[2]);
+         break;
+      case PIPE_PRIM_LINES:
+         sp_setup_line(thread->setup, prim->v[0], prim->v[1]);
+         break;
+      default:
+         sp_setup_point(thread->setup, prim->v[0]);
+         break;
+      }
+   }
+
+   tile->count = 0;
+}
+
+
+static void
+rasterize_bins(struct sp_bin_thread *thread)
+{
+   struct sp_binner *bin = thread->bin;
+   struct softpipe_context *softpipe = bin->softpipe;
+   const struct sp_fragment_shader_variant *fs_variant = softpipe->fs_variant;
+   unsigned tx, ty;
+
+   if (fs_variant && thread->fs_machine->Tokens != fs_variant->tokens) {
+      fs_variant->prepare(fs_variant, thread->fs_machine,
+                          (struct tgsi_sampler *) thread->fs_sampler);
+   }
+
+   sp_build_quad_pipeline(softpipe, &thread->quad);
+   sp_setup_prepare_bin(thread->setup);
+
+   for (ty = 0; ty < bin->tiles_y; ty++) {
+      /* first tx for which tile_owner() is this thread */
+      tx = (thread->index + bin->num_threads - ty % bin->num_threads) %
+           bin->num_threads;
+
+      for (; tx < bin->tiles_x; tx += bin->num_threads) {
+         struct sp_bin_tile *tile = &bin->tiles[ty * bin->tiles_x + tx];
+
+         if (tile->count)
+            rasterize_tile(thread, tile, tx, ty);
+      }
+   }
+}
+
+
+static void
+flush_caches(struct sp_bin_thread *thread)
+{
+   unsigned i;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_flush_tile_cache(thread->cbuf_cache[i]);
+
+   sp_flush_tile_cache(thread->zsbuf_cache);
+}
+
+
+static PIPE_THREAD_ROUTINE( thread_function, init_data )
+{
+   struct sp_bin_thread *thread = (struct sp_bin_thread *) init_data;
+   struct sp_binner *bin = thread->bin;
+
+   while (1) {
+      pipe_semaphore_wait(&thread->work_ready);
+
+      if (bin->exit_flag)
+         break;
+
+      switch (bin->job) {
+      case SP_BIN_JOB_RASTERIZE:
+         rasterize_bins(thread);
+         break;
+      case SP_BIN_JOB_FLUSH:
+         flush_caches(thread);
+         break;
+      }
+
+      pipe_semaphore_signal(&bin->work_done);
+   }
+
+   return 0;
+}
+
+
+/**
+ * Run a job on the threads (all of them, or only the ones with binned
+ * primitives) and wait for them to finish it.
+ */
+static void
+run_job(struct sp_binner *bin, enum sp_bin_job job, boolean all)
+{
+   unsigned i, count = 0;
+
+   bin->job = job;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      if (all || bin->threads[i]->has_work) {
+         pipe_semaphore_signal(&bin->threads[i]->work_ready);
+         count++;
+      }
+   }
+
+   while (count--)
+      pipe_semaphore_wait(&bin->work_done);
+}
+
+
+/**
+ * Point the thread's fragment sampler at the currently bound samplers and
+ * sampler views, with texture tile caches of its own.
+ */
+static boolean
+update_thread_samplers(struct sp_bin_thread *thread)
+{
+   struct softpipe_context *softpipe = thread->bin->softpipe;
+   const unsigned num_views =
+      softpipe->num_sampler_views[PIPE_SHADER_FRAGMENT];
+   unsigned i;
+
+   memcpy(thread->fs_sampler, softpipe->tgsi.sampler[PIPE_SHADER_FRAGMENT],
+          sizeof *thread->fs_sampler);
+
+   for (i = 0; i < Elements(thread->tex_cache); i++) {
+      struct pipe_sampler_view *view = i < num_views ?
+         softpipe->sampler_views[PIPE_SHADER_FRAGMENT][i] : NULL;
+      struct softpipe_tex_tile_cache *tc = thread->tex_cache[i];
+
+      if (!view) {
+         /* don't hold on to unbound textures */
+         if (tc)
+            sp_tex_tile_cache_set_sampler_view(tc, NULL);
+         continue;
+      }
+
+      if (!tc) {
+         tc = sp_create_tex_tile_cache(&softpipe->pipe);
+         if (!tc)
+            return FALSE;
+         thread->tex_cache[i] = tc;
+      }
+
+      sp_tex_tile_cache_set_sampler_view(tc, view);
+
+      if (tc->texture) {
+         struct softpipe_resource *spr = softpipe_resource(tc->texture);
+         if (spr->timestamp != tc->timestamp) {
+            sp_tex_tile_cache_validate_texture(tc);
+            tc->timestamp = spr->timestamp;
+         }
+      }
+
+      thread->fs_sampler->sp_sview[i].cache = tc;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Rasterize all binned primitives with the current state, and release the
+ * vertices they refer to.
+ */
+void
+sp_bin_rasterize(struct sp_binner *bin)
+{
+   struct softpipe_context *softpipe = bin->softpipe;
+   boolean fallback[SP_MAX_THREADS];
+   unsigned i;
+
+   if (!bin->num_prims)
+      return;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = bin->threads[i];
+
+      fallback[i] = thread->has_work && !update_thread_samplers(thread);
+      if (fallback[i])
+         thread->has_work = FALSE;
+   }
+
+   run_job(bin, SP_BIN_JOB_RASTERIZE, FALSE);
+
+   /* The threads which couldn't get texture caches of their own are idle,
+    * so rasterize their tiles here, one after the other, sampling through
+    * the context's texture caches.
+    */
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = bin->threads[i];
+
+      if (fallback[i]) {
+         debug_printf("softpipe: out of memory for thread texture caches\n");
+         memcpy(thread->fs_sampler,
+                softpipe->tgsi.sampler[PIPE_SHADER_FRAGMENT],
+                sizeof *thread->fs_sampler);
+         rasterize_bins(thread);
+      }
+   }
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = bin->threads[i];
+
+      softpipe->occlusion_count += thread->occlusion_count;
+      softpipe->pipeline_statistics.ps_invocations += thread->ps_invocations;
+      thread->occlusion_count = 0;
+      thread->ps_invocations = 0;
+      thread->has_work = FALSE;
+   }
+
+   bin->num_prims = 0;
+   bin->block = NULL;
+   bin->num_blocks = 0;
+   bin->dirty = TRUE;
+}
+
+
+/**
+ * Write back the thread tile caches, and invalidate their texture caches
+ * if SP_FLUSH_TEXTURE_CACHE is set.
+ */
+void
+sp_bin_flush(struct sp_binner *bin, unsigned flags)
+{
+   unsigned i, j;
+
+   sp_bin_rasterize(bin);
+
+   if (bin->dirty) {
+      run_job(bin, SP_BIN_JOB_FLUSH, TRUE);
+      bin->dirty = FALSE;
+   }
+
+   if (flags & SP_FLUSH_TEXTURE_CACHE) {
+      for (i = 0; i < bin->num_threads; i++) {
+         for (j = 0; j < Elements(bin->threads[i]->tex_cache); j++) {
+            if (bin->threads[i]->tex_cache[j])
+               sp_flush_tex_tile_cache(bin->threads[i]->tex_cache[j]);
+         }
+      }
+   }
+}
+
+
+/**
+ * Called before the framebuffer state changes.  Writes back the thread
+ * tile caches of the surfaces that are unbound and points them at the new
+ * ones.
+ */
+void
+sp_bin_set_framebuffer_state(struct sp_binner *bin,
+                             const struct pipe_framebuffer_state *fb)
+{
+   struct softpipe_context *softpipe = bin->softpipe;
+   boolean changed = softpipe->framebuffer.zsbuf != fb->zsbuf;
+   unsigned i, j;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      struct pipe_surface *cb = i < fb->nr_cbufs ? fb->cbufs[i] : NULL;
+      if (softpipe->framebuffer.cbufs[i] != cb)
+         changed = TRUE;
+   }
+
+   if (!changed)
+      return;
+
+   sp_bin_flush(bin, 0);
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = bin->threads[i];
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++) {
+         sp_tile_cache_set_surface(thread->cbuf_cache[j],
+                                   j < fb->nr_cbufs ? fb->cbufs[j] : NULL);
+      }
+      sp_tile_cache_set_surface(thread->zsbuf_cache, fb->zsbuf);
+   }
+}
+
+
+void
+sp_bin_clear_cbuf(struct sp_binner *bin, unsigned cbuf,
+                  const union pipe_color_union *color)
+{
+   unsigned i;
+
+   for (i = 0; i < bin->num_threads; i++)
+      sp_tile_cache_clear(bin->threads[i]->cbuf_cache[cbuf], color, 0);
+
+   bin->dirty = TRUE;
+}
+
+
+void
+sp_bin_clear_zsbuf(struct sp_binner *bin, uint64_t clear_value)
+{
+   static const union pipe_color_union zero;
+   unsigned i;
+
+   for (i = 0; i < bin->num_threads; i++)
+      sp_tile_cache_clear(bin->threads[i]->zsbuf_cache, &zero, clear_value);
+
+   bin->dirty = TRUE;
+}
+
+
+/**
+ * Called before a fragment shader variant is deleted.
+ */
+void
+sp_bin_unbind_fs_variant(struct sp_binner *bin,
+                         const struct sp_fragment_shader_variant *var)
+{
+   unsigned i;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct tgsi_exec_machine *machine = bin->threads[i]->fs_machine;
+
+      if (machine->Tokens == var->tokens)
+         tgsi_exec_machine_bind_shader(machine, NULL, NULL);
+   }
+}
+
+
+static boolean
+next_block(struct sp_binner *bin)
+{
+   struct sp_bin_block *block = bin->block ? bin->block->next : bin->blocks;
+
+   if (!block) {
+      block = CALLOC_STRUCT(sp_bin_block);
+      if (!block)
+         return FALSE;
+
+      block->data = align_malloc(SP_BIN_BLOCK_SIZE, 16);
+      if (!block->data) {
+         FREE(block);
+         return FALSE;
+      }
+
+      if (bin->block)
+         bin->block->next = block;
+      else
+         bin->blocks = block;
+   }
+
+   bin->block = block;
+   bin->block_used = 0;
+   bin->num_blocks++;
+
+   return TRUE;
+}
+
+
+/**
+ * The binned primitives refer to their vertices until they're rasterized,
+ * so the vertices are copied out of the buffer the draw module reuses.
+ * Returns the copy, or NULL if out of memory.
+ */
+const void *
+sp_bin_copy_vertices(struct sp_binner *bin,
+                     const void *vertices, unsigned size)
+{
+   void *copy;
+
+   if (size > SP_BIN_BLOCK_SIZE) {
+      assert(0);
+      return NULL;
+   }
+
+   if (bin->num_prims >= SP_BIN_MAX_PRIMS)
+      sp_bin_rasterize(bin);
+
+   if (!bin->block || bin->block_used + size > SP_BIN_BLOCK_SIZE) {
+      if (bin->num_blocks >= SP_BIN_MAX_BLOCKS)
+         sp_bin_rasterize(bin);
+
+      if (!next_block(bin)) {
+         /* make room by rasterizing what has been binned so far */
+         sp_bin_rasterize(bin);
+         if (!next_block(bin))
+            return NULL;
+      }
+   }
+
+   copy = bin->block->data + bin->block_used;
+   memcpy(copy, vertices, size);
+   bin->block_used += align(size, 16);
+
+   return copy;
+}
+
+
+/**
+ * Size the bins for the current framebuffer, on the first primitive after
+ * rasterizing.
+ */
+static boolean
+begin_binning(struct sp_binner *bin)
+{
+   const struct pipe_framebuffer_state *fb = &bin->softpipe->framebuffer;
+   unsigned num_tiles;
+
+   bin->tiles_x = align(fb->width, TILE_SIZE) / TILE_SIZE;
+   bin->tiles_y = align(fb->height, TILE_SIZE) / TILE_SIZE;
+   num_tiles = bin->tiles_x * bin->tiles_y;
+
+   if (num_tiles > bin->max_tiles) {
+      struct sp_bin_tile *tiles =
+         REALLOC(bin->tiles, bin->max_tiles * sizeof *tiles,
+                 num_tiles * sizeof *tiles);
+      if (!tiles) {
+         bin->tiles_x = bin->tiles_y = 0;
+         return FALSE;
+      }
+
+      memset(tiles + bin->max_tiles, 0,
+             (num_tiles - bin->max_tiles) * sizeof *tiles);
+      bin->tiles = tiles;
+      bin->max_tiles = num_tiles;
+   }
+
+   return TRUE;
+}
+
+
+static INLINE boolean
+bin_to_tile(struct sp_bin_tile *tile, unsigned prim)
+{
+   if (tile->count == tile->size) {
+      unsigned size = MAX2(tile->size * 2, 64);
+      unsigned *prims = REALLOC(tile->prims, tile->size * sizeof *prims,
+                                size * sizeof *prims);
+      if (!prims)
+         return FALSE;
+
+      tile->prims = prims;
+      tile->size = size;
+   }
+
+   tile->prims[tile->count++] = prim;
+   return TRUE;
+}
+
+
+/**
+ * Bin a primitive to the tiles its bounding box, in window coordinates,
+ * overlaps within the cliprect.
+ */
+static void
+bin_prim(struct sp_binner *bin, const struct sp_bin_prim *prim,
+         float xmin, float ymin, float xmax, float ymax)
+{
+   const struct pipe_scissor_state *cliprect = &bin->softpipe->cliprect;
+   unsigned tx0, ty0, tx1, ty1, tx, ty;
+
+   /* allow for the pixel center and rounding conventions of setup */
+   xmin -= 1.0f;
+   ymin -= 1.0f;
+   xmax += 1.0f;
+   ymax += 1.0f;
+
+   if (xmax < (float) cliprect->minx || xmin >= (float) cliprect->maxx ||
+       ymax < (float) cliprect->miny || ymin >= (float) cliprect->maxy)
+      return;
+
+   if (bin->num_prims == 0 && !begin_binning(bin))
+      return;
+
+   if (bin->num_prims == bin->max_prims) {
+      unsigned max_prims = MAX2(bin->max_prims * 2, 1024);
+      struct sp_bin_prim *prims =
+         REALLOC(bin->prims, bin->max_prims * sizeof *prims,
+                 max_prims * sizeof *prims);
+      if (!prims)
+         return;
+
+      bin->prims = prims;
+      bin->max_prims = max_prims;
+   }
+
+   bin->prims[bin->num_prims] = *prim;
+
+   tx0 = (unsigned) MAX2(xmin, (float) cliprect->minx) / TILE_SIZE;
+   ty0 = (unsigned) MAX2(ymin, (float) cliprect->miny) / TILE_SIZE;
+   tx1 = (unsigned) MIN2(xmax, (float) (cliprect->maxx - 1)) / TILE_SIZE;
+   ty1 = (unsigned) MIN2(ymax, (float) (cliprect->maxy - 1)) / TILE_SIZE;
+
+   tx1 = MIN2(tx1, bin->tiles_x - 1);
+   ty1 = MIN2(ty1, bin->tiles_y - 1);
+
+   for (ty = ty0; ty <= ty1; ty++) {
+      for (tx = tx0; tx <= tx1; tx++) {
+         if (bin_to_tile(&bin->tiles[ty * bin->tiles_x + tx], bin->num_prims))
+            bin->threads[tile_owner(bin, tx, ty)]->has_work = TRUE;
+      }
+   }
+
+   bin->num_prims++;
+}
+
+
+void
+sp_bin_tri(struct sp_binner *bin,
+           const float (*v0)[4],
+           const float (*v1)[4],
+           const float (*v2)[4])
+{
+   struct sp_bin_prim prim;
+
+   prim.type = PIPE_PRIM_TRIANGLES;
+   prim.v[0] = v0;
+   prim.v[1] = v1;
+   prim.v[2] = v2;
+
+   bin_prim(bin, &prim,
+            MIN3(v0[0][0], v1[0][0], v2[0][0]),
+            MIN3(v0[0][1], v1[0][1], v2[0][1]),
+            MAX3(v0[0][0], v1[0][0], v2[0][0]),
+            MAX3(v0[0][1], v1[0][1], v2[0][1]));
+}
+
+
+void
+sp_bin_line(struct sp_binner *bin,
+            const float (*v0)[4],
+            const float (*v1)[4])
+{
+   struct sp_bin_prim prim;
+
+   prim.type = PIPE_PRIM_LINES;
+   prim.v[0] = v0;
+   prim.v[1] = v1;
+   prim.v[2] = NULL;
+
+   bin_prim(bin, &prim,
+            MIN2(v0[0][0], v1[0][0]),
+            MIN2(v0[0][1], v1[0][1]),
+            MAX2(v0[0][0], v1[0][0]),
+            MAX2(v0[0][1], v1[0][1]));
+}
+
+
+void
+sp_bin_point(struct sp_binner *bin,
+             const float (*v0)[4],
+             float size)
+{
+   const float half_size = 0.5f * size;
+   struct sp_bin_prim prim;
+
+   prim.type = PIPE_PRIM_POINTS;
+   prim.v[0] = v0;
+   prim.v[1] = NULL;
+   prim.v[2] = NULL;
+
+   bin_prim(bin, &prim,
+            v0[0][0] - half_size, v0[0][1] - half_size,
+            v0[0][0] + half_size, v0[0][1] + half_size);
+}
+
+
+static void
+destroy_thread(struct sp_bin_thread *thread)
+{
+   unsigned i;
+
+   if (thread->setup)
+      sp_setup_destroy_context(thread->setup);
+
+   sp_destroy_quad_pipeline(&thread->quad);
+
+   if (thread->fs_machine)
+      tgsi_exec_machine_destroy(thread->fs_machine);
+
+   FREE(thread->fs_sampler);
+
+   for (i = 0; i < Elements(thread->tex_cache); i++) {
+      if (thread->tex_cache[i])
+         sp_destroy_tex_tile_cache(thread->tex_cache[i]);
+   }
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      if (thread->cbuf_cache[i])
+         sp_destroy_tile_cache(thread->cbuf_cache[i]);
+   }
+
+   if (thread->zsbuf_cache)
+      sp_destroy_tile_cache(thread->zsbuf_cache);
+
+   FREE(thread);
+}
+
+
+static struct sp_bin_thread *
+create_thread(struct sp_binner *bin, unsigned index)
+{
+   struct softpipe_context *softpipe = bin->softpipe;
+   struct sp_bin_thread *thread;
+   unsigned i, tx, ty;
+
+   thread = CALLOC_STRUCT(sp_bin_thread);
+   if (!thread)
+      return NULL;
+
+   thread->bin = bin;
+   thread->index = index;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      thread->cbuf_cache[i] = sp_create_tile_cache(&softpipe->pipe);
+      if (!thread->cbuf_cache[i])
+         goto fail;
+      thread->cbuf_cache[i]->clear_mask = thread->tile_mask;
+   }
+
+   thread->zsbuf_cache = sp_create_tile_cache(&softpipe->pipe);
+   if (!thread->zsbuf_cache)
+      goto fail;
+   thread->zsbuf_cache->clear_mask = thread->tile_mask;
+
+   for (ty = 0; ty < MAX_HEIGHT / TILE_SIZE; ty++) {
+      for (tx = 0; tx < SP_BIN_TILES_PER_ROW; tx++) {
+         if (tile_owner(bin, tx, ty) == index) {
+            unsigned pos = ty * SP_BIN_TILES_PER_ROW + tx;
+            thread->tile_mask[pos / 32] |= 1 << (pos % 32);
+         }
+      }
+   }
+
+   thread->fs_machine = tgsi_exec_machine_create();
+   thread->fs_sampler = sp_create_tgsi_sampler();
+   if (!thread->fs_machine || !thread->fs_sampler)
+      goto fail;
+
+   if (!sp_init_quad_pipeline(softpipe, &thread->quad))
+      goto fail;
+
+   thread->quad.fs_machine = thread->fs_machine;
+   thread->quad.cbuf_cache = thread->cbuf_cache;
+   thread->quad.zsbuf_cache = thread->zsbuf_cache;
+   thread->quad.occlusion_count = &thread->occlusion_count;
+   thread->quad.ps_invocations = &thread->ps_invocations;
+
+   thread->setup = sp_setup_create_bin_context(softpipe, &thread->quad,
+                                               &thread->cliprect);
+   if (!thread->setup)
+      goto fail;
+
+   pipe_semaphore_init(&thread->work_ready, 0);
+
+   return thread;
+
+fail:
+   destroy_thread(thread);
+   return NULL;
+}
+
+
+/**
+ * Create the binner and its threads.  Called early in context creation,
+ * the setup contexts of the threads only keep the context pointer.
+ */
+struct sp_binner *
+sp_bin_create(struct softpipe_context *softpipe, unsigned num_threads)
+{
+   struct sp_binner *bin;
+   unsigned i;
+
+   assert(num_threads > 0 && num_threads <= SP_MAX_THREADS);
+
+   bin = CALLOC_STRUCT(sp_binner);
+   if (!bin)
+      return NULL;
+
+   bin->softpipe = softpipe;
+   bin->num_threads = num_threads;
+
+   for (i = 0; i < num_threads; i++) {
+      bin->threads[i] = create_thread(bin, i);
+      if (!bin->threads[i])
+         goto fail;
+   }
+
+   pipe_semaphore_init(&bin->work_done, 0);
+
+   for (i = 0; i < num_threads; i++) {
+      bin->threads[i]->thread = pipe_thread_create(thread_function,
+                                                   bin->threads[i]);
+   }
+
+   return bin;
+
+fail:
+   while (i--)
+      destroy_thread(bin->threads[i]);
+   FREE(bin);
+   return NULL;
+}
+
+
+void
+sp_bin_destroy(struct sp_binner *bin)
+{
+   struct sp_bin_block *block, *next;
+   unsigned i;
+
+   bin->exit_flag = TRUE;
+
+   for (i = 0; i < bin->num_threads; i++)
+      pipe_semaphore_signal(&bin->threads[i]->work_ready);
+
+   for (i = 0; i < bin->num_threads; i++) {
+      pipe_thread_wait(bin->threads[i]->thread);
+      pipe_semaphore_destroy(&bin->threads[i]->work_ready);
+      destroy_thread(bin->threads[i]);
+   }
+
+   pipe_semaphore_destroy(&bin->work_done);
+
+   for (i = 0; i < bin->max_tiles; i++)
+      FREE(bin->tiles[i].prims);
+   FREE(bin->tiles);
+   FREE(bin->prims);
+
+   for (block = bin->blocks; block; block = next) {
+      next = block->next;
+      align_free(block->data);
+      FREE(block);
+   }
+
+   FREE(bin);
+}
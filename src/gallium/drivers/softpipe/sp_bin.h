@@ -0,0 +1,101 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Binned, multithreaded rasterization.
+ *
+ * When SOFTPIPE_NUM_THREADS is set, setup doesn't rasterize primitives
+ * itself but bins them to the screen tiles their bounding boxes touch.
+ * When the draw call is done the bins are handed to a pool of threads.
+ * Every tile is owned by one thread, which sets up and rasterizes the
+ * tile's primitives in submission order through a quad pipeline, TGSI
+ * machine, sampler and color/depth tile caches of its own.
+ */
+
+#ifndef SP_BIN_H
+#define SP_BIN_H
+
+#include "pipe/p_compiler.h"
+
+/** Maximum number of binning threads */
+#define SP_MAX_THREADS 32
+
+struct softpipe_context;
+struct sp_binner;
+struct sp_fragment_shader_variant;
+struct pipe_framebuffer_state;
+union pipe_color_union;
+
+
+struct sp_binner *
+sp_bin_create(struct softpipe_context *softpipe, unsigned num_threads);
+
+void
+sp_bin_destroy(struct sp_binner *bin);
+
+const void *
+sp_bin_copy_vertices(struct sp_binner *bin,
+                     const void *vertices, unsigned size);
+
+void
+sp_bin_tri(struct sp_binner *bin,
+           const float (*v0)[4],
+           const float (*v1)[4],
+           const float (*v2)[4]);
+
+void
+sp_bin_line(struct sp_binner *bin,
+            const float (*v0)[4],
+            const float (*v1)[4]);
+
+void
+sp_bin_point(struct sp_binner *bin,
+             const float (*v0)[4],
+             float size);
+
+void
+sp_bin_rasterize(struct sp_binner *bin);
+
+void
+sp_bin_flush(struct sp_binner *bin, unsigned flags);
+
+void
+sp_bin_set_framebuffer_state(struct sp_binner *bin,
+                             const struct pipe_framebuffer_state *fb);
+
+void
+sp_bin_clear_cbuf(struct sp_binner *bin, unsigned cbuf,
+                  const union pipe_color_union *color);
+
+void
+sp_bin_clear_zsbuf(struct sp_binner *bin, uint64_t clear_value);
+
+void
+sp_bin_unbind_fs_variant(struct sp_binner *bin,
+                         const struct sp_fragment_shader_variant *var);
+
+#endif /* SP_BIN_H */
@@ -37,6 +37,7 @@
 #include "util/u_prim.h"
 
 #include "sp_context.h"
+#include "sp_flush.h"
 #include "sp_query.h"
 #include "sp_state.h"
 #include "sp_texture.h"
@@ -145,7 +146,7 @@ softpipe_draw_vbo(struct pipe_context *pipe,
     * (or even better, modify draw module to do this
     * internally when this condition is seen?)
     */
-   draw_flush(draw);
+   softpipe_draw_flush(sp);
 
    /* Note: leave drawing surfaces mapped */
    sp->dirty_render_cache = TRUE;
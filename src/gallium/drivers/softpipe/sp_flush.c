@@ -33,6 +33,7 @@
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
+#include "sp_bin.h"
 #include "sp_flush.h"
 #include "sp_context.h"
 #include "sp_state.h"
@@ -42,6 +43,20 @@
 #include "util/u_string.h"
 
 
+/**
+ * Flush the draw module, and with binning rasterize what it binned, so that
+ * everything drawn so far is rendered with the current state.
+ */
+void
+softpipe_draw_flush(struct softpipe_context *softpipe)
+{
+   draw_flush(softpipe->draw);
+
+   if (softpipe->binner)
+      sp_bin_rasterize(softpipe->binner);
+}
+
+
 void
 softpipe_flush( struct pipe_context *pipe,
                 unsigned flags,
@@ -50,7 +65,10 @@ softpipe_flush( struct pipe_context *pipe,
    struct softpipe_context *softpipe = softpipe_context(pipe);
    uint i;
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
+
+   if (softpipe->binner)
+      sp_bin_flush(softpipe->binner, flags);
 
    if (flags & SP_FLUSH_TEXTURE_CACHE) {
       unsigned sh;
@@ -32,9 +32,13 @@
 
 struct pipe_context;
 struct pipe_fence_handle;
+struct softpipe_context;
 
 #define SP_FLUSH_TEXTURE_CACHE  0x2
 
+void
+softpipe_draw_flush(struct softpipe_context *softpipe);
+
 void
 softpipe_flush(struct pipe_context *pipe,
                unsigned flags,
@@ -36,6 +36,7 @@
  */
 
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_setup.h"
 #include "sp_state.h"
@@ -46,7 +47,7 @@
 #include "util/u_prim.h"
 
 
-#define SP_MAX_VBUF_INDEXES 1024
+#define SP_MAX_VBUF_INDEXES 16384
 #define SP_MAX_VBUF_SIZE    4096
 
 typedef const float (*cptrf4)[4];
@@ -145,6 +146,49 @@ sp_vbuf_set_primitive(struct vbuf_render *vbr, unsigned prim)
 }
 
 
+/**
+ * The vertices to set up primitives from.  With binning they're copied, as
+ * the primitives are only rasterized after the buffer has been reused.
+ */
+static const void *
+get_vertex_buffer(struct softpipe_vbuf_render *cvbr)
+{
+   struct sp_binner *binner = cvbr->softpipe->binner;
+   const void *copy;
+
+   if (!binner)
+      return cvbr->vertex_buffer;
+
+   copy = sp_bin_copy_vertices(binner, cvbr->vertex_buffer,
+                               cvbr->vertex_size * cvbr->nr_vertices);
+   if (!copy) {
+      /* Out of memory.  Bin the primitives from the buffer itself, and
+       * rasterize them in put_vertex_buffer().
+       */
+      debug_printf("softpipe: out of memory for binned vertices\n");
+      return cvbr->vertex_buffer;
+   }
+
+   return copy;
+}
+
+
+/**
+ * Called when done with the vertices get_vertex_buffer() returned.  If
+ * they weren't copied, rasterize what refers to them before the draw
+ * module reuses the buffer.
+ */
+static void
+put_vertex_buffer(struct softpipe_vbuf_render *cvbr,
+                  const void *vertex_buffer)
+{
+   struct sp_binner *binner = cvbr->softpipe->binner;
+
+   if (binner && vertex_buffer == cvbr->vertex_buffer)
+      sp_bin_rasterize(binner);
+}
+
+
 static INLINE cptrf4 get_vert( const void *vertex_buffer,
                                int index,
                                int stride )
@@ -162,11 +206,14 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
    struct softpipe_context *softpipe = cvbr->softpipe;
    const unsigned stride = softpipe->vertex_info_vbuf.size * sizeof(float);
-   const void *vertex_buffer = cvbr->vertex_buffer;
+   const void *vertex_buffer = get_vertex_buffer(cvbr);
    struct setup_context *setup = cvbr->setup;
    const boolean flatshade_first = softpipe->rasterizer->flatshade_first;
    unsigned i;
 
+   if (!vertex_buffer)
+      return;
+
    switch (cvbr->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -345,6 +392,8 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   put_vertex_buffer(cvbr, vertex_buffer);
 }
 
 
@@ -359,11 +408,16 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    struct softpipe_context *softpipe = cvbr->softpipe;
    struct setup_context *setup = cvbr->setup;
    const unsigned stride = softpipe->vertex_info_vbuf.size * sizeof(float);
-   const void *vertex_buffer =
-      (void *) get_vert(cvbr->vertex_buffer, start, stride);
+   const void *vertices = get_vertex_buffer(cvbr);
+   const void *vertex_buffer;
    const boolean flatshade_first = softpipe->rasterizer->flatshade_first;
    unsigned i;
 
+   if (!vertices)
+      return;
+
+   vertex_buffer = get_vert(vertices, start, stride);
+
    switch (cvbr->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -585,6 +639,8 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   put_vertex_buffer(cvbr, vertices);
 }
 
 /*
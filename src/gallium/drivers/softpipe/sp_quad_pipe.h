@@ -31,8 +31,13 @@
 #ifndef SP_QUAD_PIPE_H
 #define SP_QUAD_PIPE_H
 
+#include "pipe/p_compiler.h"
+
 
 struct softpipe_context;
+struct softpipe_tile_cache;
+struct sp_quad_pipeline;
+struct tgsi_exec_machine;
 struct quad_header;
 
 
@@ -43,6 +48,7 @@ struct quad_header;
  */
 struct quad_stage {
    struct softpipe_context *softpipe;
+   struct sp_quad_pipeline *pipeline;  /**< the pipeline this stage is in */
 
    struct quad_stage *next;
 
@@ -55,6 +61,28 @@ struct quad_stage {
 };
 
 
+/**
+ * A quad pipeline and the mutable state its stages render with: the
+ * fragment shader machine, the color/depth tile caches and the query
+ * counters.  The context has one for rendering on the calling thread and
+ * each binning thread (see sp_bin.c) has its own.
+ */
+struct sp_quad_pipeline {
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+   struct quad_stage *first; /**< points to one of the above stages */
+
+   struct tgsi_exec_machine *fs_machine;
+   struct softpipe_tile_cache **cbuf_cache;  /**< [PIPE_MAX_COLOR_BUFS] */
+   struct softpipe_tile_cache *zsbuf_cache;
+
+   uint64_t *occlusion_count;
+   uint64_t *ps_invocations;
+};
+
+
 struct quad_stage *sp_quad_polygon_stipple_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_earlyz_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_shade_stage( struct softpipe_context *softpipe );
@@ -67,6 +95,10 @@ struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_colormask_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_output_stage( struct softpipe_context *softpipe );
 
-void sp_build_quad_pipeline(struct softpipe_context *sp);
+boolean sp_init_quad_pipeline(struct softpipe_context *sp,
+                              struct sp_quad_pipeline *qp);
+void sp_destroy_quad_pipeline(struct sp_quad_pipeline *qp);
+void sp_build_quad_pipeline(struct softpipe_context *sp,
+                            struct sp_quad_pipeline *qp);
 
 #endif /* SP_QUAD_PIPE_H */
@@ -32,6 +32,7 @@
  * \author  Brian Paul
  */
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_quad.h"
 #include "sp_quad_pipe.h"
@@ -75,6 +76,18 @@ struct edge {
 struct setup_context {
    struct softpipe_context *softpipe;
 
+   /** Where the quads go: the context's pipeline or a binning thread's */
+   struct sp_quad_pipeline *pipeline;
+
+   /** Scissor/surface bounds, narrowed to a tile on binning threads */
+   const struct pipe_scissor_state *cliprect;
+
+   /** If set, primitives are binned here and rasterized by its threads */
+   struct sp_binner *binner;
+
+   /** Set for the setup contexts of the binning threads */
+   boolean bin_thread;
+
    /* Vertices are just an array of floats making up each attribute in
     * turn.  Currently fixed at 4 floats, but should change in time.
     * Codegen will help cope with this.
@@ -127,7 +140,7 @@ struct setup_context {
 static INLINE void
 quad_clip(struct setup_context *setup, struct quad_header *quad)
 {
-   const struct pipe_scissor_state *cliprect = &setup->softpipe->cliprect;
+   const struct pipe_scissor_state *cliprect = setup->cliprect;
    const int minx = (int) cliprect->minx;
    const int maxx = (int) cliprect->maxx;
    const int miny = (int) cliprect->miny;
@@ -161,13 +174,13 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
    quad_clip( setup, quad );
 
    if (quad->inout.mask) {
-      struct softpipe_context *sp = setup->softpipe;
+      struct quad_stage *pipe = setup->pipeline->first;
 
 #if DEBUG_FRAGS
       setup->numFragsEmitted += util_bitcount(quad->inout.mask);
 #endif
 
-      sp->quad.first->run( sp->quad.first, &quad, 1 );
+      pipe->run( pipe, &quad, 1 );
    }
 }
 
@@ -202,7 +215,7 @@ flush_spans(struct setup_context *setup)
    const int xleft1 = setup->span.left[1];
    const int xright0 = setup->span.right[0];
    const int xright1 = setup->span.right[1];
-   struct quad_stage *pipe = setup->softpipe->quad.first;
+   struct quad_stage *pipe = setup->pipeline->first;
 
    const int minleft = block_x(MIN2(xleft0, xleft1));
    const int maxright = MAX2(xright0, xright1);
@@ -704,7 +717,7 @@ subtriangle(struct setup_context *setup,
             struct edge *eright,
             int lines)
 {
-   const struct pipe_scissor_state *cliprect = &setup->softpipe->cliprect;
+   const struct pipe_scissor_state *cliprect = setup->cliprect;
    const int minx = (int) cliprect->minx;
    const int maxx = (int) cliprect->maxx;
    const int miny = (int) cliprect->miny;
@@ -825,10 +838,23 @@ sp_setup_tri(struct setup_context *setup,
    if (!setup_sort_vertices( setup, det, v0, v1, v2 ))
       return;
 
+   /* Binning threads see each triangle once per tile it is binned to,
+    * it's counted when it's binned.
+    */
+   if (setup->softpipe->active_statistics_queries && !setup->bin_thread) {
+      setup->softpipe->pipeline_statistics.c_primitives++;
+   }
+
+   if (setup->binner) {
+      sp_bin_tri(setup->binner, v0, v1, v2);
+      return;
+   }
+
    setup_tri_coefficients( setup );
    setup_tri_edges( setup );
 
-   assert(setup->softpipe->reduced_prim == PIPE_PRIM_TRIANGLES);
+   assert(setup->bin_thread ||
+          setup->softpipe->reduced_prim == PIPE_PRIM_TRIANGLES);
 
    setup->span.y = 0;
    setup->span.right[0] = 0;
@@ -852,10 +878,6 @@ sp_setup_tri(struct setup_context *setup,
 
    flush_spans( setup );
 
-   if (setup->softpipe->active_statistics_queries) {
-      setup->softpipe->pipeline_statistics.c_primitives++;
-   }
-
 #if DEBUG_FRAGS
    printf("Tri: %u frags emitted, %u written\n",
           setup->numFragsEmitted,
@@ -1085,6 +1107,11 @@ sp_setup_line(struct setup_context *setup,
    if (dx == 0 && dy == 0)
       return;
 
+   if (setup->binner) {
+      sp_bin_line(setup->binner, v0, v1);
+      return;
+   }
+
    if (!setup_line_coefficients(setup, v0, v1))
       return;
 
@@ -1111,7 +1138,8 @@ sp_setup_line(struct setup_context *setup,
 
    assert(dx >= 0);
    assert(dy >= 0);
-   assert(setup->softpipe->reduced_prim == PIPE_PRIM_LINES);
+   assert(setup->bin_thread ||
+          setup->softpipe->reduced_prim == PIPE_PRIM_LINES);
 
    setup->quad[0].input.x0 = setup->quad[0].input.y0 = -1;
    setup->quad[0].inout.mask = 0x0;
@@ -1215,7 +1243,13 @@ sp_setup_point(struct setup_context *setup,
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
 
-   assert(setup->softpipe->reduced_prim == PIPE_PRIM_POINTS);
+   if (setup->binner) {
+      sp_bin_point(setup->binner, v0, size);
+      return;
+   }
+
+   assert(setup->bin_thread ||
+          setup->softpipe->reduced_prim == PIPE_PRIM_POINTS);
 
    /* For points, all interpolants are constant-valued.
     * However, for point sprites, we'll need to setup texcoords appropriately.
@@ -1394,6 +1428,25 @@ sp_setup_point(struct setup_context *setup,
 }
 
 
+/**
+ * Which faces setup culls, the rest is left to the draw module.
+ */
+static unsigned
+get_cull_face(const struct softpipe_context *sp)
+{
+   if (sp->reduced_api_prim == PIPE_PRIM_TRIANGLES &&
+       sp->rasterizer->fill_front == PIPE_POLYGON_MODE_FILL &&
+       sp->rasterizer->fill_back == PIPE_POLYGON_MODE_FILL) {
+      /* we'll do culling */
+      return sp->rasterizer->cull_face;
+   }
+   else {
+      /* 'draw' will do culling */
+      return PIPE_FACE_NONE;
+   }
+}
+
+
 /**
  * Called by vbuf code just before we start buffering primitives.
  */
@@ -1411,16 +1464,24 @@ sp_setup_prepare(struct setup_context *setup)
 
    sp->quad.first->begin( sp->quad.first );
 
-   if (sp->reduced_api_prim == PIPE_PRIM_TRIANGLES &&
-       sp->rasterizer->fill_front == PIPE_POLYGON_MODE_FILL &&
-       sp->rasterizer->fill_back == PIPE_POLYGON_MODE_FILL) {
-      /* we'll do culling */
-      setup->cull_face = sp->rasterizer->cull_face;
-   }
-   else {
-      /* 'draw' will do culling */
-      setup->cull_face = PIPE_FACE_NONE;
-   }
+   setup->cull_face = get_cull_face(sp);
+}
+
+
+/**
+ * Called on a binning thread before it rasterizes the binned primitives.
+ * The state can't have changed since they were binned.
+ */
+void
+sp_setup_prepare_bin(struct setup_context *setup)
+{
+   struct softpipe_context *sp = setup->softpipe;
+
+   setup->nr_vertex_attrs = draw_num_shader_outputs(sp->draw);
+
+   setup->pipeline->first->begin( setup->pipeline->first );
+
+   setup->cull_face = get_cull_face(sp);
 }
 
 
@@ -1436,11 +1497,39 @@ sp_setup_destroy_context(struct setup_context *setup)
  */
 struct setup_context *
 sp_setup_create_context(struct softpipe_context *softpipe)
+{
+   struct setup_context *setup =
+      sp_setup_create_bin_context(softpipe, &softpipe->quad,
+                                  &softpipe->cliprect);
+
+   if (setup) {
+      setup->binner = softpipe->binner;
+      setup->bin_thread = FALSE;
+   }
+
+   return setup;
+}
+
+
+/**
+ * Create the setup context of a binning thread, which rasterizes into its
+ * own quad pipeline and only within the given cliprect.
+ */
+struct setup_context *
+sp_setup_create_bin_context(struct softpipe_context *softpipe,
+                            struct sp_quad_pipeline *pipeline,
+                            const struct pipe_scissor_state *cliprect)
 {
    struct setup_context *setup = CALLOC_STRUCT(setup_context);
    unsigned i;
 
+   if (!setup)
+      return NULL;
+
    setup->softpipe = softpipe;
+   setup->pipeline = pipeline;
+   setup->cliprect = cliprect;
+   setup->bin_thread = TRUE;
 
    for (i = 0; i < MAX_QUADS; i++) {
       setup->quad[i].coef = setup->coef;
@@ -29,6 +29,8 @@
 
 struct setup_context;
 struct softpipe_context;
+struct sp_quad_pipeline;
+struct pipe_scissor_state;
 
 void 
 sp_setup_tri( struct setup_context *setup,
@@ -47,7 +49,12 @@ sp_setup_point( struct setup_context *setup,
 
 
 struct setup_context *sp_setup_create_context( struct softpipe_context *softpipe );
+struct setup_context *
+sp_setup_create_bin_context(struct softpipe_context *softpipe,
+                            struct sp_quad_pipeline *pipeline,
+                            const struct pipe_scissor_state *cliprect);
 void sp_setup_prepare( struct setup_context *setup );
+void sp_setup_prepare_bin( struct setup_context *setup );
 void sp_setup_destroy_context( struct setup_context *setup );
 
 #endif
@@ -32,6 +32,7 @@
 #include "util/u_memory.h"
 #include "draw/draw_context.h"
 #include "sp_context.h"
+#include "sp_flush.h"
 #include "sp_state.h"
 
 
@@ -49,7 +50,7 @@ softpipe_bind_blend_state(struct pipe_context *pipe,
 {
    struct softpipe_context *softpipe = softpipe_context(pipe);
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    softpipe->blend = (struct pipe_blend_state *)blend;
 
@@ -72,7 +73,7 @@ softpipe_set_blend_color(struct pipe_context *pipe,
    struct softpipe_context *softpipe = softpipe_context(pipe);
    unsigned i;
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    softpipe->blend_color = *blend_color;
 
@@ -28,6 +28,7 @@
 /* Authors:  Keith Whitwell <keithw@vmware.com>
  */
 #include "sp_context.h"
+#include "sp_flush.h"
 #include "sp_state.h"
 #include "draw/draw_context.h"
 
@@ -68,7 +69,7 @@ softpipe_set_scissor_states(struct pipe_context *pipe,
 {
    struct softpipe_context *softpipe = softpipe_context(pipe);
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    softpipe->scissor = *scissor; /* struct copy */
    softpipe->dirty |= SP_NEW_SCISSOR;
@@ -81,7 +82,7 @@ softpipe_set_polygon_stipple(struct pipe_context *pipe,
 {
    struct softpipe_context *softpipe = softpipe_context(pipe);
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    softpipe->poly_stipple = *stipple; /* struct copy */
    softpipe->dirty |= SP_NEW_STIPPLE;
@@ -35,6 +35,7 @@
 #include "draw/draw_context.h"
 
 #include "sp_context.h"
+#include "sp_flush.h"
 #include "sp_state.h"
 #include "sp_texture.h"
 #include "sp_tex_sample.h"
@@ -64,7 +65,7 @@ softpipe_bind_sampler_states(struct pipe_context *pipe,
       return;
    }
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    /* set the new samplers */
    for (i = 0; i < num; i++) {
@@ -119,7 +120,7 @@ softpipe_set_sampler_views(struct pipe_context *pipe,
       return;
    }
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    /* set the new sampler views */
    for (i = 0; i < num; i++) {
@@ -25,7 +25,9 @@
  * 
  **************************************************************************/
 
+#include "sp_bin.h"
 #include "sp_context.h"
+#include "sp_flush.h"
 #include "sp_state.h"
 #include "sp_fs.h"
 #include "sp_texture.h"
@@ -153,7 +155,7 @@ softpipe_bind_fs_state(struct pipe_context *pipe, void *fs)
    if (softpipe->fs == fs)
       return;
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    softpipe->fs = fs;
 
@@ -192,6 +194,9 @@ softpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
       draw_delete_fragment_shader(softpipe->draw, var->draw_shader);
 #endif
 
+      if (softpipe->binner)
+         sp_bin_unbind_fs_variant(softpipe->binner, var);
+
       var->delete(var, softpipe->fs_machine);
    }
 
@@ -361,7 +366,7 @@ softpipe_set_constant_buffer(struct pipe_context *pipe,
    if (data)
       data = (const char *) data + cb->buffer_offset;
 
-   draw_flush(softpipe->draw);
+   softpipe_draw_flush(softpipe);
 
    /* note: reference counting */
    pipe_resource_reference(&softpipe->constants[shader][index], constants);
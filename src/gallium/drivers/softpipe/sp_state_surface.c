@@ -28,7 +28,9 @@
 /* Authors:  Keith Whitwell <keithw@vmware.com>
  */
 
+#include "sp_bin.h"
 #include "sp_context.h"
+#include "sp_flush.h"
 #include "sp_state.h"
 #include "sp_tile_cache.h"
 
@@ -51,7 +53,10 @@ softpipe_set_framebuffer_state(struct pipe_context *pipe,
    struct softpipe_context *sp = softpipe_context(pipe);
    uint i;
 
-   draw_flush(sp->draw);
+   softpipe_draw_flush(sp);
+
+   if (sp->binner)
+      sp_bin_set_framebuffer_state(sp->binner, fb);
 
    for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
       struct pipe_surface *cb = i < fb->nr_cbufs ? fb->cbufs[i] : NULL;
@@ -2841,9 +2841,10 @@ sample_cube(struct sp_sampler_view *sp_sview,
    float ssss[4], tttt[4];
 
    /* Not actually used, but the intermediate steps that do the
-    * dereferencing don't know it.
+    * dereferencing don't know it.  Not static: binning threads may
+    * sample cube maps concurrently.
     */
-   static float pppp[4] = { 0, 0, 0, 0 };
+   float pppp[4];
 
    pppp[0] = c0[0];
    pppp[1] = c0[1];
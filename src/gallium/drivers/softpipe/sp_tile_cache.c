@@ -606,7 +606,10 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
    tc->clear_val = clearValue;
 
    /* set flags to indicate all the tiles are cleared */
-   memset(tc->clear_flags, 255, sizeof(tc->clear_flags));
+   if (tc->clear_mask)
+      memcpy(tc->clear_flags, tc->clear_mask, sizeof(tc->clear_flags));
+   else
+      memset(tc->clear_flags, 255, sizeof(tc->clear_flags));
 
    for (pos = 0; pos < Elements(tc->tile_addrs); pos++) {
       tc->tile_addrs[pos].bits.invalid = 1;
@@ -88,6 +88,12 @@ struct softpipe_tile_cache
    union tile_address tile_addrs[NUM_ENTRIES];
    struct softpipe_cached_tile *entries[NUM_ENTRIES];
    uint clear_flags[(MAX_WIDTH / TILE_SIZE) * (MAX_HEIGHT / TILE_SIZE) / 32];
+   /**
+    * If set, clears only flag the tiles whose bit is set in this mask,
+    * which has the same layout as clear_flags.  Used by the binning threads
+    * so that each one only writes back the cleared tiles it owns.
+    */
+   const uint *clear_mask;
    union pipe_color_union clear_color; /**< for color bufs */
    uint64_t clear_val;        /**< for z+stencil */
    boolean depth_stencil; /**< Is the surface a depth/stencil format? */
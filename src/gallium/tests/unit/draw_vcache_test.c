@@ -0,0 +1,389 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+/*
+ * Measures how many vertices the draw module's post-transform vertex
+ * cache ends up shading per index, for a few procedural meshes and a
+ * range of cache sizes, and checks the counts: every vertex is shaded at
+ * least once and at most once per index, a bigger cache never shades
+ * more, a cache that holds the whole mesh shades each vertex exactly
+ * once, and the row ordered 16x16 grid gives known counts.
+ *
+ * Usage: draw_vcache_test [grid_size]
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "cso_cache/cso_context.h"
+#include "draw/draw_context.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "softpipe/sp_context.h"
+#include "softpipe/sp_public.h"
+#include "sw/null/null_sw_winsys.h"
+
+
+#define WIDTH 64
+#define HEIGHT 64
+
+
+static const unsigned cache_sizes[] = {
+   16, 32, 64, 128, 256, 512, 1024, 2048, 4096
+};
+
+/* Vertices shaded for the row ordered 16x16 grid, per cache size */
+static const unsigned grid16_rows_shaded[Elements(cache_sizes)] = {
+   626, 576, 386, 325, 307, 289, 289, 289, 289
+};
+
+
+/**
+ * Indices for a grid of grid_size x grid_size quads, two triangles each,
+ * in row order.
+ */
+static unsigned *
+make_grid_indices(unsigned grid_size, unsigned *count)
+{
+   unsigned stride = grid_size + 1;
+   unsigned *indices = MALLOC(grid_size * grid_size * 6 * sizeof *indices);
+   unsigned x, y, n = 0;
+
+   for (y = 0; y < grid_size; y++) {
+      for (x = 0; x < grid_size; x++) {
+         unsigned v0 = y * stride + x;
+         unsigned v1 = v0 + 1;
+         unsigned v2 = v0 + stride;
+         unsigned v3 = v2 + 1;
+
+         indices[n++] = v0;
+         indices[n++] = v1;
+         indices[n++] = v2;
+         indices[n++] = v2;
+         indices[n++] = v1;
+         indices[n++] = v3;
+      }
+   }
+
+   *count = n;
+   return indices;
+}
+
+
+/**
+ * Shuffle whole triangles, the worst case for any vertex cache.
+ */
+static void
+shuffle_triangles(unsigned *indices, unsigned count)
+{
+   unsigned num_tris = count / 3;
+   unsigned i, j, k;
+
+   srand(0);
+
+   for (i = num_tris - 1; i > 0; i--) {
+      j = rand() % (i + 1);
+      for (k = 0; k < 3; k++) {
+         unsigned tmp = indices[i * 3 + k];
+         indices[i * 3 + k] = indices[j * 3 + k];
+         indices[j * 3 + k] = tmp;
+      }
+   }
+}
+
+
+static float *
+make_grid_vertices(unsigned grid_size)
+{
+   unsigned stride = grid_size + 1;
+   float *vertices = MALLOC(stride * stride * 4 * sizeof *vertices);
+   unsigned x, y;
+
+   for (y = 0; y < stride; y++) {
+      for (x = 0; x < stride; x++) {
+         float *v = &vertices[(y * stride + x) * 4];
+         v[0] = -1.0f + 2.0f * x / grid_size;
+         v[1] = -1.0f + 2.0f * y / grid_size;
+         v[2] = 0.0f;
+         v[3] = 1.0f;
+      }
+   }
+
+   return vertices;
+}
+
+
+static void
+draw_indexed(struct pipe_context *pipe,
+             const unsigned *indices,
+             unsigned count,
+             unsigned max_index)
+{
+   struct pipe_index_buffer ib;
+   struct pipe_draw_info info;
+
+   memset(&ib, 0, sizeof ib);
+   ib.index_size = 4;
+   ib.user_buffer = indices;
+   pipe->set_index_buffer(pipe, &ib);
+
+   util_draw_init_info(&info);
+   info.indexed = TRUE;
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.count = count;
+   info.min_index = 0;
+   info.max_index = max_index;
+   pipe->draw_vbo(pipe, &info);
+}
+
+
+/**
+ * Draw the mesh with each cache size and check the shaded vertex counts.
+ * expected_shaded is optional.  Returns FALSE on failure.
+ */
+static boolean
+test_mesh(struct pipe_context *pipe,
+          const char *name,
+          const unsigned *indices,
+          unsigned count,
+          unsigned num_vertices,
+          const unsigned *expected_shaded)
+{
+   struct draw_context *draw = softpipe_context(pipe)->draw;
+   uint64_t last_shaded = ~(uint64_t)0;
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < Elements(cache_sizes); i++) {
+      const struct draw_vertex_cache_counters *counters;
+      uint64_t indices_start, shaded_start;
+      uint64_t num_indices, num_shaded;
+      double shaded;
+
+      draw_set_vertex_cache_size(draw, cache_sizes[i]);
+
+      counters = draw_get_vertex_cache_counters(draw);
+      indices_start = counters->indices;
+      shaded_start = counters->shaded_vertices;
+
+      draw_indexed(pipe, indices, count, num_vertices - 1);
+      pipe->flush(pipe, NULL, 0);
+
+      counters = draw_get_vertex_cache_counters(draw);
+      num_indices = counters->indices - indices_start;
+      num_shaded = counters->shaded_vertices - shaded_start;
+      shaded = (double)num_shaded;
+
+      printf("%-8s cache %4u: %8.0f shaded, %.3f per index, %.3f per vertex\n",
+             name, cache_sizes[i], shaded,
+             shaded / (double)num_indices,
+             shaded / (double)num_vertices);
+
+      if (num_indices != count) {
+         printf("FAIL: %u indices drawn, %llu counted\n",
+                count, (unsigned long long)num_indices);
+         success = FALSE;
+      }
+
+      if (num_shaded < num_vertices || num_shaded > count) {
+         printf("FAIL: %llu shaded, expected between %u and %u\n",
+                (unsigned long long)num_shaded, num_vertices, count);
+         success = FALSE;
+      }
+
+      if (num_shaded > last_shaded) {
+         printf("FAIL: %llu shaded, more than with a smaller cache\n",
+                (unsigned long long)num_shaded);
+         success = FALSE;
+      }
+
+      if (cache_sizes[i] >= num_vertices && num_shaded != num_vertices) {
+         printf("FAIL: %llu shaded, expected each vertex once\n",
+                (unsigned long long)num_shaded);
+         success = FALSE;
+      }
+
+      if (expected_shaded && num_shaded != expected_shaded[i]) {
+         printf("FAIL: %llu shaded, expected %u\n",
+                (unsigned long long)num_shaded, expected_shaded[i]);
+         success = FALSE;
+      }
+
+      last_shaded = num_shaded;
+   }
+
+   return success;
+}
+
+
+/**
+ * Draw a grid_size x grid_size grid in row order and with its triangles
+ * shuffled.  Returns FALSE on failure.
+ */
+static boolean
+test_grid(struct pipe_context *pipe,
+          struct cso_context *cso,
+          unsigned grid_size,
+          const unsigned *expected_rows_shaded)
+{
+   struct pipe_resource *vbuf;
+   struct pipe_vertex_buffer vb;
+   unsigned num_vertices = (grid_size + 1) * (grid_size + 1);
+   unsigned count;
+   unsigned *indices;
+   float *vertices;
+   boolean success = TRUE;
+
+   vertices = make_grid_vertices(grid_size);
+   vbuf = pipe_buffer_create(pipe->screen, PIPE_BIND_VERTEX_BUFFER,
+                             PIPE_USAGE_DEFAULT,
+                             num_vertices * 4 * sizeof(float));
+   pipe_buffer_write(pipe, vbuf, 0, num_vertices * 4 * sizeof(float),
+                     vertices);
+   memset(&vb, 0, sizeof vb);
+   vb.stride = 4 * sizeof(float);
+   vb.buffer = vbuf;
+   cso_set_vertex_buffers(cso, 0, 1, &vb);
+
+   printf("grid %ux%u, %u vertices\n", grid_size, grid_size, num_vertices);
+
+   indices = make_grid_indices(grid_size, &count);
+   success &= test_mesh(pipe, "rows", indices, count, num_vertices,
+                        expected_rows_shaded);
+   shuffle_triangles(indices, count);
+   success &= test_mesh(pipe, "shuffled", indices, count, num_vertices,
+                        NULL);
+
+   cso_set_vertex_buffers(cso, 0, 0, NULL);
+
+   FREE(indices);
+   FREE(vertices);
+   pipe_resource_reference(&vbuf, NULL);
+
+   return success;
+}
+
+
+int main(int argc, char **argv)
+{
+   unsigned grid_size = argc > 1 ? atoi(argv[1]) : 128;
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct cso_context *cso;
+   struct pipe_resource templ, *target;
+   struct pipe_surface surf_tmpl;
+   struct pipe_framebuffer_state fb;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element velem;
+   const uint semantic_names[] = { TGSI_SEMANTIC_POSITION };
+   const uint semantic_indexes[] = { 0 };
+   void *vs, *fs;
+   boolean success = TRUE;
+
+   screen = softpipe_create_screen(null_sw_create());
+   pipe = screen->context_create(screen, NULL);
+   cso = cso_create_context(pipe);
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = WIDTH;
+   templ.height0 = HEIGHT;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   target = screen->resource_create(screen, &templ);
+
+   memset(&surf_tmpl, 0, sizeof surf_tmpl);
+   surf_tmpl.format = templ.format;
+   memset(&fb, 0, sizeof fb);
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = pipe->create_surface(pipe, target, &surf_tmpl);
+   cso_set_framebuffer(cso, &fb);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   cso_set_blend(cso, &blend);
+
+   memset(&dsa, 0, sizeof dsa);
+   cso_set_depth_stencil_alpha(cso, &dsa);
+
+   memset(&rast, 0, sizeof rast);
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.half_pixel_center = 1;
+   rast.depth_clip = 1;
+   cso_set_rasterizer(cso, &rast);
+
+   viewport.scale[0] = WIDTH / 2.0f;
+   viewport.scale[1] = HEIGHT / 2.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.scale[3] = 1.0f;
+   viewport.translate[0] = WIDTH / 2.0f;
+   viewport.translate[1] = HEIGHT / 2.0f;
+   viewport.translate[2] = 0.5f;
+   viewport.translate[3] = 0.0f;
+   cso_set_viewport(cso, &viewport);
+
+   vs = util_make_vertex_passthrough_shader(pipe, 1, semantic_names,
+                                            semantic_indexes);
+   fs = util_make_empty_fragment_shader(pipe);
+   cso_set_vertex_shader_handle(cso, vs);
+   cso_set_fragment_shader_handle(cso, fs);
+
+   memset(&velem, 0, sizeof velem);
+   velem.src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   cso_set_vertex_elements(cso, 1, &velem);
+
+   success &= test_grid(pipe, cso, 16, grid16_rows_shaded);
+   if (grid_size != 16)
+      success &= test_grid(pipe, cso, grid_size, NULL);
+
+   cso_release_all(cso);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->delete_fs_state(pipe, fs);
+   pipe_surface_reference(&fb.cbufs[0], NULL);
+   pipe_resource_reference(&target, NULL);
+   cso_destroy_context(cso);
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return success ? 0 : 1;
+}
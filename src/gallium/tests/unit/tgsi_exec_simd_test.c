@@ -0,0 +1,241 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+/*
+ * Runs the C, SSE2 and AVX tgsi_exec kernels over the same inputs,
+ * including NaNs, infinities, denormals and signed zeros, and checks that
+ * they all give bit identical results for every writemask.
+ *
+ * The one exception is which payload a NaN result carries when both
+ * operands of ADD, MUL, MAD or LRP are NaNs: x86 returns the first
+ * operand's, and compilers are free to swap the operands of commutative
+ * operations, so those results are compared as canonical NaNs.
+ *
+ * Usage: tgsi_exec_simd_test
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tgsi/tgsi_exec_simd.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+
+
+#define NUM_ROUNDS 64
+
+
+static const uint32_t special_values[] = {
+   0x00000000, /* +0 */
+   0x80000000, /* -0 */
+   0x3f800000, /* 1.0 */
+   0xbfc00000, /* -1.5 */
+   0x7f800000, /* +Inf */
+   0xff800000, /* -Inf */
+   0x7fc00000, /* quiet NaN */
+   0xffc00001, /* negative quiet NaN with a payload */
+   0x7f800001, /* signaling NaN */
+   0x00000001, /* smallest denormal */
+   0x807fffff, /* largest negative denormal */
+   0x00800000, /* smallest normal */
+   0x7f7fffff, /* largest finite */
+   0x0000ffff, /* small integers, for the bitwise and integer ops */
+   0xffffffff,
+   0x12345678,
+};
+
+
+struct op_info
+{
+   const char *name;
+   boolean commutative_float;
+};
+
+static const struct op_info binary_ops[TGSI_EXEC_SIMD_NUM_BINARY] = {
+   { "ADD", TRUE },
+   { "SUB", FALSE },
+   { "MUL", TRUE },
+   { "MIN", FALSE },
+   { "MAX", FALSE },
+   { "SLT", FALSE },
+   { "SGE", FALSE },
+   { "SEQ", FALSE },
+   { "SNE", FALSE },
+   { "FSLT", FALSE },
+   { "FSGE", FALSE },
+   { "FSEQ", FALSE },
+   { "FSNE", FALSE },
+   { "AND", FALSE },
+   { "OR", FALSE },
+   { "XOR", FALSE },
+   { "UADD", FALSE }
+};
+
+static const struct op_info trinary_ops[TGSI_EXEC_SIMD_NUM_TRINARY] = {
+   { "MAD", TRUE },
+   { "LRP", TRUE }
+};
+
+
+/**
+ * Fill the sources so that, over all the rounds, every lane of every
+ * channel sees every pair of special values in src0 and src1.
+ */
+static void
+fill_sources(struct tgsi_exec_vector *src, unsigned num_src, unsigned round)
+{
+   const unsigned n = Elements(special_values);
+   unsigned s, chan, j;
+
+   for (s = 0; s < num_src; s++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            unsigned lane = chan * TGSI_QUAD_SIZE + j;
+            unsigned v = (lane + round * (s + 1) + (round / n) * s) % n;
+            src[s].xyzw[chan].u[j] = special_values[v];
+         }
+      }
+   }
+}
+
+
+static void
+fill_dst(struct tgsi_exec_vector *dst)
+{
+   /* Untouched channels must keep this */
+   memset(dst, 0xa5, sizeof *dst);
+}
+
+
+static void
+canonicalize_nans(struct tgsi_exec_vector *v)
+{
+   unsigned chan, j;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         if ((v->xyzw[chan].u[j] & 0x7fffffff) > 0x7f800000)
+            v->xyzw[chan].u[j] = 0x7fc00000;
+      }
+   }
+}
+
+
+static boolean
+check(const struct op_info *op, const struct tgsi_exec_simd_funcs *funcs,
+      unsigned writemask, unsigned round,
+      struct tgsi_exec_vector *ref,
+      struct tgsi_exec_vector *res)
+{
+   unsigned chan, j;
+
+   if (op->commutative_float) {
+      canonicalize_nans(ref);
+      canonicalize_nans(res);
+   }
+
+   if (memcmp(ref, res, sizeof *ref) == 0)
+      return TRUE;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         if (ref->xyzw[chan].u[j] != res->xyzw[chan].u[j]) {
+            printf("%s %s: writemask 0x%x round %u chan %u lane %u: "
+                   "got 0x%08x, expected 0x%08x\n",
+                   funcs->name, op->name, writemask, round, chan, j,
+                   res->xyzw[chan].u[j], ref->xyzw[chan].u[j]);
+            return FALSE;
+         }
+      }
+   }
+
+   return FALSE;
+}
+
+
+static boolean
+test_funcs(const struct tgsi_exec_simd_funcs *funcs)
+{
+   const struct tgsi_exec_simd_funcs *ref_funcs = &tgsi_exec_simd_funcs_c;
+   struct tgsi_exec_vector src[3], ref, res;
+   unsigned op, writemask, round;
+   boolean success = TRUE;
+
+   for (round = 0; round < NUM_ROUNDS; round++) {
+      fill_sources(src, Elements(src), round);
+
+      for (writemask = 1; writemask <= TGSI_WRITEMASK_XYZW; writemask++) {
+         for (op = 0; op < TGSI_EXEC_SIMD_NUM_BINARY; op++) {
+            fill_dst(&ref);
+            fill_dst(&res);
+            ref_funcs->binary[op](&ref, &src[0], &src[1], writemask);
+            funcs->binary[op](&res, &src[0], &src[1], writemask);
+            success &= check(&binary_ops[op], funcs, writemask, round,
+                             &ref, &res);
+         }
+
+         for (op = 0; op < TGSI_EXEC_SIMD_NUM_TRINARY; op++) {
+            fill_dst(&ref);
+            fill_dst(&res);
+            ref_funcs->trinary[op](&ref, &src[0], &src[1], &src[2],
+                                   writemask);
+            funcs->trinary[op](&res, &src[0], &src[1], &src[2], writemask);
+            success &= check(&trinary_ops[op], funcs, writemask, round,
+                             &ref, &res);
+         }
+      }
+   }
+
+   printf("%s: %s\n", funcs->name, success ? "ok" : "FAILED");
+
+   return success;
+}
+
+
+int main(int argc, char **argv)
+{
+   const struct tgsi_exec_simd_funcs *funcs;
+   boolean success = TRUE;
+
+   util_cpu_detect();
+
+   funcs = tgsi_exec_simd_funcs_sse2();
+   if (funcs && util_cpu_caps.has_sse2)
+      success &= test_funcs(funcs);
+   else
+      printf("sse2: skipped\n");
+
+   funcs = tgsi_exec_simd_funcs_avx();
+   if (funcs && util_cpu_caps.has_avx)
+      success &= test_funcs(funcs);
+   else
+      printf("avx: skipped\n");
+
+   return success ? 0 : 1;
+}
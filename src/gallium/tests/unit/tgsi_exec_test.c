@@ -0,0 +1,240 @@
+/**************************************************************************
+ *
+ * Copyright 2014 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+/*
+ * Runs a few shaders through tgsi_exec with and without the instructions
+ * pre-decoded at bind time, checks that both give the same outputs and
+ * prints the instruction throughput of each.
+ *
+ * Usage: tgsi_exec_test [iterations]
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os/os_time.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_memory.h"
+
+
+#define NUM_INPUTS 4
+#define NUM_OUTPUTS 4
+#define NUM_CONSTS 16
+
+
+struct shader_test
+{
+   const char *name;
+   const char *text;
+};
+
+
+static const struct shader_test tests[] = {
+   {
+      "transform",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], COLOR\n"
+      "DCL CONST[0..15]\n"
+      "DCL TEMP[0..2]\n"
+      "IMM[0] FLT32 { 0.0, 1.0, 0.5, 16.0 }\n"
+      "  0: DP4 TEMP[0].x, CONST[0], IN[0]\n"
+      "  1: DP4 TEMP[0].y, CONST[1], IN[0]\n"
+      "  2: DP4 TEMP[0].z, CONST[2], IN[0]\n"
+      "  3: DP4 TEMP[0].w, CONST[3], IN[0]\n"
+      "  4: MOV OUT[0], TEMP[0]\n"
+      "  5: DP3 TEMP[1].x, CONST[4], IN[1]\n"
+      "  6: DP3 TEMP[1].y, CONST[5], IN[1]\n"
+      "  7: DP3 TEMP[1].z, CONST[6], IN[1]\n"
+      "  8: DP3 TEMP[2].x, TEMP[1], CONST[8]\n"
+      "  9: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+      " 10: MAD TEMP[2], CONST[9], TEMP[2].xxxx, CONST[10]\n"
+      " 11: MUL_SAT OUT[1], TEMP[2], CONST[11]\n"
+      " 12: END\n"
+   },
+   {
+      "arith",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL OUT[0], GENERIC[0]\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] FLT32 { 0.5, 2.0, -1.0, 3.0 }\n"
+      "  0: MUL TEMP[0], IN[0], IMM[0]\n"
+      "  1: MAD TEMP[1], TEMP[0], IN[1], IMM[0].yyyy\n"
+      "  2: ADD TEMP[2], TEMP[1], -IN[0]\n"
+      "  3: LRP TEMP[3], IMM[0].xxxx, TEMP[2], TEMP[1]\n"
+      "  4: MAX TEMP[0].xy, TEMP[3], IMM[0].zzzz\n"
+      "  5: MIN TEMP[0].zw, TEMP[3], IMM[0].wwww\n"
+      "  6: SLT TEMP[1], TEMP[0], IN[1]\n"
+      "  7: SUB TEMP[2].xyz, TEMP[0], TEMP[1]\n"
+      "  8: MAD TEMP[2].w, TEMP[0], |TEMP[1]|, IN[1]\n"
+      "  9: SGE TEMP[3], TEMP[2].wzyx, IMM[0].xxxx\n"
+      " 10: MUL TEMP[3], TEMP[3], TEMP[2]\n"
+      " 11: MOV_SAT OUT[0], TEMP[3]\n"
+      " 12: END\n"
+   },
+   {
+      "branch",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL OUT[0], GENERIC[0]\n"
+      "DCL TEMP[0..1]\n"
+      "IMM[0] FLT32 { 0.0, 1.0, 0.5, 0.25 }\n"
+      "  0: SLT TEMP[0].x, IN[0].xxxx, IMM[0].zzzz\n"
+      "  1: IF TEMP[0].xxxx :4\n"
+      "  2:   MUL TEMP[1], IN[0], IMM[0].wwww\n"
+      "  3: ELSE :5\n"
+      "  4:   ADD TEMP[1], IN[0], IMM[0].zzzz\n"
+      "  5: ENDIF\n"
+      "  6: FRC TEMP[1], TEMP[1]\n"
+      "  7: MOV OUT[0], TEMP[1]\n"
+      "  8: END\n"
+   }
+};
+
+
+static float
+rand_float(void)
+{
+   return (float)(rand() % 2000 - 1000) / 250.0f;
+}
+
+
+/**
+ * Run the shader iterations times, and return the nanoseconds it took.
+ */
+static int64_t
+run_shader(struct tgsi_exec_machine *mach,
+           const struct tgsi_token *tokens,
+           const float *consts,
+           boolean predecode,
+           unsigned iterations,
+           struct tgsi_exec_vector *outputs)
+{
+   const void *bufs[1];
+   unsigned sizes[1];
+   struct tgsi_exec_vector inputs[NUM_INPUTS];
+   int64_t start, end;
+   unsigned i, chan, j;
+
+   srand(0);
+   for (i = 0; i < NUM_INPUTS; i++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            inputs[i].xyzw[chan].f[j] = rand_float();
+         }
+      }
+   }
+
+   bufs[0] = consts;
+   sizes[0] = NUM_CONSTS * 4 * sizeof(float);
+
+   mach->Predecode = predecode;
+   tgsi_exec_machine_bind_shader(mach, tokens, NULL);
+   tgsi_exec_set_constant_buffers(mach, 1, bufs, sizes);
+
+   memcpy(mach->Inputs, inputs, sizeof inputs);
+
+   start = os_time_get_nano();
+   for (i = 0; i < iterations; i++) {
+      tgsi_exec_machine_run(mach);
+   }
+   end = os_time_get_nano();
+
+   memcpy(outputs, mach->Outputs, NUM_OUTPUTS * sizeof *outputs);
+
+   tgsi_exec_machine_bind_shader(mach, NULL, NULL);
+
+   return end - start;
+}
+
+
+int main(int argc, char **argv)
+{
+   unsigned iterations = argc > 1 ? atoi(argv[1]) : 100000;
+   struct tgsi_exec_machine *mach;
+   float consts[NUM_CONSTS * 4];
+   unsigned i;
+   int failed = 0;
+
+   srand(1);
+   for (i = 0; i < NUM_CONSTS * 4; i++) {
+      consts[i] = rand_float();
+   }
+
+   mach = tgsi_exec_machine_create();
+
+   for (i = 0; i < Elements(tests); i++) {
+      struct tgsi_token tokens[1024];
+      struct tgsi_exec_vector interp[NUM_OUTPUTS], decoded[NUM_OUTPUTS];
+      unsigned num_instructions;
+      int64_t interp_time, decoded_time;
+
+      if (!tgsi_text_translate(tests[i].text, tokens, Elements(tokens))) {
+         printf("%s: failed to parse\n", tests[i].name);
+         failed = 1;
+         continue;
+      }
+
+      /* Zero both so unwritten outputs compare equal */
+      memset(interp, 0, sizeof interp);
+      memset(decoded, 0, sizeof decoded);
+      memset(mach->Outputs, 0, NUM_OUTPUTS * sizeof *mach->Outputs);
+      interp_time = run_shader(mach, tokens, consts, FALSE, iterations,
+                               interp);
+      memset(mach->Outputs, 0, NUM_OUTPUTS * sizeof *mach->Outputs);
+      decoded_time = run_shader(mach, tokens, consts, TRUE, iterations,
+                                decoded);
+
+      tgsi_exec_machine_bind_shader(mach, tokens, NULL);
+      num_instructions = mach->NumInstructions;
+      tgsi_exec_machine_bind_shader(mach, NULL, NULL);
+
+      if (memcmp(interp, decoded, sizeof interp) != 0) {
+         printf("%s: outputs differ\n", tests[i].name);
+         failed = 1;
+      }
+
+      printf("%-10s %2u instructions: interpreted %7.1f Minstr/s, "
+             "pre-decoded %7.1f Minstr/s (%.2fx)\n",
+             tests[i].name, num_instructions,
+             (double)num_instructions * iterations * 1e3 / interp_time,
+             (double)num_instructions * iterations * 1e3 / decoded_time,
+             (double)interp_time / decoded_time);
+   }
+
+   tgsi_exec_machine_destroy(mach);
+
+   return failed;
+}
@@ -29,6 +29,7 @@
 #include "util/u_format.h"
 #include "util/u_half.h"
 #include "util/u_cpu_detect.h"
+#include "os/os_time.h"
 #include "rtasm/rtasm_cpu.h"
 
 /* don't use this for serious use */
@@ -46,6 +47,102 @@ static double rand_double()
    return v;
 }
 
+/* Return the linear conversion rate in millions of vertices per second. */
+static double bench_run(struct translate *translate, const void *src,
+                        unsigned src_stride, unsigned count, void *dst)
+{
+   unsigned iterations = 0;
+   int64_t start, end;
+
+   translate->set_buffer(translate, 0, src, src_stride, count - 1);
+
+   start = os_time_get();
+   do {
+      unsigned i;
+      for (i = 0; i < 64; ++i)
+         translate->run(translate, 0, count, 0, 0, dst);
+      iterations += 64;
+      end = os_time_get();
+   } while (end - start < 20000);
+
+   return (double)iterations * count / (end - start);
+}
+
+/* Translate a key with several elements, one of them the instance id, and
+ * check that the linear path gives the same bytes as the indexed path.
+ */
+static void
+test_multi_element(struct translate *(*create_fn)(const struct translate_key *key),
+                   const float *src, unsigned count, const unsigned *elts,
+                   unsigned char *linear, unsigned char *indexed,
+                   unsigned *passed, unsigned *total)
+{
+   /* A vertex is four floats, four bytes and two shorts */
+   const unsigned src_stride = 24;
+   const unsigned instance_id = 7;
+   struct translate_key key;
+   struct translate *translate;
+   unsigned fail = 0;
+
+   memset(&key, 0, sizeof key);
+   key.nr_elements = 5;
+
+   key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[0].input_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   key.element[0].output_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   key.element[0].input_offset = 0;
+   key.element[0].output_offset = 0;
+
+   key.element[1].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[1].input_format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   key.element[1].output_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   key.element[1].input_offset = 16;
+   key.element[1].output_offset = 16;
+
+   key.element[2].type = TRANSLATE_ELEMENT_INSTANCE_ID;
+   key.element[2].input_format = PIPE_FORMAT_R32_USCALED;
+   key.element[2].output_format = PIPE_FORMAT_R32_USCALED;
+   key.element[2].output_offset = 32;
+
+   key.element[3].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[3].input_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   key.element[3].output_format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   key.element[3].input_offset = 0;
+   key.element[3].output_offset = 36;
+
+   key.element[4].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[4].input_format = PIPE_FORMAT_R16G16_SNORM;
+   key.element[4].output_format = PIPE_FORMAT_R32G32_FLOAT;
+   key.element[4].input_offset = 20;
+   key.element[4].output_offset = 40;
+
+   key.output_stride = 48;
+
+   translate = create_fn(&key);
+   if (!translate)
+      return;
+
+   memset(linear, 0xcd, count * key.output_stride);
+   memset(indexed, 0xab, count * key.output_stride);
+
+   translate->set_buffer(translate, 0, src, src_stride, count - 1);
+   translate->run(translate, 0, count, 0, instance_id, linear);
+   translate->run_elts(translate, elts, count, 0, instance_id, indexed);
+
+   if (memcmp(linear, indexed, count * key.output_stride))
+      fail = 1;
+   else if (*(const unsigned *)(linear + (count - 1) * key.output_stride + 32) != instance_id)
+      fail = 1;
+
+   printf("%s: multi-element with instance id\n", fail ? "FAIL" : "PASS");
+
+   if (!fail)
+      ++*passed;
+   ++*total;
+
+   translate->release(translate);
+}
+
 int main(int argc, char** argv)
 {
    struct translate *(*create_fn)(const struct translate_key *key) = 0;
@@ -61,6 +158,11 @@ int main(int argc, char** argv)
    uint16_t *half_buffer;
    unsigned * elts;
    unsigned count = 4;
+   /* odd, so that the linear path has a tail after the batched loop */
+   unsigned linear_count = 13;
+   unsigned bench_count = 1024;
+   unsigned char *bench_buffer[2];
+   boolean bench = FALSE;
    unsigned i, j, k;
    unsigned passed = 0;
    unsigned total = 0;
@@ -70,6 +172,9 @@ int main(int argc, char** argv)
 
    util_cpu_detect();
 
+   if (argc > 2 && !strcmp(argv[2], "bench"))
+      bench = TRUE;
+
    if(argc <= 1)
    {}
    else if (!strcmp(argv[1], "generic"))
@@ -82,6 +187,8 @@ int main(int argc, char** argv)
       util_cpu_caps.has_sse2 = 0;
       util_cpu_caps.has_sse3 = 0;
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_avx2 = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse"))
@@ -94,6 +201,8 @@ int main(int argc, char** argv)
       util_cpu_caps.has_sse2 = 0;
       util_cpu_caps.has_sse3 = 0;
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_avx2 = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse2"))
@@ -105,6 +214,8 @@ int main(int argc, char** argv)
       }
       util_cpu_caps.has_sse3 = 0;
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_avx2 = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse3"))
@@ -115,6 +226,8 @@ int main(int argc, char** argv)
          return 2;
       }
       util_cpu_caps.has_sse4_1 = 0;
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_avx2 = 0;
       create_fn = translate_sse2_create;
    }
    else if (!strcmp(argv[1], "sse4.1"))
@@ -124,12 +237,33 @@ int main(int argc, char** argv)
          printf("Error: CPU doesn't support SSE4.1 (test with qemu)\n");
          return 2;
       }
+      util_cpu_caps.has_avx = 0;
+      util_cpu_caps.has_avx2 = 0;
+      create_fn = translate_sse2_create;
+   }
+   else if (!strcmp(argv[1], "avx"))
+   {
+      if(!util_cpu_caps.has_avx || !rtasm_cpu_has_sse())
+      {
+         printf("Error: CPU doesn't support AVX (test with qemu)\n");
+         return 2;
+      }
+      util_cpu_caps.has_avx2 = 0;
+      create_fn = translate_sse2_create;
+   }
+   else if (!strcmp(argv[1], "avx2"))
+   {
+      if(!util_cpu_caps.has_avx2 || !rtasm_cpu_has_sse())
+      {
+         printf("Error: CPU doesn't support AVX2 (test with qemu)\n");
+         return 2;
+      }
       create_fn = translate_sse2_create;
    }
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [generic|x86|nosse|sse|sse2|sse3|sse4.1]\n");
+      printf("Usage: ./translate_test [generic|x86|nosse|sse|sse2|sse3|sse4.1|avx|avx2] [bench]\n");
       return 2;
    }
 
@@ -141,7 +275,11 @@ int main(int argc, char** argv)
    double_buffer = align_malloc(buffer_size, 4096);
    half_buffer = align_malloc(buffer_size, 4096);
 
-   elts = align_malloc(count * sizeof *elts, 4096);
+   elts = align_malloc(linear_count * sizeof *elts, 4096);
+
+   /* large enough for bench_count vertices of the widest format */
+   bench_buffer[0] = align_malloc(bench_count * 32, 4096);
+   bench_buffer[1] = align_malloc(bench_count * 32, 4096);
 
    key.nr_elements = 1;
    key.element[0].input_buffer = 0;
@@ -165,7 +303,7 @@ int main(int argc, char** argv)
    for (i = 0; i < buffer_size / sizeof(double); ++i)
       half_buffer[i] = util_float_to_half((float) rand_double());
 
-   for (i = 0; i < count; ++i)
+   for (i = 0; i < linear_count; ++i)
       elts[i] = i;
 
    for (output_format = 1; output_format < PIPE_FORMAT_COUNT; ++output_format)
@@ -199,6 +337,7 @@ int main(int argc, char** argv)
          unsigned used_generic = 0;
          unsigned input_normalized = 0;
          boolean input_is_float = FALSE;
+         double rate = 0.0, generic_rate = 0.0;
 
          if (!input_format_desc
                || !input_format_desc->fetch_rgba_float
@@ -309,6 +448,46 @@ int main(int argc, char** argv)
             }
          }
 
+         /* The linear path converts several vertices per iteration; it must
+          * give the same bytes as the indexed path, which doesn't.
+          */
+         if (!fail)
+         {
+            translate[0]->set_buffer(translate[0], 0, buffer[0], input_format_size, linear_count - 1);
+            translate[0]->run(translate[0], 0, linear_count, 0, 0, buffer[3]);
+            translate[0]->run_elts(translate[0], elts, linear_count, 0, 0, buffer[4]);
+            if (memcmp(buffer[3], buffer[4], linear_count * output_format_size))
+            {
+               printf("FAIL: %s -> %s: linear and indexed results differ\n",
+                     input_format_desc->name, output_format_desc->name);
+               fail = 1;
+            }
+         }
+
+         if (bench && !fail)
+         {
+            struct translate *generic;
+
+            key.element[0].input_format = input_format;
+            key.element[0].output_format = output_format;
+            key.output_stride = output_format_size;
+            generic = translate_generic_create(&key);
+
+            for (i = 0; i < bench_count * input_format_size; ++i)
+               bench_buffer[0][i] = buffer[0][i % (linear_count * input_format_size)];
+
+            rate = bench_run(translate[0], bench_buffer[0], input_format_size, bench_count, bench_buffer[1]);
+            if (generic)
+            {
+               generic_rate = bench_run(generic, bench_buffer[0], input_format_size, bench_count, bench_buffer[1]);
+               generic->release(generic);
+            }
+
+            printf("BENCH: %s -> %s: %.1f Mvert/s, generic %.1f Mvert/s (%.2fx)\n",
+                  input_format_desc->name, output_format_desc->name,
+                  rate, generic_rate, generic_rate ? rate / generic_rate : 0.0);
+         }
+
          if (!fail)
             ++passed;
          ++total;
@@ -319,6 +498,9 @@ int main(int argc, char** argv)
       }
    }
 
+   test_multi_element(create_fn, float_buffer, linear_count, elts,
+                      buffer[1], buffer[2], &passed, &total);
+
    printf("%u/%u tests passed for translate_%s\n", passed, total, argv[1]);
    return passed != total;
 }
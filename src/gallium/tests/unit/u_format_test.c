@@ -28,12 +28,16 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <float.h>
 
+#include "util/u_cpu_detect.h"
 #include "util/u_half.h"
 #include "util/u_format.h"
 #include "util/u_format_tests.h"
 #include "util/u_format_s3tc.h"
+#include "util/u_string.h"
+#include "util/u_tile_simd.h"
 
 
 static boolean
@@ -679,6 +683,247 @@ test_one_func(const struct util_format_description *format_desc,
 }
 
 
+/*
+ * u_tile_simd kernels.  Each test case is replicated over enough pixels to
+ * go through both the vector loop and the scalar tail.
+ */
+
+#define TILE_TEST_PIXELS 19
+
+static const struct util_tile_simd_funcs *tile_funcs;
+static int tile_format;
+
+
+static boolean
+is_depth_format(const struct util_format_description *format_desc)
+{
+   return format_desc->colorspace == UTIL_FORMAT_COLORSPACE_ZS;
+}
+
+
+static boolean
+test_format_tile_unpack(const struct util_format_description *format_desc,
+                        const struct util_format_test_case *test)
+{
+   const unsigned size = format_desc->block.bits / 8;
+   uint8_t packed[TILE_TEST_PIXELS * UTIL_FORMAT_MAX_PACKED_BYTES];
+   float unpacked[TILE_TEST_PIXELS][4];
+   unsigned i, j;
+   boolean success = TRUE;
+
+   for (i = 0; i < TILE_TEST_PIXELS; ++i) {
+      memcpy(packed + i * size, test->packed, size);
+   }
+
+   tile_funcs->unpack[tile_format](&unpacked[0][0], packed, TILE_TEST_PIXELS);
+
+   for (i = 0; i < TILE_TEST_PIXELS; ++i) {
+      for (j = 0; j < 4; ++j) {
+         /* Depth comes back in all channels, and stencil is dropped. */
+         double expected = is_depth_format(format_desc) ?
+            test->unpacked[0][0][0] : test->unpacked[0][0][j];
+
+         if (!compare_float(unpacked[i][j], (float) expected)) {
+            success = FALSE;
+         }
+      }
+   }
+
+   if (!success) {
+      for (i = 0; i < TILE_TEST_PIXELS; ++i) {
+         printf("%s{%f, %f, %f, %f}", i ? ", " : "FAILED: ",
+                unpacked[i][0], unpacked[i][1], unpacked[i][2], unpacked[i][3]);
+      }
+      printf(" obtained\n");
+      print_unpacked_rgba_doubl(format_desc, "        ", test->unpacked, " expected\n");
+   }
+
+   return success;
+}
+
+
+static boolean
+test_format_tile_pack(const struct util_format_description *format_desc,
+                      const struct util_format_test_case *test)
+{
+   const unsigned size = format_desc->block.bits / 8;
+   float unpacked[TILE_TEST_PIXELS][4];
+   uint8_t packed[TILE_TEST_PIXELS * UTIL_FORMAT_MAX_PACKED_BYTES];
+   unsigned i, j;
+   boolean success = TRUE;
+
+   for (i = 0; i < TILE_TEST_PIXELS; ++i) {
+      for (j = 0; j < 4; ++j) {
+         unpacked[i][j] = (float) test->unpacked[0][0][j];
+      }
+   }
+
+   memset(packed, 0, sizeof packed);
+   tile_funcs->pack[tile_format](packed, &unpacked[0][0], TILE_TEST_PIXELS);
+
+   for (i = 0; i < TILE_TEST_PIXELS; ++i) {
+      for (j = 0; j < size; ++j) {
+         if ((test->packed[j] & test->mask[j]) !=
+             (packed[i * size + j] & test->mask[j])) {
+            if (success) {
+               print_packed(format_desc, "FAILED: ", packed + i * size, " obtained\n");
+               print_packed(format_desc, "        ", test->packed, " expected\n");
+            }
+            success = FALSE;
+         }
+      }
+   }
+
+   /* Ignore NaN */
+   if (util_is_double_nan(test->unpacked[0][0][0]))
+      success = TRUE;
+
+   return success;
+}
+
+
+/* Random and exhaustive inputs.  The 16-bit formats see every value. */
+#define TILE_EXACT_BYTES (65536 * 4)
+#define TILE_EXACT_PIXELS 65533
+
+
+static unsigned
+rand_bits(void)
+{
+   return ((unsigned) rand() << 16) ^ (unsigned) rand();
+}
+
+
+/**
+ * Check that a kernel gives exactly the same bits as the reference: the
+ * util_format functions for the C kernels of color formats, otherwise the
+ * C kernels.
+ */
+static boolean
+test_tile_exact(const struct util_format_description *format_desc,
+                const char *name)
+{
+   const unsigned size = format_desc->block.bits / 8;
+   const unsigned n = MIN2(TILE_EXACT_BYTES / size, TILE_EXACT_PIXELS);
+   const boolean c_kernels = tile_funcs == &util_tile_simd_funcs_c;
+   uint16_t *packed = malloc(TILE_EXACT_BYTES);
+   uint8_t *packed_ref = malloc(TILE_EXACT_BYTES);
+   float *unpacked = malloc(n * 4 * sizeof(float));
+   float *unpacked_ref = malloc(n * 4 * sizeof(float));
+   boolean success = TRUE;
+   unsigned i;
+
+   if (c_kernels && is_depth_format(format_desc))
+      goto out;
+
+   printf("Testing util_format_%s_%s exactness ...\n",
+          format_desc->short_name, name);
+   fflush(stdout);
+
+   srand(0);
+   for (i = 0; i < TILE_EXACT_BYTES / 2; ++i) {
+      packed[i] = i < 65536 ? i : rand();
+   }
+
+   tile_funcs->unpack[tile_format](unpacked, packed, n);
+   if (c_kernels)
+      format_desc->unpack_rgba_float(unpacked_ref, 0, (uint8_t *) packed, 0, n, 1);
+   else
+      util_tile_simd_funcs_c.unpack[tile_format](unpacked_ref, packed, n);
+
+   if (memcmp(unpacked, unpacked_ref, n * 4 * sizeof(float)) != 0) {
+      printf("FAILED: unpack differs from the reference\n");
+      success = FALSE;
+   }
+
+   if (tile_funcs->pack[tile_format]) {
+      /* Arbitrary bit patterns, then mostly values around [0, 1]. */
+      for (i = 0; i < n * 4; ++i) {
+         union fi fi;
+
+         if (i < n)
+            fi.ui = rand_bits();
+         else
+            fi.f = (float) ((int) (rand_bits() % 3000000) - 1000000) / 1000000.0f;
+         unpacked[i] = fi.f;
+      }
+
+      memset(packed, 0, TILE_EXACT_BYTES);
+      memset(packed_ref, 0, TILE_EXACT_BYTES);
+      tile_funcs->pack[tile_format](packed, unpacked, n);
+      if (c_kernels)
+         format_desc->pack_rgba_float(packed_ref, 0, unpacked, 0, n, 1);
+      else
+         util_tile_simd_funcs_c.pack[tile_format](packed_ref, unpacked, n);
+
+      if (memcmp(packed, packed_ref, n * size) != 0) {
+         printf("FAILED: pack differs from the reference\n");
+         success = FALSE;
+      }
+   }
+
+out:
+   free(packed);
+   free(packed_ref);
+   free(unpacked);
+   free(unpacked_ref);
+   return success;
+}
+
+
+static boolean
+test_tile_simd(const struct util_format_description *format_desc)
+{
+   const struct util_tile_simd_funcs *funcs[4];
+   unsigned num_funcs = 0;
+   unsigned i;
+   boolean success = TRUE;
+
+   tile_format = util_tile_simd_format(format_desc->format);
+   if (tile_format < 0)
+      return TRUE;
+
+   util_cpu_detect();
+
+   funcs[num_funcs++] = &util_tile_simd_funcs_c;
+   if (util_cpu_caps.has_sse2 && util_tile_simd_funcs_sse2())
+      funcs[num_funcs++] = util_tile_simd_funcs_sse2();
+   if (util_cpu_caps.has_ssse3 && util_tile_simd_funcs_ssse3())
+      funcs[num_funcs++] = util_tile_simd_funcs_ssse3();
+   if (util_cpu_caps.has_avx2 && util_tile_simd_funcs_avx2())
+      funcs[num_funcs++] = util_tile_simd_funcs_avx2();
+
+   for (i = 0; i < num_funcs; ++i) {
+      char name[64];
+
+      tile_funcs = funcs[i];
+
+      if (tile_funcs->unpack[tile_format]) {
+         util_snprintf(name, sizeof name, "tile_unpack_%s", tile_funcs->name);
+         if (!test_one_func(format_desc, &test_format_tile_unpack, name)) {
+            success = FALSE;
+         }
+      }
+
+      if (tile_funcs->pack[tile_format]) {
+         util_snprintf(name, sizeof name, "tile_pack_%s", tile_funcs->name);
+         if (!test_one_func(format_desc, &test_format_tile_pack, name)) {
+            success = FALSE;
+         }
+      }
+
+      if (tile_funcs->unpack[tile_format]) {
+         util_snprintf(name, sizeof name, "tile_%s", tile_funcs->name);
+         if (!test_tile_exact(format_desc, name)) {
+            success = FALSE;
+         }
+      }
+   }
+
+   return success;
+}
+
+
 static boolean
 test_all(void)
 {
@@ -719,6 +964,10 @@ test_all(void)
       TEST_ONE_FUNC(pack_s_8uint);
 
 #     undef TEST_ONE_FUNC
+
+      if (!test_tile_simd(format_desc)) {
+         success = FALSE;
+      }
    }
 
    return success;